@@ -26,7 +26,7 @@
 
 #include "stdafx.h"
 
-#include "iapi.h"
+#include "GhostscriptApi.h"
 #include <shellapi.h>
 #include <errno.h>
 #include <stdio.h>
@@ -42,6 +42,30 @@
 #include "Userenv.h"
 #pragma comment(lib, "userenv.lib")
 #include "crtdbg.h"
+#include "Configuration.h"
+#include "SpoolBuffer.h"
+#include "Sidecar.h"
+#include "Diagnostics.h"
+#include "JobResult.h"
+#include "Profiles.h"
+#include "PdfaSupport.h"
+#include "OutputWriter.h"
+#include "OutputStream.h"
+#include "ConversionCache.h"
+#include "CompletionJournal.h"
+#include "TempFiles.h"
+#include "IoBackend.h"
+#include "FanOut.h"
+#include "StagingQueue.h"
+#include "ProgressiveDelivery.h"
+#include "PdfPipeline.h"
+#include "PdfAppend.h"
+#include "OutputNaming.h"
+#include "RecoveryJournal.h"
+#include "DirectoryIndex.h"
+#include "JobRouter.h"
+#include <fcntl.h>
+#include <vector>
 
 #ifdef CC_PDF_CONVERTER
 #define PRODUCT_NAME	"CC PDF Converter"
@@ -63,10 +87,26 @@ char cBuffer[MAX_PATH * 2 + 1];
 int nBuffer = 0;
 /// Current location in the initial buffer
 int nInBuffer = 0;
-/// Size of error string buffer
-#define MAX_ERR		1023
-/// Error string buffer
-char cErr[MAX_ERR + 1];
+/// Default for the memory a job may use to keep its input (job.memory); the rest is spilled to disk
+#define DEFAULT_JOB_MEMORY	(16 * 1024 * 1024)
+/// Exit code when the conversion went over its memory limit (limit.memory)
+#define EXIT_LIMIT_MEMORY	3
+/// Exit code when the conversion went over its time limit (limit.time)
+#define EXIT_LIMIT_TIME		4
+/// Exit code when the output could not be streamed to its target
+#define EXIT_STREAM_FAILED	5
+/// Exit code when the output could not be published as its final name
+#define EXIT_PUBLISH_FAILED	6
+/// Default for how many folders are listed at a time when the directory index is built (dirindex.threads)
+#define DEFAULT_INDEX_THREADS	8
+/// true when running as a helper process for another conversion (see Sidecar)
+bool bRenderWorker = false;
+/// GhostScript output and errors of the current job
+Diagnostics diagnostics;
+/// Result of the current job
+JobResult jobResult;
+/// Index of the level 1 and level 2 folders under the root
+DirectoryIndex directoryIndex;
 
 // File to write
 TCHAR docName[MAX_PATH];
@@ -78,107 +118,18 @@ TCHAR path1[MAX_PATH];
 TCHAR path2[MAX_PATH];
 // File to write
 TCHAR fullFileName[MAX_PATH];
+/// The file GhostScript writes (with .inprogress added): the PDF itself, or its staged copy
+TCHAR cOutputFile[MAX_PATH];
 // TRUE of user pressed OK, not sure if we really need this.
 boolean okPressed;
 
-#ifdef _DEBUG
-
-
-#include <iostream>
-#include <map>
-#include <string>
-
-namespace configuration
-  {
-
-  //---------------------------------------------------------------------------
-  // The configuration::data is a simple map string (key, value) pairs.
-  // The file is stored as a simple listing of those pairs, one per line.
-  // The key is separated from the value by an equal sign '='.
-  // Commentary begins with the first non-space character on the line a hash or
-  // semi-colon ('#' or ';').
-  //
-  // Example:
-  //   # This is an example
-  //   source.directory = C:\Documents and Settings\Jennifer\My Documents\
-  //   file.types = *.jpg;*.gif;*.png;*.pix;*.tif;*.bmp
-  //
-  // Notice that the configuration file format does not permit values to span
-  // more than one line, commentary at the end of a line, or [section]s.
-  //   
-  struct data: std::map <std::string, std::string>
-    {
-    // Here is a little convenience method...
-    bool iskey( const std::string& s ) const
-      {
-      return count( s ) != 0;
-      }
-    };
-
-  //---------------------------------------------------------------------------
-  // The extraction operator reads configuration::data until EOF.
-  // Invalid data is ignored.
-  //
-  std::istream& operator >> ( std::istream& ins, data& d )
-    {
-    std::string s, key, value;
-
-    // For each (key, value) pair in the file
-    while (std::getline( ins, s ))
-      {
-      std::string::size_type begin = s.find_first_not_of( " \f\t\v" );
-
-      // Skip blank lines
-      if (begin == std::string::npos) continue;
-
-      // Skip commentary
-      if (std::string( "#;" ).find( s[ begin ] ) != std::string::npos) continue;
-
-      // Extract the key value
-      std::string::size_type end = s.find( '=', begin );
-      key = s.substr( begin, end - begin );
-
-      // (No leading or trailing whitespace allowed)
-      key.erase( key.find_last_not_of( " \f\t\v" ) + 1 );
-
-      // No blank keys allowed
-      if (key.empty()) continue;
-
-      // Extract the value (no leading or trailing whitespace allowed)
-      begin = s.find_first_not_of( " \f\n\r\t\v", end + 1 );
-	  if (begin == 0xFFFFFFFF) {
-		  value = "";
-	  } else {
-		end   = s.find_last_not_of(  " \f\n\r\t\v" ) + 1;
-		value = s.substr( begin, end - begin );
-	  }
-      // Insert the properly extracted (key, value) pair into the map
-      d[ key ] = value;
-      }
-
-    return ins;
-    }
-
-
-//---------------------------------------------------------------------------
-  // The insertion operator writes all configuration::data to stream.
-  //
-  std::ostream& operator << ( std::ostream& outs, const data& d )
-    {
-    data::const_iterator iter;
-    for (iter = d.begin(); iter != d.end(); iter++)
-      outs << iter->first << " = " << iter->second << '\n';
-    return outs;
-    }
-}
-
-	// Read-only properties
-  	  configuration::data myconfigdata;
-
-	  // Writable properties
-  	  configuration::data myconfigdata2;
+// Read-only properties
+configuration::data myconfigdata;
 
+// Writable properties
+configuration::data myconfigdata2;
 
+#ifdef _DEBUG
 /**
 @brief This function outputs an error via OutputDebugStringn
 @param pBefore Text to add before the error
@@ -216,80 +167,66 @@ bool ExistsAsFolder(LPCTSTR pPath)
 }
 //////////////////////////////////////////////////////////////////////////
 
-#define TEMP_FILENAME "ccprint_"
-#define TEMP_EXTENSION "pdf"
-
-void CleanTempFiles ()
+/**
+@return Time since this process was created (in milliseconds)
+*/
+static double GetProcessAge()
 {
-	char sTempFolder[MAX_PATH];
-	GetTempPath(MAX_PATH, sTempFolder);
-
-	char sFileToFind[MAX_PATH];
-	sprintf_s (sFileToFind, "%s%s*.%s", sTempFolder, TEMP_FILENAME, TEMP_EXTENSION);
-
-	struct _finddata64i32_t finddata;
-	intptr_t hFind = _findfirst (sFileToFind, &finddata);
-	int ret = (int)hFind;
-	char sFullFilename[MAX_PATH];
-
-	while (ret != -1) {
-		sprintf_s (sFullFilename, "%s%s", sTempFolder, finddata.name);
-		DeleteFile (sFullFilename);						// Deliberately ignore the return value
-		ret = _findnext (hFind, &finddata);				// Find the next file
-	}
-
-	_findclose (hFind);
+	FILETIME ftCreate, ftExit, ftKernel, ftUser, ftNow;
+	if (!GetProcessTimes(GetCurrentProcess(), &ftCreate, &ftExit, &ftKernel, &ftUser))
+		return 0;
+	GetSystemTimeAsFileTime(&ftNow);
+	ULARGE_INTEGER uCreate, uNow;
+	uCreate.LowPart = ftCreate.dwLowDateTime;
+	uCreate.HighPart = ftCreate.dwHighDateTime;
+	uNow.LowPart = ftNow.dwLowDateTime;
+	uNow.HighPart = ftNow.dwHighDateTime;
+	// FILETIME counts 100 nanosecond units
+	return (uNow.QuadPart - uCreate.QuadPart) / 10000.0;
 }
 
+/// Prefix of the temporary files of streamed jobs
+#define STREAM_FILENAME "ccstream_"
+
 
 //////////////////////////////////////////////////////////////////////////
 
 /**
-@brief Callback function used by GhostScript to retrieve more data from the input buffer; stops at newlines
-@param instance Pointer to the GhostScript instance (not used)
+@brief Callback function used by GhostScript to retrieve more data from the spool buffer
+@param instance Pointer to the SpoolReader used by this GhostScript instance
 @param buf Buffer to fill with data
 @param len Length of requested data
 @return Size of retrieved data (in bytes), 0 when there's no more data
 */
 static int GSDLLCALL my_in(void *instance, char *buf, int len)
 {
-	// Initialize variables
-	int ch;
-	int count = 0;
-	char* pStart = buf;
-	// Read until we reached the wanted size...
-	while (count < len) 
-	{
-		// Is there still data in the initial buffer?
-		if (nBuffer > nInBuffer)
-			// Yes, read from there
-			ch = cBuffer[nInBuffer++];
-		else
-			// No, get more data
-			ch = fgetc(fileInput);
-		if (ch == EOF)
-			// That's it
-			return 0;
-		// Put the character in the buffer and increate the countn
-		*buf++ = ch;
-		count++;
-		if (ch == '\n')
-			// Stop on newlines
-			break;
-	}
+	// Get whatever the spool buffer has (waits for the input if it has nothing yet)
+	int count = (int)((SpoolReader*)instance)->Read(buf, len);
 #ifdef _DEBUG
 	// Leave a trace of the data (debug mode)
-	WriteOutput("", pStart, count);
+	WriteOutput("", buf, count);
 	if (pSave != NULL)
 	{
 		// Also save the data into the save file (debug mode)
-		fwrite(pStart, 1, count, pSave);
+		fwrite(buf, 1, count, pSave);
 	}
 #endif
 	// That's it
 	return count;
 }
 
+/**
+@brief Callback function used by GhostScript in a helper process to read its input pipe
+@param instance Pointer to the input FILE
+@param buf Buffer to fill with data
+@param len Length of requested data
+@return Size of retrieved data (in bytes), 0 when there's no more data
+*/
+static int GSDLLCALL file_in(void *instance, char *buf, int len)
+{
+	return (int)fread(buf, 1, len, (FILE*)instance);
+}
+
 /**
 @brief Callback function used by GhostScript to output notes and warnings
 @param instance Pointer to the GhostScript instance (not used)
@@ -306,6 +243,8 @@ static int GSDLLCALL my_out(void *instance, const char *str, int len)
 	// Trace also (debug mode)
 	WriteOutput("OUT: ", str, len);
 #endif
+	// Keep the last lines (a fixed amount, so a noisy job doesn't cost more)
+	diagnostics.Add(Diagnostics::StreamOut, str, len);
 
 	// That's it
 	return len;
@@ -326,10 +265,13 @@ static int GSDLLCALL my_err(void *instance, const char *str, int len)
 	fflush(stderr);
 	// Trace too (debug mode)
 	WriteOutput("ERR: ", str, len);
+#else
+	// Helper processes pass their errors on to the main process through stderr
+	if (bRenderWorker)
+		fwrite(str, 1, len, stderr);
 #endif
-	// Keep the error in cErr for later handling
-	int nAdd = min(len, (int)(MAX_ERR - strlen(cErr)));
-	strncat_s(cErr, str, MAX_ERR);
+	// Keep the error for later handling
+	diagnostics.Add(Diagnostics::StreamErr, str, len);
 	// OK
 	return len;
 }
@@ -427,6 +369,11 @@ const char* ARGS[] =
 	"-"
 };
 
+/// GhostScript's e_Quit code (see ierrors.h); returned when the input ends with quit, so not an error
+#define GS_QUIT		(-101)
+/// Checks a GhostScript return code for success
+#define GS_SUCCEEDED(n)		(((n) == 0) || ((n) == GS_QUIT))
+
 void combine(TCHAR* destination, const TCHAR* pathPart1, const TCHAR* pathPart2)
 {
 	if(pathPart1 == NULL && pathPart2 == NULL) {
@@ -457,36 +404,26 @@ void combine(TCHAR* destination, const TCHAR* pathPart1, const TCHAR* pathPart2)
 	}
 }
 
-void FillChildDirectories(HWND LIST, TCHAR * directoryPath) {
-	TCHAR filePattern[MAX_PATH] = { 0 };
-	WIN32_FIND_DATA FindFileData;
-
-	combine(filePattern, directoryPath, "*");
-
-	HANDLE hFind = FindFirstFile(filePattern, &FindFileData);
-	if (hFind == INVALID_HANDLE_VALUE) 
-	{
-		printf ("FindFirstFile failed (%d)\n", GetLastError());
-		return; //????
-	} 
-	else 
-	{
-		// do this later  FindClose(hFind);
-	}
-
+/**
+	@param LIST The list box to fill
+	@param sNode The folder whose sub-folders go in the list, as named in the directory index ("" for the root)
+*/
+void FillChildDirectories(HWND LIST, const std::string& sNode) {
+	// From the index, so the folder is only listed if it changed
+	const std::vector<std::string>& children = directoryIndex.GetChildren(sNode);
+
+	// All at once: room for everything up front, and drawn once at the end
+	SendMessage(LIST, WM_SETREDRAW, FALSE, 0);
+	SendMessage(LIST, LB_RESETCONTENT, 0, 0);
+	size_t nChars = 0;
+	for (std::vector<std::string>::const_iterator i = children.begin(); i != children.end(); i++)
+		nChars += (*i).size() + 1;
+	SendMessage(LIST, LB_INITSTORAGE, children.size(), nChars);
 	int Index = 0;
-	BOOL result;
-	do {
-
-		if (_tcscmp(FindFileData.cFileName, _T("..")) != 0 
-			&& _tcscmp(FindFileData.cFileName, _T(".")) != 0 
-			&& FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-		{
-
-			SendMessage(LIST, LB_INSERTSTRING, Index++, (LPARAM)FindFileData.cFileName);
-		}
-		result = FindNextFile(hFind, &FindFileData);
-	} while (result);
+	for (std::vector<std::string>::const_iterator i = children.begin(); i != children.end(); i++)
+		SendMessage(LIST, LB_INSERTSTRING, Index++, (LPARAM)(*i).c_str());
+	SendMessage(LIST, WM_SETREDRAW, TRUE, 0);
+	InvalidateRect(LIST, NULL, TRUE);
 
 	// Select if only one
 	if (Index == 1) {
@@ -547,7 +484,7 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
 					combine(path1, path, text);
 
 					HWND List2 = GetDlgItem(hDlg, IDC_LIST2);
-					FillChildDirectories(List2, path1);
+					FillChildDirectories(List2, text);
 
 					// Save selected level 1 directory as 'last used'
 					myconfigdata2["recent1"] = text;
@@ -614,6 +551,218 @@ INT_PTR CALLBACK DialogProc(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
 	return FALSE;
 }
 
+/**
+@brief Builds the GhostScript include folders flag (the fonts and lib folders next to the application)
+@param cInclude Buffer to fill with the flag
+@param nSize Size of the buffer
+@return true if the flag was built
+*/
+static bool GetIncludeFlag(char* cInclude, size_t nSize)
+{
+	char cPath[MAX_PATH + 1];
+	if (!::GetModuleFileName(NULL, cPath, MAX_PATH))
+		return false;
+	// Should be next to the application
+	char* pPos = strrchr(cPath, '\\');
+	if (pPos != NULL)
+		*(pPos) = '\0';
+	else
+		cPath[0] = '\0';
+	// OK, add the fonts and lib folders:
+	sprintf_s (cInclude, nSize, "-I%s\\urwfonts;%s\\lib", cPath, cPath);
+	return true;
+}
+
+/**
+@brief Runs a single GhostScript conversion of stdin; this is what the helper processes started by Sidecar do
+@param argc Count of arguments following the "/render" flag
+@param argv The device name, the output file and any extra GhostScript flags
+@return 0 if the conversion succeeded, other values upon errors
+*/
+static int RunRenderWorker(int argc, char** argv)
+{
+	if (argc < 2)
+		return -1;
+
+	char cDevice[MAX_PATH];
+	char cFile[MAX_PATH + 128];
+	char cInclude[3 * MAX_PATH + 7];
+	sprintf_s(cDevice, sizeof(cDevice), "-sDEVICE=%s", argv[0]);
+	sprintf_s(cFile, sizeof(cFile), "-sOutputFile=%s", argv[1]);
+
+	std::vector<const char*> args;
+	args.push_back("PS2PDF");
+	args.push_back("-dNOPAUSE");
+	args.push_back("-dBATCH");
+	args.push_back("-dSAFER");
+	args.push_back(cDevice);
+	args.push_back(cFile);
+	if (GetIncludeFlag(cInclude, sizeof(cInclude)))
+		args.push_back(cInclude);
+	for (int i = 2; i < argc; i++)
+		args.push_back(argv[i]);
+	args.push_back("-");
+
+	if (!gsapi.Load())
+		return -4;
+
+	// Our input is a pipe with the raw spool data
+	_setmode(_fileno(stdin), _O_BINARY);
+	fileInput = stdin;
+	bRenderWorker = true;
+
+	void* pGS;
+	if (gsapi.new_instance(&pGS, stdin) < 0)
+		return -1;
+	if (gsapi.set_stdio(pGS, file_in, my_out, my_err) < 0)
+	{
+		gsapi.delete_instance(pGS);
+		return -2;
+	}
+	int nRet = gsapi.init_with_args(pGS, (int)args.size(), (char**)&args[0]);
+	gsapi.exit(pGS);
+	gsapi.delete_instance(pGS);
+
+	// Whatever is left is not needed, but the feeding process shouldn't get an error
+	CleanInput();
+	return GS_SUCCEEDED(nRet) ? 0 : -3;
+}
+
+/**
+@brief Runs the main GhostScript conversion of the spool buffer data into the PDF
+@param spool The input data; it is read from the start, so this can be called again to retry
+@param extra Extra flags (from the conversion profile)
+@return GhostScript's return code
+*/
+static int RunConversion(SpoolBuffer& spool, const ARGLIST& extra)
+{
+	// The profile flags go before the -c .setpdfwrite part
+	std::vector<const char*> args(ARGS, ARGS + 7);
+	for (ARGLIST::const_iterator i = extra.begin(); i != extra.end(); i++)
+		args.push_back(i->c_str());
+	args.insert(args.end(), ARGS + 7, ARGS + sizeof(ARGS)/sizeof(char*));
+
+	// Load GhostScript on first use
+	if (!gsapi.Load())
+	{
+		const char* pErr = "Can't load the GhostScript library\n";
+		diagnostics.Add(Diagnostics::StreamErr, pErr, (int)strlen(pErr));
+		return -1;
+	}
+
+	// First try to initialize a new GhostScript instance
+	SpoolReader reader(spool);
+	void* pGS;
+	if (gsapi.new_instance(&pGS, &reader) < 0)
+	{
+		// Error 
+		return -1;
+	}
+
+	// Set up the callbacks
+	if (gsapi.set_stdio(pGS, my_in, my_out, my_err) < 0)
+	{
+		// Failed...
+		gsapi.delete_instance(pGS);
+		return -2;
+	}
+
+	int nRet = gsapi.init_with_args(pGS, (int)args.size(), (char**)&args[0]);
+
+	gsapi.exit(pGS);
+	gsapi.delete_instance(pGS);
+	diagnostics.Flush();
+	return nRet;
+}
+
+/**
+@brief Adds the GhostScript memory flags derived from a job's memory budget
+@param args The flags to add to
+@param nBudget The memory budget (in bytes)
+*/
+static void AddMemoryFlags(ARGLIST& args, unsigned __int64 nBudget)
+{
+	char cFlag[64];
+	// Three quarters for the interpreter (in KB); the rest is for the bands and buffers
+	sprintf_s(cFlag, sizeof(cFlag), "-K%I64u", nBudget / 4 * 3 / 1024);
+	args.push_back(cFlag);
+	// Pages needing more than a quarter of it are rendered in bands
+	sprintf_s(cFlag, sizeof(cFlag), "-dMaxBitmap=%I64u", nBudget / 4);
+	args.push_back(cFlag);
+	// And the band buffer gets a sixteenth (at least 1MB, at most 64MB)
+	sprintf_s(cFlag, sizeof(cFlag), "-dBufferSpace=%I64u", max(min(nBudget / 16, (unsigned __int64)64 * 1024 * 1024), (unsigned __int64)1024 * 1024));
+	args.push_back(cFlag);
+}
+
+/**
+@brief Runs the main conversion in a helper process kept under the job's resource limits
+@param spool The input data
+@param extra Extra flags (from the conversion profile and memory budget)
+@param nMemory Maximal memory of the conversion (in bytes, 0 for no limit)
+@param dwSeconds Maximal run time (in seconds, 0 for no limit)
+@param eLimit Set to the limit the conversion went over, if any
+@return 0 if the conversion succeeded, other values upon errors
+*/
+static int RunLimitedConversion(SpoolBuffer& spool, const ARGLIST& extra, unsigned __int64 nMemory, DWORD dwSeconds, Sidecar::Limit& eLimit)
+{
+	ARGLIST args(extra);
+	args.push_back("-c");
+	args.push_back(".setpdfwrite");
+
+	// The helper writes <file>.inprogress, which is renamed with the rest of the job
+	Sidecar conversion(spool);
+	conversion.SetLimits(nMemory, dwSeconds);
+	conversion.SetPublish(false);
+	conversion.CaptureErrors(&diagnostics);
+	eLimit = Sidecar::LimitNone;
+	if (!conversion.Start("pdfwrite", cOutputFile, args))
+		return -1;
+	conversion.Finish();
+	eLimit = conversion.GetLimitExceeded();
+	return (int)conversion.GetExitCode();
+}
+
+/**
+@brief Saves the job result, if wanted: into the result.folder folder when it is set, or
+next to the PDF when "result" is enabled
+@param lpPDF The PDF file the job created
+*/
+static void SaveJobResult(LPCTSTR lpPDF)
+{
+	TCHAR cResultFile[MAX_PATH];
+	std::string sFolder = myconfigdata.getstring("result.folder", "");
+	if (!sFolder.empty())
+	{
+		std::string sName = jobResult.GetId() + ".result";
+		combine(cResultFile, sFolder.c_str(), sName.c_str());
+	}
+	else if (myconfigdata.getbool("result", false) && (lpPDF[0] != '\0'))
+		MakeSidePath(cResultFile, MAX_PATH, lpPDF, _T(".result"));
+	else
+		return;
+	jobResult.Save(cResultFile);
+}
+
+/**
+@brief Builds the path of the combined document a job is appended to
+@param lpDest Receives the path (MAX_PATH characters)
+@param lpPDF The PDF file the job would have created
+@param sAppend The combined document: a name (in the PDF's folder), or a full path
+*/
+static void MakeAppendPath(LPTSTR lpDest, LPCTSTR lpPDF, const std::string& sAppend)
+{
+	TCHAR cFolder[MAX_PATH];
+	cFolder[0] = '\0';
+	if ((sAppend.find(':') == std::string::npos) && (sAppend.compare(0, 2, "\\\\") != 0))
+	{
+		strcpy_s(cFolder, MAX_PATH, lpPDF);
+		TCHAR* pSlash = _tcsrchr(cFolder, '\\');
+		if (pSlash != NULL)
+			*pSlash = '\0';
+	}
+	combine(lpDest, cFolder, sAppend.c_str());
+}
+
 /*
 void GetUserHomeDir(TCHAR* szHomeDirBuf)
 {
@@ -646,23 +795,10 @@ void GetPublicDocsDir(TCHAR* szHomeDirBuf)
 }
 
 /**
-@brief Main function
-@param hInstance Handle to the current instance
-@param hPrevInstance Handle to the previous running instance (not used)
-@param lpCmdLine Command line (not used)
-@param nCmdShow Initial window visibility and location flag (not used)
-@return 0 if all went well, other values upon errors
+@brief Reads the read-only properties (CCPDFConverterMessages.ini, next to the application)
 */
-int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+static void ReadConfiguration()
 {
-	// Initialize stuff
-	char cPath[MAX_PATH + 1];
-	char cFile[MAX_PATH + 128];
-	char cInclude[3 * MAX_PATH + 7];
-	cErr[0] = '\0';
-
-
-	// Read configuration file
 	HMODULE hModule = GetModuleHandle(NULL);
 	TCHAR iniPath[MAX_PATH];
 	GetModuleFileName(hModule, iniPath, MAX_PATH);
@@ -674,34 +810,145 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
   std::ifstream f( iniPath );
   f >> myconfigdata;
   f.close();
+}
 
-  std::string title = myconfigdata["title"];
-  std::string directoryName = myconfigdata["directory"];
-  std::string level1Text = myconfigdata["level1.prompt"];
-  std::string level2Text = myconfigdata["level2.prompt"];
-  std::string filenameText = myconfigdata["filename.prompt"];
+/**
+@brief Returns the directory index snapshot file
+@return The file, in the converters' shared temp folder (empty if it's not kept, or there's no such folder)
+*/
+static std::string GetIndexSnapshot()
+{
+	if (!myconfigdata.getbool("dirindex", true) || (tempFiles.GetRoot()[0] == '\0'))
+		return "";
+	return std::string(tempFiles.GetRoot()) + "\\directory.index";
+}
 
+/**
+@brief Builds the directory index ahead of the jobs (/index), so no job has to list a folder
+@return 0 if the index was saved
+*/
+static int RunIndexBuild()
+{
+	ReadConfiguration();
+	tempFiles.Create();
+	std::string sSnapshot = GetIndexSnapshot();
+	if (sSnapshot.empty())
+	{
+		tempFiles.Close();
+		return -1;
+	}
 
-#ifdef _DEBUG
-	// Save a record of the original PostScript data (debug mode)
-	errno_t file_err = fopen_s (&pSave, "c:\\test.ps", "w+b");
-#endif
+	TCHAR homeDir[MAX_PATH] = { 0 };
+	GetPublicDocsDir(homeDir);
+	combine(path, homeDir, myconfigdata["directory"].c_str());
+	directoryIndex.Open(path, sSnapshot.c_str());
+	directoryIndex.Build(myconfigdata.getint("dirindex.threads", DEFAULT_INDEX_THREADS));
+	int nRet = directoryIndex.Save() ? 0 : -2;
+	tempFiles.Close();
+	return nRet;
+}
 
-	// Delete whichever temp files might exist
-	CleanTempFiles();
+/**
+@brief Looks for a routing rule for the job (sets the root folder, path, if there is one)
+@param router The routing rules
+@param sDirectory The root folder, under the public documents folder
+@param sLevel1 Receives the level 1 folder
+@param sLevel2 Receives the level 2 folder
+@param sName Receives the document name
+@return true if a rule matched (and the document's path isn't too long)
+*/
+static bool RouteJob(JobRouter& router, const std::string& sDirectory, std::string& sLevel1, std::string& sLevel2, std::string& sName)
+{
+	JobInfo info;
+	info.sTitle = docName;
+	info.Read(cBuffer, nBuffer);
+	if (info.sUser.empty())
+	{
+		TCHAR cUser[256];
+		DWORD dwUser = 256;
+		if (GetUserName(cUser, &dwUser))
+			info.sUser = cUser;
+	}
+	if (router.Route(info, sLevel1, sLevel2, sName, jobResult) == 0)
+		return false;
 
-	// Add the include directories to the command line flags we'll use with GhostScript:
-	if (::GetModuleFileName(NULL, cPath, MAX_PATH))
+	TCHAR homeDir[MAX_PATH] = { 0 };
+	GetPublicDocsDir(homeDir);
+	combine(path, homeDir, sDirectory.c_str());
+	if (strlen(path) + sLevel1.size() + sLevel2.size() + sName.size() + 8 >= MAX_PATH)
 	{
-		// Should be next to the application
-		char* pPos = strrchr(cPath, '\\');
-		if (pPos != NULL)
-			*(pPos) = '\0';
-		else
-			cPath[0] = '\0';
-		// OK, add the fonts and lib folders:
-		sprintf_s (cInclude, sizeof(cInclude), "-I%s\\urwfonts;%s\\lib", cPath, cPath);
-		ARGS[6] = cInclude;
+		// Too long for the path buffers: ask after all
+		sLevel1.clear();
+		sLevel2.clear();
+		return false;
+	}
+	return true;
+}
+
+/**
+@brief Describes a document for the completion journal (all but the finish time)
+@param lpFile The document
+@param lpPath The name it's published as
+@param nPages Count of pages in the document
+@return The journal record
+*/
+static JournalRecord DescribeDocument(LPCTSTR lpFile, LPCTSTR lpPath, int nPages)
+{
+	JournalRecord record;
+	record["path"] = lpPath;
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (GetFileAttributesEx(lpFile, GetFileExInfoStandard, &data))
+	{
+		char cNum[32];
+		sprintf_s(cNum, sizeof(cNum), "%I64u", ((unsigned __int64)data.nFileSizeHigh << 32) | data.nFileSizeLow);
+		record["size"] = cNum;
+	}
+	char cPages[16];
+	sprintf_s(cPages, sizeof(cPages), "%d", nPages);
+	record["pages"] = cPages;
+	ContentHash hash;
+	if (hash.AddFile(lpFile))
+		record["sha256"] = hash.Finish();
+	FILETIME ftCreate, ftExit, ftKernel, ftUser;
+	if (GetProcessTimes(GetCurrentProcess(), &ftCreate, &ftExit, &ftKernel, &ftUser))
+		record["started"] = CompletionJournal::FormatTime(ftCreate);
+	return record;
+}
+
+/**
+@brief Main function
+@param hInstance Handle to the current instance
+@param hPrevInstance Handle to the previous running instance (not used)
+@param lpCmdLine Command line (not used)
+@param nCmdShow Initial window visibility and location flag (not used)
+@return 0 if all went well, other values upon errors
+*/
+int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+{
+	// Initialize stuff
+	char cPath[MAX_PATH + 1];
+	char cFile[MAX_PATH + 128];
+	char cInclude[3 * MAX_PATH + 7];
+	char cStream[MAX_PATH + 1];
+	std::string sFanOut;
+	std::string sAppend;
+
+	jobResult.SetTime("startup.main", GetProcessAge());
+
+	// Are we a helper process for another conversion?
+	if ((__argc > 1) && (strcmp(__argv[1], "/render") == 0))
+		return RunRenderWorker(__argc - 2, __argv + 2);
+	// Or building the directory index?
+	if ((__argc > 1) && (strcmp(__argv[1], "/index") == 0))
+		return RunIndexBuild();
+	// Or converting again a job a converter crashed on? (/rerun <attempt> <document> <captured input>)
+	char cRerun[MAX_PATH + 1];
+	int nAttempt = 1;
+	cRerun[0] = '\0';
+	if ((__argc > 4) && (strcmp(__argv[1], "/rerun") == 0))
+	{
+		nAttempt = atoi(__argv[2]);
+		strcpy_s(cRerun, sizeof(cRerun), __argv[3]);
 	}
 
 #ifdef _DEBUG_CMD
@@ -711,14 +958,18 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	// Get the data from stdin (that's where the redmon port monitor sends it)
 	fileInput = stdin;
 #endif
+	if ((cRerun[0] != '\0') && (fopen_s(&fileInput, __argv[4], "rb") != 0))
+		return 0;
 
 	// Check if we have a filename to write to:
 	cPath[0] = '\0';
+	cStream[0] = '\0';
 	bool bAutoOpen = false;
 	bool bMakeTemp = false;
 	// Read the start of the file; if we have a filename and/or the auto-open flag, they must be there:
 	nBuffer = fread(cBuffer, 1, MAX_PATH * 2, fileInput);
 	cBuffer[nBuffer] = EOF;
+	jobResult.SetTime("startup.firstbyte", GetProcessAge());
 
 	myconfigdata2["nBuffer"] = cBuffer;
 	myconfigdata2["nBuffer2"] = cBuffer + 9;
@@ -764,6 +1015,77 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 		WriteOutput("FILENAME: ", cPath, nCount);
 #endif
 	}
+	// Do we stream the output instead of writing a file?
+	if ((nBuffer - nInBuffer > 10) && (strncmp(cBuffer + nInBuffer, "%%Stream: ", 10) == 0))
+	{
+		// Yes, so read the target
+		char ch;
+		int nCount = 0;
+		nInBuffer += 10;
+		do
+		{
+			ch = cBuffer[nInBuffer++];
+			if (ch == EOF)
+				break;
+			if (ch == '\n')
+				break;
+			if ((ch != '\r') && (nCount < MAX_PATH))
+				cStream[nCount++] = ch;
+		} while (true);
+
+		if (ch == EOF)
+		{
+			// If we didn't find a newline, something ain't right
+			return 0;
+		}
+		cStream[nCount] = '\0';
+	}
+	// Do we also publish it to other folders?
+	if ((nBuffer - nInBuffer > 10) && (strncmp(cBuffer + nInBuffer, "%%FanOut: ", 10) == 0))
+	{
+		// Yes, so read the folders
+		char ch;
+		nInBuffer += 10;
+		do
+		{
+			ch = cBuffer[nInBuffer++];
+			if (ch == EOF)
+				break;
+			if (ch == '\n')
+				break;
+			if (ch != '\r')
+				sFanOut += ch;
+		} while (true);
+
+		if (ch == EOF)
+		{
+			// If we didn't find a newline, something ain't right
+			return 0;
+		}
+	}
+	// Do we add it to a combined document instead?
+	if ((nBuffer - nInBuffer > 10) && (strncmp(cBuffer + nInBuffer, "%%Append: ", 10) == 0))
+	{
+		// Yes, so read its name
+		char ch;
+		nInBuffer += 10;
+		do
+		{
+			ch = cBuffer[nInBuffer++];
+			if (ch == EOF)
+				break;
+			if (ch == '\n')
+				break;
+			if (ch != '\r')
+				sAppend += ch;
+		} while (true);
+
+		if (ch == EOF)
+		{
+			// If we didn't find a newline, something ain't right
+			return 0;
+		}
+	}
 	// Do we have an auto-file-open flag?
 	if ((nBuffer - nInBuffer > 14) && ((!strncmp(cBuffer + nInBuffer, "%%FileAutoOpen", 14)) || (!strncmp(cBuffer + nInBuffer, "%%CreateAsTemp", 14))))
 	{
@@ -782,6 +1104,35 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 		}
 	}
 
+	// Only now that we know there's something to do: read configuration file
+	ReadConfiguration();
+
+	// The job's temporary files go in a folder of its own, written through the chosen backend
+	tempFiles.Create();
+	IoBackend& io = IoBackend::Get();
+	// Did a converter crash, leaving something to clean up (or a job to finish)?
+	if (myconfigdata.getbool("recovery", true))
+		RecoveryJournal::Replay();
+	StagingQueue staging;
+
+  std::string title = myconfigdata["title"];
+  std::string directoryName = myconfigdata["directory"];
+  std::string level1Text = myconfigdata["level1.prompt"];
+  std::string level2Text = myconfigdata["level2.prompt"];
+  std::string filenameText = myconfigdata["filename.prompt"];
+
+
+#ifdef _DEBUG
+	// Save a record of the original PostScript data (debug mode)
+	errno_t file_err = fopen_s (&pSave, "c:\\test.ps", "w+b");
+#endif
+
+	// Add the include directories to the command line flags we'll use with GhostScript:
+	if (GetIncludeFlag(cInclude, sizeof(cInclude)))
+		ARGS[6] = cInclude;
+
+	jobResult.SetTime("startup.config", GetProcessAge());
+
 	// Look for the title.
 	char* titleKeyword = strstr(cBuffer + 9, "%%Title: ");
 	if (titleKeyword != NULL) {
@@ -809,6 +1160,13 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 
 	myconfigdata2["docName"] = docName;
 
+	// Jobs the routing rules know where to put don't need the dialog
+	JobRouter router;
+	router.LoadRules();
+	std::string sRoute1, sRoute2, sRouteName;
+	// true if the naming template reserved the document's name
+	bool bNameReserved = false;
+
 	// Did we find a filename?
 	if (cPath[0] == '\0')
 	{
@@ -832,77 +1190,131 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 
 		okPressed = FALSE;
 
-		// Create the dialog
-		HWND hDlg;
-		hDlg = CreateDialogParam(hInstance, MAKEINTRESOURCE(IDD_DIALOG1), 0, DialogProc, 0);
-
-		HWND OK = GetDlgItem(hDlg, IDOK);
-		EnableWindow(OK, false);
-
-		SetWindowText(hDlg, title.c_str());
-		SetDlgItemText(hDlg, IDC_LABEL_LEVEL1, level1Text.c_str());
-		SetDlgItemText(hDlg, IDC_LABEL_LEVEL2, level2Text.c_str());
-		SetDlgItemText(hDlg, IDC_LABEL_DOC_NAME, filenameText.c_str());
-		
-		// Find last occurance of " - "
-		TCHAR *ptr = docName;
-		TCHAR *prevptr = NULL;
-		while( (ptr = strstr(ptr, " - ")))
+		if (cStream[0] != '\0')
 		{
-			prevptr = ptr;
-			// move pointer to end of match
-			ptr = ptr + 3;
+			// Streamed jobs have no one to ask: convert into a temporary file, sent when done
+			sprintf_s (fullFileName, MAX_PATH, "%s\\%s%u.%s", tempFiles.GetJobFolder(), STREAM_FILENAME, GetCurrentProcessId(), TEMP_EXTENSION);
+			okPressed = TRUE;
 		}
-		// now, prevptr contains the last occurrence
-		if (prevptr != NULL) {
-			*prevptr = 0;
+		else if (cRerun[0] != '\0')
+		{
+			// Converted again: it has its name already, and no one to ask
+			strcpy_s (fullFileName, cRerun);
+			TCHAR homeDir[MAX_PATH] = { 0 };
+			GetPublicDocsDir(homeDir);
+			combine(path, homeDir, directoryName.c_str());
+			okPressed = TRUE;
 		}
+		else if (router.IsEnabled() && RouteJob(router, directoryName, sRoute1, sRoute2, sRouteName))
+		{
+			// Routed by a rule: no one to ask
+			combine(path1, path, sRoute1.c_str());
+			combine(path2, path1, sRoute2.c_str());
+			CreateDirectory(path1, NULL);
+			CreateDirectory(path2, NULL);
+			combine(fullFileName, path2, sRouteName.c_str());
+			if ((sRouteName.size() < 4) || (_stricmp(sRouteName.c_str() + sRouteName.size() - 4, ".pdf") != 0))
+				strcat(fullFileName, ".pdf");
+			okPressed = TRUE;
+		}
+		else
+		{
+			// Create the dialog
+			HWND hDlg;
+			hDlg = CreateDialogParam(hInstance, MAKEINTRESOURCE(IDD_DIALOG1), 0, DialogProc, 0);
 
-		SetDlgItemText(hDlg, IDC_EDIT_DOC_NAME, docName);
-
-		ShowWindow(hDlg, nCmdShow);
+			HWND OK = GetDlgItem(hDlg, IDOK);
+			EnableWindow(OK, false);
 
+			SetWindowText(hDlg, title.c_str());
+			SetDlgItemText(hDlg, IDC_LABEL_LEVEL1, level1Text.c_str());
+			SetDlgItemText(hDlg, IDC_LABEL_LEVEL2, level2Text.c_str());
+			SetDlgItemText(hDlg, IDC_LABEL_DOC_NAME, filenameText.c_str());
+		
+			// Find last occurance of " - "
+			TCHAR *ptr = docName;
+			TCHAR *prevptr = NULL;
+			while( (ptr = strstr(ptr, " - ")))
+			{
+				prevptr = ptr;
+				// move pointer to end of match
+				ptr = ptr + 3;
+			}
+			// now, prevptr contains the last occurrence
+			if (prevptr != NULL) {
+				*prevptr = 0;
+			}
 
-		TCHAR homeDir[MAX_PATH] = { 0 };
+			SetDlgItemText(hDlg, IDC_EDIT_DOC_NAME, docName);
 
-		GetPublicDocsDir(homeDir);
-		
-		TCHAR *directoryNameAsTChar=new TCHAR[directoryName.size()+1];
-		directoryNameAsTChar[directoryName.size()]=0;
-		std::copy(directoryName.begin(),directoryName.end(),directoryNameAsTChar);
+			ShowWindow(hDlg, nCmdShow);
 
-		combine(path, homeDir, directoryNameAsTChar);
 
-		// Now read the writable properties
-		TCHAR writableConfig[MAX_PATH] = { 0 };
-		combine(writableConfig, path, _T("CCPDFConverter.ini")); 
-  std::ifstream f( writableConfig );
-  f >> myconfigdata2;
-  f.close();
+			TCHAR homeDir[MAX_PATH] = { 0 };
 
-  std::string recent1 = myconfigdata2["recent1"];
-  
-  myconfigdata2["debug"] = lpCmdLine;
+			GetPublicDocsDir(homeDir);
+		
+			TCHAR *directoryNameAsTChar=new TCHAR[directoryName.size()+1];
+			directoryNameAsTChar[directoryName.size()]=0;
+			std::copy(directoryName.begin(),directoryName.end(),directoryNameAsTChar);
 
-		HWND LIST = GetDlgItem(hDlg, IDC_LIST1);
+			combine(path, homeDir, directoryNameAsTChar);
 
-		FillChildDirectories(LIST, path);
+			// Now read the writable properties
+			TCHAR writableConfig[MAX_PATH] = { 0 };
+			combine(writableConfig, path, _T("CCPDFConverter.ini")); 
+	  std::ifstream f( writableConfig );
+	  f >> myconfigdata2;
+	  f.close();
 
-		BOOL ret;
-		MSG msg;
-		while((ret = GetMessage(&msg, 0, 0, 0)) != 0) {
-			if(ret == -1) /* error found */
-				return -1;
+	  std::string recent1 = myconfigdata2["recent1"];
+  
+	  myconfigdata2["debug"] = lpCmdLine;
+
+			HWND LIST = GetDlgItem(hDlg, IDC_LIST1);
+
+			// The folders come from an index kept between jobs, in the converters' shared temp folder
+			std::string sIndex = GetIndexSnapshot();
+			directoryIndex.Open(path, sIndex.empty() ? NULL : sIndex.c_str());
+			FillChildDirectories(LIST, "");
+
+			BOOL ret;
+			MSG msg;
+			while((ret = GetMessage(&msg, 0, 0, 0)) != 0) {
+				if(ret == -1) /* error found */
+				{
+					tempFiles.Close();
+					return -1;
+				}
 
-			if(!IsDialogMessage(hDlg, &msg)) {
-				TranslateMessage(&msg); /* translate virtual-key messages */
-				DispatchMessage(&msg); /* send it to dialog procedure */
+				if(!IsDialogMessage(hDlg, &msg)) {
+					TranslateMessage(&msg); /* translate virtual-key messages */
+					DispatchMessage(&msg); /* send it to dialog procedure */
+				}
 			}
+			directoryIndex.Save();
 		}
 		if (okPressed)
 		{
 						// OK, get a filename, write it up
-				sprintf_s (cFile, sizeof(cFile), "-sOutputFile=%s.inprogress", fullFileName);
+				// Named by the template, if there's one (streamed jobs have no name to give)
+				OutputNaming naming(myconfigdata.getstring("naming", ""));
+				if (naming.IsEnabled() && (cStream[0] == '\0') && (cRerun[0] == '\0'))
+				{
+					naming.SetVariable("level1", sRoute1.empty() ? myconfigdata2["recent1"] : sRoute1);
+					naming.SetVariable("level2", sRoute2.empty() ? myconfigdata2["recent2"] : sRoute2);
+					TCHAR cUser[256];
+					DWORD dwUser = 256;
+					if (GetUserName(cUser, &dwUser))
+						naming.SetVariable("user", cUser);
+					bNameReserved = naming.MakeName(fullFileName, MAX_PATH, jobResult);
+				}
+				// Staged locally first, if wanted (not for streamed jobs, they're local already)
+				if (staging.IsEnabled() && (cStream[0] == '\0'))
+					strcpy_s (cOutputFile, staging.GetStagedFile(jobResult.GetId()).c_str());
+				else
+					strcpy_s (cOutputFile, fullFileName);
+				sprintf_s (cFile, sizeof(cFile), "-sOutputFile=%s.inprogress", cOutputFile);
 				ARGS[5] = cFile;
 				bMakeTemp = true;
 
@@ -916,28 +1328,206 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 //  f2 << myconfigdata2;
 //  f2.close();
 	}
+	else
+	{
+		// Cancelled, so there's nothing to convert (and no reason to load GhostScript)
+		CleanInput();
+		tempFiles.Close();
+		return 0;
+	}
 
-	// First try to initialize a new GhostScript instance
-	void* pGS;
-	if (gsapi_new_instance(&pGS, NULL) < 0)
+	// Keep the input in a spool buffer, so it is read once but can be used by more than one
+	// GhostScript instance: start with whatever's left of the initial buffer
+	SpoolBuffer spool(myconfigdata.getsize("job.memory", DEFAULT_JOB_MEMORY));
+	ConversionCache cache;
+	ContentHash inputHash;
+	spool.SetSpillFolder(tempFiles.GetJobFolder());
+
+	// Recorded before anything is written, so a crash leaves nothing behind (streamed jobs are
+	// converted in the job folder, which is cleaned up anyway); the input can be kept, so the
+	// job can be converted again
+	RecoveryJournal recovery;
+	if ((cStream[0] == '\0') && myconfigdata.getbool("recovery", true))
 	{
-		// Error 
-		return -1;
+		TCHAR cPartial[MAX_PATH + 16];
+		sprintf_s (cPartial, sizeof(cPartial), "%s.inprogress", cOutputFile);
+		std::string sCapture;
+		if (cRerun[0] != '\0')
+			sCapture = __argv[4];
+		else if (myconfigdata.getbool("recovery.capture", false) && spool.SetCapture(RecoveryJournal::GetCapturePath(jobResult.GetId()).c_str(), &recovery))
+			sCapture = RecoveryJournal::GetCapturePath(jobResult.GetId());
+		recovery.Begin(jobResult.GetId(), cPartial, fullFileName, bNameReserved ? fullFileName : NULL, sCapture.empty() ? NULL : sCapture.c_str(), nAttempt);
+		if (cRerun[0] != '\0')
+			// (All there already)
+			recovery.Captured();
+	}
+	if (cache.IsEnabled())
+		spool.SetHash(&inputHash);
+	spool.Append(cBuffer + nInBuffer, nBuffer - nInBuffer);
+	spool.StartInput(fileInput);
+
+	// Resource limits: GhostScript's own memory use is kept within the budget, and with a
+	// limit the conversions run in helper processes that are stopped when they go over
+	unsigned __int64 nMemoryLimit = myconfigdata.getsize("limit.memory", 0);
+	DWORD dwTimeLimit = (DWORD)myconfigdata.getint("limit.time", 0);
+
+	// Do we also want the text of the document (for indexing)?
+	Sidecar textSidecar(spool);
+	if (okPressed && (cStream[0] == '\0') && myconfigdata.getbool("sidecar.text", false))
+	{
+		TCHAR cTextFile[MAX_PATH];
+		MakeSidePath(cTextFile, MAX_PATH, fullFileName, _T(".txt"));
+		textSidecar.SetLimits(nMemoryLimit, dwTimeLimit);
+		textSidecar.Start("txtwrite", cTextFile, ARGLIST());
 	}
 
-	// Set up the callbacks
-	if (gsapi_set_stdio(pGS, my_in, my_out, my_err) < 0)
+	// And a preview image? Only the first page is rendered, at a low resolution
+	PageSidecar thumbnailSidecar(spool, 1, 1);
+	if (okPressed && (cStream[0] == '\0') && myconfigdata.getbool("thumbnail", false))
 	{
-		// Failed...
-		gsapi_delete_instance(pGS);
-		return -2;
+		TCHAR cImageFile[MAX_PATH];
+		MakeSidePath(cImageFile, MAX_PATH, fullFileName, _T(".png"));
+		thumbnailSidecar.SetLimits(nMemoryLimit, dwTimeLimit);
+		ARGLIST args;
+		args.push_back("-r" + myconfigdata.getstring("thumbnail.dpi", "24"));
+		args.push_back("-dTextAlphaBits=4");
+		args.push_back("-dGraphicsAlphaBits=4");
+		thumbnailSidecar.Start(myconfigdata.getstring("thumbnail.device", "png16m").c_str(), cImageFile, args);
 	}
 
-	// Now run the GhostScript engine to transform PostScript into PDF
-	int nRet = gsapi_init_with_args(pGS, sizeof(ARGS)/sizeof(char*), (char**)ARGS);
+	// Now run the GhostScript engine to transform PostScript into PDF; if it fails, try again
+	// from the start of the input with the profile's fallback (up to retry.max times)
+	diagnostics.SetMaxLines(myconfigdata.getint("diagnostics.maxlines", 200));
+	jobResult.SetTime("startup.conversion", GetProcessAge());
+	ConversionProfile profile;
+	std::string sProfile = myconfigdata.getstring("profile", "standard");
+	if (!GetConversionProfile(sProfile, profile))
+	{
+		jobResult["profile.unavailable"] = sProfile;
+		GetConversionProfile("standard", profile);
+	}
 
-	gsapi_exit(pGS);
-	gsapi_delete_instance(pGS);
+	// A reprinted document can come from the cache; that needs all of the data first, to
+	// know which document it is
+	PlaceMethod eCached = PlaceNone;
+	if (okPressed && cache.IsEnabled())
+	{
+		spool.WaitComplete();
+		ARGLIST key;
+		for (int i = 0; i < (int)(sizeof(ARGS) / sizeof(char*)); i++)
+			// Not the output file name, of course
+			if (i != 5)
+				key.push_back(ARGS[i]);
+		key.insert(key.end(), profile.args.begin(), profile.args.end());
+		cache.SetKey(inputHash.Finish(), key);
+		TCHAR cCached[MAX_PATH + 16];
+		sprintf_s (cCached, sizeof(cCached), "%s.inprogress", cOutputFile);
+		eCached = cache.Fetch(cCached);
+		jobResult["cache"] = (eCached != PlaceNone) ? "hit" : "miss";
+		jobResult["cache.key"] = cache.GetKey();
+		if (eCached != PlaceNone)
+			jobResult["cache.place"] = GetPlaceMethodName(eCached);
+	}
+
+	// Large documents can be delivered a chunk of pages at a time, while they're converted
+	ProgressiveDelivery progressive(spool);
+	if (okPressed && (eCached == PlaceNone) && (cStream[0] == '\0') && myconfigdata.getbool("progressive", false))
+		progressive.Start(fullFileName, profile.args, nMemoryLimit, dwTimeLimit);
+
+	int nMaxRetries = myconfigdata.getint("retry.max", 1);
+	bool bLimited = okPressed && ((nMemoryLimit > 0) || (dwTimeLimit > 0));
+	Sidecar::Limit eLimit = Sidecar::LimitNone;
+	int nRetries = 0;
+	int nRet = 0;
+	double dConversionStart = GetProcessAge();
+	while (eCached == PlaceNone)
+	{
+		ARGLIST args(profile.args);
+		if (nMemoryLimit > 0)
+			AddMemoryFlags(args, nMemoryLimit);
+		if (bLimited)
+			nRet = RunLimitedConversion(spool, args, nMemoryLimit, dwTimeLimit, eLimit);
+		else
+			nRet = RunConversion(spool, args);
+		if (GS_SUCCEEDED(nRet) || (eLimit != Sidecar::LimitNone))
+			// Done (a job over its limits would only go over them again)
+			break;
+		ConversionProfile fallback;
+		if ((nRetries >= nMaxRetries) || profile.sFallback.empty() || !GetConversionProfile(profile.sFallback, fallback))
+			break;
+		// Keep what went wrong, and start over
+		jobResult["retry." + profile.sName + ".error"] = diagnostics.GetErrorName();
+		jobResult.SetInt("retry." + profile.sName + ".return", nRet);
+		diagnostics.Reset();
+		nRetries++;
+		profile = fallback;
+	}
+	jobResult["profile"] = profile.sName;
+	// (The input thread records the capture in the journal when the input ends)
+	spool.WaitComplete();
+	jobResult.SetInt("retry.count", nRetries);
+	if ((eCached == PlaceNone) && GS_SUCCEEDED(nRet) && cache.IsEnabled() && okPressed)
+	{
+		// Keep it for the next time it's printed
+		TCHAR cConverted[MAX_PATH + 16];
+		sprintf_s (cConverted, sizeof(cConverted), "%s.inprogress", cOutputFile);
+		cache.Store(cConverted);
+	}
+	jobResult.SetTime("time.conversion", GetProcessAge() - dConversionStart);
+	// Our own file I/O (the spill file), for comparing the backends
+	jobResult["io.backend"] = io.GetName();
+	jobResult.SetInt("io.reads", io.GetStats().nReads);
+	jobResult.SetInt("io.writes", io.GetStats().nWrites);
+	jobResult.SetInt("io.submits", io.GetStats().nSubmits);
+	jobResult.SetInt("io.waits", io.GetStats().nWaits);
+	if (PdfaSupport::GetPrepareTime() > 0)
+	{
+		// PDF/A overhead: preparing (or checking) the definitions
+		jobResult.SetTime("time.pdfa.prepare", PdfaSupport::GetPrepareTime());
+		jobResult["pdfa.cached"] = PdfaSupport::WasCached() ? "1" : "0";
+	}
+	if (gsapi.IsLoaded())
+		jobResult.SetTime("time.gsload", gsapi.dLoadTime);
+
+	// Post-processing, set per print queue
+	if (okPressed && GS_SUCCEEDED(nRet))
+	{
+		PdfPipeline pipeline;
+		TCHAR cPrinter[256];
+		if (!GetEnvironmentVariable(_T("REDMON_PRINTER"), cPrinter, sizeof(cPrinter) / sizeof(TCHAR)))
+			cPrinter[0] = '\0';
+		pipeline.AddConfiguredStages(cPrinter);
+		TCHAR cConverted[MAX_PATH + 16];
+		sprintf_s (cConverted, sizeof(cConverted), "%s.inprogress", cOutputFile);
+		pipeline.Run(cConverted, jobResult);
+	}
+
+	// Added to a combined document, rather than written on its own? (If it can't be, it's
+	// written on its own after all)
+	if (sAppend.empty())
+		sAppend = myconfigdata.getstring("append.file", "");
+	TCHAR cAppendTo[MAX_PATH];
+	bool bAppended = false;
+	if (okPressed && GS_SUCCEEDED(nRet) && (cStream[0] == '\0') && !sAppend.empty())
+	{
+		TCHAR cConverted[MAX_PATH + 16];
+		sprintf_s (cConverted, sizeof(cConverted), "%s.inprogress", cOutputFile);
+		MakeAppendPath(cAppendTo, fullFileName, sAppend);
+		PdfAppender appender;
+		bAppended = appender.Append(cConverted, cAppendTo, jobResult);
+		if (bAppended)
+		{
+			// (Converting it again would append it twice)
+			recovery.Published();
+			DeleteFile(cConverted);
+		}
+	}
+
+	// The text and preview are published with the PDF
+	if (textSidecar.IsStarted())
+		textSidecar.Finish();
+	if (thumbnailSidecar.IsStarted())
+		thumbnailSidecar.Finish();
 
 #ifdef _DEBUG
 	// Close the PostScript copy file (debug mode)
@@ -955,26 +1545,137 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	// it is completely written.
 
 	TCHAR src_file[MAX_PATH + 128];
-				sprintf_s (src_file, sizeof(src_file), "%s.inprogress", fullFileName);
+				sprintf_s (src_file, sizeof(src_file), "%s.inprogress", cOutputFile);
 const char *dest_file = fullFileName;
  
-	if (!MoveFileEx(src_file, dest_file, MOVEFILE_REPLACE_EXISTING)) {
-		/* Handle error condition */
+	double dPublishStart = GetProcessAge();
+	bool bStreamFailed = false, bPublishFailed = false;
+	if (cStream[0] != '\0')
+	{
+		// Streamed: send the file to the target instead, and drop it
+		OutputStream stream(cStream);
+		if (GS_SUCCEEDED(nRet))
+			bStreamFailed = !stream.Send(src_file);
+		DeleteFile(src_file);
+		jobResult["stream"] = cStream;
+		jobResult.SetInt("stream.bytes", (__int64)stream.GetSent());
+		jobResult.SetTime("time.stream", GetProcessAge() - dPublishStart);
+	}
+	else if (!bAppended)
+	{
+		// (When staged, this publishes it in the staging folder; a reserved name is published
+		// in one step, without replacing a document someone placed there since)
+		bool bPublished;
+		if (bNameReserved && !staging.IsEnabled())
+			bPublished = PublishOutput(src_file, cOutputFile, GetOutputDurability(), false);
+		else
+			bPublished = PublishOutput(src_file, cOutputFile);
+		if (!bPublished)
+		{
+			// Nothing is left behind: the job is reported as failed, and converted again if printed again
+			jobResult.SetInt("publish.error", GetLastError());
+			DeleteFile(src_file);
+			bPublishFailed = true;
+		}
+		else
+		{
+			// In place: whatever happens from here on, it's not converted again
+			recovery.Published();
+			if (GS_SUCCEEDED(nRet))
+			{
+				// Copies in other folders?
+				FanOut fanOut;
+				// The job's folders: routed by a rule, or chosen in the dialog
+				fanOut.SetVariable("level1", sRoute1.empty() ? myconfigdata2["recent1"] : sRoute1);
+				fanOut.SetVariable("level2", sRoute2.empty() ? myconfigdata2["recent2"] : sRoute2);
+				TCHAR cUser[256];
+				DWORD dwUser = 256;
+				if (GetUserName(cUser, &dwUser))
+					fanOut.SetVariable("user", cUser);
+				fanOut.AddDestinations(myconfigdata.getstring("fanout", ""));
+				fanOut.AddDestinations(sFanOut);
+				if (fanOut.HasDestinations())
+					jobResult.SetInt("fanout.count", fanOut.Publish(cOutputFile, dest_file, jobResult));
+			}
+
+			// Tell the folder watchers (once it's in its folder)
+			bool bJournal = GS_SUCCEEDED(nRet) && myconfigdata.getbool("journal", false);
+			JournalRecord record;
+			if (bJournal)
+				record = DescribeDocument(cOutputFile, dest_file, spool.GetPageCount());
+			if (staging.IsEnabled())
+			{
+				// The rest happens in the background, while the job finishes up
+				staging.Enqueue(jobResult.GetId(), dest_file, bJournal ? path : NULL, record);
+				staging.Start();
+			}
+			else if (bJournal)
+			{
+				FILETIME ftNow;
+				GetSystemTimeAsFileTime(&ftNow);
+				record["finished"] = CompletionJournal::FormatTime(ftNow);
+				CompletionJournal(path).Append(record);
+			}
+		}
+		jobResult.SetTime("time.publish", GetProcessAge() - dPublishStart);
 	}
+	// The name's marker goes once the document is in place, or nothing will be (the job was
+	// appended, or failed); a staged document's marker is removed when it's published
+	if (bNameReserved && (bAppended || !staging.IsEnabled()))
+		OutputNaming::Unreserve(fullFileName);
 
-			// Now write the writable properties
+			// Now write the writable properties (streamed, routed and converted again jobs didn't read them)
+	if ((cStream[0] == '\0') && (cRerun[0] == '\0') && sRoute1.empty())
+	{
 		TCHAR writableConfig2[MAX_PATH] = { 0 };
 		combine(writableConfig2, path, _T("CCPDFConverter.ini")); 
 			  std::ofstream f2( writableConfig2 );
   f2 << myconfigdata2;
   f2.close();
+	}
+
 
+	// Wait for the staged document to reach its folder (or to be left for later)
+	staging.Finish(jobResult);
+	// The progressive chunks were a preview; now the document is there
+	progressive.Finish(GS_SUCCEEDED(nRet), jobResult);
+	recovery.End();
+	// Before WinMain returns: the sweep mustn't outlive the job
+	tempFiles.Close();
+
+	// Record what happened
+	jobResult["status"] = bStreamFailed ? "stream" : bPublishFailed ? "publish" : (GS_SUCCEEDED(nRet) ? "ok" : ((eLimit != Sidecar::LimitNone) ? "limit" : "failed"));
+	if (eLimit != Sidecar::LimitNone)
+		jobResult["limit"] = (eLimit == Sidecar::LimitMemory) ? "memory" : "time";
+	jobResult["output"] = bAppended ? cAppendTo : fullFileName;
+	jobResult.SetInt("gs.return", nRet);
+	diagnostics.ToResult(jobResult);
+	SaveJobResult(fullFileName);
+
+	// Could the output be sent? (There's no one to tell but the caller)
+	if (bStreamFailed)
+		return EXIT_STREAM_FAILED;
+
+	// Could it be placed?
+	if (bPublishFailed)
+	{
+		std::string sMessage = std::string("The document could not be saved as ") + fullFileName + ".";
+		MessageBox(NULL, sMessage.c_str(), PRODUCT_NAME, MB_ICONERROR|MB_OK);
+		return EXIT_PUBLISH_FAILED;
+	}
+
+	// Did it go over its limits?
+	if (eLimit != Sidecar::LimitNone)
+	{
+		MessageBox(NULL, (eLimit == Sidecar::LimitMemory) ? "The document needs more memory than a conversion is allowed to use." : "The document took longer to convert than a conversion is allowed to run.", PRODUCT_NAME, MB_ICONERROR|MB_OK);
+		return (eLimit == Sidecar::LimitMemory) ? EXIT_LIMIT_MEMORY : EXIT_LIMIT_TIME;
+	}
 
 	// Did we get an error?
-	if (strlen(cErr) > 0)
+	if (diagnostics.HasErrors())
 	{
 		// Yes, show it
-		MessageBox(NULL, cErr, PRODUCT_NAME, MB_ICONERROR|MB_OK);
+		MessageBox(NULL, diagnostics.GetErrorText().c_str(), PRODUCT_NAME, MB_ICONERROR|MB_OK);
 		return 0;
 	}
 
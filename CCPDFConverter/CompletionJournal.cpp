@@ -0,0 +1,142 @@
+/**
+	@file
+	@brief Journal of finished documents, for folder watchers
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "CompletionJournal.h"
+#include <stdio.h>
+
+/// Size of the blocks the reader reads
+#define READ_BLOCK		(64 * 1024)
+
+/**
+	@param lpRoot The output root folder
+*/
+CompletionJournal::CompletionJournal(LPCTSTR lpRoot)
+{
+	m_sFile = lpRoot;
+	if (!m_sFile.empty() && (m_sFile[m_sFile.size() - 1] != '\\'))
+		m_sFile += '\\';
+	m_sFile += JOURNAL_FILE_NAME;
+}
+
+/**
+	@param record The record to add
+	@return true if added
+*/
+bool CompletionJournal::Append(const JournalRecord& record)
+{
+	std::string sLine;
+	for (JournalRecord::const_iterator i = record.begin(); i != record.end(); i++)
+	{
+		if (!sLine.empty())
+			sLine += '\t';
+		sLine += i->first + '=';
+		for (std::string::const_iterator c = i->second.begin(); c != i->second.end(); c++)
+			// Nothing in a value may end the field or the record
+			sLine += ((*c == '\t') || (*c == '\r') || (*c == '\n')) ? ' ' : *c;
+	}
+	sLine += '\n';
+
+	// Append-only access: every write goes to the end of the file, as one piece
+	HANDLE hFile = CreateFile(m_sFile.c_str(), FILE_APPEND_DATA | SYNCHRONIZE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD dwWritten;
+	bool bRet = WriteFile(hFile, sLine.c_str(), (DWORD)sLine.size(), &dwWritten, NULL) && (dwWritten == sLine.size());
+	CloseHandle(hFile);
+	return bRet;
+}
+
+/**
+	@param ft The time (UTC)
+	@return The time as yyyy-mm-ddThh:mm:ss.mmmZ
+*/
+std::string CompletionJournal::FormatTime(const FILETIME& ft)
+{
+	SYSTEMTIME st;
+	FileTimeToSystemTime(&ft, &st);
+	char cTime[32];
+	sprintf_s(cTime, sizeof(cTime), "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+	return cTime;
+}
+
+/**
+	@param lpJournal The journal file
+	@param nOffset Location to start reading from (as returned by GetOffset)
+*/
+JournalReader::JournalReader(LPCTSTR lpJournal, unsigned __int64 nOffset) : m_nOffset(nOffset)
+{
+	m_hFile = CreateFile(lpJournal, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+}
+
+/**
+*/
+JournalReader::~JournalReader()
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+}
+
+/**
+	@param record Filled with the record
+	@return true if a record was read, false if there's no complete record (yet)
+*/
+bool JournalReader::Next(JournalRecord& record)
+{
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	std::string::size_type nEnd;
+	while ((nEnd = m_sPending.find('\n')) == std::string::npos)
+	{
+		// Read on from where the pending data ends
+		char cBlock[READ_BLOCK];
+		LARGE_INTEGER liPos;
+		liPos.QuadPart = m_nOffset + m_sPending.size();
+		DWORD dwRead;
+		if (!SetFilePointerEx(m_hFile, liPos, NULL, FILE_BEGIN) || !ReadFile(m_hFile, cBlock, sizeof(cBlock), &dwRead, NULL) || (dwRead == 0))
+			// Nothing more for now (a record being written is left for next time)
+			return false;
+		m_sPending.append(cBlock, dwRead);
+	}
+
+	record.clear();
+	std::string::size_type nStart = 0;
+	while (nStart < nEnd)
+	{
+		std::string::size_type nField = m_sPending.find('\t', nStart);
+		if ((nField == std::string::npos) || (nField > nEnd))
+			nField = nEnd;
+		std::string::size_type nEqual = m_sPending.find('=', nStart);
+		if (nEqual < nField)
+			record[m_sPending.substr(nStart, nEqual - nStart)] = m_sPending.substr(nEqual + 1, nField - nEqual - 1);
+		nStart = nField + 1;
+	}
+	m_sPending.erase(0, nEnd + 1);
+	m_nOffset += nEnd + 1;
+	return true;
+}
@@ -0,0 +1,103 @@
+/**
+	@file
+	@brief Journal of finished documents, for folder watchers
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _COMPLETIONJOURNAL_H_
+#define _COMPLETIONJOURNAL_H_
+
+#include "Configuration.h"
+
+/// Name of the journal file, in the output root folder
+#define JOURNAL_FILE_NAME	"completed.journal"
+
+/**
+	@brief One journal record: key/value pairs
+
+	The converter writes these keys:
+	- path: the published document
+	- size: its size in bytes
+	- pages: count of pages (as found in the PostScript comments)
+	- sha256: hash of the document
+	- started, finished: when the job started and ended (UTC, ISO 8601)
+*/
+typedef configuration::data JournalRecord;
+
+/**
+    @brief Appends records to the completion journal
+
+	Each record is one line of tab separated key=value pairs, written with a single
+	append-only write, so records from concurrent converters never mix. Watchers read
+	the journal (see JournalReader) instead of scanning the output folders.
+*/
+class CompletionJournal
+{
+public:
+	/// Ctor
+	CompletionJournal(LPCTSTR lpRoot);
+
+	/// Adds a record to the journal
+	bool				Append(const JournalRecord& record);
+
+	/// Formats a time for a record
+	static std::string	FormatTime(const FILETIME& ft);
+
+protected:
+	/// Full name of the journal file
+	std::string			m_sFile;
+};
+
+/**
+    @brief Reads the completion journal, from a saved location on
+
+	Only complete records are returned, so it can be read while converters add to it:
+	call Next until it returns false, save GetOffset, and continue from there later.
+*/
+class JournalReader
+{
+public:
+	/// Ctor
+	JournalReader(LPCTSTR lpJournal, unsigned __int64 nOffset = 0);
+	/// Dtor
+	virtual ~JournalReader();
+
+	/// Reads the next complete record
+	bool				Next(JournalRecord& record);
+	/**
+		@brief Returns the location after the last record returned
+		@return Offset to continue from
+	*/
+	unsigned __int64	GetOffset() const {return m_nOffset;};
+
+protected:
+	/// Journal file
+	HANDLE				m_hFile;
+	/// Location after the last record returned
+	unsigned __int64	m_nOffset;
+	/// Data read after m_nOffset, not returned yet
+	std::string			m_sPending;
+};
+
+#endif   //#define _COMPLETIONJOURNAL_H_
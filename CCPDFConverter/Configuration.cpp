@@ -0,0 +1,139 @@
+/**
+	@file
+	@brief Simple key/value configuration file reading and writing
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "Configuration.h"
+#include <stdlib.h>
+
+namespace configuration
+  {
+
+  std::string data::getstring( const std::string& s, const std::string& def ) const
+    {
+    const_iterator iter = find( s );
+    if ((iter == end()) || iter->second.empty())
+      return def;
+    return iter->second;
+    }
+
+  long data::getint( const std::string& s, long def ) const
+    {
+    const_iterator iter = find( s );
+    if ((iter == end()) || iter->second.empty())
+      return def;
+    return strtol( iter->second.c_str(), NULL, 10 );
+    }
+
+  bool data::getbool( const std::string& s, bool def ) const
+    {
+    const_iterator iter = find( s );
+    if ((iter == end()) || iter->second.empty())
+      return def;
+    switch (iter->second[ 0 ])
+      {
+      case '1': case 'y': case 'Y': case 't': case 'T':
+        return true;
+      case 'o': case 'O':
+        // "on" or "off"
+        return (iter->second.size() > 1) && ((iter->second[ 1 ] == 'n') || (iter->second[ 1 ] == 'N'));
+      default:
+        return false;
+      }
+    }
+
+  unsigned __int64 data::getsize( const std::string& s, unsigned __int64 def ) const
+    {
+    const_iterator iter = find( s );
+    if ((iter == end()) || iter->second.empty())
+      return def;
+    char* pEnd = NULL;
+    unsigned __int64 n = _strtoui64( iter->second.c_str(), &pEnd, 10 );
+    switch (*pEnd)
+      {
+      case 'g': case 'G': n *= 1024 * 1024 * 1024; break;
+      case 'm': case 'M': n *= 1024 * 1024; break;
+      case 'k': case 'K': n *= 1024; break;
+      }
+    return n;
+    }
+
+  //---------------------------------------------------------------------------
+  // The extraction operator reads configuration::data until EOF.
+  // Invalid data is ignored.
+  //
+  std::istream& operator >> ( std::istream& ins, data& d )
+    {
+    std::string s, key, value;
+
+    // For each (key, value) pair in the file
+    while (std::getline( ins, s ))
+      {
+      std::string::size_type begin = s.find_first_not_of( " \f\t\v" );
+
+      // Skip blank lines
+      if (begin == std::string::npos) continue;
+
+      // Skip commentary
+      if (std::string( "#;" ).find( s[ begin ] ) != std::string::npos) continue;
+
+      // Extract the key value
+      std::string::size_type end = s.find( '=', begin );
+      key = s.substr( begin, end - begin );
+
+      // (No leading or trailing whitespace allowed)
+      key.erase( key.find_last_not_of( " \f\t\v" ) + 1 );
+
+      // No blank keys allowed
+      if (key.empty()) continue;
+
+      // Extract the value (no leading or trailing whitespace allowed)
+      begin = s.find_first_not_of( " \f\n\r\t\v", end + 1 );
+	  if (begin == 0xFFFFFFFF) {
+		  value = "";
+	  } else {
+		end   = s.find_last_not_of(  " \f\n\r\t\v" ) + 1;
+		value = s.substr( begin, end - begin );
+	  }
+      // Insert the properly extracted (key, value) pair into the map
+      d[ key ] = value;
+      }
+
+    return ins;
+    }
+
+
+//---------------------------------------------------------------------------
+  // The insertion operator writes all configuration::data to stream.
+  //
+  std::ostream& operator << ( std::ostream& outs, const data& d )
+    {
+    data::const_iterator iter;
+    for (iter = d.begin(); iter != d.end(); iter++)
+      outs << iter->first << " = " << iter->second << '\n';
+    return outs;
+    }
+  }
@@ -0,0 +1,92 @@
+/**
+	@file
+	@brief Simple key/value configuration file reading and writing
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _CONFIGURATION_H_
+#define _CONFIGURATION_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace configuration
+  {
+
+  //---------------------------------------------------------------------------
+  // The configuration::data is a simple map string (key, value) pairs.
+  // The file is stored as a simple listing of those pairs, one per line.
+  // The key is separated from the value by an equal sign '='.
+  // Commentary begins with the first non-space character on the line a hash or
+  // semi-colon ('#' or ';').
+  //
+  // Example:
+  //   # This is an example
+  //   source.directory = C:\Documents and Settings\Jennifer\My Documents
+  //   file.types = *.jpg;*.gif;*.png;*.pix;*.tif;*.bmp
+  //
+  // Notice that the configuration file format does not permit values to span
+  // more than one line, commentary at the end of a line, or [section]s.
+  //   
+  struct data: std::map <std::string, std::string>
+    {
+    // Here is a little convenience method...
+    bool iskey( const std::string& s ) const
+      {
+      return count( s ) != 0;
+      }
+
+    // Returns the value of a key, or the default if the key is missing or empty
+    std::string getstring( const std::string& s, const std::string& def ) const;
+
+    // Returns the value of a key as a number, or the default if not there
+    long getint( const std::string& s, long def ) const;
+
+    // Returns the value of a key as a flag (1/0, yes/no, true/false, on/off)
+    bool getbool( const std::string& s, bool def ) const;
+
+    // Returns the value of a key as a size in bytes; the value may end with
+    // K, M or G (e.g. "64M")
+    unsigned __int64 getsize( const std::string& s, unsigned __int64 def ) const;
+    };
+
+  //---------------------------------------------------------------------------
+  // The extraction operator reads configuration::data until EOF.
+  // Invalid data is ignored.
+  //
+  std::istream& operator >> ( std::istream& ins, data& d );
+
+  //---------------------------------------------------------------------------
+  // The insertion operator writes all configuration::data to stream.
+  //
+  std::ostream& operator << ( std::ostream& outs, const data& d );
+  }
+
+/// Read-only properties (CCPDFConverterMessages.ini next to the application)
+extern configuration::data myconfigdata;
+/// Writable properties (CCPDFConverter.ini in the output root folder)
+extern configuration::data myconfigdata2;
+
+#endif   //#define _CONFIGURATION_H_
@@ -0,0 +1,123 @@
+/**
+	@file
+	@brief SHA-256 hashing of conversion inputs
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "ContentHash.h"
+#include <bcrypt.h>
+
+#pragma comment(lib, "bcrypt.lib")
+
+/// Size of a SHA-256 hash
+#define HASH_SIZE	32
+
+/**
+*/
+ContentHash::ContentHash() : m_hAlg(NULL), m_hHash(NULL), m_pObject(NULL)
+{
+	BCRYPT_ALG_HANDLE hAlg;
+	if (BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_SHA256_ALGORITHM, NULL, 0) < 0)
+		return;
+	m_hAlg = hAlg;
+
+	DWORD dwObject, dwSize;
+	if (BCryptGetProperty(hAlg, BCRYPT_OBJECT_LENGTH, (PUCHAR)&dwObject, sizeof(dwObject), &dwSize, 0) < 0)
+		return;
+	m_pObject = new unsigned char[dwObject];
+	BCRYPT_HASH_HANDLE hHash;
+	if (BCryptCreateHash(hAlg, &hHash, m_pObject, dwObject, NULL, 0, 0) >= 0)
+		m_hHash = hHash;
+}
+
+/**
+*/
+ContentHash::~ContentHash()
+{
+	if (m_hHash != NULL)
+		BCryptDestroyHash((BCRYPT_HASH_HANDLE)m_hHash);
+	if (m_hAlg != NULL)
+		BCryptCloseAlgorithmProvider((BCRYPT_ALG_HANDLE)m_hAlg, 0);
+	if (m_pObject != NULL)
+		delete [] m_pObject;
+}
+
+/**
+	@param pData The data to add
+	@param nLen Size of the data
+*/
+void ContentHash::Add(const void* pData, size_t nLen)
+{
+	if (m_hHash == NULL)
+		return;
+	// BCryptHashData takes a ULONG length, so the data goes in 1GB blocks
+	const unsigned char* p = (const unsigned char*)pData;
+	while (nLen > 0)
+	{
+		ULONG nBlock = (ULONG)min(nLen, (size_t)0x40000000);
+		BCryptHashData((BCRYPT_HASH_HANDLE)m_hHash, (PUCHAR)p, nBlock, 0);
+		p += nBlock;
+		nLen -= nBlock;
+	}
+}
+
+/**
+	@param lpFile The file to add
+	@return true if the whole file was read
+*/
+bool ContentHash::AddFile(LPCTSTR lpFile)
+{
+	HANDLE hFile = CreateFile(lpFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	char cBlock[64 * 1024];
+	DWORD dwRead;
+	BOOL bRead;
+	while ((bRead = ReadFile(hFile, cBlock, sizeof(cBlock), &dwRead, NULL)) && (dwRead > 0))
+		Add(cBlock, dwRead);
+	CloseHandle(hFile);
+	return bRead != FALSE;
+}
+
+/**
+	@return The hash, as lower case hex digits (empty if hashing isn't available)
+*/
+std::string ContentHash::Finish()
+{
+	unsigned char cHash[HASH_SIZE];
+	if ((m_hHash == NULL) || (BCryptFinishHash((BCRYPT_HASH_HANDLE)m_hHash, cHash, HASH_SIZE, 0) < 0))
+		return "";
+	BCryptDestroyHash((BCRYPT_HASH_HANDLE)m_hHash);
+	m_hHash = NULL;
+
+	static const char HEX[] = "0123456789abcdef";
+	std::string sRet;
+	for (int i = 0; i < HASH_SIZE; i++)
+	{
+		sRet += HEX[cHash[i] >> 4];
+		sRet += HEX[cHash[i] & 0xF];
+	}
+	return sRet;
+}
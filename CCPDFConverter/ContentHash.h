@@ -0,0 +1,66 @@
+/**
+	@file
+	@brief SHA-256 hashing of conversion inputs
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _CONTENTHASH_H_
+#define _CONTENTHASH_H_
+
+#include <string>
+
+/**
+    @brief Incremental SHA-256 hash (using the Windows CNG provider)
+*/
+class ContentHash
+{
+public:
+	/// Ctor
+	ContentHash();
+	/// Dtor
+	virtual ~ContentHash();
+
+	/// Adds data to the hash
+	void				Add(const void* pData, size_t nLen);
+	/// Adds the contents of a file to the hash
+	bool				AddFile(LPCTSTR lpFile);
+	/// Ends the hash and returns it as hex text
+	std::string			Finish();
+
+	/**
+		@brief Checks if the hash could be created
+		@return true if the hash provider is available
+	*/
+	bool				IsValid() const {return m_hHash != NULL;};
+
+protected:
+	/// Algorithm provider
+	void*				m_hAlg;
+	/// Hash object
+	void*				m_hHash;
+	/// Memory for the hash object
+	unsigned char*		m_pObject;
+};
+
+#endif   //#define _CONTENTHASH_H_
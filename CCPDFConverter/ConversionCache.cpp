@@ -0,0 +1,265 @@
+/**
+	@file
+	@brief Content-addressed cache of converted documents
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "ConversionCache.h"
+#include "Configuration.h"
+#include "ContentHash.h"
+#include "OutputWriter.h"
+#include <algorithm>
+#include <ctype.h>
+#include <fstream>
+#include <stdio.h>
+
+/// Default cache size limit
+#define DEFAULT_CACHE_SIZE		(256 * 1024 * 1024)
+/// Name of the mutex serializing cache changes (followed by a hash of the cache folder)
+#define CACHE_MUTEX				"CCPDFConverterCache-"
+/// Name of the statistics file
+#define CACHE_STATS				"cache.stats"
+
+/// A cache entry, as seen when evicting
+struct CacheEntry
+{
+	/// Last use
+	unsigned __int64	nUsed;
+	/// File size
+	unsigned __int64	nSize;
+	/// File name (in the cache folder)
+	std::string			sName;
+
+	/// Least recently used first
+	bool operator<(const CacheEntry& other) const {return nUsed < other.nUsed;};
+};
+
+/**
+*/
+ConversionCache::ConversionCache() : m_hMutex(NULL)
+{
+	m_sFolder = myconfigdata.getstring("cache.folder", "");
+	m_nMaxSize = myconfigdata.getsize("cache.size", DEFAULT_CACHE_SIZE);
+	m_bHardlink = myconfigdata.getbool("cache.hardlink", false);
+	if (m_sFolder.empty())
+		return;
+	if ((m_sFolder[m_sFolder.size() - 1] == '\\') || (m_sFolder[m_sFolder.size() - 1] == '/'))
+		m_sFolder.erase(m_sFolder.size() - 1);
+	CreateDirectory(m_sFolder.c_str(), NULL);
+
+	// One mutex per folder, so unrelated caches don't wait for each other (the same folder
+	// named another way, e.g. through a share, gets a mutex of its own)
+	TCHAR cFull[MAX_PATH];
+	std::string sPath = GetFullPathName(m_sFolder.c_str(), MAX_PATH, cFull, NULL) ? cFull : m_sFolder;
+	std::transform(sPath.begin(), sPath.end(), sPath.begin(), tolower);
+	ContentHash hash;
+	hash.Add(sPath.data(), sPath.size());
+	m_hMutex = CreateMutex(NULL, FALSE, (CACHE_MUTEX + hash.Finish().substr(0, 32)).c_str());
+}
+
+/**
+*/
+ConversionCache::~ConversionCache()
+{
+	if (m_hMutex != NULL)
+		CloseHandle(m_hMutex);
+}
+
+/**
+	@param sInputHash Hash of the PostScript data
+	@param args The GhostScript flags that affect the output
+*/
+void ConversionCache::SetKey(const std::string& sInputHash, const ARGLIST& args)
+{
+	ContentHash hash;
+	hash.Add(sInputHash.c_str(), sInputHash.size());
+	for (ARGLIST::const_iterator i = args.begin(); i != args.end(); i++)
+	{
+		// Separated, so "-a" "b" isn't the same as "-ab"
+		hash.Add("\n", 1);
+		hash.Add(i->c_str(), i->size());
+	}
+	m_sKey = hash.Finish();
+}
+
+/**
+	@return Full name of the entry file
+*/
+std::string ConversionCache::GetEntryName() const
+{
+	return m_sFolder + "\\" + m_sKey + ".pdf";
+}
+
+/**
+	@param lpDest Where to place the document
+	@return How it was placed (PlaceNone if not in the cache)
+*/
+PlaceMethod ConversionCache::Fetch(LPCTSTR lpDest)
+{
+	if (!IsEnabled() || m_sKey.empty())
+		return PlaceNone;
+
+	std::string sEntry = GetEntryName();
+	PlaceMethod eMethod = PlaceNone;
+	WaitForSingleObject(m_hMutex, INFINITE);
+	HANDLE hEntry = CreateFile(sEntry.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	if (hEntry != INVALID_HANDLE_VALUE)
+	{
+		// Mark it as used (access times aren't always updated by the file system)
+		FILETIME ftNow;
+		GetSystemTimeAsFileTime(&ftNow);
+		SetFileTime(hEntry, NULL, &ftNow, NULL);
+		CloseHandle(hEntry);
+		eMethod = PlaceFile(sEntry.c_str(), lpDest, m_bHardlink);
+	}
+	ReleaseMutex(m_hMutex);
+	AddStats((eMethod != PlaceNone) ? "hits" : "misses", 1);
+	return eMethod;
+}
+
+/**
+	@param lpFile The converted document
+	@return true if added
+*/
+bool ConversionCache::Store(LPCTSTR lpFile)
+{
+	if (!IsEnabled() || m_sKey.empty())
+		return false;
+
+	// Placed aside and renamed, so a concurrent Fetch never sees half an entry
+	std::string sEntry = GetEntryName();
+	char cTemp[MAX_PATH + 16];
+	sprintf_s(cTemp, sizeof(cTemp), "%s.%u", sEntry.c_str(), GetCurrentProcessId());
+	if (PlaceFile(lpFile, cTemp, m_bHardlink) == PlaceNone)
+		return false;
+	WaitForSingleObject(m_hMutex, INFINITE);
+	// (An entry with the same key, if any, is replaced)
+	__int64 nAdded = (__int64)GetSize(cTemp) - (__int64)GetSize(sEntry.c_str());
+	bool bRet = PublishOutput(cTemp, sEntry.c_str(), DurabilityNone);
+	// The cache's size is kept in the statistics, so the folder is only listed once it's over the limit
+	// (or when there was no size kept yet, e.g. for a cache made by an older version)
+	if (bRet)
+	{
+		__int64 nBytes = AddStats("bytes", nAdded);
+		if ((nBytes == nAdded) || ((unsigned __int64)nBytes > m_nMaxSize))
+			Evict();
+	}
+	ReleaseMutex(m_hMutex);
+	if (bRet)
+		AddStats("stores", 1);
+	else
+		DeleteFile(cTemp);
+	return bRet;
+}
+
+/**
+	@param lpFile The file
+	@return Its size (0 if it's not there)
+*/
+unsigned __int64 ConversionCache::GetSize(LPCTSTR lpFile)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesEx(lpFile, GetFileExInfoStandard, &data))
+		return 0;
+	return ((unsigned __int64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+}
+
+/**
+	@param pCounter Name of the counter to add to
+	@param nAdd Value to add
+	@param pCounter2 Name of another counter to add to (NULL if none)
+	@param nAdd2 Value to add to the other counter
+	@return The new value of the (first) counter
+*/
+__int64 ConversionCache::AddStats(const char* pCounter, __int64 nAdd, const char* pCounter2, __int64 nAdd2)
+{
+	std::string sStats = m_sFolder + "\\" + CACHE_STATS;
+	WaitForSingleObject(m_hMutex, INFINITE);
+	configuration::data stats;
+	{
+		std::ifstream in(sStats.c_str());
+		in >> stats;
+	}
+	char cNum[32];
+	__int64 nRet = _atoi64(stats.getstring(pCounter, "0").c_str()) + nAdd;
+	sprintf_s(cNum, sizeof(cNum), "%I64d", nRet);
+	stats[pCounter] = cNum;
+	if (pCounter2 != NULL)
+	{
+		sprintf_s(cNum, sizeof(cNum), "%I64d", _atoi64(stats.getstring(pCounter2, "0").c_str()) + nAdd2);
+		stats[pCounter2] = cNum;
+	}
+	{
+		std::ofstream out(sStats.c_str());
+		out << stats;
+	}
+	ReleaseMutex(m_hMutex);
+	return nRet;
+}
+
+/**
+	Called with the mutex held, when the kept size of the cache is over the limit (or not known)
+*/
+void ConversionCache::Evict()
+{
+	std::vector<CacheEntry> entries;
+	unsigned __int64 nTotal = 0;
+	WIN32_FIND_DATA fd;
+	HANDLE hFind = FindFirstFile((m_sFolder + "\\*.pdf").c_str(), &fd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		CacheEntry entry;
+		entry.nUsed = ((unsigned __int64)fd.ftLastAccessTime.dwHighDateTime << 32) | fd.ftLastAccessTime.dwLowDateTime;
+		entry.nSize = ((unsigned __int64)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+		entry.sName = fd.cFileName;
+		nTotal += entry.nSize;
+		entries.push_back(entry);
+	} while (FindNextFile(hFind, &fd));
+	FindClose(hFind);
+	// (The kept size may have drifted, e.g. if entries were removed by hand: it's set right here)
+	__int64 nKept = AddStats("bytes", 0);
+	if (nTotal <= m_nMaxSize)
+	{
+		AddStats("bytes", (__int64)nTotal - nKept);
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end());
+	__int64 nEvicted = 0, nEvictedBytes = 0;
+	for (std::vector<CacheEntry>::const_iterator i = entries.begin(); (i != entries.end()) && (nTotal > m_nMaxSize); i++)
+	{
+		if (DeleteFile((m_sFolder + "\\" + i->sName).c_str()))
+		{
+			nTotal -= i->nSize;
+			nEvicted++;
+			nEvictedBytes += i->nSize;
+		}
+	}
+	// The mutex can be taken again by the same thread
+	AddStats("evictions", nEvicted, "evicted.bytes", nEvictedBytes);
+	AddStats("bytes", (__int64)nTotal - nKept);
+}
@@ -0,0 +1,99 @@
+/**
+	@file
+	@brief Content-addressed cache of converted documents
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _CONVERSIONCACHE_H_
+#define _CONVERSIONCACHE_H_
+
+#include "Sidecar.h"
+#include "FilePlacement.h"
+
+/**
+    @brief Keeps converted documents, so a reprinted document isn't converted again
+
+	Entries are named by a SHA-256 key of the PostScript data (after the job header) and
+	the GhostScript flags used to convert it. The cache is kept within a size limit by
+	removing the least recently used entries. Hit and miss counts, and the size of the
+	cache, are kept in the cache.stats file in the cache folder; the folder is only
+	listed (to choose what to remove) when a new entry takes that size over the limit.
+
+	Settings:
+	- cache.folder: where the cache is kept (no caching if not set)
+	- cache.size: size limit (default 256M)
+	- cache.hardlink: allow entries to be hard links to published documents (default no;
+	  only safe if documents are never modified in place)
+*/
+class ConversionCache
+{
+public:
+	/// Ctor
+	ConversionCache();
+	/// Dtor
+	virtual ~ConversionCache();
+
+	/**
+		@brief Checks if caching is enabled
+		@return true if a cache folder is set
+	*/
+	bool				IsEnabled() const {return !m_sFolder.empty();};
+
+	/// Sets the key of the current job
+	void				SetKey(const std::string& sInputHash, const ARGLIST& args);
+	/**
+		@brief Returns the key of the current job
+		@return The key (hex digits)
+	*/
+	const std::string&	GetKey() const {return m_sKey;};
+
+	/// Places the cached document of the current job, if there's one
+	PlaceMethod			Fetch(LPCTSTR lpDest);
+	/// Adds the converted document of the current job
+	bool				Store(LPCTSTR lpFile);
+
+protected:
+	/// Returns the name of the current job's entry
+	std::string			GetEntryName() const;
+	/// Adds to counters in the statistics file
+	__int64				AddStats(const char* pCounter, __int64 nAdd, const char* pCounter2 = NULL, __int64 nAdd2 = 0);
+	/// Returns the size of a file
+	static unsigned __int64	GetSize(LPCTSTR lpFile);
+	/// Removes the least recently used entries until the cache is within its size limit
+	void				Evict();
+
+protected:
+	/// The cache folder (empty if disabled)
+	std::string			m_sFolder;
+	/// Size limit
+	unsigned __int64	m_nMaxSize;
+	/// true if entries may be hard links
+	bool				m_bHardlink;
+	/// Key of the current job
+	std::string			m_sKey;
+	/// Serializes changes to the cache between converters
+	HANDLE				m_hMutex;
+};
+
+#endif   //#define _CONVERSIONCACHE_H_
@@ -0,0 +1,215 @@
+/**
+	@file
+	@brief Bounded capture of the GhostScript output and errors
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "Diagnostics.h"
+#include <stdio.h>
+#include <string.h>
+
+/// Default maximal count of lines per job
+#define DEFAULT_MAX_LINES	200
+
+/// GhostScript error names, in error code order (e_dictfull is -2, e_dictstackoverflow is -3 etc., see ierrors.h)
+static const char* ERROR_NAMES[] =
+{
+	"unknownerror", "dictfull", "dictstackoverflow", "dictstackunderflow", "execstackoverflow",
+	"interrupt", "invalidaccess", "invalidexit", "invalidfileaccess", "invalidfont",
+	"invalidrestore", "ioerror", "limitcheck", "nocurrentpoint", "rangecheck",
+	"stackoverflow", "stackunderflow", "syntaxerror", "timeout", "typecheck",
+	"undefined", "undefinedfilename", "undefinedresult", "unmatchedmark", "VMerror",
+	"configurationerror", "undefinedresource", "unregistered", "invalidcontext", "invalidid"
+};
+
+Diagnostics::Diagnostics() : m_nMaxLines(DEFAULT_MAX_LINES)
+{
+	Reset();
+}
+
+void Diagnostics::Reset()
+{
+	m_nRingNext = m_nRingCount = 0;
+	m_nPartial[StreamOut] = m_nPartial[StreamErr] = 0;
+	m_nLines = m_nErrLines = m_nDropped = 0;
+	m_sErrorName.clear();
+	m_sOffendingCommand.clear();
+	m_nErrorCode = 0;
+}
+
+/**
+	@param eStream The stream the data was written to
+	@param pStr The data
+	@param nLen Size of the data
+*/
+void Diagnostics::Add(Stream eStream, const char* pStr, int nLen)
+{
+	char* pPartial = m_cPartial[eStream];
+	int& nPartial = m_nPartial[eStream];
+	for (int i = 0; i < nLen; i++)
+	{
+		if (pStr[i] == '\n')
+		{
+			AddLine(eStream, pPartial, nPartial);
+			nPartial = 0;
+		}
+		else if ((pStr[i] != '\r') && (nPartial < LINE_LEN - 1))
+			// Anything longer than a line is cut
+			pPartial[nPartial++] = pStr[i];
+	}
+}
+
+void Diagnostics::Flush()
+{
+	for (int i = StreamOut; i <= StreamErr; i++)
+	{
+		if (m_nPartial[i] > 0)
+			AddLine((Stream)i, m_cPartial[i], m_nPartial[i]);
+		m_nPartial[i] = 0;
+	}
+}
+
+/**
+	@param eStream The stream the line was written to
+	@param pLine The line (without the newline)
+	@param nLen Length of the line
+*/
+void Diagnostics::AddLine(Stream eStream, const char* pLine, int nLen)
+{
+	if (nLen == 0)
+		return;
+	if (eStream == StreamErr)
+		m_nErrLines++;
+
+	// Every line is checked for the error: GhostScript reports the fatal one last, after
+	// whatever made the job noisy, so the limit mustn't hide it
+	char cLine[LINE_LEN];
+	memcpy(cLine, pLine, nLen);
+	cLine[nLen] = '\0';
+	bool bError = m_sErrorName.empty() && ParseError(cLine);
+	if ((m_nLines >= m_nMaxLines) && (eStream != StreamErr) && !bError)
+	{
+		// Over the limit: just count it
+		m_nDropped++;
+		return;
+	}
+	m_nLines++;
+
+	// Keep it (overwriting the oldest line if the ring is full)
+	memcpy(m_cRing[m_nRingNext], cLine, nLen + 1);
+	m_eRing[m_nRingNext] = eStream;
+	m_nRingNext = (m_nRingNext + 1) % RING_LINES;
+	if (m_nRingCount < RING_LINES)
+		m_nRingCount++;
+}
+
+/**
+	@param pLine The line to check (NULL terminated)
+	@return true if the line described an error (which is now the job's error)
+*/
+bool Diagnostics::ParseError(const char* pLine)
+{
+	char cName[LINE_LEN], cCommand[LINE_LEN];
+	cCommand[0] = '\0';
+	const char* pFound;
+	if ((pFound = strstr(pLine, "Error: /")) != NULL)
+	{
+		// Interpreter format: "Error: /undefined in /foo"
+		if (sscanf_s(pFound + 8, "%[^ ] in %[^\n]", cName, LINE_LEN, cCommand, LINE_LEN) < 1)
+			return false;
+	}
+	else if ((pFound = strstr(pLine, "%%[ Error: ")) != NULL)
+	{
+		// Printer format: "%%[ Error: undefined; OffendingCommand: foo ]%%"
+		if (sscanf_s(pFound + 11, "%[^;]; OffendingCommand: %[^ ]", cName, LINE_LEN, cCommand, LINE_LEN) < 1)
+			return false;
+	}
+	else
+		return false;
+
+	m_sErrorName = cName;
+	m_sOffendingCommand = (cCommand[0] == '/') ? cCommand + 1 : cCommand;
+	m_nErrorCode = -1;
+	for (int i = 0; i < (int)(sizeof(ERROR_NAMES) / sizeof(ERROR_NAMES[0])); i++)
+	{
+		if (m_sErrorName == ERROR_NAMES[i])
+		{
+			m_nErrorCode = -(i + 1);
+			break;
+		}
+	}
+	return true;
+}
+
+/**
+	@return The kept error stream lines, oldest first
+*/
+std::string Diagnostics::GetErrorText() const
+{
+	std::string sRet;
+	int nFirst = (m_nRingNext - m_nRingCount + RING_LINES) % RING_LINES;
+	for (int i = 0; i < m_nRingCount; i++)
+	{
+		int n = (nFirst + i) % RING_LINES;
+		if (m_eRing[n] != StreamErr)
+			continue;
+		sRet += m_cRing[n];
+		sRet += '\n';
+	}
+	if (m_nDropped > 0)
+	{
+		char cMore[64];
+		sprintf_s(cMore, sizeof(cMore), "(%d more lines)\n", m_nDropped);
+		sRet += cMore;
+	}
+	return sRet;
+}
+
+/**
+	@param result The job result to add the diagnostics to
+*/
+void Diagnostics::ToResult(configuration::data& result) const
+{
+	char cNum[32];
+	result["error.name"] = m_sErrorName;
+	result["error.command"] = m_sOffendingCommand;
+	sprintf_s(cNum, sizeof(cNum), "%d", m_nErrorCode);
+	result["error.code"] = cNum;
+	sprintf_s(cNum, sizeof(cNum), "%d", m_nErrLines);
+	result["output.errlines"] = cNum;
+	sprintf_s(cNum, sizeof(cNum), "%d", m_nLines + m_nDropped);
+	result["output.lines"] = cNum;
+	sprintf_s(cNum, sizeof(cNum), "%d", m_nDropped);
+	result["output.dropped"] = cNum;
+
+	// And the last lines themselves, oldest first
+	int nFirst = (m_nRingNext - m_nRingCount + RING_LINES) % RING_LINES;
+	for (int i = 0; i < m_nRingCount; i++)
+	{
+		int n = (nFirst + i) % RING_LINES;
+		sprintf_s(cNum, sizeof(cNum), "output.%02d.%s", i, (m_eRing[n] == StreamErr) ? "err" : "out");
+		result[cNum] = m_cRing[n];
+	}
+}
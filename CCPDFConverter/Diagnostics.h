@@ -0,0 +1,134 @@
+/**
+	@file
+	@brief Bounded capture of the GhostScript output and errors
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _DIAGNOSTICS_H_
+#define _DIAGNOSTICS_H_
+
+#include <string>
+#include "Configuration.h"
+
+/**
+    @brief Keeps the last lines GhostScript wrote, and the error it reported
+
+	Lines are kept in a fixed-size ring buffer, so a noisy job costs O(1) per line and
+	never more memory than the ring. Each job may add a limited count of lines; after that,
+	output lines are only counted, while error stream lines (and any line describing the
+	error) still go through the ring. Every line is checked for the error. Error lines
+	("Error: /name in command" and "%%[ Error: name; OffendingCommand: command ]%%") are
+	parsed into an error name, the offending command and the GhostScript error code.
+*/
+class Diagnostics
+{
+public:
+	/// Output stream a line came from
+	typedef enum
+	{
+		StreamOut = 0,
+		StreamErr = 1
+	} Stream;
+
+	/// Constructor
+	Diagnostics();
+
+	/**
+		@brief Sets the maximal count of lines a job may add
+		@param nMax The count of lines; anything above it is dropped
+	*/
+	void				SetMaxLines(int nMax) {m_nMaxLines = nMax;};
+	/// Adds output from GhostScript (any part of a line or more than one line)
+	void				Add(Stream eStream, const char* pStr, int nLen);
+	/// Ends the current job: completes partial lines
+	void				Flush();
+	/// Clears everything (for a new job or a retry)
+	void				Reset();
+
+	/**
+		@brief Checks if any errors were reported
+		@return true if there was output on the error stream
+	*/
+	bool				HasErrors() const {return m_nErrLines > 0;};
+	/**
+		@brief Returns the name of the (first) error reported
+		@return The error name (e.g. "undefined"), empty if none was found
+	*/
+	const std::string&	GetErrorName() const {return m_sErrorName;};
+	/**
+		@brief Returns the command that caused the (first) error
+		@return The offending command, empty if none was found
+	*/
+	const std::string&	GetOffendingCommand() const {return m_sOffendingCommand;};
+	/**
+		@brief Returns the GhostScript code of the (first) error reported
+		@return The code (see ierrors.h), 0 if none was found, -1 for unknown names
+	*/
+	int					GetErrorCode() const {return m_nErrorCode;};
+	/// Returns the kept error lines as text (for showing to the user)
+	std::string			GetErrorText() const;
+	/// Writes the diagnostics into a job result
+	void				ToResult(configuration::data& result) const;
+
+protected:
+	/// Ring buffer size (lines)
+	enum {RING_LINES = 64};
+	/// Maximal kept line length
+	enum {LINE_LEN = 160};
+
+	/// Handles a complete line
+	void				AddLine(Stream eStream, const char* pLine, int nLen);
+	/// Looks for an error description in a line
+	bool				ParseError(const char* pLine);
+
+	// Data
+	/// The kept lines
+	char				m_cRing[RING_LINES][LINE_LEN];
+	/// Stream of each of the kept lines
+	Stream				m_eRing[RING_LINES];
+	/// Next ring location to write
+	int					m_nRingNext;
+	/// Count of lines in the ring
+	int					m_nRingCount;
+	/// Partial (incomplete) line for each stream
+	char				m_cPartial[2][LINE_LEN];
+	/// Length of the partial lines
+	int					m_nPartial[2];
+	/// Maximal count of lines per job
+	int					m_nMaxLines;
+	/// Count of lines added
+	int					m_nLines;
+	/// Count of error stream lines added
+	int					m_nErrLines;
+	/// Count of lines dropped by the limit
+	int					m_nDropped;
+	/// Error name
+	std::string			m_sErrorName;
+	/// Offending command
+	std::string			m_sOffendingCommand;
+	/// Error code
+	int					m_nErrorCode;
+};
+
+#endif   //#define _DIAGNOSTICS_H_
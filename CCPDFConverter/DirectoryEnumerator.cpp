@@ -0,0 +1,280 @@
+/**
+	@file
+	@brief Lists the sub-folders of folders in large batches, several folders at a time
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "DirectoryEnumerator.h"
+#include <string.h>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+// (Windows 7 and up; older SDKs don't have them)
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH	2
+#endif
+/// FindExInfoBasic: no short (8.3) names
+#define FIND_EX_INFO_BASIC			((FINDEX_INFO_LEVELS)1)
+#else
+/// Size of the buffer entries are read into
+#define LISTING_BUFFER_SIZE			(256 * 1024)
+
+/// An entry as getdents64 returns it
+struct LinuxDirent64
+{
+	/// Inode number
+	unsigned long long	d_ino;
+	/// Offset of the next entry
+	long long			d_off;
+	/// Size of this entry
+	unsigned short		d_reclen;
+	/// Entry type (DT_xxx)
+	unsigned char		d_type;
+	/// Name
+	char				d_name[1];
+};
+#endif
+
+/**
+*/
+DirectoryEnumerator::DirectoryEnumerator() : m_nNext(0)
+{
+}
+
+/**
+	@param sFolder The folder
+*/
+void DirectoryEnumerator::Add(const std::string& sFolder)
+{
+	Folder folder;
+	folder.sPath = sFolder;
+	m_folders.push_back(folder);
+}
+
+/**
+	@param nThreads Most threads to list the folders with (1 or less to list them one by one on this thread)
+*/
+void DirectoryEnumerator::Run(int nThreads)
+{
+	m_lists.clear();
+	m_lists.resize(m_folders.size());
+	m_nNext = 0;
+	if (nThreads > (int)m_folders.size())
+		nThreads = (int)m_folders.size();
+	if (nThreads <= 1)
+		Work();
+	else
+	{
+#ifdef _WIN32
+		std::vector<HANDLE> threads;
+		for (int i = 0; i < nThreads; i++)
+		{
+			HANDLE hThread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+			if (hThread != NULL)
+				threads.push_back(hThread);
+		}
+		// (This thread does its part too, so it's done even if no thread could start)
+		Work();
+		if (!threads.empty())
+			WaitForMultipleObjects((DWORD)threads.size(), &threads[0], TRUE, INFINITE);
+		for (std::vector<HANDLE>::iterator i = threads.begin(); i != threads.end(); i++)
+			CloseHandle(*i);
+#else
+		std::vector<pthread_t> threads;
+		for (int i = 0; i < nThreads; i++)
+		{
+			pthread_t thread;
+			if (pthread_create(&thread, NULL, WorkerThread, this) == 0)
+				threads.push_back(thread);
+		}
+		Work();
+		for (std::vector<pthread_t>::iterator i = threads.begin(); i != threads.end(); i++)
+			pthread_join(*i, NULL);
+#endif
+	}
+
+	// All in one array
+	size_t nTotal = 0;
+	for (std::vector<std::vector<std::string> >::const_iterator i = m_lists.begin(); i != m_lists.end(); i++)
+		nTotal += (*i).size();
+	m_names.clear();
+	m_names.reserve(nTotal);
+	for (size_t i = 0; i < m_folders.size(); i++)
+	{
+		m_folders[i].nFirst = m_names.size();
+		m_folders[i].nCount = m_lists[i].size();
+		for (std::vector<std::string>::iterator j = m_lists[i].begin(); j != m_lists[i].end(); j++)
+		{
+			m_names.push_back(std::string());
+			m_names.back().swap(*j);
+		}
+	}
+	m_lists.clear();
+}
+
+/**
+	@param lpParam The enumerator
+	@return 0
+*/
+#ifdef _WIN32
+DWORD WINAPI DirectoryEnumerator::WorkerThread(LPVOID lpParam)
+#else
+void* DirectoryEnumerator::WorkerThread(void* lpParam)
+#endif
+{
+	((DirectoryEnumerator*)lpParam)->Work();
+	return 0;
+}
+
+/**
+	Each thread takes the next folder no one took yet
+*/
+void DirectoryEnumerator::Work()
+{
+	// One listing buffer for all the thread's folders
+	std::vector<char> buffer;
+	while (true)
+	{
+#ifdef _WIN32
+		long nFolder = InterlockedIncrement(&m_nNext) - 1;
+#else
+		long nFolder = __sync_fetch_and_add(&m_nNext, 1);
+#endif
+		if (nFolder >= (long)m_folders.size())
+			break;
+		Folder& folder = m_folders[nFolder];
+		// The time first, so a change made while it's listed shows up next time
+		folder.bListed = GetStamp(folder.sPath, folder.nStamp) && ListFolder(folder.sPath, m_lists[nFolder], &buffer);
+	}
+}
+
+/**
+	@param s1 First name
+	@param s2 Second name
+	@return true if the first name comes before the second (ignoring case, unless that's all they differ by)
+*/
+bool DirectoryEnumerator::NameLess(const std::string& s1, const std::string& s2)
+{
+#ifdef _WIN32
+	int nCompare = _stricmp(s1.c_str(), s2.c_str());
+#else
+	int nCompare = strcasecmp(s1.c_str(), s2.c_str());
+#endif
+	return (nCompare != 0) ? (nCompare < 0) : (s1 < s2);
+}
+
+/**
+	@param sFolder The folder
+	@param nStamp Receives the time the folder was last changed
+	@return true if the folder is there
+*/
+bool DirectoryEnumerator::GetStamp(const std::string& sFolder, unsigned __int64& nStamp)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesEx(sFolder.c_str(), GetFileExInfoStandard, &data) || !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+	nStamp = ((unsigned __int64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if ((stat(sFolder.c_str(), &st) != 0) || !S_ISDIR(st.st_mode))
+		return false;
+	nStamp = (unsigned __int64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+/**
+	@param sFolder The folder
+	@param names Receives the names of the sub-folders, sorted
+	@param pBuffer Buffer to read the entries into, kept for the next folder (NULL to use one
+	just for this folder; not used on Windows)
+	@return true if the folder was listed
+*/
+bool DirectoryEnumerator::ListFolder(const std::string& sFolder, std::vector<std::string>& names, std::vector<char>* pBuffer)
+{
+	names.clear();
+#ifdef _WIN32
+	WIN32_FIND_DATA data;
+	std::string sPattern = sFolder + "\\*";
+	HANDLE hFind = FindFirstFileEx(sPattern.c_str(), FIND_EX_INFO_BASIC, &data, FindExSearchLimitToDirectories, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if ((hFind == INVALID_HANDLE_VALUE) && (GetLastError() == ERROR_INVALID_PARAMETER))
+		// Before Windows 7
+		hFind = FindFirstFileEx(sPattern.c_str(), FindExInfoStandard, &data, FindExSearchLimitToDirectories, NULL, 0);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		// (Limiting the search to folders is only a hint)
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && (strcmp(data.cFileName, ".") != 0) && (strcmp(data.cFileName, "..") != 0))
+			names.push_back(data.cFileName);
+	}
+	while (FindNextFile(hFind, &data));
+	FindClose(hFind);
+#else
+	int nFolder = open(sFolder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (nFolder == -1)
+		return false;
+	std::vector<char> ownBuffer;
+	std::vector<char>& buffer = (pBuffer != NULL) ? *pBuffer : ownBuffer;
+	// (Filling a new buffer would cost more than listing a small folder)
+	if (buffer.size() < LISTING_BUFFER_SIZE)
+		buffer.resize(LISTING_BUFFER_SIZE);
+	long nRead;
+	while ((nRead = syscall(SYS_getdents64, nFolder, &buffer[0], buffer.size())) > 0)
+	{
+		for (long nPos = 0; nPos < nRead; )
+		{
+			const LinuxDirent64* pEntry = (const LinuxDirent64*)&buffer[nPos];
+			nPos += pEntry->d_reclen;
+			const char* pName = pEntry->d_name;
+			if ((strcmp(pName, ".") == 0) || (strcmp(pName, "..") == 0) || (strchr(pName, '\n') != NULL))
+				continue;
+			bool bFolder = (pEntry->d_type == DT_DIR);
+			if ((pEntry->d_type == DT_UNKNOWN) || (pEntry->d_type == DT_LNK))
+			{
+				// The file system didn't say (or it's a link, which may be to a folder)
+				struct stat st;
+				bFolder = (fstatat(nFolder, pName, &st, 0) == 0) && S_ISDIR(st.st_mode);
+			}
+			if (bFolder)
+				names.push_back(pName);
+		}
+	}
+	close(nFolder);
+	if (nRead < 0)
+		return false;
+#endif
+	std::sort(names.begin(), names.end(), NameLess);
+	return true;
+}
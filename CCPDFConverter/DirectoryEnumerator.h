@@ -0,0 +1,123 @@
+/**
+	@file
+	@brief Lists the sub-folders of folders in large batches, several folders at a time
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _DIRECTORYENUMERATOR_H_
+#define _DIRECTORYENUMERATOR_H_
+
+#include <string>
+#include <vector>
+
+/**
+    @brief Lists the sub-folders of folders, reading many entries per call
+
+	On Windows each folder is read with FindFirstFileEx asking for the basic information
+	only, in large fetches (fewer round trips to a file server); on Linux with getdents64
+	into a large buffer. Folders are told apart by the entry type the listing already has,
+	without looking at each entry on its own (except where the file system doesn't say).
+
+	Any number of folders can be listed together by a few threads. The names of all their
+	sub-folders come back in one array, folder after folder (in the order they were added),
+	each folder's names sorted.
+
+	On a local disk this is no faster than listing with readdir (tests/
+	DirectoryEnumeratorBenchmark times both); fewer round trips only matter to a file
+	server, which hasn't been measured.
+*/
+class DirectoryEnumerator
+{
+public:
+	/// A folder to list
+	struct Folder
+	{
+		/// Ctor
+		Folder() : bListed(false), nStamp(0), nFirst(0), nCount(0) {};
+
+		/// The folder
+		std::string			sPath;
+		/// true if it was listed
+		bool				bListed;
+		/// Its modification time, taken before it was listed
+		unsigned __int64	nStamp;
+		/// Where its sub-folders start in the names
+		size_t				nFirst;
+		/// Count of its sub-folders
+		size_t				nCount;
+	};
+
+	/// Ctor
+	DirectoryEnumerator();
+
+	/// Adds a folder to list
+	void				Add(const std::string& sFolder);
+	/// Lists all the folders that were added
+	void				Run(int nThreads);
+	/**
+		@brief Returns the count of folders
+		@return Count of folders added
+	*/
+	size_t				GetFolderCount() const {return m_folders.size();};
+	/**
+		@brief Returns a folder (and where its sub-folders are in the names)
+		@param nFolder Index of the folder (in the order it was added)
+		@return The folder
+	*/
+	const Folder&		GetFolder(size_t nFolder) const {return m_folders[nFolder];};
+	/**
+		@brief Returns the names of all the sub-folders
+		@return The names, by folder, and sorted within each
+	*/
+	const std::vector<std::string>&	GetNames() const {return m_names;};
+
+	/// Lists the sub-folders of one folder
+	static bool			ListFolder(const std::string& sFolder, std::vector<std::string>& names, std::vector<char>* pBuffer = NULL);
+	/// Returns the modification time of a folder
+	static bool			GetStamp(const std::string& sFolder, unsigned __int64& nStamp);
+	/// Compares names the way they're sorted
+	static bool			NameLess(const std::string& s1, const std::string& s2);
+
+protected:
+	/// Thread function
+#ifdef _WIN32
+	static DWORD WINAPI	WorkerThread(LPVOID lpParam);
+#else
+	static void*		WorkerThread(void* pParam);
+#endif
+	/// Lists folders until there are none left
+	void				Work();
+
+protected:
+	/// The folders
+	std::vector<Folder>	m_folders;
+	/// Each folder's sub-folders, until they're all put in m_names
+	std::vector<std::vector<std::string> >	m_lists;
+	/// Sub-folders of all the folders
+	std::vector<std::string>	m_names;
+	/// Index of the next folder to list
+	volatile long		m_nNext;
+};
+
+#endif   //#define _DIRECTORYENUMERATOR_H_
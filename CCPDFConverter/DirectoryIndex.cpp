@@ -0,0 +1,480 @@
+/**
+	@file
+	@brief Cached index of the output folder tree (level 1 and level 2 folders)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "DirectoryIndex.h"
+#include "DirectoryEnumerator.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/// First line of the snapshot file
+#define SNAPSHOT_HEADER		"CCPDFConverter directory index 1"
+
+#ifdef _WIN32
+const char DirectoryIndex::cSeparator = '\\';
+#else
+const char DirectoryIndex::cSeparator = '/';
+#endif
+
+/**
+	@param sData The text
+	@param nPos Where to start (moved past the line)
+	@param sLine Receives the line, without the line end
+	@return true if there was a line
+*/
+static bool NextLine(const std::string& sData, size_t& nPos, std::string& sLine)
+{
+	if (nPos >= sData.size())
+		return false;
+	size_t nEnd = sData.find('\n', nPos);
+	if (nEnd == std::string::npos)
+		nEnd = sData.size();
+	sLine = sData.substr(nPos, nEnd - nPos);
+	nPos = nEnd + 1;
+	return true;
+}
+
+/**
+	@param sText The digits
+	@param nValue Receives the number
+	@return true if the text was a number
+*/
+static bool ParseNumber(const std::string& sText, unsigned __int64& nValue)
+{
+	if (sText.empty())
+		return false;
+	nValue = 0;
+	for (std::string::const_iterator i = sText.begin(); i != sText.end(); i++)
+	{
+		if ((*i < '0') || (*i > '9'))
+			return false;
+		nValue = nValue * 10 + (*i - '0');
+	}
+	return true;
+}
+
+/**
+	@param nValue The number
+	@return The number in decimal
+*/
+static std::string FormatNumber(unsigned __int64 nValue)
+{
+	char cDigits[24];
+	int nPos = sizeof(cDigits);
+	cDigits[--nPos] = '\0';
+	do
+	{
+		cDigits[--nPos] = (char)('0' + (nValue % 10));
+		nValue /= 10;
+	}
+	while (nValue > 0);
+	return cDigits + nPos;
+}
+
+/**
+*/
+DirectoryIndex::DirectoryIndex() : m_bChanged(false)
+#ifndef _WIN32
+, m_nNotify(-1)
+#endif
+{
+}
+
+/**
+*/
+DirectoryIndex::~DirectoryIndex()
+{
+	Close();
+}
+
+/**
+	@param pRoot The root folder
+	@param pSnapshot The snapshot file (NULL to keep none)
+	@return true if the snapshot was read
+*/
+bool DirectoryIndex::Open(const char* pRoot, const char* pSnapshot)
+{
+	Close();
+	m_sRoot = pRoot;
+	while ((m_sRoot.size() > 1) && (m_sRoot[m_sRoot.size() - 1] == cSeparator))
+		m_sRoot.erase(m_sRoot.size() - 1);
+	m_sSnapshot = (pSnapshot != NULL) ? pSnapshot : "";
+#ifndef _WIN32
+	m_nNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	return !m_sSnapshot.empty() && Load();
+}
+
+/**
+*/
+void DirectoryIndex::Close()
+{
+#ifndef _WIN32
+	if (m_nNotify != -1)
+		close(m_nNotify);
+	m_nNotify = -1;
+	m_watches.clear();
+#endif
+	m_nodes.clear();
+	m_bChanged = false;
+}
+
+/**
+	@return true if the snapshot was read (and was of the same root folder)
+*/
+bool DirectoryIndex::Load()
+{
+	std::ifstream in(m_sSnapshot.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+	std::ostringstream data;
+	data << in.rdbuf();
+	std::string sData = data.str();
+
+	size_t nPos = 0;
+	std::string sLine;
+	if (!NextLine(sData, nPos, sLine) || (sLine != SNAPSHOT_HEADER))
+		return false;
+	if (!NextLine(sData, nPos, sLine) || (sLine != m_sRoot))
+		// Another tree
+		return false;
+
+	// Each node: name, time and count of sub-folders (tab separated), then the sub-folders
+	while (NextLine(sData, nPos, sLine))
+	{
+		size_t nCount = sLine.rfind('\t');
+		size_t nStamp = (nCount == std::string::npos) || (nCount == 0) ? std::string::npos : sLine.rfind('\t', nCount - 1);
+		unsigned __int64 nStampValue, nCountValue;
+		if ((nStamp == std::string::npos) || !ParseNumber(sLine.substr(nStamp + 1, nCount - nStamp - 1), nStampValue) || !ParseNumber(sLine.substr(nCount + 1), nCountValue))
+		{
+			m_nodes.clear();
+			return false;
+		}
+		Node& node = m_nodes[sLine.substr(0, nStamp)];
+		node.nStamp = nStampValue;
+		node.children.reserve((size_t)nCountValue);
+		for (; nCountValue > 0; nCountValue--)
+		{
+			if (!NextLine(sData, nPos, sLine))
+			{
+				m_nodes.clear();
+				return false;
+			}
+			node.children.push_back(sLine);
+		}
+	}
+	return true;
+}
+
+/**
+	Written to a file of its own, then swapped in, so other converters reading it never see half of it
+
+	@return true if the snapshot is up to date
+*/
+bool DirectoryIndex::Save()
+{
+	if (m_sSnapshot.empty())
+		return false;
+	Refresh();
+	if (!m_bChanged)
+		return true;
+
+	std::string sOut = SNAPSHOT_HEADER "\n" + m_sRoot + "\n";
+	for (NodeMap::const_iterator i = m_nodes.begin(); i != m_nodes.end(); i++)
+	{
+		sOut += (*i).first + '\t' + FormatNumber((*i).second.nStamp) + '\t' + FormatNumber((*i).second.children.size()) + '\n';
+		for (std::vector<std::string>::const_iterator j = (*i).second.children.begin(); j != (*i).second.children.end(); j++)
+			sOut += *j + '\n';
+	}
+
+#ifdef _WIN32
+	std::string sTemp = m_sSnapshot + '.' + FormatNumber(GetCurrentProcessId());
+#else
+	std::string sTemp = m_sSnapshot + '.' + FormatNumber(getpid());
+#endif
+	bool bRet;
+	{
+		std::ofstream out(sTemp.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		out.write(sOut.data(), sOut.size());
+		out.close();
+		bRet = !out.fail();
+	}
+#ifdef _WIN32
+	bRet = bRet && MoveFileEx(sTemp.c_str(), m_sSnapshot.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	bRet = bRet && (rename(sTemp.c_str(), m_sSnapshot.c_str()) == 0);
+#endif
+	if (!bRet)
+	{
+		remove(sTemp.c_str());
+		return false;
+	}
+	m_bChanged = false;
+	return true;
+}
+
+/**
+	A node that's being watched is returned as it is; otherwise the time of its folder is
+	checked, and the folder is only listed if it changed since the index last saw it.
+
+	@param sNode The node ("" for the root)
+	@return The names of the sub-folders, sorted (valid until the index is next used)
+*/
+const std::vector<std::string>& DirectoryIndex::GetChildren(const std::string& sNode)
+{
+	static const std::vector<std::string> empty;
+	Refresh();
+	NodeMap::iterator i = m_nodes.find(sNode);
+	if ((i != m_nodes.end()) && i->second.bChecked)
+		return i->second.children;
+
+	std::string sFolder = GetFolder(sNode);
+	// Watched before the time is checked, so no change can slip in between
+	bool bWatched = Watch(sNode);
+	unsigned __int64 nStamp;
+	if (!DirectoryEnumerator::GetStamp(sFolder, nStamp))
+	{
+		// Not there (any more)
+		RemoveNode(sNode);
+		return empty;
+	}
+
+	bool bNew = (i == m_nodes.end());
+	Node& node = bNew ? m_nodes[sNode] : i->second;
+	if (bNew || (node.nStamp != nStamp))
+	{
+		std::vector<std::string> names;
+		if (!DirectoryEnumerator::ListFolder(sFolder, names))
+		{
+			RemoveNode(sNode);
+			return empty;
+		}
+		node.children.swap(names);
+		node.nStamp = nStamp;
+		m_bChanged = true;
+	}
+	node.bChecked = bWatched;
+	return node.children;
+}
+
+/**
+	Meant for building the index ahead of the jobs: the level 1 folders are listed several
+	at a time, rather than one by one as they're used
+
+	@param nThreads Most folders to list at a time
+	@return Count of level 1 folders listed
+*/
+int DirectoryIndex::Build(int nThreads)
+{
+	// (A copy: the nodes change below)
+	std::vector<std::string> level1 = GetChildren("");
+	DirectoryEnumerator enumerator;
+	for (std::vector<std::string>::const_iterator i = level1.begin(); i != level1.end(); i++)
+		enumerator.Add(GetFolder(*i));
+	enumerator.Run(nThreads);
+
+	int nListed = 0;
+	const std::vector<std::string>& names = enumerator.GetNames();
+	for (size_t i = 0; i < level1.size(); i++)
+	{
+		const DirectoryEnumerator::Folder& folder = enumerator.GetFolder(i);
+		if (!folder.bListed)
+		{
+			RemoveNode(level1[i]);
+			continue;
+		}
+		Node& node = m_nodes[level1[i]];
+		node.children.assign(names.begin() + folder.nFirst, names.begin() + folder.nFirst + folder.nCount);
+		node.nStamp = folder.nStamp;
+		// (Not watched: checked when it's used)
+		node.bChecked = false;
+		m_bChanged = true;
+		nListed++;
+	}
+	return nListed;
+}
+
+/**
+	@param sNode The parent node ("" for the root)
+	@param sChild The name of the sub-folder
+	@return The name of the child node
+*/
+std::string DirectoryIndex::GetChildNode(const std::string& sNode, const std::string& sChild)
+{
+	return sNode.empty() ? sChild : (sNode + cSeparator + sChild);
+}
+
+/**
+	@param sNode The node ("" for the root)
+	@return The full path of the node's folder
+*/
+std::string DirectoryIndex::GetFolder(const std::string& sNode) const
+{
+	return sNode.empty() ? m_sRoot : (m_sRoot + cSeparator + sNode);
+}
+
+/**
+	@param sNode The node
+*/
+void DirectoryIndex::RemoveNode(const std::string& sNode)
+{
+	std::string sPrefix = sNode + cSeparator;
+	for (NodeMap::iterator i = m_nodes.begin(); i != m_nodes.end(); )
+	{
+		if (((*i).first == sNode) || sNode.empty() || ((*i).first.compare(0, sPrefix.size(), sPrefix) == 0))
+		{
+			i = m_nodes.erase(i);
+			m_bChanged = true;
+		}
+		else
+			i++;
+	}
+#ifndef _WIN32
+	// Stop watching them too (a folder of the same name may come back, with a new watch)
+	for (std::map<int, std::string>::iterator i = m_watches.begin(); i != m_watches.end(); )
+	{
+		if ((i->second == sNode) || sNode.empty() || (i->second.compare(0, sPrefix.size(), sPrefix) == 0))
+		{
+			inotify_rm_watch(m_nNotify, i->first);
+			m_watches.erase(i++);
+		}
+		else
+			i++;
+	}
+#endif
+}
+
+/**
+	@param names The sorted list
+	@param sName The name to add
+*/
+void DirectoryIndex::InsertName(std::vector<std::string>& names, const std::string& sName)
+{
+	std::vector<std::string>::iterator i = std::lower_bound(names.begin(), names.end(), sName, DirectoryEnumerator::NameLess);
+	if ((i == names.end()) || (*i != sName))
+		names.insert(i, sName);
+}
+
+/**
+	@param names The sorted list
+	@param sName The name to remove
+*/
+void DirectoryIndex::RemoveName(std::vector<std::string>& names, const std::string& sName)
+{
+	std::vector<std::string>::iterator i = std::lower_bound(names.begin(), names.end(), sName, DirectoryEnumerator::NameLess);
+	if ((i != names.end()) && (*i == sName))
+		names.erase(i);
+}
+
+/**
+	@param sNode The node
+	@return true if the node's folder is watched (so its list is kept up to date by Refresh)
+*/
+bool DirectoryIndex::Watch(const std::string& sNode)
+{
+#ifdef _WIN32
+	// No watching: the folder's time is checked instead
+	return false;
+#else
+	if (m_nNotify == -1)
+		return false;
+	int nWatch = inotify_add_watch(m_nNotify, GetFolder(sNode).c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+	if (nWatch == -1)
+		// (Out of watches, for one)
+		return false;
+	m_watches[nWatch] = sNode;
+	return true;
+#endif
+}
+
+/**
+	Reads the pending inotify events, and adds and removes sub-folders as they report
+*/
+void DirectoryIndex::Refresh()
+{
+#ifndef _WIN32
+	if (m_nNotify == -1)
+		return;
+	char cEvents[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t nRead;
+	while ((nRead = read(m_nNotify, cEvents, sizeof(cEvents))) > 0)
+	{
+		for (const char* p = cEvents; p < cEvents + nRead; p += sizeof(struct inotify_event) + ((const struct inotify_event*)p)->len)
+		{
+			const struct inotify_event* pEvent = (const struct inotify_event*)p;
+			if (pEvent->mask & IN_Q_OVERFLOW)
+			{
+				// Events were lost: check every node again
+				for (NodeMap::iterator i = m_nodes.begin(); i != m_nodes.end(); i++)
+					i->second.bChecked = false;
+				continue;
+			}
+			std::map<int, std::string>::iterator w = m_watches.find(pEvent->wd);
+			if (w == m_watches.end())
+				continue;
+			NodeMap::iterator i = m_nodes.find(w->second);
+			if (pEvent->mask & IN_IGNORED)
+			{
+				// The watch is gone
+				if (i != m_nodes.end())
+					i->second.bChecked = false;
+				m_watches.erase(w);
+				continue;
+			}
+			if (i == m_nodes.end())
+				continue;
+			if (pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+			{
+				// Checked (and dropped) when it's next used
+				i->second.bChecked = false;
+				continue;
+			}
+			if (!(pEvent->mask & IN_ISDIR) || (pEvent->len == 0))
+				continue;
+			std::string sName = pEvent->name;
+			if (pEvent->mask & (IN_CREATE | IN_MOVED_TO))
+				InsertName(i->second.children, sName);
+			else
+			{
+				std::string sNode = w->second;
+				RemoveName(i->second.children, sName);
+				RemoveNode(GetChildNode(sNode, sName));
+			}
+			m_bChanged = true;
+		}
+	}
+#endif
+}
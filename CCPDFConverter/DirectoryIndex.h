@@ -0,0 +1,131 @@
+/**
+	@file
+	@brief Cached index of the output folder tree (level 1 and level 2 folders)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _DIRECTORYINDEX_H_
+#define _DIRECTORYINDEX_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#ifdef _WIN32
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+/**
+    @brief Index of the sub-folders of a folder tree, kept between jobs in a snapshot file
+
+	Nodes are named by their path under the root ("" is the root itself, "Customer" a
+	level 1 folder, "Customer\\Orders" one under it); each holds the names of its
+	sub-folders, sorted without regard to case. Looking a node up is a hash lookup, and
+	nodes are only listed the first time they're asked for.
+
+	The index is kept fresh without listing folders again: on Linux, inotify reports the
+	folders added, removed or renamed in every node that was looked up. Elsewhere the
+	modification time of the node's folder is checked (it changes whenever an entry is
+	added, removed or renamed in it), and the folder is listed again only if it changed.
+	Either way the time is checked once against the snapshot when a node is first used.
+
+	This class has no user interface and no Windows-only parts outside of the _WIN32
+	sections, so it builds on other systems as well (its tests, in tests/, run on Linux).
+*/
+class DirectoryIndex
+{
+public:
+	/// Ctor
+	DirectoryIndex();
+	/// Dtor
+	virtual ~DirectoryIndex();
+
+	/// Sets the root folder, and reads the snapshot (if there is one)
+	bool				Open(const char* pRoot, const char* pSnapshot);
+	/// Writes the snapshot (if anything changed)
+	bool				Save();
+	/// Stops watching the folders and forgets the index
+	void				Close();
+
+	/// Returns the sub-folders of a node (an empty list if the folder isn't there)
+	const std::vector<std::string>&	GetChildren(const std::string& sNode);
+	/// Lists the root and all the level 1 folders again
+	int					Build(int nThreads);
+	/// Returns the name of a node's child (adding the separator)
+	static std::string	GetChildNode(const std::string& sNode, const std::string& sChild);
+
+	/// Folder separator
+	static const char	cSeparator;
+
+protected:
+	/// A folder in the index
+	struct Node
+	{
+		/// Ctor
+		Node() : nStamp(0), bChecked(false) {};
+
+		/// Modification time of the folder when it was listed
+		unsigned __int64	nStamp;
+		/// true once the time was checked against the folder (by this process)
+		bool				bChecked;
+		/// Names of the sub-folders, sorted
+		std::vector<std::string>	children;
+	};
+	/// The nodes, by name
+	typedef std::tr1::unordered_map<std::string, Node>	NodeMap;
+
+	/// Reads the snapshot
+	bool				Load();
+	/// Applies the changes reported since the last call (Linux only)
+	void				Refresh();
+	/// Starts watching a node's folder (Linux only)
+	bool				Watch(const std::string& sNode);
+	/// Forgets a node, and the nodes under it
+	void				RemoveNode(const std::string& sNode);
+	/// Returns a node's folder
+	std::string			GetFolder(const std::string& sNode) const;
+	/// Adds a name to a sorted list
+	static void			InsertName(std::vector<std::string>& names, const std::string& sName);
+	/// Removes a name from a sorted list
+	static void			RemoveName(std::vector<std::string>& names, const std::string& sName);
+
+protected:
+	/// The root folder
+	std::string			m_sRoot;
+	/// The snapshot file (empty if none is kept)
+	std::string			m_sSnapshot;
+	/// The nodes
+	NodeMap				m_nodes;
+	/// true if the index changed since it was read
+	bool				m_bChanged;
+#ifndef _WIN32
+	/// inotify descriptor (-1 if not watching)
+	int					m_nNotify;
+	/// Watched nodes, by watch descriptor
+	std::map<int, std::string>	m_watches;
+#endif
+};
+
+#endif   //#define _DIRECTORYINDEX_H_
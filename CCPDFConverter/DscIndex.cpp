@@ -0,0 +1,99 @@
+/**
+	@file
+	@brief Index of the DSC structure comments in the PostScript input
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "DscIndex.h"
+#include <string.h>
+
+/// Checks if the current line starts with a comment
+#define LINE_IS(s)		((m_nLine >= (int)sizeof(s) - 1) && (strncmp(m_cLine, s, sizeof(s) - 1) == 0))
+
+DscIndex::DscIndex() : m_nEndProlog(NOT_FOUND), m_nEndSetup(NOT_FOUND), m_nTrailer(NOT_FOUND), m_nScanned(0), m_nLineStart(0), m_nLine(0), m_nEmbedded(0)
+{
+}
+
+/**
+	@param pData The data (immediately following the data of the previous call)
+	@param nLen Size of the data (in bytes)
+*/
+void DscIndex::Scan(const char* pData, size_t nLen)
+{
+	for (size_t i = 0; i < nLen; i++)
+	{
+		char ch = pData[i];
+		if ((ch == '\n') || (ch == '\r'))
+		{
+			// End of line: the next one starts after it
+			EndLine(m_nScanned + i + 1);
+			m_nLineStart = m_nScanned + i + 1;
+			m_nLine = 0;
+		}
+		else if (m_nLine < (int)sizeof(m_cLine))
+			m_cLine[m_nLine++] = ch;
+		else if (m_cLine[0] != '%')
+		{
+			// Long non-comment line (probably binary data): skip quickly to its end
+			const char* pEnd = (const char*)memchr(pData + i, '\n', nLen - i);
+			const char* pCR = (const char*)memchr(pData + i, '\r', nLen - i);
+			if ((pEnd == NULL) || ((pCR != NULL) && (pCR < pEnd)))
+				pEnd = pCR;
+			if (pEnd == NULL)
+				break;
+			i = (pEnd - pData) - 1;
+		}
+	}
+	m_nScanned += nLen;
+}
+
+/**
+	@param nNextLine Location of the line following this one
+*/
+void DscIndex::EndLine(unsigned __int64 nNextLine)
+{
+	if ((m_nLine < 2) || (m_cLine[0] != '%') || (m_cLine[1] != '%'))
+		// Not a DSC comment
+		return;
+
+	if (LINE_IS("%%BeginDocument"))
+		m_nEmbedded++;
+	else if (LINE_IS("%%EndDocument"))
+	{
+		if (m_nEmbedded > 0)
+			m_nEmbedded--;
+	}
+	else if (m_nEmbedded > 0)
+		// Belongs to an embedded document
+		return;
+	else if (LINE_IS("%%Page:"))
+		m_pages.push_back(m_nLineStart);
+	else if (LINE_IS("%%EndProlog"))
+		m_nEndProlog = nNextLine;
+	else if (LINE_IS("%%EndSetup"))
+		m_nEndSetup = nNextLine;
+	else if (LINE_IS("%%Trailer"))
+		m_nTrailer = m_nLineStart;
+}
@@ -0,0 +1,104 @@
+/**
+	@file
+	@brief Index of the DSC structure comments in the PostScript input
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _DSCINDEX_H_
+#define _DSCINDEX_H_
+
+#include <vector>
+
+/**
+    @brief Locations of the Document Structuring Conventions comments in the input
+
+	The index is built incrementally as data arrives, so it can be used while the
+	input is still being received. Comments inside embedded documents
+	(%%BeginDocument ... %%EndDocument) are ignored.
+*/
+class DscIndex
+{
+public:
+	/// Value used for locations that weren't found (yet)
+	static const unsigned __int64 NOT_FOUND = (unsigned __int64)-1;
+
+	/// Constructor
+	DscIndex();
+
+	/// Scans the next block of data
+	void				Scan(const char* pData, size_t nLen);
+
+	/**
+		@brief Returns the count of pages found so far
+		@return Count of %%Page: comments
+	*/
+	int					GetPageCount() const {return (int)m_pages.size();};
+	/**
+		@brief Returns the location of the start of a page
+		@param nPage The page number (starting at 1)
+		@return Location of the page's %%Page: comment, or NOT_FOUND
+	*/
+	unsigned __int64	GetPageStart(int nPage) const {return ((nPage < 1) || (nPage > (int)m_pages.size())) ? NOT_FOUND : m_pages[nPage - 1];};
+	/**
+		@brief Returns the location of the end of the prolog
+		@return Location of the line following %%EndProlog, or NOT_FOUND
+	*/
+	unsigned __int64	GetEndProlog() const {return m_nEndProlog;};
+	/**
+		@brief Returns the location of the end of the document setup
+		@return Location of the line following %%EndSetup, or NOT_FOUND
+	*/
+	unsigned __int64	GetEndSetup() const {return m_nEndSetup;};
+	/**
+		@brief Returns the location of the trailer
+		@return Location of the %%Trailer comment, or NOT_FOUND
+	*/
+	unsigned __int64	GetTrailer() const {return m_nTrailer;};
+
+protected:
+	/// Handles a complete line (only its start is kept)
+	void				EndLine(unsigned __int64 nNextLine);
+
+	// Data
+	/// Start location of each page
+	std::vector<unsigned __int64>	m_pages;
+	/// Location after %%EndProlog
+	unsigned __int64	m_nEndProlog;
+	/// Location after %%EndSetup
+	unsigned __int64	m_nEndSetup;
+	/// Location of %%Trailer
+	unsigned __int64	m_nTrailer;
+	/// Count of bytes scanned
+	unsigned __int64	m_nScanned;
+	/// Location of the current line
+	unsigned __int64	m_nLineStart;
+	/// Start of the current line (enough to recognize the comments we want)
+	char				m_cLine[20];
+	/// Count of characters in m_cLine
+	int					m_nLine;
+	/// Embedded document depth
+	int					m_nEmbedded;
+};
+
+#endif   //#define _DSCINDEX_H_
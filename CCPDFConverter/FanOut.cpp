@@ -0,0 +1,134 @@
+/**
+	@file
+	@brief Publishing the converted document into more folders
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "FanOut.h"
+#include "Configuration.h"
+#include "FilePlacement.h"
+#include "OutputWriter.h"
+#include <shlobj.h>
+#include <stdio.h>
+
+/**
+*/
+FanOut::FanOut()
+{
+	m_bHardlink = myconfigdata.getbool("fanout.hardlink", true);
+}
+
+/**
+	@param sName Name of the variable (without the braces)
+	@param sValue Its value
+*/
+void FanOut::SetVariable(const std::string& sName, const std::string& sValue)
+{
+	m_variables.push_back(std::make_pair("{" + sName + "}", sValue));
+}
+
+/**
+	@param sList Destination folders, separated by semicolons
+*/
+void FanOut::AddDestinations(const std::string& sList)
+{
+	std::string::size_type nStart = 0;
+	while (nStart < sList.size())
+	{
+		std::string::size_type nEnd = sList.find(';', nStart);
+		if (nEnd == std::string::npos)
+			nEnd = sList.size();
+		std::string sDest = sList.substr(nStart, nEnd - nStart);
+		// Trim spaces, and trailing backslashes
+		std::string::size_type nFirst = sDest.find_first_not_of(' ');
+		std::string::size_type nLast = sDest.find_last_not_of(" \\");
+		if ((nFirst != std::string::npos) && (nLast != std::string::npos) && (nLast >= nFirst))
+			m_destinations.push_back(sDest.substr(nFirst, nLast - nFirst + 1));
+		nStart = nEnd + 1;
+	}
+}
+
+/**
+	@param sDest A destination
+	@param sRet Receives the destination with the variables replaced
+	@return false if it uses a variable the job has no value for
+*/
+bool FanOut::Expand(const std::string& sDest, std::string& sRet) const
+{
+	sRet = sDest;
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator i = m_variables.begin(); i != m_variables.end(); i++)
+	{
+		std::string::size_type nPos;
+		while ((nPos = sRet.find(i->first)) != std::string::npos)
+		{
+			if (i->second.empty())
+				return false;
+			sRet.replace(nPos, i->first.size(), i->second);
+		}
+	}
+	return true;
+}
+
+/**
+	@param lpFile The document to copy
+	@param lpName The name it's published as (only the file name part is used)
+	@param result Job result to record the copies in (fanout.N.path, fanout.N.method)
+	@return Count of copies published
+*/
+int FanOut::Publish(LPCTSTR lpFile, LPCTSTR lpName, JobResult& result)
+{
+	LPCTSTR pName = strrchr(lpName, '\\');
+	pName = (pName == NULL) ? lpName : pName + 1;
+
+	int nPublished = 0;
+	for (size_t i = 0; i < m_destinations.size(); i++)
+	{
+		char cKey[32];
+		sprintf_s(cKey, sizeof(cKey), "fanout.%u.", (unsigned)i + 1);
+		std::string sFolder;
+		if (!Expand(m_destinations[i], sFolder))
+		{
+			// Not for this job (e.g. {level1} for a streamed job): left out rather than copied to a folder above it
+			result[std::string(cKey) + "method"] = GetPlaceMethodName(PlaceNone);
+			continue;
+		}
+		std::string sDest = sFolder + "\\" + pName;
+		std::string sTemp = sDest + ".inprogress";
+		result[std::string(cKey) + "path"] = sDest;
+
+		// Placed aside and then renamed, like the document itself
+		SHCreateDirectoryEx(NULL, sFolder.c_str(), NULL);
+		PlaceMethod eMethod = PlaceFile(lpFile, sTemp.c_str(), m_bHardlink);
+		if ((eMethod != PlaceNone) && !PublishOutput(sTemp.c_str(), sDest.c_str()))
+		{
+			DeleteFile(sTemp.c_str());
+			eMethod = PlaceNone;
+		}
+		result[std::string(cKey) + "method"] = GetPlaceMethodName(eMethod);
+		if (eMethod != PlaceNone)
+			nPublished++;
+	}
+	return nPublished;
+}
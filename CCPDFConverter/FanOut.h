@@ -0,0 +1,78 @@
+/**
+	@file
+	@brief Publishing the converted document into more folders
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _FANOUT_H_
+#define _FANOUT_H_
+
+#include "JobResult.h"
+#include <vector>
+
+/**
+    @brief Places copies of the converted document in more destination folders
+
+	Destinations are folders, separated by semicolons, from the fanout setting and the
+	job's "%%FanOut: " header line. They may use these variables:
+	- {level1}, {level2}: the job's folders (routed by a rule, or chosen in the dialog)
+	- {user}: the user name
+	A destination using a variable the job has no value for (e.g. the folders of a
+	streamed job) is left out.
+	Each copy is as cheap as the file system allows (see PlaceFile; hard links only if
+	fanout.hardlink is set, which is the default), and published like the document itself.
+*/
+class FanOut
+{
+public:
+	/// Ctor
+	FanOut();
+
+	/// Sets the value of a variable used in destinations
+	void				SetVariable(const std::string& sName, const std::string& sValue);
+	/// Adds destination folders
+	void				AddDestinations(const std::string& sList);
+	/**
+		@brief Checks if there's somewhere to publish to
+		@return true if destinations were added
+	*/
+	bool				HasDestinations() const {return !m_destinations.empty();};
+
+	/// Publishes copies of a document to all destinations
+	int					Publish(LPCTSTR lpFile, LPCTSTR lpName, JobResult& result);
+
+protected:
+	/// Replaces the variables in a destination
+	bool				Expand(const std::string& sDest, std::string& sRet) const;
+
+protected:
+	/// Destination folders (variables not replaced yet)
+	std::vector<std::string>	m_destinations;
+	/// Variable names and values
+	std::vector<std::pair<std::string, std::string> >	m_variables;
+	/// true if copies may be hard links
+	bool				m_bHardlink;
+};
+
+#endif   //#define _FANOUT_H_
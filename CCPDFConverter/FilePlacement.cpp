@@ -0,0 +1,158 @@
+/**
+	@file
+	@brief Placing copies of files: block cloning, hard links or copies
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "FilePlacement.h"
+#include <winioctl.h>
+
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+/// Block cloning control code (newer SDKs define it)
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE		CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+/// Block cloning request
+typedef struct _DUPLICATE_EXTENTS_DATA
+{
+	HANDLE			FileHandle;
+	LARGE_INTEGER	SourceFileOffset;
+	LARGE_INTEGER	TargetFileOffset;
+	LARGE_INTEGER	ByteCount;
+} DUPLICATE_EXTENTS_DATA;
+#endif
+
+/**
+	@param lpSource The file to clone
+	@param lpDest The clone to create (replaced if it exists)
+	@return true if cloned
+*/
+static bool CloneFile(LPCTSTR lpSource, LPCTSTR lpDest)
+{
+	// Clones must be cluster aligned, so find the cluster size of the volume
+	TCHAR cVolume[MAX_PATH];
+	DWORD dwSectorsPerCluster, dwBytesPerSector, dwFree, dwTotal;
+	if (!GetVolumePathName(lpDest, cVolume, MAX_PATH) || !GetDiskFreeSpace(cVolume, &dwSectorsPerCluster, &dwBytesPerSector, &dwFree, &dwTotal))
+		return false;
+	LONGLONG nCluster = (LONGLONG)dwSectorsPerCluster * dwBytesPerSector;
+
+	HANDLE hSource = CreateFile(lpSource, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	if (hSource == INVALID_HANDLE_VALUE)
+		return false;
+	bool bRet = false;
+	LARGE_INTEGER liSize;
+	HANDLE hDest = INVALID_HANDLE_VALUE;
+	if (GetFileSizeEx(hSource, &liSize))
+		hDest = CreateFile(lpDest, GENERIC_READ | GENERIC_WRITE | DELETE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+	if (hDest != INVALID_HANDLE_VALUE)
+	{
+		// The target needs its full size first
+		DUPLICATE_EXTENTS_DATA data;
+		data.FileHandle = hSource;
+		data.SourceFileOffset.QuadPart = 0;
+		data.TargetFileOffset.QuadPart = 0;
+		data.ByteCount.QuadPart = (liSize.QuadPart + nCluster - 1) / nCluster * nCluster;
+		DWORD dwReturned;
+		bRet = SetFilePointerEx(hDest, liSize, NULL, FILE_BEGIN) && SetEndOfFile(hDest) &&
+			((liSize.QuadPart == 0) || DeviceIoControl(hDest, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &data, sizeof(data), NULL, 0, &dwReturned, NULL));
+		CloseHandle(hDest);
+		if (!bRet)
+			DeleteFile(lpDest);
+	}
+	CloseHandle(hSource);
+	return bRet;
+}
+
+/**
+	@param lpSource The file to copy
+	@param lpDest The copy to create (replaced if it exists)
+	@return true if copied
+*/
+static bool CopyData(LPCTSTR lpSource, LPCTSTR lpDest)
+{
+	HANDLE hSource = CreateFile(lpSource, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hSource == INVALID_HANDLE_VALUE)
+		return false;
+	HANDLE hDest = CreateFile(lpDest, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hDest == INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(hSource);
+		return false;
+	}
+	const DWORD BLOCK = 1024 * 1024;
+	char* pBlock = new char[BLOCK];
+	bool bRet = true;
+	DWORD dwRead, dwWritten;
+	while (bRet && (bRet = (ReadFile(hSource, pBlock, BLOCK, &dwRead, NULL) != FALSE)) && (dwRead > 0))
+		bRet = WriteFile(hDest, pBlock, dwRead, &dwWritten, NULL) && (dwWritten == dwRead);
+	delete [] pBlock;
+	CloseHandle(hDest);
+	CloseHandle(hSource);
+	if (!bRet)
+		DeleteFile(lpDest);
+	return bRet;
+}
+
+/**
+	@param lpSource The file to place
+	@param lpDest Where to place it (replaced if it exists)
+	@param bAllowHardlink true if the copy may be a hard link (only if neither file is ever changed in place)
+	@return How the file was placed (PlaceNone on failure)
+*/
+PlaceMethod PlaceFile(LPCTSTR lpSource, LPCTSTR lpDest, bool bAllowHardlink)
+{
+	if (CloneFile(lpSource, lpDest))
+		return PlaceReflink;
+	if (bAllowHardlink)
+	{
+		DeleteFile(lpDest);
+		if (CreateHardLink(lpDest, lpSource, NULL))
+			return PlaceHardlink;
+	}
+	if (CopyFileEx(lpSource, lpDest, NULL, NULL, NULL, 0))
+		return PlaceCopyFile;
+	if (CopyData(lpSource, lpDest))
+		return PlaceCopy;
+	return PlaceNone;
+}
+
+/**
+	@param eMethod The method
+	@return Its name (for job results and logs)
+*/
+const char* GetPlaceMethodName(PlaceMethod eMethod)
+{
+	switch (eMethod)
+	{
+		case PlaceReflink:
+			return "reflink";
+		case PlaceHardlink:
+			return "hardlink";
+		case PlaceCopyFile:
+			return "copyfile";
+		case PlaceCopy:
+			return "copy";
+		default:
+			return "none";
+	}
+}
@@ -0,0 +1,51 @@
+/**
+	@file
+	@brief Placing copies of files: block cloning, hard links or copies
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _FILEPLACEMENT_H_
+#define _FILEPLACEMENT_H_
+
+/// How a file was placed
+enum PlaceMethod
+{
+	/// Not placed
+	PlaceNone,
+	/// Block clone sharing the source's data (ReFS)
+	PlaceReflink,
+	/// Hard link to the source
+	PlaceHardlink,
+	/// Copy made by the system (which may offload it to the server or storage)
+	PlaceCopyFile,
+	/// Copy made by reading and writing the data
+	PlaceCopy
+};
+
+/// Places a copy of a file, as cheaply as the file system allows
+PlaceMethod PlaceFile(LPCTSTR lpSource, LPCTSTR lpDest, bool bAllowHardlink);
+/// Returns the name of a placement method
+const char* GetPlaceMethodName(PlaceMethod eMethod);
+
+#endif   //#define _FILEPLACEMENT_H_
@@ -0,0 +1,87 @@
+/**
+	@file
+	@brief GhostScript library, loaded when a conversion needs it
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "GhostscriptApi.h"
+#include <tchar.h>
+
+#ifdef _WIN64
+/// Name of the GhostScript DLL
+#define GS_DLL		_T("gsdll64.dll")
+#else
+/// Name of the GhostScript DLL
+#define GS_DLL		_T("gsdll32.dll")
+#endif
+
+GhostscriptApi gsapi;
+
+/**
+	@return true if the DLL is loaded and has all the functions we need
+*/
+bool GhostscriptApi::Load()
+{
+	if (hModule != NULL)
+		return true;
+
+	LARGE_INTEGER liStart, liEnd, liFreq;
+	QueryPerformanceCounter(&liStart);
+
+	// Prefer the DLL next to the application; otherwise, the usual search order
+	TCHAR cDLL[MAX_PATH];
+	if (GetModuleFileName(NULL, cDLL, MAX_PATH))
+	{
+		TCHAR* pPos = _tcsrchr(cDLL, '\\');
+		if (pPos != NULL)
+		{
+			_tcscpy_s(pPos + 1, MAX_PATH - (pPos + 1 - cDLL), GS_DLL);
+			hModule = LoadLibrary(cDLL);
+		}
+	}
+	if (hModule == NULL)
+		hModule = LoadLibrary(GS_DLL);
+	if (hModule == NULL)
+		return false;
+
+	revision = (PFN_gsapi_revision)GetProcAddress(hModule, "gsapi_revision");
+	new_instance = (PFN_gsapi_new_instance)GetProcAddress(hModule, "gsapi_new_instance");
+	delete_instance = (PFN_gsapi_delete_instance)GetProcAddress(hModule, "gsapi_delete_instance");
+	set_stdio = (PFN_gsapi_set_stdio)GetProcAddress(hModule, "gsapi_set_stdio");
+	init_with_args = (PFN_gsapi_init_with_args)GetProcAddress(hModule, "gsapi_init_with_args");
+	exit = (PFN_gsapi_exit)GetProcAddress(hModule, "gsapi_exit");
+	if ((new_instance == NULL) || (delete_instance == NULL) || (set_stdio == NULL) || (init_with_args == NULL) || (exit == NULL))
+	{
+		// Not a DLL we can use
+		FreeLibrary(hModule);
+		hModule = NULL;
+		return false;
+	}
+
+	QueryPerformanceCounter(&liEnd);
+	QueryPerformanceFrequency(&liFreq);
+	dLoadTime = (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFreq.QuadPart;
+	return true;
+}
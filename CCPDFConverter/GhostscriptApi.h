@@ -0,0 +1,76 @@
+/**
+	@file
+	@brief GhostScript library, loaded when a conversion needs it
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _GHOSTSCRIPTAPI_H_
+#define _GHOSTSCRIPTAPI_H_
+
+#include "iapi.h"
+
+// (The PFN_gsapi_xxx function types come from iapi.h)
+
+/**
+    @brief The GhostScript functions we use, loaded from the GhostScript DLL on first use
+
+	The DLL is not linked to the application, so jobs that never convert anything (dropped
+	files, cancelled jobs, cached results) don't pay for loading it.
+*/
+struct GhostscriptApi
+{
+	/// Constructor: nothing loaded yet
+	GhostscriptApi() : hModule(NULL), revision(NULL), new_instance(NULL), delete_instance(NULL), set_stdio(NULL), init_with_args(NULL), exit(NULL), dLoadTime(0) {};
+
+	/// Loads the DLL (if not loaded yet)
+	bool						Load();
+	/**
+		@brief Checks if the DLL was loaded
+		@return true if the functions can be called
+	*/
+	bool						IsLoaded() const {return hModule != NULL;};
+
+	// Data
+	/// The DLL
+	HMODULE						hModule;
+	/// gsapi_revision
+	PFN_gsapi_revision			revision;
+	/// gsapi_new_instance
+	PFN_gsapi_new_instance		new_instance;
+	/// gsapi_delete_instance
+	PFN_gsapi_delete_instance	delete_instance;
+	/// gsapi_set_stdio
+	PFN_gsapi_set_stdio			set_stdio;
+	/// gsapi_init_with_args
+	PFN_gsapi_init_with_args	init_with_args;
+	/// gsapi_exit
+	PFN_gsapi_exit				exit;
+	/// Time it took to load the DLL (in milliseconds)
+	double						dLoadTime;
+};
+
+/// The GhostScript library
+extern GhostscriptApi gsapi;
+
+#endif   //#define _GHOSTSCRIPTAPI_H_
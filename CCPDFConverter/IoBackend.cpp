@@ -0,0 +1,430 @@
+/**
+	@file
+	@brief File I/O backends: blocking, or batched overlapped I/O on a completion port
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "IoBackend.h"
+#include "Configuration.h"
+
+/**
+    @brief Synchronous I/O: one system call per request
+*/
+class BlockingIo : public IoBackend
+{
+public:
+	/**
+		@param lpFile File name
+		@param dwAccess Access wanted
+		@param dwShare Sharing mode
+		@param dwCreation Creation disposition
+		@param dwFlags Attributes and flags
+		@return The file handle, INVALID_HANDLE_VALUE on failure
+	*/
+	virtual HANDLE Open(LPCTSTR lpFile, DWORD dwAccess, DWORD dwShare, DWORD dwCreation, DWORD dwFlags)
+	{
+		return CreateFile(lpFile, dwAccess, dwShare, NULL, dwCreation, dwFlags, NULL);
+	}
+
+	/**
+		@param hFile The file
+		@param nOffset Location to read from
+		@param pBuffer Buffer to fill
+		@param dwLen Size of the buffer
+		@param dwRead Filled with the count of bytes read
+		@return true if read successfully
+	*/
+	virtual bool Read(HANDLE hFile, unsigned __int64 nOffset, void* pBuffer, DWORD dwLen, DWORD& dwRead)
+	{
+		OVERLAPPED over;
+		ZeroMemory(&over, sizeof(over));
+		over.Offset = (DWORD)nOffset;
+		over.OffsetHigh = (DWORD)(nOffset >> 32);
+		// Called from more than one thread
+		InterlockedIncrement64(&m_stats.nReads);
+		InterlockedIncrement64(&m_stats.nSubmits);
+		dwRead = 0;
+		return ReadFile(hFile, pBuffer, dwLen, &dwRead, &over) != FALSE;
+	}
+
+	/**
+		@param hFile The file
+		@param nOffset Location to write at
+		@param pData Data to write
+		@param dwLen Size of the data
+		@return true if written successfully
+	*/
+	virtual bool Write(HANDLE hFile, unsigned __int64 nOffset, const void* pData, DWORD dwLen)
+	{
+		OVERLAPPED over;
+		ZeroMemory(&over, sizeof(over));
+		over.Offset = (DWORD)nOffset;
+		over.OffsetHigh = (DWORD)(nOffset >> 32);
+		InterlockedIncrement64(&m_stats.nWrites);
+		InterlockedIncrement64(&m_stats.nSubmits);
+		DWORD dwWritten;
+		return WriteFile(hFile, pData, dwLen, &dwWritten, &over) && (dwWritten == dwLen);
+	}
+
+	/**
+		@param hFile The file
+		@param bToDisk true to also flush the file to disk
+		@return true if successful
+	*/
+	virtual bool Flush(HANDLE hFile, bool bToDisk)
+	{
+		return !bToDisk || (FlushFileBuffers(hFile) != FALSE);
+	}
+
+	/**
+		@param hFile The file
+		@return true if successful
+	*/
+	virtual bool Close(HANDLE hFile)
+	{
+		return CloseHandle(hFile) != FALSE;
+	}
+
+	/**
+		@return The name
+	*/
+	virtual const char* GetName() const {return "blocking";};
+};
+
+/**
+    @brief Overlapped I/O on a completion port, with writes batched into fixed buffers
+
+	Consecutive writes to a file are gathered into one of a fixed set of buffers (allocated
+	once), which is submitted when it's full or when something depends on it; up to
+	QUEUE_DEPTH writes are in flight at a time. All methods are thread safe.
+*/
+class OverlappedIo : public IoBackend
+{
+public:
+	/// Ctor
+	OverlappedIo()
+	{
+		InitializeCriticalSection(&m_cs);
+		m_hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+		m_nCurrent = -1;
+		m_bFailed = false;
+		for (int i = 0; i < QUEUE_DEPTH; i++)
+		{
+			m_requests[i].pBuffer = (char*)VirtualAlloc(NULL, BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+			m_requests[i].bBusy = false;
+			m_requests[i].hFile = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	/// Dtor
+	virtual ~OverlappedIo()
+	{
+		EnterCriticalSection(&m_cs);
+		Drain(INVALID_HANDLE_VALUE, 0, 0);
+		LeaveCriticalSection(&m_cs);
+		for (int i = 0; i < QUEUE_DEPTH; i++)
+			VirtualFree(m_requests[i].pBuffer, 0, MEM_RELEASE);
+		if (m_hPort != NULL)
+			CloseHandle(m_hPort);
+		DeleteCriticalSection(&m_cs);
+	}
+
+	/**
+		@param lpFile File name
+		@param dwAccess Access wanted
+		@param dwShare Sharing mode
+		@param dwCreation Creation disposition
+		@param dwFlags Attributes and flags
+		@return The file handle, INVALID_HANDLE_VALUE on failure
+	*/
+	virtual HANDLE Open(LPCTSTR lpFile, DWORD dwAccess, DWORD dwShare, DWORD dwCreation, DWORD dwFlags)
+	{
+		HANDLE hFile = CreateFile(lpFile, dwAccess, dwShare, NULL, dwCreation, dwFlags | FILE_FLAG_OVERLAPPED, NULL);
+		if ((hFile != INVALID_HANDLE_VALUE) && (CreateIoCompletionPort(hFile, m_hPort, 0, 0) == NULL))
+		{
+			CloseHandle(hFile);
+			return INVALID_HANDLE_VALUE;
+		}
+		return hFile;
+	}
+
+	/**
+		@param hFile The file
+		@param nOffset Location to read from
+		@param pBuffer Buffer to fill
+		@param dwLen Size of the buffer
+		@param dwRead Filled with the count of bytes read
+		@return true if read successfully
+	*/
+	virtual bool Read(HANDLE hFile, unsigned __int64 nOffset, void* pBuffer, DWORD dwLen, DWORD& dwRead)
+	{
+		// The data may still be on its way to the file
+		EnterCriticalSection(&m_cs);
+		m_stats.nReads++;
+		bool bOK = Drain(hFile, nOffset, dwLen);
+		m_stats.nSubmits++;
+		LeaveCriticalSection(&m_cs);
+		dwRead = 0;
+		if (!bOK)
+			return false;
+
+		// A read that isn't queued to the port (the low bit of the event says so): its
+		// caller waits for it
+		OVERLAPPED over;
+		ZeroMemory(&over, sizeof(over));
+		over.Offset = (DWORD)nOffset;
+		over.OffsetHigh = (DWORD)(nOffset >> 32);
+		HANDLE hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		over.hEvent = (HANDLE)((ULONG_PTR)hEvent | 1);
+		BOOL bRet = ReadFile(hFile, pBuffer, dwLen, NULL, &over);
+		if (bRet || (GetLastError() == ERROR_IO_PENDING))
+			bRet = GetOverlappedResult(hFile, &over, &dwRead, TRUE);
+		CloseHandle(hEvent);
+		return bRet != FALSE;
+	}
+
+	/**
+		@param hFile The file
+		@param nOffset Location to write at
+		@param pData Data to write
+		@param dwLen Size of the data
+		@return true if the write was accepted (failures show in Flush and Close)
+	*/
+	virtual bool Write(HANDLE hFile, unsigned __int64 nOffset, const void* pData, DWORD dwLen)
+	{
+		const char* p = (const char*)pData;
+		EnterCriticalSection(&m_cs);
+		m_stats.nWrites++;
+		while (dwLen > 0)
+		{
+			if (m_nCurrent >= 0)
+			{
+				// Can it be added to the buffer being gathered?
+				Request& req = m_requests[m_nCurrent];
+				if ((req.hFile != hFile) || (req.nOffset + req.dwLen != nOffset))
+					Submit();
+			}
+			if (m_nCurrent < 0)
+			{
+				m_nCurrent = GetFreeRequest();
+				Request& req = m_requests[m_nCurrent];
+				req.hFile = hFile;
+				req.nOffset = nOffset;
+				req.dwLen = 0;
+			}
+			Request& req = m_requests[m_nCurrent];
+			DWORD dwAdd = min(dwLen, BUFFER_SIZE - req.dwLen);
+			memcpy(req.pBuffer + req.dwLen, p, dwAdd);
+			req.dwLen += dwAdd;
+			p += dwAdd;
+			nOffset += dwAdd;
+			dwLen -= dwAdd;
+			if (req.dwLen == BUFFER_SIZE)
+				Submit();
+		}
+		bool bRet = !m_bFailed;
+		LeaveCriticalSection(&m_cs);
+		return bRet;
+	}
+
+	/**
+		@param hFile The file
+		@param bToDisk true to also flush the file to disk
+		@return true if all writes succeeded
+	*/
+	virtual bool Flush(HANDLE hFile, bool bToDisk)
+	{
+		EnterCriticalSection(&m_cs);
+		bool bRet = Drain(hFile, 0, 0);
+		LeaveCriticalSection(&m_cs);
+		if (bToDisk && !FlushFileBuffers(hFile))
+			bRet = false;
+		return bRet;
+	}
+
+	/**
+		@param hFile The file
+		@return true if all writes succeeded
+	*/
+	virtual bool Close(HANDLE hFile)
+	{
+		bool bRet = Flush(hFile, false);
+		return (CloseHandle(hFile) != FALSE) && bRet;
+	}
+
+	/**
+		@return The name
+	*/
+	virtual const char* GetName() const {return "overlapped";};
+
+protected:
+	/// Count of buffers (and so, of writes in flight)
+	enum {QUEUE_DEPTH = 8};
+	/// Size of each buffer
+	enum {BUFFER_SIZE = 256 * 1024};
+
+	/// A write request, with its buffer
+	struct Request
+	{
+		/// Overlapped structure (first, so completions map back to the request)
+		OVERLAPPED			over;
+		/// The file
+		HANDLE				hFile;
+		/// Location in the file
+		unsigned __int64	nOffset;
+		/// Buffer (BUFFER_SIZE bytes)
+		char*				pBuffer;
+		/// Count of bytes in the buffer
+		DWORD				dwLen;
+		/// true while submitted
+		bool				bBusy;
+	};
+
+	/**
+		@brief Submits the buffer being gathered (called with the lock held)
+	*/
+	void Submit()
+	{
+		Request& req = m_requests[m_nCurrent];
+		m_nCurrent = -1;
+		ZeroMemory(&req.over, sizeof(req.over));
+		req.over.Offset = (DWORD)req.nOffset;
+		req.over.OffsetHigh = (DWORD)(req.nOffset >> 32);
+		req.bBusy = true;
+		m_stats.nSubmits++;
+		if (!WriteFile(req.hFile, req.pBuffer, req.dwLen, NULL, &req.over) && (GetLastError() != ERROR_IO_PENDING))
+		{
+			// No completion will come for this one
+			req.bBusy = false;
+			m_bFailed = true;
+		}
+	}
+
+	/**
+		@brief Waits for a write to complete (called with the lock held)
+		@return false if no write is in flight
+	*/
+	bool WaitOne()
+	{
+		DWORD dwBytes;
+		ULONG_PTR nKey;
+		LPOVERLAPPED pOver;
+		m_stats.nWaits++;
+		BOOL bRet = GetQueuedCompletionStatus(m_hPort, &dwBytes, &nKey, &pOver, INFINITE);
+		if (pOver == NULL)
+			return false;
+		Request* pReq = (Request*)pOver;
+		if (!bRet || (dwBytes != pReq->dwLen))
+			m_bFailed = true;
+		pReq->bBusy = false;
+		return true;
+	}
+
+	/**
+		@brief Returns a buffer that's not in use, waiting for one if needed (called with the lock held)
+		@return Index of the request
+	*/
+	int GetFreeRequest()
+	{
+		while (true)
+		{
+			for (int i = 0; i < QUEUE_DEPTH; i++)
+				if (!m_requests[i].bBusy)
+					return i;
+			if (!WaitOne())
+			{
+				// Shouldn't happen: take the first one
+				m_requests[0].bBusy = false;
+			}
+		}
+	}
+
+	/**
+		@brief Completes the writes a file range depends on (called with the lock held)
+		@param hFile The file (INVALID_HANDLE_VALUE for all files)
+		@param nOffset Start of the range
+		@param dwLen Size of the range (0 for the whole file)
+		@return true if all writes so far succeeded
+	*/
+	bool Drain(HANDLE hFile, unsigned __int64 nOffset, DWORD dwLen)
+	{
+		if ((m_nCurrent >= 0) && Depends(m_requests[m_nCurrent], hFile, nOffset, dwLen))
+			Submit();
+		while (true)
+		{
+			bool bWait = false;
+			for (int i = 0; (i < QUEUE_DEPTH) && !bWait; i++)
+				bWait = m_requests[i].bBusy && Depends(m_requests[i], hFile, nOffset, dwLen);
+			if (!bWait || !WaitOne())
+				break;
+		}
+		return !m_bFailed;
+	}
+
+	/**
+		@param req The request
+		@param hFile The file (INVALID_HANDLE_VALUE for all files)
+		@param nOffset Start of the range
+		@param dwLen Size of the range (0 for the whole file)
+		@return true if the request writes to the range
+	*/
+	static bool Depends(const Request& req, HANDLE hFile, unsigned __int64 nOffset, DWORD dwLen)
+	{
+		if (hFile == INVALID_HANDLE_VALUE)
+			return true;
+		if (req.hFile != hFile)
+			return false;
+		return (dwLen == 0) || ((req.nOffset < nOffset + dwLen) && (nOffset < req.nOffset + req.dwLen));
+	}
+
+protected:
+	/// The requests
+	Request				m_requests[QUEUE_DEPTH];
+	/// Index of the request being gathered (-1 if none)
+	int					m_nCurrent;
+	/// Completion port
+	HANDLE				m_hPort;
+	/// true once a write failed
+	bool				m_bFailed;
+	/// Protects everything
+	CRITICAL_SECTION	m_cs;
+};
+
+/**
+	@return The backend chosen by the io.backend setting
+*/
+IoBackend& IoBackend::Get()
+{
+	static IoBackend* pBackend = NULL;
+	if (pBackend == NULL)
+	{
+		// Called by the main thread once the settings are read, before any other thread uses it
+		if (myconfigdata.getstring("io.backend", "blocking") == "overlapped")
+			pBackend = new OverlappedIo;
+		else
+			pBackend = new BlockingIo;
+	}
+	return *pBackend;
+}
@@ -0,0 +1,89 @@
+/**
+	@file
+	@brief File I/O backends: blocking, or batched overlapped I/O on a completion port
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _IOBACKEND_H_
+#define _IOBACKEND_H_
+
+/// Counts of I/O calls made through a backend
+struct IoStats
+{
+	/// Read requests
+	LONGLONG	nReads;
+	/// Write requests
+	LONGLONG	nWrites;
+	/// Read/write calls made to the system
+	LONGLONG	nSubmits;
+	/// Waits for completions
+	LONGLONG	nWaits;
+};
+
+/**
+    @brief Positioned file I/O, used for the converter's own files (spill file, captures)
+
+	Set with the io.backend setting:
+	- blocking (default): each request is a synchronous system call
+	- overlapped: writes are gathered into fixed buffers and submitted without waiting,
+	  with completions collected from a completion port; reads and flushes wait only for
+	  the writes they depend on
+*/
+class IoBackend
+{
+public:
+	/// Dtor
+	virtual ~IoBackend() {};
+
+	/// Opens (or creates) a file for use with this backend
+	virtual HANDLE		Open(LPCTSTR lpFile, DWORD dwAccess, DWORD dwShare, DWORD dwCreation, DWORD dwFlags) = 0;
+	/// Reads from a location in a file
+	virtual bool		Read(HANDLE hFile, unsigned __int64 nOffset, void* pBuffer, DWORD dwLen, DWORD& dwRead) = 0;
+	/// Writes at a location in a file (may complete later)
+	virtual bool		Write(HANDLE hFile, unsigned __int64 nOffset, const void* pData, DWORD dwLen) = 0;
+	/// Completes all writes to a file, and optionally flushes it to disk
+	virtual bool		Flush(HANDLE hFile, bool bToDisk) = 0;
+	/// Completes all writes to a file and closes it
+	virtual bool		Close(HANDLE hFile) = 0;
+	/// Returns the name of the backend
+	virtual const char*	GetName() const = 0;
+
+	/**
+		@brief Returns the counts of calls made so far
+		@return The counts
+	*/
+	const IoStats&		GetStats() const {return m_stats;};
+
+	/// Returns the configured backend
+	static IoBackend&	Get();
+
+protected:
+	/// Ctor
+	IoBackend() {ZeroMemory(&m_stats, sizeof(m_stats));};
+
+	/// Call counts
+	IoStats				m_stats;
+};
+
+#endif   //#define _IOBACKEND_H_
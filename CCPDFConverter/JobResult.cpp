@@ -0,0 +1,86 @@
+/**
+	@file
+	@brief Machine-readable result of a conversion job
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "JobResult.h"
+#include "OutputWriter.h"
+#include <fstream>
+#include <stdio.h>
+#include <tchar.h>
+
+JobResult::JobResult()
+{
+	// Time and process make it unique
+	SYSTEMTIME st;
+	GetLocalTime(&st);
+	char cId[64];
+	sprintf_s(cId, sizeof(cId), "%04d%02d%02d%02d%02d%02d%03d-%u", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds, GetCurrentProcessId());
+	m_sId = cId;
+	(*this)["job.id"] = m_sId;
+}
+
+/**
+	@param sKey The key to set
+	@param nValue The value to set
+*/
+void JobResult::SetInt(const std::string& sKey, __int64 nValue)
+{
+	char cNum[32];
+	sprintf_s(cNum, sizeof(cNum), "%I64d", nValue);
+	(*this)[sKey] = cNum;
+}
+
+/**
+	@param sKey The key to set
+	@param dMilliseconds The time to set
+*/
+void JobResult::SetTime(const std::string& sKey, double dMilliseconds)
+{
+	char cNum[32];
+	sprintf_s(cNum, sizeof(cNum), "%.3f", dMilliseconds);
+	(*this)[sKey] = cNum;
+}
+
+/**
+	@param lpFile Name of the file to write
+	@return true if written successfully
+*/
+bool JobResult::Save(LPCTSTR lpFile) const
+{
+	// Write it aside first, so readers never see half a result
+	TCHAR cTemp[MAX_PATH + 16];
+	_stprintf_s(cTemp, MAX_PATH + 16, _T("%s.inprogress"), lpFile);
+	{
+		std::ofstream f(cTemp);
+		if (!f)
+			return false;
+		f << *this;
+		if (!f)
+			return false;
+	}
+	return PublishOutput(cTemp, lpFile);
+}
@@ -0,0 +1,61 @@
+/**
+	@file
+	@brief Machine-readable result of a conversion job
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _JOBRESULT_H_
+#define _JOBRESULT_H_
+
+#include "Configuration.h"
+
+/**
+    @brief The result of a conversion job, saved as a key/value file for monitoring tools
+
+	Uses the same format as the configuration files (one "key = value" per line).
+*/
+class JobResult : public configuration::data
+{
+public:
+	/// Constructor: creates a new job ID
+	JobResult();
+
+	/**
+		@brief Returns the ID of this job
+		@return The job ID (unique per computer)
+	*/
+	const std::string&	GetId() const {return m_sId;};
+	/// Sets a numeric value
+	void				SetInt(const std::string& sKey, __int64 nValue);
+	/// Sets a time value (in milliseconds)
+	void				SetTime(const std::string& sKey, double dMilliseconds);
+	/// Writes the result to a file (replacing it in one step)
+	bool				Save(LPCTSTR lpFile) const;
+
+protected:
+	/// The job ID
+	std::string			m_sId;
+};
+
+#endif   //#define _JOBRESULT_H_
@@ -0,0 +1,412 @@
+/**
+	@file
+	@brief Routes jobs to their level 1 and level 2 folders by rules, without the dialog
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "JobRouter.h"
+#include "Configuration.h"
+#include <algorithm>
+#include <ctype.h>
+
+/// Characters that can't be in a folder or file name (replaced in the values put in a target)
+#define BAD_NAME_CHARS		"\\/:*?\"<>|"
+
+/**
+	@param s The text
+	@return The text without white space at either end
+*/
+static std::string Trim(const std::string& s)
+{
+	size_t nStart = s.find_first_not_of(" \t\r\n");
+	if (nStart == std::string::npos)
+		return "";
+	return s.substr(nStart, s.find_last_not_of(" \t\r\n") - nStart + 1);
+}
+
+/**
+	@param s The text
+	@return The text in lower case
+*/
+static std::string ToLower(const std::string& s)
+{
+	std::string sRet(s);
+	for (std::string::iterator i = sRet.begin(); i != sRet.end(); i++)
+		*i = (char)tolower((unsigned char)*i);
+	return sRet;
+}
+
+/**
+	@param s The text
+	@return The text, without characters that can't be in a file name
+*/
+static std::string MakeName(const std::string& s)
+{
+	std::string sRet(s);
+	for (std::string::iterator i = sRet.begin(); i != sRet.end(); i++)
+		if (((unsigned char)*i < ' ') || (strchr(BAD_NAME_CHARS, *i) != NULL))
+			*i = '_';
+	return sRet;
+}
+
+/**
+	@param sData The job's data
+	@param pKey What comes before the value (e.g. "%%For:")
+	@return The rest of the line after the key, trimmed, without the quotes or parentheses around it (empty if the key isn't there)
+*/
+static std::string GetValue(const std::string& sData, const char* pKey)
+{
+	size_t nPos = sData.find(pKey);
+	if (nPos == std::string::npos)
+		return "";
+	nPos += strlen(pKey);
+	size_t nEnd = sData.find_first_of("\r\n", nPos);
+	std::string sValue = Trim(sData.substr(nPos, (nEnd == std::string::npos) ? std::string::npos : nEnd - nPos));
+	// PJL values may have a = before them
+	if (!sValue.empty() && (sValue[0] == '='))
+		sValue = Trim(sValue.substr(1));
+	if ((sValue.size() >= 2) && (((sValue[0] == '"') && (sValue[sValue.size() - 1] == '"')) || ((sValue[0] == '(') && (sValue[sValue.size() - 1] == ')'))))
+		sValue = sValue.substr(1, sValue.size() - 2);
+	return sValue;
+}
+
+/**
+	@param pData The start of the job's data (the PJL header, if any, and the PostScript header comments)
+	@param nSize Size of the data
+*/
+void JobInfo::Read(const char* pData, size_t nSize)
+{
+	std::string sData(pData, nSize);
+	sUser = GetValue(sData, "%%For:");
+	sJobName = GetValue(sData, "@PJL JOB NAME");
+	if (sJobName.empty())
+		sJobName = GetValue(sData, "@PJL SET JOBNAME");
+}
+
+/**
+*/
+JobRouter::JobRouter()
+{
+}
+
+/**
+	The rules are the route.<n> settings, tried in the order of their numbers
+
+	@return true if all the rules were read (the ones that weren't are left out)
+*/
+bool JobRouter::LoadRules()
+{
+	static const std::string sPrefix = "route.";
+	std::vector<std::pair<long, std::string> > lines;
+	for (configuration::data::const_iterator i = myconfigdata.lower_bound(sPrefix); (i != myconfigdata.end()) && ((*i).first.compare(0, sPrefix.size(), sPrefix) == 0); i++)
+	{
+		std::string sNumber = (*i).first.substr(sPrefix.size());
+		if (!sNumber.empty() && (sNumber.find_first_not_of("0123456789") == std::string::npos))
+			lines.push_back(std::make_pair(atol(sNumber.c_str()), (*i).second));
+	}
+	std::sort(lines.begin(), lines.end());
+
+	m_rules.reserve(lines.size());
+	for (std::vector<std::pair<long, std::string> >::const_iterator i = lines.begin(); i != lines.end(); i++)
+	{
+		Rule rule;
+		if (!ParseRule((*i).second, rule))
+		{
+			char cNumber[16];
+			sprintf_s(cNumber, sizeof(cNumber), "%s%ld", m_sInvalid.empty() ? "" : ",", (*i).first);
+			m_sInvalid += cNumber;
+			continue;
+		}
+		rule.nNumber = (*i).first;
+		m_rules.push_back(rule);
+	}
+	return m_sInvalid.empty();
+}
+
+/**
+	@param sText The rule: field, matcher, pattern, -> and the target
+	@param rule Receives the rule
+	@return true if the rule was read
+*/
+bool JobRouter::ParseRule(const std::string& sText, Rule& rule)
+{
+	size_t nArrow = sText.rfind("->");
+	if (nArrow == std::string::npos)
+		return false;
+	rule.sTarget = Trim(sText.substr(nArrow + 2));
+	std::string sMatch = Trim(sText.substr(0, nArrow));
+
+	size_t nEnd = sMatch.find_first_of(" \t");
+	std::string sField = ToLower(sMatch.substr(0, nEnd));
+	sMatch = Trim((nEnd == std::string::npos) ? "" : sMatch.substr(nEnd));
+	nEnd = sMatch.find_first_of(" \t");
+	std::string sKind = ToLower(sMatch.substr(0, nEnd));
+	std::string sPattern = Trim((nEnd == std::string::npos) ? "" : sMatch.substr(nEnd));
+	if ((sPattern.size() >= 2) && (sPattern[0] == '"') && (sPattern[sPattern.size() - 1] == '"'))
+		sPattern = sPattern.substr(1, sPattern.size() - 2);
+	if (sPattern.empty() || rule.sTarget.empty())
+		return false;
+
+	if (sField == "title")
+		rule.eField = Title;
+	else if (sField == "user")
+		rule.eField = User;
+	else if (sField == "jobname")
+		rule.eField = JobName;
+	else
+		return false;
+
+	if (sKind == "prefix")
+	{
+		rule.eKind = Prefix;
+		rule.sPattern = ToLower(sPattern);
+		rule.sLiteral = rule.sPattern;
+	}
+	else if (sKind == "glob")
+	{
+		rule.eKind = Glob;
+		rule.sPattern = ToLower(sPattern);
+		rule.sLiteral = rule.sPattern.substr(0, rule.sPattern.find_first_of("*?"));
+	}
+	else if (sKind == "regex")
+	{
+		rule.eKind = Regex;
+		rule.sPattern = sPattern;
+		// The whole value must match, so it starts with whatever the pattern starts with (unless
+		// there's an alternative somewhere)
+		if (sPattern.find('|') == std::string::npos)
+		{
+			size_t nPos = (sPattern[0] == '^') ? 1 : 0;
+			size_t nLiteral = sPattern.find_first_of("\\.[]{}()*+?^$", nPos);
+			if (nLiteral == std::string::npos)
+				nLiteral = sPattern.size();
+			else if ((nLiteral > nPos) && (strchr("*?{", sPattern[nLiteral]) != NULL))
+				// The last character may repeat, or not be there at all
+				nLiteral--;
+			rule.sLiteral = ToLower(sPattern.substr(nPos, nLiteral - nPos));
+			// (The regex may see other letters as the same in another case: those end it too)
+			for (size_t i = 0; i < rule.sLiteral.size(); i++)
+				if ((unsigned char)rule.sLiteral[i] >= 0x80)
+				{
+					rule.sLiteral.erase(i);
+					break;
+				}
+		}
+	}
+	else
+		return false;
+	return true;
+}
+
+/**
+	@param info What's known about the job
+	@param sLevel1 Receives the level 1 folder
+	@param sLevel2 Receives the level 2 folder
+	@param sFile Receives the document name (without a folder, and maybe without .pdf)
+	@param result The job result (gets route.rule and time.route, and route.invalid if some rules couldn't be read)
+	@return The number of the rule that matched, 0 if none did
+*/
+int JobRouter::Route(const JobInfo& info, std::string& sLevel1, std::string& sLevel2, std::string& sFile, JobResult& result)
+{
+	LARGE_INTEGER liStart, liEnd, liFreq;
+	QueryPerformanceCounter(&liStart);
+
+	// Indexed by Field
+	const std::string values[] = {info.sTitle, info.sUser, info.sJobName};
+	const std::string lower[] = {ToLower(info.sTitle), ToLower(info.sUser), ToLower(info.sJobName)};
+	std::vector<std::string> captures;
+	int nRet = 0;
+	for (std::vector<Rule>::iterator i = m_rules.begin(); i != m_rules.end(); i++)
+	{
+		if (Matches(*i, values, lower, captures) && Expand(*i, info, captures, sLevel1, sLevel2, sFile))
+		{
+			nRet = (int)(*i).nNumber;
+			result.SetInt("route.rule", nRet);
+			break;
+		}
+	}
+
+	QueryPerformanceCounter(&liEnd);
+	QueryPerformanceFrequency(&liFreq);
+	result.SetTime("time.route", (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFreq.QuadPart);
+	if (!m_sInvalid.empty())
+		result["route.invalid"] = m_sInvalid;
+	return nRet;
+}
+
+/**
+	@param rule The rule (its regex is compiled if needed)
+	@param pValues The fields, indexed by Field
+	@param pLower The fields in lower case
+	@param captures Receives what a regex captured ({0} to {9})
+	@return true if the rule matches
+*/
+bool JobRouter::Matches(Rule& rule, const std::string* pValues, const std::string* pLower, std::vector<std::string>& captures)
+{
+	// Most rules stop here
+	if (rule.bInvalid || (pLower[rule.eField].compare(0, rule.sLiteral.size(), rule.sLiteral) != 0))
+		return false;
+
+	captures.clear();
+	switch (rule.eKind)
+	{
+		case Prefix:
+			return true;
+		case Glob:
+			return GlobMatch(rule.sPattern.c_str(), pLower[rule.eField].c_str());
+		case Regex:
+			break;
+	}
+
+	if (!rule.bCompiled)
+	{
+		try
+		{
+			rule.regex.assign(rule.sPattern, std::tr1::regex_constants::ECMAScript | std::tr1::regex_constants::icase);
+			rule.bCompiled = true;
+		}
+		catch (std::tr1::regex_error&)
+		{
+			rule.bInvalid = true;
+			char cNumber[16];
+			sprintf_s(cNumber, sizeof(cNumber), "%s%ld", m_sInvalid.empty() ? "" : ",", rule.nNumber);
+			m_sInvalid += cNumber;
+			return false;
+		}
+	}
+	std::tr1::smatch match;
+	if (!std::tr1::regex_match(pValues[rule.eField], match, rule.regex))
+		return false;
+	for (size_t i = 0; (i < match.size()) && (i < 10); i++)
+		captures.push_back(match[i].str());
+	return true;
+}
+
+/**
+	@param rule The rule that matched
+	@param info What's known about the job
+	@param captures What the rule's regex captured
+	@param sLevel1 Receives the level 1 folder
+	@param sLevel2 Receives the level 2 folder
+	@param sFile Receives the document name
+	@return true if the target made a usable folder and name (otherwise the next rule is tried)
+*/
+bool JobRouter::Expand(const Rule& rule, const JobInfo& info, const std::vector<std::string>& captures, std::string& sLevel1, std::string& sLevel2, std::string& sFile)
+{
+	// What the dialog would suggest: the title up to its last " - " (what follows is usually the application)
+	std::string sName = info.sTitle;
+	size_t nDash = sName.rfind(" - ");
+	if (nDash != std::string::npos)
+		sName.erase(nDash);
+
+	// The values go in as they are (a value with {...} in it isn't expanded again)
+	std::string sTarget;
+	for (size_t nPos = 0; nPos < rule.sTarget.size(); )
+	{
+		size_t nEnd = (rule.sTarget[nPos] == '{') ? rule.sTarget.find('}', nPos) : std::string::npos;
+		if (nEnd == std::string::npos)
+		{
+			sTarget += rule.sTarget[nPos++];
+			continue;
+		}
+		std::string sVariable = rule.sTarget.substr(nPos + 1, nEnd - nPos - 1);
+		if (sVariable == "title")
+			sTarget += MakeName(info.sTitle);
+		else if (sVariable == "name")
+			sTarget += MakeName(sName);
+		else if (sVariable == "user")
+			sTarget += MakeName(info.sUser);
+		else if (sVariable == "jobname")
+			sTarget += MakeName(info.sJobName);
+		else if ((sVariable.size() == 1) && isdigit((unsigned char)sVariable[0]))
+		{
+			size_t nCapture = sVariable[0] - '0';
+			if (nCapture < captures.size())
+				sTarget += MakeName(captures[nCapture]);
+		}
+		else
+			// Not a variable
+			sTarget += rule.sTarget.substr(nPos, nEnd - nPos + 1);
+		nPos = nEnd + 1;
+	}
+
+	// level1\level2[\filename]
+	std::vector<std::string> parts;
+	size_t nPos = 0;
+	while (true)
+	{
+		size_t nEnd = sTarget.find_first_of("\\/", nPos);
+		std::string sPart = Trim(sTarget.substr(nPos, (nEnd == std::string::npos) ? std::string::npos : nEnd - nPos));
+		if (sPart.empty() || (sPart == ".") || (sPart == ".."))
+			return false;
+		parts.push_back(sPart);
+		if (nEnd == std::string::npos)
+			break;
+		nPos = nEnd + 1;
+	}
+	if ((parts.size() < 2) || (parts.size() > 3))
+		return false;
+	sLevel1 = parts[0];
+	sLevel2 = parts[1];
+	sFile = (parts.size() == 3) ? parts[2] : Trim(MakeName(sName));
+	if (sFile.empty())
+		sFile = "Untitled";
+	return true;
+}
+
+/**
+	@param pPattern The pattern (* for any text, ? for any character)
+	@param pText The text
+	@return true if the whole text matches the pattern
+*/
+bool JobRouter::GlobMatch(const char* pPattern, const char* pText)
+{
+	// Where to go back to when what followed the last * didn't match
+	const char* pStar = NULL;
+	const char* pBack = NULL;
+	while (*pText != '\0')
+	{
+		if (*pPattern == '*')
+		{
+			pStar = ++pPattern;
+			pBack = pText;
+		}
+		else if ((*pPattern == '?') || (*pPattern == *pText))
+		{
+			pPattern++;
+			pText++;
+		}
+		else if (pStar != NULL)
+		{
+			pPattern = pStar;
+			pText = ++pBack;
+		}
+		else
+			return false;
+	}
+	while (*pPattern == '*')
+		pPattern++;
+	return *pPattern == '\0';
+}
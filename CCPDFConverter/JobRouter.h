@@ -0,0 +1,145 @@
+/**
+	@file
+	@brief Routes jobs to their level 1 and level 2 folders by rules, without the dialog
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _JOBROUTER_H_
+#define _JOBROUTER_H_
+
+#include "JobResult.h"
+#include <vector>
+#include <regex>
+
+/**
+    @brief What's known about a job before it's converted (the fields the rules look at)
+*/
+struct JobInfo
+{
+	/// Document title (%%Title)
+	std::string			sTitle;
+	/// User (%%For, or the user the job runs as)
+	std::string			sUser;
+	/// Job name from the PJL header (@PJL JOB NAME, or @PJL SET JOBNAME)
+	std::string			sJobName;
+
+	/// Reads the user and the job name from the start of the job's data
+	void				Read(const char* pData, size_t nSize);
+};
+
+/**
+    @brief Decides where a job goes by the route.<n> rules, so no one has to be asked
+
+	Each rule is a line in the settings, tried in the order of the numbers:
+	@code
+	route.10 = title prefix "Invoice " -> Invoices\{user}\{name}
+	route.20 = jobname glob *-Q?-report -> Reports\Quarterly
+	route.30 = user regex ^acct-(\w+)$ -> Accounts\{1}
+	@endcode
+	The field is title, user or jobname; the matcher is prefix, glob (* and ?) or regex (the
+	whole value must match); none of them care about case. The pattern may be quoted, to keep
+	spaces at its ends. The target is level1\level2, optionally followed by \filename; it
+	may use {title}, {name} (the title without its " - application" end, as the dialog
+	suggests it), {user}, {jobname}, and {0} to {9} for what a regex captured. Without a
+	filename the document is named {name}.
+
+	Rules are compiled when they're read, except regexes: each rule knows the text the value
+	must start with (the prefix, the glob up to its first wildcard, or what follows a regex's
+	^ up to its first special character), and most rules are passed over by comparing that.
+	Regexes are only compiled once a value gets past it.
+*/
+class JobRouter
+{
+public:
+	/// Ctor
+	JobRouter();
+
+	/// Reads the rules from the settings
+	bool				LoadRules();
+	/**
+		@brief Checks if there are rules
+		@return true if there's at least one rule
+	*/
+	bool				IsEnabled() const {return !m_rules.empty();};
+	/// Finds where a job goes
+	int					Route(const JobInfo& info, std::string& sLevel1, std::string& sLevel2, std::string& sFile, JobResult& result);
+
+protected:
+	/// Fields a rule can look at
+	enum Field
+	{
+		Title,
+		User,
+		JobName
+	};
+	/// Ways a rule can match
+	enum Kind
+	{
+		Prefix,
+		Glob,
+		Regex
+	};
+	/// A rule
+	struct Rule
+	{
+		/// Ctor
+		Rule() : nNumber(0), eField(Title), eKind(Prefix), bCompiled(false), bInvalid(false) {};
+
+		/// Rule number (route.<n>)
+		long			nNumber;
+		/// Field to look at
+		Field			eField;
+		/// How it's matched
+		Kind			eKind;
+		/// The pattern (in lower case for prefix and glob)
+		std::string		sPattern;
+		/// What the value must start with (in lower case)
+		std::string		sLiteral;
+		/// The target (level1\level2[\filename])
+		std::string		sTarget;
+		/// true once the regex was compiled
+		bool			bCompiled;
+		/// true if the regex didn't compile (the rule is passed over)
+		bool			bInvalid;
+		/// The compiled regex
+		std::tr1::regex	regex;
+	};
+
+	/// Reads a rule
+	static bool			ParseRule(const std::string& sText, Rule& rule);
+	/// Checks if a rule matches a job
+	bool				Matches(Rule& rule, const std::string* pValues, const std::string* pLower, std::vector<std::string>& captures);
+	/// Makes the target of a rule
+	static bool			Expand(const Rule& rule, const JobInfo& info, const std::vector<std::string>& captures, std::string& sLevel1, std::string& sLevel2, std::string& sFile);
+	/// Matches a glob pattern
+	static bool			GlobMatch(const char* pPattern, const char* pText);
+
+protected:
+	/// The rules, in order
+	std::vector<Rule>	m_rules;
+	/// Numbers of the rules that couldn't be read
+	std::string			m_sInvalid;
+};
+
+#endif   //#define _JOBROUTER_H_
@@ -0,0 +1,235 @@
+/**
+	@file
+	@brief Names output documents from a template, with a sequence number per folder
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "OutputNaming.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Name of the counter file, in each folder
+#define SEQUENCE_FILE		"CCPDFConverter.seq"
+/// Names tried before giving up (only more than one if documents were numbered by hand)
+#define MAX_NAME_TRIES		16
+/// Extension of the documents
+#define PDF_EXTENSION		".pdf"
+
+/**
+	@param sTemplate The naming template (without the extension; empty if documents aren't
+	named by a template)
+*/
+OutputNaming::OutputNaming(const std::string& sTemplate) : m_sTemplate(sTemplate)
+{
+	SYSTEMTIME st;
+	GetLocalTime(&st);
+	char cValue[32];
+	sprintf_s(cValue, sizeof(cValue), "%04u-%02u-%02u", st.wYear, st.wMonth, st.wDay);
+	SetVariable("date", cValue);
+	sprintf_s(cValue, sizeof(cValue), "%02u%02u%02u", st.wHour, st.wMinute, st.wSecond);
+	SetVariable("time", cValue);
+}
+
+/**
+	@param sName Name of the variable (without the braces)
+	@param sValue Its value (characters file names can't have are replaced)
+*/
+void OutputNaming::SetVariable(const std::string& sName, const std::string& sValue)
+{
+	std::string sClean(sValue);
+	for (std::string::iterator i = sClean.begin(); i != sClean.end(); i++)
+		if (strchr("\\/:*?\"<>|", *i) != NULL)
+			*i = '_';
+	std::string sVariable = "{" + sName + "}";
+	for (std::vector<std::pair<std::string, std::string> >::iterator i = m_variables.begin(); i != m_variables.end(); i++)
+	{
+		if (i->first == sVariable)
+		{
+			// Set before: the new value replaces it
+			i->second = sClean;
+			return;
+		}
+	}
+	m_variables.push_back(std::make_pair(sVariable, sClean));
+}
+
+/**
+	@param sTemplate The template
+	@param nSequence The sequence number, for {seq}
+	@return The template with the variables replaced
+*/
+std::string OutputNaming::Expand(const std::string& sTemplate, unsigned __int64 nSequence) const
+{
+	std::string sRet(sTemplate);
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator i = m_variables.begin(); i != m_variables.end(); i++)
+	{
+		std::string::size_type nPos;
+		while ((nPos = sRet.find(i->first)) != std::string::npos)
+			sRet.replace(nPos, i->first.size(), i->second);
+	}
+	std::string::size_type nPos;
+	while ((nPos = sRet.find("{seq")) != std::string::npos)
+	{
+		std::string::size_type nEnd = sRet.find('}', nPos);
+		if (nEnd == std::string::npos)
+			break;
+		int nWidth = (sRet[nPos + 4] == ':') ? atoi(sRet.c_str() + nPos + 5) : 0;
+		char cValue[32];
+		sprintf_s(cValue, sizeof(cValue), "%0*I64u", max(0, min(20, nWidth)), nSequence);
+		sRet.replace(nPos, nEnd + 1 - nPos, cValue);
+	}
+	return sRet;
+}
+
+/**
+	@param sFolder The folder
+	@param nSequence Receives the number (1 the first time)
+	@return true if a number was taken
+*/
+bool OutputNaming::NextSequence(const std::string& sFolder, unsigned __int64& nSequence)
+{
+	std::string sCounter = sFolder + "\\" + SEQUENCE_FILE;
+	HANDLE hFile = CreateFile(sCounter.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_HIDDEN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	// Held only while the number is read and written (other computers sharing the folder
+	// wait for it too)
+	OVERLAPPED ov;
+	memset(&ov, 0, sizeof(ov));
+	if (!LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	char cValue[32];
+	DWORD dwRead = 0;
+	if (!ReadFile(hFile, cValue, sizeof(cValue) - 1, &dwRead, NULL))
+		dwRead = 0;
+	cValue[dwRead] = '\0';
+	nSequence = _strtoui64(cValue, NULL, 10) + 1;
+	sprintf_s(cValue, sizeof(cValue), "%I64u\r\n", nSequence);
+	DWORD dwWritten;
+	bool bRet = (SetFilePointer(hFile, 0, NULL, FILE_BEGIN) == 0) && WriteFile(hFile, cValue, (DWORD)strlen(cValue), &dwWritten, NULL) && SetEndOfFile(hFile);
+	UnlockFileEx(hFile, 0, 1, 0, &ov);
+	CloseHandle(hFile);
+	return bRet;
+}
+
+/**
+	@param sName The document name
+	@return true if the name is ours now (an empty hidden marker holds it); false if it's
+	taken, or couldn't be had (GetLastError() tells which: ERROR_FILE_EXISTS if taken)
+*/
+bool OutputNaming::Reserve(const std::string& sName)
+{
+	// Created only if it's not there, in one file system operation, so no two jobs get the same name
+	std::string sMarker = GetReservation(sName.c_str());
+	HANDLE hFile = CreateFile(sMarker.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_HIDDEN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	CloseHandle(hFile);
+	// A document that's there already (named some other way) keeps its name
+	if (GetFileAttributes(sName.c_str()) != INVALID_FILE_ATTRIBUTES)
+	{
+		DeleteFile(sMarker.c_str());
+		SetLastError(ERROR_FILE_EXISTS);
+		return false;
+	}
+	return true;
+}
+
+/**
+	@param lpFile A name given by MakeName
+	@return true if the name's marker is gone; false if it couldn't be removed, or isn't just
+	a marker any more
+*/
+bool OutputNaming::Unreserve(LPCTSTR lpFile)
+{
+	std::string sMarker = GetReservation(lpFile);
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesEx(sMarker.c_str(), GetFileExInfoStandard, &data))
+		return GetLastError() == ERROR_FILE_NOT_FOUND;
+	if ((data.nFileSizeLow != 0) || (data.nFileSizeHigh != 0))
+		return false;
+	return DeleteFile(sMarker.c_str()) != FALSE;
+}
+
+/**
+	@param lpFile The document as named in the dialog (replaced by the new name)
+	@param nSize Size of lpFile (characters)
+	@param result Job result to record the sequence number in (naming.seq)
+	@return true if the document was named (and the name reserved); false if it keeps its name
+*/
+bool OutputNaming::MakeName(LPTSTR lpFile, size_t nSize, JobResult& result)
+{
+	if (!IsEnabled())
+		return false;
+	std::string sFolder(lpFile);
+	std::string::size_type nSlash = sFolder.rfind('\\');
+	if (nSlash == std::string::npos)
+		return false;
+	std::string sTitle = sFolder.substr(nSlash + 1);
+	sFolder.erase(nSlash);
+	if ((sTitle.size() >= strlen(PDF_EXTENSION)) && (_stricmp(sTitle.c_str() + sTitle.size() - strlen(PDF_EXTENSION), PDF_EXTENSION) == 0))
+		sTitle.erase(sTitle.size() - strlen(PDF_EXTENSION));
+	SetVariable("title", sTitle);
+
+	std::string sTemplate = m_sTemplate;
+	std::string sName;
+	if (sTemplate.find("{seq") == std::string::npos)
+	{
+		// Not numbered, unless it has to be
+		sName = sFolder + "\\" + Expand(sTemplate, 0) + PDF_EXTENSION;
+		if (sName.size() >= nSize)
+			return false;
+		if (Reserve(sName))
+		{
+			strcpy_s(lpFile, nSize, sName.c_str());
+			return true;
+		}
+		if (GetLastError() != ERROR_FILE_EXISTS)
+			return false;
+		sTemplate += " ({seq})";
+	}
+	for (int i = 0; i < MAX_NAME_TRIES; i++)
+	{
+		unsigned __int64 nSequence;
+		if (!NextSequence(sFolder, nSequence))
+			return false;
+		sName = sFolder + "\\" + Expand(sTemplate, nSequence) + PDF_EXTENSION;
+		if (sName.size() >= nSize)
+			return false;
+		// Only taken if it was named some other way
+		if (Reserve(sName))
+		{
+			strcpy_s(lpFile, nSize, sName.c_str());
+			result.SetInt("naming.seq", nSequence);
+			return true;
+		}
+		if (GetLastError() != ERROR_FILE_EXISTS)
+			return false;
+	}
+	return false;
+}
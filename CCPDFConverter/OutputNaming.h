@@ -0,0 +1,94 @@
+/**
+	@file
+	@brief Names output documents from a template, with a sequence number per folder
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _OUTPUTNAMING_H_
+#define _OUTPUTNAMING_H_
+
+#include "JobResult.h"
+#include <vector>
+
+/// Extension of the marker reserving a document name
+#define RESERVED_EXTENSION	".reserved"
+
+/**
+    @brief Names the converted document from the naming template, so it doesn't replace another
+
+	The template (the naming setting; without it, the document is named as typed in the
+	dialog) may use these variables:
+	- {title}: the name typed in the dialog
+	- {level1}, {level2}: the folders chosen in the dialog
+	- {user}: the user name
+	- {date}, {time}: when the job was converted (yyyy-mm-dd, hhmmss)
+	- {seq}, or {seq:N} for at least N digits: the folder's next sequence number
+
+	Sequence numbers come from a small counter file in the folder, read and incremented
+	under a lock, so a unique name takes the same few file operations however many documents
+	the folder has (nothing is listed, and names aren't tried one by one). A name without
+	{seq} is used if there's no such document yet; otherwise it gets a sequence number too.
+
+	The name is reserved as soon as it's chosen, by creating an empty hidden
+	"<name>.reserved" marker next to it (which fails if the marker is there already, so two
+	jobs never get the same name); folder watchers never see an empty document. The document
+	is then published as the name without replacing anything, and the marker removed (see
+	Unreserve).
+*/
+class OutputNaming
+{
+public:
+	/// Ctor
+	OutputNaming(const std::string& sTemplate);
+
+	/**
+		@brief Checks if there's a template
+		@return true if documents are named by the template
+	*/
+	bool				IsEnabled() const {return !m_sTemplate.empty();};
+	/// Sets the value of a variable used in the template
+	void				SetVariable(const std::string& sName, const std::string& sValue);
+	/// Names a document
+	bool				MakeName(LPTSTR lpFile, size_t nSize, JobResult& result);
+	/// Frees a reserved name, by removing its marker
+	static bool			Unreserve(LPCTSTR lpFile);
+	/// Returns the name of the marker reserving a document name
+	static std::string	GetReservation(LPCTSTR lpFile) {return std::string(lpFile) + RESERVED_EXTENSION;};
+
+protected:
+	/// Replaces the variables in a template
+	std::string			Expand(const std::string& sTemplate, unsigned __int64 nSequence) const;
+	/// Gets the next sequence number of a folder
+	static bool			NextSequence(const std::string& sFolder, unsigned __int64& nSequence);
+	/// Reserves a document name
+	static bool			Reserve(const std::string& sName);
+
+protected:
+	/// The template
+	std::string			m_sTemplate;
+	/// Variable names and values
+	std::vector<std::pair<std::string, std::string> >	m_variables;
+};
+
+#endif   //#define _OUTPUTNAMING_H_
@@ -0,0 +1,169 @@
+/**
+	@file
+	@brief Streaming finished output to stdout, a named pipe or a socket
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <string>
+#include "OutputStream.h"
+
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "mswsock.lib")
+
+/// Size of the chunks copied to handles (large, so a pipe reader gets few big writes)
+#define STREAM_CHUNK			(1024 * 1024)
+/// How long to wait for a busy named pipe (milliseconds)
+#define PIPE_WAIT				10000
+
+/**
+	@param sTarget The stream target (see class description)
+*/
+OutputStream::OutputStream(const std::string& sTarget) : m_sTarget(sTarget), m_nSent(0)
+{
+}
+
+/**
+*/
+OutputStream::~OutputStream()
+{
+}
+
+/**
+	@param lpFile The file to send
+	@return true if the whole file was sent
+*/
+bool OutputStream::Send(LPCTSTR lpFile)
+{
+	HANDLE hFile = CreateFile(lpFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool bRet = false;
+	if ((m_sTarget == "-") || (m_sTarget == "stdout"))
+		bRet = SendToHandle(hFile, GetStdHandle(STD_OUTPUT_HANDLE));
+	else if (m_sTarget.compare(0, 4, "tcp:") == 0)
+		bRet = SendToSocket(hFile, m_sTarget.substr(4));
+	else if (m_sTarget.compare(0, 9, "\\\\.\\pipe\\") == 0)
+	{
+		HANDLE hPipe;
+		while (true)
+		{
+			hPipe = CreateFile(m_sTarget.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+			if ((hPipe != INVALID_HANDLE_VALUE) || (GetLastError() != ERROR_PIPE_BUSY) || !WaitNamedPipe(m_sTarget.c_str(), PIPE_WAIT))
+				break;
+		}
+		if (hPipe != INVALID_HANDLE_VALUE)
+		{
+			bRet = SendToHandle(hFile, hPipe);
+			FlushFileBuffers(hPipe);
+			CloseHandle(hPipe);
+		}
+	}
+	CloseHandle(hFile);
+	return bRet;
+}
+
+/**
+	@param hFile The file to send
+	@param hTarget Where to send it
+	@return true if the whole file was sent
+*/
+bool OutputStream::SendToHandle(HANDLE hFile, HANDLE hTarget)
+{
+	if ((hTarget == NULL) || (hTarget == INVALID_HANDLE_VALUE))
+		return false;
+
+	char* pChunk = new char[STREAM_CHUNK];
+	bool bRet = true;
+	DWORD dwRead;
+	while (bRet && ReadFile(hFile, pChunk, STREAM_CHUNK, &dwRead, NULL) && (dwRead > 0))
+	{
+		DWORD dwDone = 0;
+		while (dwDone < dwRead)
+		{
+			DWORD dwWritten;
+			if (!WriteFile(hTarget, pChunk + dwDone, dwRead - dwDone, &dwWritten, NULL))
+			{
+				bRet = false;
+				break;
+			}
+			dwDone += dwWritten;
+			m_nSent += dwWritten;
+		}
+	}
+	delete [] pChunk;
+	return bRet;
+}
+
+/**
+	@param hFile The file to send
+	@param sAddress Where to send it (host:port)
+	@return true if the whole file was sent
+*/
+bool OutputStream::SendToSocket(HANDLE hFile, const std::string& sAddress)
+{
+	std::string::size_type nColon = sAddress.rfind(':');
+	if (nColon == std::string::npos)
+		return false;
+
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+		return false;
+
+	bool bRet = false;
+	addrinfo hints = {0};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	addrinfo* pAddresses = NULL;
+	if (getaddrinfo(sAddress.substr(0, nColon).c_str(), sAddress.substr(nColon + 1).c_str(), &hints, &pAddresses) == 0)
+	{
+		for (addrinfo* pAddr = pAddresses; (pAddr != NULL) && !bRet; pAddr = pAddr->ai_next)
+		{
+			SOCKET s = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+			if (s == INVALID_SOCKET)
+				continue;
+			if (connect(s, pAddr->ai_addr, (int)pAddr->ai_addrlen) == 0)
+			{
+				// The kernel sends the file straight from the cache, without copying it through here
+				LARGE_INTEGER liSize;
+				SetFilePointer(hFile, 0, NULL, FILE_BEGIN);
+				if (GetFileSizeEx(hFile, &liSize) && TransmitFile(s, hFile, 0, 0, NULL, NULL, TF_USE_KERNEL_APC))
+				{
+					m_nSent += liSize.QuadPart;
+					bRet = true;
+				}
+				shutdown(s, SD_SEND);
+			}
+			closesocket(s);
+		}
+		freeaddrinfo(pAddresses);
+	}
+	WSACleanup();
+	return bRet;
+}
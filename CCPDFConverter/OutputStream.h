@@ -0,0 +1,68 @@
+/**
+	@file
+	@brief Streaming finished output to stdout, a named pipe or a socket
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _OUTPUTSTREAM_H_
+#define _OUTPUTSTREAM_H_
+
+/**
+    @brief Sends a finished file to a stream target instead of publishing it
+
+	A job whose header has a "%%Stream: <target>" line is converted into a temporary file
+	(pdfwrite needs to seek in its output) which is then sent to the target and deleted.
+	Targets:
+	- "-" or "stdout": the converter's standard output
+	- "\\.\pipe\<name>": a named pipe (which must be listening)
+	- "tcp:<host>:<port>": a socket connection
+*/
+class OutputStream
+{
+public:
+	/// Ctor
+	OutputStream(const std::string& sTarget);
+	/// Dtor
+	virtual ~OutputStream();
+
+	/// Sends a file to the target
+	bool Send(LPCTSTR lpFile);
+
+	/// Returns the count of bytes sent
+	unsigned __int64 GetSent() const {return m_nSent;};
+
+protected:
+	/// Sends the file through a handle (stdout or a pipe)
+	bool SendToHandle(HANDLE hFile, HANDLE hTarget);
+	/// Sends the file through a socket connection
+	bool SendToSocket(HANDLE hFile, const std::string& sAddress);
+
+protected:
+	/// Stream target, as given in the job header
+	std::string			m_sTarget;
+	/// Bytes sent so far
+	unsigned __int64	m_nSent;
+};
+
+#endif   //#define _OUTPUTSTREAM_H_
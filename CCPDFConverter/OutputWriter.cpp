@@ -0,0 +1,145 @@
+/**
+	@file
+	@brief Publishing finished output files with a selectable durability
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "OutputWriter.h"
+#include "Configuration.h"
+#include <tchar.h>
+#include <vector>
+
+/**
+	@return The durability mode from the output.durability setting (none if not set or unknown)
+*/
+OutputDurability GetOutputDurability()
+{
+	std::string sMode = myconfigdata.getstring("output.durability", "none");
+	if (sMode == "data")
+		return DurabilityData;
+	if (sMode == "full")
+		return DurabilityFull;
+	return DurabilityNone;
+}
+
+/**
+	@param hFile Handle of the file (opened with DELETE access)
+	@param lpFinal Name to give it
+	@param bReplace true to replace a file with that name
+	@return true if renamed successfully
+*/
+static bool RenameByHandle(HANDLE hFile, LPCTSTR lpFinal, bool bReplace)
+{
+	// Renaming the handle we flushed means it's the same file that lands under the final name
+	TCHAR cFull[MAX_PATH];
+	if (!GetFullPathName(lpFinal, MAX_PATH, cFull, NULL))
+		return false;
+#ifdef UNICODE
+	std::wstring sName(cFull);
+#else
+	int nLen = MultiByteToWideChar(CP_ACP, 0, cFull, -1, NULL, 0);
+	if (nLen <= 0)
+		return false;
+	std::wstring sName(nLen, L'\0');
+	MultiByteToWideChar(CP_ACP, 0, cFull, -1, &sName[0], nLen);
+	sName.resize(nLen - 1);
+#endif
+	std::vector<BYTE> info(sizeof(FILE_RENAME_INFO) + sName.size() * sizeof(WCHAR));
+	FILE_RENAME_INFO* pInfo = (FILE_RENAME_INFO*)&info[0];
+	pInfo->ReplaceIfExists = bReplace ? TRUE : FALSE;
+	pInfo->RootDirectory = NULL;
+	pInfo->FileNameLength = (DWORD)(sName.size() * sizeof(WCHAR));
+	memcpy(pInfo->FileName, sName.c_str(), pInfo->FileNameLength);
+	return SetFileInformationByHandle(hFile, FileRenameInfo, pInfo, (DWORD)info.size()) != FALSE;
+}
+
+/**
+	@param lpFile The file whose folder entry should be flushed
+*/
+static void FlushFolder(LPCTSTR lpFile)
+{
+	TCHAR cFolder[MAX_PATH];
+	LPTSTR pName;
+	if (!GetFullPathName(lpFile, MAX_PATH, cFolder, &pName) || (pName == NULL))
+		return;
+	*pName = '\0';
+	// Folders can only be opened this way with backup semantics; not all file systems allow
+	// flushing them, in which case the write-through rename is the best we get
+	HANDLE hFolder = CreateFile(cFolder, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (hFolder == INVALID_HANDLE_VALUE)
+		return;
+	FlushFileBuffers(hFolder);
+	CloseHandle(hFolder);
+}
+
+/**
+	@param lpTemp The finished file
+	@param lpFinal Name to publish it as
+	@param eDurability What to flush
+	@param bReplace true to replace a file with that name, false to fail if there's one
+	@return true if published successfully (false if the data couldn't be flushed; the file is then left as it is)
+*/
+bool PublishOutput(LPCTSTR lpTemp, LPCTSTR lpFinal, OutputDurability eDurability, bool bReplace)
+{
+	DWORD dwFlags = bReplace ? MOVEFILE_REPLACE_EXISTING : 0;
+	if (eDurability == DurabilityNone)
+		return MoveFileEx(lpTemp, lpFinal, dwFlags) != FALSE;
+
+	HANDLE hFile = CreateFile(lpTemp, GENERIC_WRITE | DELETE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	// Nothing is published unless its data made it to the disk
+	if (!FlushFileBuffers(hFile))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	bool bRet = RenameByHandle(hFile, lpFinal, bReplace);
+	DWORD dwError = GetLastError();
+	CloseHandle(hFile);
+	if (!bRet && !bReplace && ((dwError == ERROR_ALREADY_EXISTS) || (dwError == ERROR_FILE_EXISTS)))
+		return false;
+	if (!bRet)
+	{
+		// Renaming by handle isn't supported everywhere (some network file systems)
+		if (eDurability == DurabilityFull)
+			dwFlags |= MOVEFILE_WRITE_THROUGH;
+		if (!MoveFileEx(lpTemp, lpFinal, dwFlags))
+			return false;
+	}
+	if (eDurability == DurabilityFull)
+		FlushFolder(lpFinal);
+	return true;
+}
+
+/**
+	@param lpTemp The finished file
+	@param lpFinal Name to publish it as (replaced if it exists)
+	@return true if published successfully
+*/
+bool PublishOutput(LPCTSTR lpTemp, LPCTSTR lpFinal)
+{
+	return PublishOutput(lpTemp, lpFinal, GetOutputDurability());
+}
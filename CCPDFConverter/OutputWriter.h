@@ -0,0 +1,55 @@
+/**
+	@file
+	@brief Publishing finished output files with a selectable durability
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _OUTPUTWRITER_H_
+#define _OUTPUTWRITER_H_
+
+/**
+    @brief How much effort to make so a published file survives a power loss
+
+	Output is always written aside (as <file>.inprogress) and then renamed into place, so
+	readers never see a partial file; the durability mode decides what is flushed to disk
+	before and after the rename. Set with the output.durability setting (none, data, full).
+*/
+enum OutputDurability
+{
+	/// Just rename (the file system writes it back whenever it wants)
+	DurabilityNone,
+	/// Flush the file's data before renaming it
+	DurabilityData,
+	/// Flush the file, rename with write-through, and flush the folder entry too
+	DurabilityFull
+};
+
+/// Returns the configured durability mode
+OutputDurability GetOutputDurability();
+/// Renames a finished file into place
+bool PublishOutput(LPCTSTR lpTemp, LPCTSTR lpFinal, OutputDurability eDurability, bool bReplace = true);
+/// Renames a finished file into place with the configured durability
+bool PublishOutput(LPCTSTR lpTemp, LPCTSTR lpFinal);
+
+#endif   //#define _OUTPUTWRITER_H_
@@ -0,0 +1,456 @@
+/**
+	@file
+	@brief Appends documents to a combined document, as incremental updates
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfAppend.h"
+#include "PdfPipeline.h"
+#include <algorithm>
+#include <map>
+
+/// Start of the mutex names (the rest is the combined document's full path)
+#define APPEND_MUTEX			"CCPDFConverterAppend:"
+/// How long to wait for our turn, by default (milliseconds)
+#define DEFAULT_APPEND_TIMEOUT	60000
+/// How often to try for the file lock (milliseconds)
+#define LOCK_RETRY				100
+/// Where the lock byte is (high half of the offset): far past the end of any document
+#define LOCK_OFFSET_HIGH		0x7FFFFFFF
+/// Data buffered before it's written
+#define WRITE_BLOCK				(256 * 1024)
+
+/// Page tree node keys the kids inherit
+static const char* INHERITED_KEYS[] = {"Resources", "MediaBox", "CropBox", "Rotate"};
+
+/**
+	@param doc The document
+	@param nCatalog Receives the catalog's object number
+	@param nPages Receives the page count
+	@return The object number of the page tree root (0 if the document has no page tree)
+*/
+static int FindPageTree(PdfDocument& doc, int& nCatalog, __int64& nPages)
+{
+	const PdfObject* pRoot = doc.GetTrailer().Get("Root");
+	if ((pRoot == NULL) || !pRoot->Is(PdfObject::Reference))
+		return 0;
+	nCatalog = (int)pRoot->nValue;
+	const PdfObject* pCatalog = doc.GetObject(nCatalog);
+	const PdfObject* pTree = (pCatalog != NULL) ? pCatalog->Get("Pages") : NULL;
+	if ((pTree == NULL) || !pTree->Is(PdfObject::Reference))
+		return 0;
+	const PdfObject* pNode = doc.GetObject((int)pTree->nValue);
+	const PdfObject* pCount = (pNode != NULL) ? pNode->Get("Count") : NULL;
+	const PdfObject* pKids = (pNode != NULL) ? pNode->Get("Kids") : NULL;
+	if ((pCount == NULL) || !pCount->Is(PdfObject::Integer) || (pKids == NULL) || !pKids->Is(PdfObject::Array))
+		return 0;
+	nPages = pCount->nValue;
+	return (int)pTree->nValue;
+}
+
+/**
+*/
+PdfAppender::PdfAppender() : m_hMutex(NULL), m_hFile(NULL), m_bCreated(false), m_nSize(0)
+{
+}
+
+/**
+*/
+PdfAppender::~PdfAppender()
+{
+	Unlock();
+}
+
+/**
+	@param lpSource The converted document
+	@param lpTarget The combined document
+	@param result The job result
+	@return true if the document was appended (the combined document is unchanged if not)
+*/
+bool PdfAppender::Append(LPCTSTR lpSource, LPCTSTR lpTarget, JobResult& result)
+{
+	result["append.target"] = lpTarget;
+	LARGE_INTEGER liStart;
+	QueryPerformanceCounter(&liStart);
+	bool bLocked = Lock(lpTarget, (DWORD)myconfigdata.getint("append.timeout", DEFAULT_APPEND_TIMEOUT));
+	result.SetTime("time.append.wait", PdfPipeline::ElapsedSince(liStart));
+	if (!bLocked)
+	{
+		result["append.error"] = "lock";
+		return false;
+	}
+
+	QueryPerformanceCounter(&liStart);
+	unsigned __int64 nStart = m_nSize;
+	PdfDocument source;
+	int nCatalog = 0, nSourceTree = 0;
+	__int64 nPages = 0;
+	bool bRet = false;
+	if (!source.Load(lpSource) || (source.GetTrailer().Get("Encrypt") != NULL) || ((nSourceTree = FindPageTree(source, nCatalog, nPages)) == 0))
+		result["append.error"] = "source";
+	else if (m_nSize == 0)
+	{
+		// The first one
+		source.Close();
+		bRet = Copy(lpSource);
+	}
+	else
+	{
+		PdfDocument target;
+		if (!target.Load(lpTarget) || (target.GetTrailer().Get("Encrypt") != NULL))
+			result["append.error"] = "target";
+		else
+			bRet = Update(source, target, nSourceTree, nPages);
+	}
+	bRet = Flush() && bRet;
+	if (!bRet)
+	{
+		// Leave it as it was (a half-written update would hide the last good one)
+		if (!result.count("append.error"))
+			result["append.error"] = "write";
+		LARGE_INTEGER liPos;
+		liPos.QuadPart = nStart;
+		if (SetFilePointerEx(m_hFile, liPos, NULL, FILE_BEGIN))
+			SetEndOfFile(m_hFile);
+		if (m_bCreated)
+		{
+			// Not there before this job, so not there after it (removed when closed)
+			FILE_DISPOSITION_INFO info;
+			info.DeleteFile = TRUE;
+			SetFileInformationByHandle(m_hFile, FileDispositionInfo, &info, sizeof(info));
+		}
+	}
+	else
+		FlushFileBuffers(m_hFile);
+	Unlock();
+
+	if (bRet)
+	{
+		result.SetInt("append.pages", nPages);
+		result.SetInt("append.bytes", m_nSize - nStart);
+	}
+	result.SetTime("time.append", PdfPipeline::ElapsedSince(liStart));
+	return bRet;
+}
+
+/**
+	@param lpTarget The combined document (created if it's not there)
+	@param dwTimeout How long to wait (milliseconds)
+	@return true if it's ours (and open); false if it couldn't be had in time
+*/
+bool PdfAppender::Lock(LPCTSTR lpTarget, DWORD dwTimeout)
+{
+	// Named after the full path, in one case, since the same file can be named more than one way
+	TCHAR cFullPath[MAX_PATH];
+	if (!GetFullPathName(lpTarget, MAX_PATH, cFullPath, NULL))
+		return false;
+	std::string sMutex = APPEND_MUTEX;
+	for (const TCHAR* p = cFullPath; *p != '\0'; p++)
+		// (Backslashes have a meaning in object names)
+		sMutex += (*p == '\\') ? '/' : (char)toupper((unsigned char)*p);
+	m_hMutex = CreateMutex(NULL, FALSE, sMutex.c_str());
+	if (m_hMutex == NULL)
+		return false;
+	DWORD dwStart = GetTickCount();
+	DWORD dwWait = WaitForSingleObject(m_hMutex, dwTimeout);
+	if ((dwWait != WAIT_OBJECT_0) && (dwWait != WAIT_ABANDONED))
+	{
+		CloseHandle(m_hMutex);
+		m_hMutex = NULL;
+		return false;
+	}
+
+	// Converters on other computers only see the file: lock a byte of it
+	do
+	{
+		HANDLE hFile = CreateFile(lpTarget, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		m_bCreated = false;
+		if ((hFile == INVALID_HANDLE_VALUE) && (GetLastError() == ERROR_FILE_NOT_FOUND))
+		{
+			// The first job: the file is created (with DELETE access, so it can go again if the job fails);
+			// if another computer just did, it's opened again on the next round
+			hFile = CreateFile(lpTarget, GENERIC_READ | GENERIC_WRITE | DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+			m_bCreated = (hFile != INVALID_HANDLE_VALUE);
+			if (!m_bCreated && (GetLastError() == ERROR_FILE_EXISTS))
+				continue;
+		}
+		if (hFile != INVALID_HANDLE_VALUE)
+		{
+			OVERLAPPED ov;
+			memset(&ov, 0, sizeof(ov));
+			ov.OffsetHigh = LOCK_OFFSET_HIGH;
+			LARGE_INTEGER liSize;
+			if (LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &ov))
+			{
+				if (GetFileSizeEx(hFile, &liSize) && SetFilePointerEx(hFile, liSize, NULL, FILE_BEGIN))
+				{
+					m_hFile = hFile;
+					m_nSize = liSize.QuadPart;
+					return true;
+				}
+				UnlockFileEx(hFile, 0, 1, 0, &ov);
+			}
+			CloseHandle(hFile);
+		}
+		// Someone else's turn (or someone has it open, and won't share it)
+		Sleep(LOCK_RETRY);
+	} while (GetTickCount() - dwStart < dwTimeout);
+	Unlock();
+	return false;
+}
+
+/**
+*/
+void PdfAppender::Unlock()
+{
+	if (m_hFile != NULL)
+	{
+		OVERLAPPED ov;
+		memset(&ov, 0, sizeof(ov));
+		ov.OffsetHigh = LOCK_OFFSET_HIGH;
+		UnlockFileEx(m_hFile, 0, 1, 0, &ov);
+		CloseHandle(m_hFile);
+		m_hFile = NULL;
+	}
+	if (m_hMutex != NULL)
+	{
+		ReleaseMutex(m_hMutex);
+		CloseHandle(m_hMutex);
+		m_hMutex = NULL;
+	}
+}
+
+/**
+	@param lpSource The document to copy
+	@return true if it was copied
+*/
+bool PdfAppender::Copy(LPCTSTR lpSource)
+{
+	HANDLE hSource = CreateFile(lpSource, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hSource == INVALID_HANDLE_VALUE)
+		return false;
+	std::vector<char> block(WRITE_BLOCK);
+	DWORD dwRead;
+	bool bRet = true;
+	while (bRet && ReadFile(hSource, &block[0], WRITE_BLOCK, &dwRead, NULL) && (dwRead > 0))
+		bRet = Write(&block[0], dwRead);
+	CloseHandle(hSource);
+	return bRet;
+}
+
+/**
+	@param source The new document
+	@param target The combined document
+	@param nSourceTree Object number of the new document's page tree root
+	@param nSourcePages The new document's page count
+	@return true if the update was written
+*/
+bool PdfAppender::Update(PdfDocument& source, PdfDocument& target, int nSourceTree, __int64 nSourcePages)
+{
+	int nCatalog = 0, nTree = 0;
+	__int64 nPages = 0;
+	if ((nTree = FindPageTree(target, nCatalog, nPages)) == 0)
+		return false;
+
+	// What's appended: the new page tree, and all it uses (not the catalog, which nothing in
+	// the tree refers to)
+	m_renumber.assign(source.GetObjectCount(), 0);
+	std::vector<int> objects;
+	std::vector<int> stack(1, nSourceTree);
+	while (!stack.empty())
+	{
+		int nNum = stack.back();
+		stack.pop_back();
+		if (!source.IsObject(nNum) || (m_renumber[nNum] != 0))
+			continue;
+		m_renumber[nNum] = -1;
+		objects.push_back(nNum);
+		PdfObject object;
+		PdfData data;
+		if (source.ReadObject(nNum, object, &data))
+			object.CollectReferences(stack, true);
+	}
+	std::sort(objects.begin(), objects.end());
+	int nNext = target.GetObjectCount();
+	for (std::vector<int>::const_iterator i = objects.begin(); i != objects.end(); i++)
+		m_renumber[*i] = nNext++;
+
+	// The new pages go under the root of the page tree, unless it has something its kids
+	// inherit: then a new root takes the old one and the new pages (after that, it's the
+	// new root the pages go under)
+	PdfObject catalog = *target.GetObject(nCatalog);
+	PdfObject tree = *target.GetObject(nTree);
+	int nParent = nTree;
+	for (int i = 0; i < (int)(sizeof(INHERITED_KEYS) / sizeof(char*)); i++)
+		if (tree.Get(INHERITED_KEYS[i]) != NULL)
+			nParent = nNext;
+	if (nParent != nTree)
+		nNext++;
+
+	// Written: the new objects, then what changed
+	std::map<int, std::pair<unsigned __int64, int> > entries;
+	// (The file may not end with a line break)
+	if (!Write("\n"))
+		return false;
+	for (std::vector<int>::const_iterator i = objects.begin(); i != objects.end(); i++)
+	{
+		PdfObject object;
+		PdfData data;
+		if (!source.ReadObject(*i, object, &data))
+			return false;
+		object.Renumber(m_renumber);
+		if (*i == nSourceTree)
+			object.Set("Parent", PdfObject::MakeReference(nParent));
+		entries[m_renumber[*i]] = std::pair<unsigned __int64, int>(m_nSize, 0);
+		if (!WriteObject(m_renumber[*i], 0, object, object.Is(PdfObject::Stream) ? &data : NULL))
+			return false;
+	}
+
+	PdfObject* pKids = tree.Get("Kids");
+	if (nParent == nTree)
+	{
+		pKids->items.push_back(PdfObject::MakeReference(m_renumber[nSourceTree]));
+		tree.Set("Count", PdfObject::MakeInteger(nPages + nSourcePages));
+	}
+	else
+	{
+		PdfObject root = PdfObject::MakeDictionary();
+		root.Set("Type", PdfObject::MakeName("Pages"));
+		PdfObject kids = PdfObject::MakeArray();
+		kids.items.push_back(PdfObject::MakeReference(nTree, target.GetGeneration(nTree)));
+		kids.items.push_back(PdfObject::MakeReference(m_renumber[nSourceTree]));
+		root.Set("Kids", kids);
+		root.Set("Count", PdfObject::MakeInteger(nPages + nSourcePages));
+		tree.Set("Parent", PdfObject::MakeReference(nParent));
+		catalog.Set("Pages", PdfObject::MakeReference(nParent));
+		entries[nParent] = std::pair<unsigned __int64, int>(m_nSize, 0);
+		if (!WriteObject(nParent, 0, root, NULL))
+			return false;
+	}
+	entries[nTree] = std::pair<unsigned __int64, int>(m_nSize, target.GetGeneration(nTree));
+	if (!WriteObject(nTree, target.GetGeneration(nTree), tree, NULL))
+		return false;
+
+	// The catalog is written every time, so it's always in the newest section (readers
+	// follow only so many); and it says if the new document needs a later version
+	std::string sVersion = target.GetVersion();
+	const PdfObject* pVersion = catalog.Get("Version");
+	if ((pVersion != NULL) && pVersion->Is(PdfObject::Name) && (pVersion->sValue > sVersion))
+		sVersion = pVersion->sValue;
+	if (source.GetVersion() > sVersion)
+		catalog.Set("Version", PdfObject::MakeName(source.GetVersion()));
+	entries[nCatalog] = std::pair<unsigned __int64, int>(m_nSize, target.GetGeneration(nCatalog));
+	if (!WriteObject(nCatalog, target.GetGeneration(nCatalog), catalog, NULL))
+		return false;
+
+	// The new cross-reference section: a subsection for each run of numbers
+	unsigned __int64 nXref = m_nSize;
+	std::string sXref = "xref\n";
+	std::map<int, std::pair<unsigned __int64, int> >::const_iterator iEntry = entries.begin();
+	while (iEntry != entries.end())
+	{
+		std::map<int, std::pair<unsigned __int64, int> >::const_iterator iEnd = iEntry;
+		int nCount = 0;
+		while ((iEnd != entries.end()) && ((*iEnd).first == (*iEntry).first + nCount))
+		{
+			iEnd++;
+			nCount++;
+		}
+		sXref += PdfObject::FormatInteger((*iEntry).first) + " " + PdfObject::FormatInteger(nCount) + "\n";
+		for (; iEntry != iEnd; iEntry++)
+			sXref += PdfObject::FormatInteger((*iEntry).second.first, 10) + " " + PdfObject::FormatInteger((*iEntry).second.second, 5) + " n\r\n";
+	}
+
+	PdfObject trailer = target.GetTrailer();
+	trailer.Remove("XRefStm");
+	trailer.Set("Size", PdfObject::MakeInteger(nNext));
+	trailer.Set("Prev", PdfObject::MakeInteger(target.GetXrefOffset()));
+	sXref += "trailer\n";
+	trailer.Write(sXref);
+	return Write(sXref + "\nstartxref\n" + PdfObject::FormatInteger(nXref) + "\n%%EOF\n");
+}
+
+/**
+	@param nNum The object number
+	@param nGen The generation number
+	@param object The object (a stream's dictionary, for streams)
+	@param pStreamData The stream data (NULL if it's not a stream)
+	@return true if it was written (or buffered)
+*/
+bool PdfAppender::WriteObject(int nNum, int nGen, const PdfObject& object, const PdfData* pStreamData)
+{
+	std::string sObject = PdfObject::FormatInteger(nNum) + " " + PdfObject::FormatInteger(nGen) + " obj\n";
+	if (pStreamData == NULL)
+	{
+		object.Write(sObject);
+		return Write(sObject + "\nendobj\n");
+	}
+	PdfObject dict = object;
+	dict.eType = PdfObject::Dictionary;
+	dict.Set("Length", PdfObject::MakeInteger(pStreamData->size()));
+	dict.Write(sObject);
+	return Write(sObject + "\nstream\n") && Write(pStreamData->data(), pStreamData->size()) && Write("\nendstream\nendobj\n");
+}
+
+/**
+	@param pData The data
+	@param nLen Size of the data
+	@return true if it was written (or buffered)
+*/
+bool PdfAppender::Write(const char* pData, size_t nLen)
+{
+	m_nSize += nLen;
+	if (m_sBuffer.size() + nLen < WRITE_BLOCK)
+	{
+		m_sBuffer.append(pData, nLen);
+		return true;
+	}
+	if (!Flush())
+		return false;
+	// Large data goes straight to the file
+	while (nLen > 0)
+	{
+		DWORD dwChunk = (DWORD)min(nLen, (size_t)WRITE_BLOCK), dwWritten;
+		if (!WriteFile(m_hFile, pData, dwChunk, &dwWritten, NULL) || (dwWritten != dwChunk))
+			return false;
+		pData += dwChunk;
+		nLen -= dwChunk;
+	}
+	return true;
+}
+
+/**
+	@return true if everything buffered was written
+*/
+bool PdfAppender::Flush()
+{
+	if (m_sBuffer.empty())
+		return true;
+	DWORD dwWritten;
+	bool bRet = WriteFile(m_hFile, m_sBuffer.data(), (DWORD)m_sBuffer.size(), &dwWritten, NULL) && (dwWritten == m_sBuffer.size());
+	m_sBuffer.clear();
+	return bRet;
+}
+
@@ -0,0 +1,102 @@
+/**
+	@file
+	@brief Appends documents to a combined document, as incremental updates
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PDFAPPEND_H_
+#define _PDFAPPEND_H_
+
+#include "PdfDocument.h"
+#include "JobResult.h"
+
+/**
+    @brief Adds a converted document's pages to the end of a combined document
+
+	The combined document is never rewritten: the new pages, and the page tree nodes that
+	change, are added after the existing bytes as an incremental update, with a
+	cross-reference section of their own. So appending costs what the new document costs,
+	however large the combined one gets. The first document appended becomes the combined
+	document as it is. The combined document is created by the first job, and removed
+	again if that job fails, so a failed job never leaves an empty document behind.
+
+	Converters appending to the same document take turns: a mutex named after the file
+	serializes the ones on this computer, and a lock on the file itself (a byte past its
+	end, so readers aren't bothered) the ones on others sharing the folder. A converter
+	waits up to append.timeout milliseconds (default 60000) for its turn.
+
+	Only the pages are appended (with what they use), not the new document's bookmarks or
+	document information. Both documents need classic cross-reference tables (as written
+	by GhostScript), and neither can be encrypted. The job result gets append.target, append.pages,
+	append.bytes, time.append.wait and time.append (or append.error if it failed).
+*/
+class PdfAppender
+{
+public:
+	/// Ctor
+	PdfAppender();
+	/// Dtor
+	virtual ~PdfAppender();
+
+	/// Appends a document to a combined document (which is created if needed)
+	bool				Append(LPCTSTR lpSource, LPCTSTR lpTarget, JobResult& result);
+
+protected:
+	/// Waits for the combined document to be ours
+	bool				Lock(LPCTSTR lpTarget, DWORD dwTimeout);
+	/// Lets others have the combined document
+	void				Unlock();
+	/// Writes the first document (the combined document is empty)
+	bool				Copy(LPCTSTR lpSource);
+	/// Writes the new document as an update of the combined document
+	bool				Update(PdfDocument& source, PdfDocument& target, int nSourceTree, __int64 nSourcePages);
+	/// Writes an indirect object at the end of the combined document
+	bool				WriteObject(int nNum, int nGen, const PdfObject& object, const PdfData* pStreamData);
+	/**
+		@brief Writes data at the end of the combined document
+		@param sData The data
+		@return true if it was written (or buffered)
+	*/
+	bool				Write(const std::string& sData) {return Write(sData.data(), sData.size());};
+	/// Writes data at the end of the combined document
+	bool				Write(const char* pData, size_t nLen);
+	/// Writes what's buffered
+	bool				Flush();
+
+protected:
+	/// Mutex serializing appends on this computer (NULL if not ours)
+	HANDLE				m_hMutex;
+	/// The combined document (locked), or NULL
+	HANDLE				m_hFile;
+	/// true if this job created the combined document
+	bool				m_bCreated;
+	/// Size of the combined document, with what's buffered (where the next byte goes)
+	unsigned __int64	m_nSize;
+	/// Data not written yet
+	std::string			m_sBuffer;
+	/// New numbers of the source objects, by old number (0 if not appended)
+	std::vector<int>	m_renumber;
+};
+
+#endif   //#define _PDFAPPEND_H_
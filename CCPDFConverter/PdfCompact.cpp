@@ -0,0 +1,499 @@
+/**
+	@file
+	@brief Post-processing stage writing the document compacted (object and cross-reference streams)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfCompact.h"
+#include "ZlibApi.h"
+#include <map>
+
+/// Objects per object stream
+#define OBJSTM_SIZE			100
+/// Most streams compressed at a time
+#define BATCH_STREAMS		64
+/// Most stream data compressed at a time
+#define BATCH_BYTES			(32 * 1024 * 1024)
+/// Most object streams built at a time
+#define BATCH_OBJSTMS		16
+/// Most worker threads
+#define MAX_THREADS			16
+/// Default memory all the worker threads may use for decompressed streams and their compressed copies (MB)
+#define DEFAULT_MEMORY		256
+
+/**
+	@param pData The data to hash
+	@param nLen Size of the data
+	@param nHash Hash so far
+	@return The FNV-1a hash
+*/
+static unsigned __int64 HashData(const char* pData, size_t nLen, unsigned __int64 nHash = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < nLen; i++)
+		nHash = (nHash ^ (unsigned char)pData[i]) * 1099511628211ULL;
+	return nHash;
+}
+
+/**
+	@param hThread The thread
+	@return Processor time the thread took (100 ns units)
+*/
+static unsigned __int64 GetThreadTime(HANDLE hThread)
+{
+	FILETIME ftCreate, ftExit, ftKernel, ftUser;
+	if (!GetThreadTimes(hThread, &ftCreate, &ftExit, &ftKernel, &ftUser))
+		return 0;
+	return (((unsigned __int64)ftKernel.dwHighDateTime << 32) | ftKernel.dwLowDateTime) + (((unsigned __int64)ftUser.dwHighDateTime << 32) | ftUser.dwLowDateTime);
+}
+
+/**
+	@param object The object to check
+	@return true if the object must stay separate even if another one is identical: pages and
+	page tree nodes, annotations (a viewer tells them apart by their object), form fields and
+	structure elements (whose parents list them one by one)
+*/
+static bool IsUnique(const PdfObject& object)
+{
+	if ((object.Get("Parent") != NULL) || (object.Get("P") != NULL))
+		return true;
+	const PdfObject* pType = object.Get("Type");
+	if ((pType != NULL) && pType->Is(PdfObject::Name) &&
+		((pType->sValue == "Page") || (pType->sValue == "Pages") || (pType->sValue == "Annot") || (pType->sValue == "StructElem")))
+		return true;
+	// (Type is optional in annotations)
+	const PdfObject* pSubtype = object.Get("Subtype");
+	return (pSubtype != NULL) && pSubtype->Is(PdfObject::Name) && (pSubtype->sValue == "Widget");
+}
+
+/**
+	@param object The stream dictionary
+	@return true if the stream's only filter is Flate
+*/
+static bool IsFlate(const PdfObject& object)
+{
+	const PdfObject* pFilter = object.Get("Filter");
+	if ((pFilter != NULL) && pFilter->Is(PdfObject::Array) && (pFilter->items.size() == 1))
+		pFilter = &pFilter->items[0];
+	return (pFilter != NULL) && pFilter->Is(PdfObject::Name) && (pFilter->sValue == "FlateDecode");
+}
+
+/**
+*/
+CompactStage::CompactStage() : m_nFirstObjStm(0), m_nSize(0), m_nDuplicates(0), m_nPages(0), m_nLevel(9), m_nThreads(1), m_nMaxInflated(0), m_nNextJob(0), m_nWorkerTime(0), m_nStartTime(0)
+{
+}
+
+/**
+	@param doc The document
+	@param result The job result (not used)
+	@return true if the document can be compacted
+*/
+bool CompactStage::Process(PdfDocument& doc, JobResult& /*result*/)
+{
+	m_nStartTime = GetThreadTime(GetCurrentThread());
+	PdfObject* pRoot = doc.GetTrailer().Get("Root");
+	if ((doc.GetTrailer().Get("Encrypt") != NULL) || (pRoot == NULL) || !pRoot->Is(PdfObject::Reference) || !zlib.Load())
+		return false;
+	m_nLevel = max(1, min(9, (int)myconfigdata.getint("compact.level", 9)));
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	m_nThreads = max(1, min(MAX_THREADS, (int)myconfigdata.getint("compact.threads", (long)si.dwNumberOfProcessors)));
+	// Each thread gets its share of the memory, half of it for the decompressed data (and half for compressing it again)
+	m_nMaxInflated = (size_t)max(1L, myconfigdata.getint("compact.memory", DEFAULT_MEMORY)) * 1024 * 1024 / m_nThreads / 2;
+
+	// What refers to what (without keeping the objects)
+	size_t nCount = doc.GetObjectCount();
+	std::vector<std::vector<int> > refs(nCount);
+	for (size_t i = 1; i < nCount; i++)
+	{
+		PdfObject object;
+		PdfData data;
+		if (doc.ReadObject((int)i, object, &data))
+			object.CollectReferences(refs[i], true);
+	}
+
+	// Only what the document uses is kept
+	std::vector<bool> used(nCount, false);
+	std::vector<int> stack;
+	doc.GetTrailer().CollectReferences(stack, false);
+	while (!stack.empty())
+	{
+		int nNum = stack.back();
+		stack.pop_back();
+		if ((nNum <= 0) || ((size_t)nNum >= nCount) || used[nNum] || !doc.IsObject(nNum))
+			continue;
+		used[nNum] = true;
+		stack.insert(stack.end(), refs[nNum].begin(), refs[nNum].end());
+	}
+	std::vector<std::vector<int> >().swap(refs);
+
+	// New numbers; an object identical to one before it gets that one's number
+	std::map<unsigned __int64, int> twins;
+	m_renumber.assign(nCount, 0);
+	m_streams.clear();
+	m_objects.clear();
+	m_nDuplicates = 0;
+	int nNum = 1;
+	for (size_t i = 1; i < nCount; i++)
+	{
+		if (!used[i])
+			continue;
+		PdfObject object;
+		PdfData data;
+		doc.ReadObject((int)i, object, &data);
+		if (!IsUnique(object))
+		{
+			std::string sObject;
+			object.Write(sObject);
+			unsigned __int64 nHash = HashData(data.data(), data.size(), HashData(sObject.data(), sObject.size()));
+			std::map<unsigned __int64, int>::const_iterator iTwin = twins.find(nHash);
+			if (iTwin == twins.end())
+				twins[nHash] = (int)i;
+			else
+			{
+				// Same hash: make sure it's really the same
+				PdfObject twin;
+				PdfData twinData;
+				doc.ReadObject((*iTwin).second, twin, &twinData);
+				std::string sTwin;
+				twin.Write(sTwin);
+				if ((sTwin == sObject) && (twinData.size() == data.size()) && (memcmp(twinData.data(), data.data(), data.size()) == 0))
+				{
+					m_renumber[i] = m_renumber[(*iTwin).second];
+					m_nDuplicates++;
+					continue;
+				}
+			}
+		}
+		m_renumber[i] = nNum++;
+		if (object.Is(PdfObject::Stream))
+			m_streams.push_back((int)i);
+		else
+			m_objects.push_back((int)i);
+	}
+	m_nFirstObjStm = nNum;
+	m_nSize = nNum + (int)((m_objects.size() + OBJSTM_SIZE - 1) / OBJSTM_SIZE) + 1;
+
+	// For the processor time per page
+	PdfObject catalog, pages;
+	const PdfObject* pPages;
+	const PdfObject* pCount;
+	m_nPages = 0;
+	if (doc.ReadObject((int)pRoot->nValue, catalog) && ((pPages = catalog.Get("Pages")) != NULL) && pPages->Is(PdfObject::Reference) &&
+		doc.ReadObject((int)pPages->nValue, pages) && ((pCount = pages.Get("Count")) != NULL) && pCount->Is(PdfObject::Integer))
+		m_nPages = pCount->nValue;
+	return true;
+}
+
+/**
+	@param doc The document
+	@param pFile The file to write
+	@param result The job result (gets the savings and the processor time)
+	@return true if the file was written
+*/
+bool CompactStage::Save(PdfDocument& doc, const char* pFile, JobResult& result)
+{
+	PdfOutput out;
+	if ((m_nSize == 0) || !out.Open(pFile))
+		return false;
+	m_types.assign(m_nSize, 0);
+	m_field2.assign(m_nSize, 0);
+	m_field3.assign(m_nSize, 0);
+
+	// Object and cross-reference streams need PDF 1.5
+	if (doc.GetVersion() < "1.5")
+		doc.SetVersion("1.5");
+	out.Write(doc.GetHeader());
+	bool bRet = WriteStreams(doc, out);
+	WriteObjectStreams(doc, out);
+	WriteXref(doc, out);
+	bRet = out.Close() && bRet;
+
+	result.SetInt("postprocess.compact.saved", (__int64)doc.GetFileSize() - (__int64)out.GetOffset());
+	result.SetInt("postprocess.compact.packed", m_objects.size());
+	result.SetInt("postprocess.compact.duplicates", m_nDuplicates);
+	double dCpu = (GetThreadTime(GetCurrentThread()) - m_nStartTime + m_nWorkerTime) / 10000.0;
+	result.SetTime("time.postprocess.compact.cpu", dCpu);
+	if (m_nPages > 0)
+		result.SetTime("time.postprocess.compact.cpu.page", dCpu / m_nPages);
+	return bRet;
+}
+
+/**
+	@param nNum The object number
+	@param cType Entry type (0: free, 1: in the file, 2: in an object stream)
+	@param nField2 Offset in the file, or object stream number
+	@param nField3 Generation, or index in the object stream
+*/
+void CompactStage::SetEntry(int nNum, unsigned char cType, size_t nField2, int nField3)
+{
+	m_types[nNum] = cType;
+	m_field2[nNum] = nField2;
+	m_field3[nNum] = nField3;
+}
+
+/**
+	@param job The job to do
+*/
+void CompactStage::RunJob(Job& job) const
+{
+	const char* pData = job.input.data();
+	size_t nLen = job.input.size();
+	std::string sPlain;
+	if (job.bInflate)
+	{
+		// Streams too large for this thread's share of the memory are left as they are
+		if (!zlib.Decompress(pData, nLen, job.nSize, m_nMaxInflated, sPlain))
+			return;
+		pData = sPlain.data();
+		nLen = sPlain.size();
+	}
+	// Only worth it if it's smaller than what we had
+	job.bDone = zlib.Compress(pData, nLen, m_nLevel, job.sOutput) && (job.sOutput.size() < job.input.size());
+	if (!job.bDone)
+		job.sOutput.clear();
+}
+
+/**
+	@param pParam The stage
+	@return 0
+*/
+DWORD WINAPI CompactStage::WorkerThread(LPVOID pParam)
+{
+	CompactStage* pStage = (CompactStage*)pParam;
+	LONG nJob;
+	while ((nJob = InterlockedIncrement(&pStage->m_nNextJob) - 1) < (LONG)pStage->m_jobs.size())
+		pStage->RunJob(pStage->m_jobs[nJob]);
+	return 0;
+}
+
+/**
+	The jobs only touch their own data (and zlib), so they can run in any order
+*/
+void CompactStage::RunJobs()
+{
+	m_nNextJob = 0;
+	std::vector<HANDLE> threads;
+	for (int i = 0; (i < m_nThreads) && (i < (int)m_jobs.size()) && (m_jobs.size() > 1); i++)
+	{
+		HANDLE hThread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+		if (hThread != NULL)
+			threads.push_back(hThread);
+	}
+	if (threads.empty())
+	{
+		// One job, or no threads: do it here
+		WorkerThread(this);
+		return;
+	}
+	WaitForMultipleObjects((DWORD)threads.size(), &threads[0], TRUE, INFINITE);
+	for (std::vector<HANDLE>::iterator i = threads.begin(); i != threads.end(); i++)
+	{
+		m_nWorkerTime += GetThreadTime(*i);
+		CloseHandle(*i);
+	}
+}
+
+/**
+	@param doc The document
+	@param out Where to write
+	@return true if all the streams were written
+*/
+bool CompactStage::WriteStreams(PdfDocument& doc, PdfOutput& out)
+{
+	size_t nNext = 0;
+	while (nNext < m_streams.size())
+	{
+		// A batch: read the streams (the data stays where it is), and compress them all at once
+		std::vector<PdfObject> dicts;
+		std::vector<PdfData> data;
+		std::vector<int> jobs;
+		m_jobs.clear();
+		size_t nBytes = 0;
+		for (; (nNext < m_streams.size()) && (dicts.size() < BATCH_STREAMS) && (nBytes < BATCH_BYTES); nNext++)
+		{
+			dicts.push_back(PdfObject());
+			data.push_back(PdfData());
+			if (!doc.ReadObject(m_streams[nNext], dicts.back(), &data.back()) || !dicts.back().Is(PdfObject::Stream))
+				return false;
+			jobs.push_back(-1);
+			if (IsFlate(dicts.back()))
+			{
+				jobs.back() = (int)m_jobs.size();
+				m_jobs.push_back(Job());
+				m_jobs.back().input = data.back();
+				m_jobs.back().bInflate = true;
+				const PdfObject* pSize = dicts.back().Get("DL");
+				if ((pSize != NULL) && pSize->Is(PdfObject::Integer) && (pSize->nValue > 0))
+					m_jobs.back().nSize = (size_t)min((unsigned __int64)pSize->nValue, (unsigned __int64)(size_t)-1);
+				nBytes += data.back().size();
+			}
+		}
+		RunJobs();
+
+		size_t nFirst = nNext - dicts.size();
+		for (size_t i = 0; i < dicts.size(); i++)
+		{
+			int nNum = m_renumber[m_streams[nFirst + i]];
+			SetEntry(nNum, 1, out.GetOffset(), 0);
+			PdfObject& dict = dicts[i];
+			dict.Renumber(m_renumber);
+			dict.eType = PdfObject::Dictionary;
+			const PdfData& stream = ((jobs[i] >= 0) && m_jobs[jobs[i]].bDone) ? PdfData(m_jobs[jobs[i]].sOutput.data(), m_jobs[jobs[i]].sOutput.size()) : data[i];
+			dict.Set("Length", PdfObject::MakeInteger(stream.size()));
+			std::string sObject = PdfObject::FormatInteger(nNum) + " 0 obj\n";
+			dict.Write(sObject);
+			sObject += "\nstream\n";
+			out.Write(sObject);
+			out.Write(stream.data(), stream.size());
+			out.Write("\nendstream\nendobj\n");
+		}
+	}
+	m_jobs.clear();
+	return true;
+}
+
+/**
+	@param doc The document
+	@param out Where to write
+*/
+void CompactStage::WriteObjectStreams(PdfDocument& doc, PdfOutput& out)
+{
+	size_t nNext = 0;
+	while (nNext < m_objects.size())
+	{
+		// A batch of object streams, built here and compressed all at once
+		std::vector<std::string> contents;
+		std::vector<std::pair<int, size_t> > sizes;
+		m_jobs.clear();
+		for (; (nNext < m_objects.size()) && (contents.size() < BATCH_OBJSTMS); nNext += OBJSTM_SIZE)
+		{
+			int nStream = m_nFirstObjStm + (int)(nNext / OBJSTM_SIZE);
+			std::string sOffsets, sObjects;
+			int nObjects = 0;
+			for (size_t i = nNext; (i < m_objects.size()) && (i < nNext + OBJSTM_SIZE); i++, nObjects++)
+			{
+				PdfObject object;
+				doc.ReadObject(m_objects[i], object);
+				object.Renumber(m_renumber);
+				int nNum = m_renumber[m_objects[i]];
+				sOffsets += PdfObject::FormatInteger(nNum) + " " + PdfObject::FormatInteger(sObjects.size()) + " ";
+				object.Write(sObjects);
+				sObjects += '\n';
+				SetEntry(nNum, 2, nStream, nObjects);
+			}
+			sizes.push_back(std::pair<int, size_t>(nObjects, sOffsets.size()));
+			contents.push_back(sOffsets + sObjects);
+		}
+		for (size_t i = 0; i < contents.size(); i++)
+		{
+			m_jobs.push_back(Job());
+			m_jobs.back().input = PdfData(contents[i].data(), contents[i].size());
+		}
+		RunJobs();
+
+		for (size_t i = 0; i < contents.size(); i++)
+		{
+			int nNum = m_nFirstObjStm + (int)((nNext - OBJSTM_SIZE * contents.size()) / OBJSTM_SIZE + i);
+			SetEntry(nNum, 1, out.GetOffset(), 0);
+			PdfObject stream = PdfObject::MakeDictionary();
+			stream.eType = PdfObject::Stream;
+			stream.Set("Type", PdfObject::MakeName("ObjStm"));
+			stream.Set("N", PdfObject::MakeInteger(sizes[i].first));
+			stream.Set("First", PdfObject::MakeInteger(sizes[i].second));
+			if (m_jobs[i].bDone)
+			{
+				stream.Set("Filter", PdfObject::MakeName("FlateDecode"));
+				stream.sValue.swap(m_jobs[i].sOutput);
+			}
+			else
+				stream.sValue.swap(contents[i]);
+			std::string sObject = PdfObject::FormatInteger(nNum) + " 0 obj\n";
+			stream.Write(sObject);
+			sObject += "\nendobj\n";
+			out.Write(sObject);
+		}
+	}
+	m_jobs.clear();
+}
+
+/**
+	@param doc The document (for the trailer)
+	@param out Where to write
+*/
+void CompactStage::WriteXref(PdfDocument& doc, PdfOutput& out)
+{
+	int nXref = m_nSize - 1;
+	size_t nOffset = out.GetOffset();
+	SetEntry(0, 0, 0, 65535);
+	SetEntry(nXref, 1, nOffset, 0);
+
+	// Field widths: 1 byte for the type, what the largest offset needs, 2 bytes for the rest
+	size_t nLargest = 0;
+	for (std::vector<size_t>::const_iterator i = m_field2.begin(); i != m_field2.end(); i++)
+		nLargest = max(nLargest, *i);
+	int nWidth = 1;
+	while ((nWidth < (int)sizeof(size_t)) && ((nLargest >> (8 * nWidth)) > 0))
+		nWidth++;
+	std::string sRows;
+	for (int i = 0; i < m_nSize; i++)
+	{
+		sRows += (char)m_types[i];
+		for (int j = nWidth - 1; j >= 0; j--)
+			sRows += (char)((m_field2[i] >> (8 * j)) & 0xFF);
+		sRows += (char)((m_field3[i] >> 8) & 0xFF);
+		sRows += (char)(m_field3[i] & 0xFF);
+	}
+
+	PdfObject xref = PdfObject::MakeDictionary();
+	xref.eType = PdfObject::Stream;
+	xref.Set("Type", PdfObject::MakeName("XRef"));
+	xref.Set("Size", PdfObject::MakeInteger(m_nSize));
+	PdfObject widths = PdfObject::MakeArray();
+	widths.items.push_back(PdfObject::MakeInteger(1));
+	widths.items.push_back(PdfObject::MakeInteger(nWidth));
+	widths.items.push_back(PdfObject::MakeInteger(2));
+	xref.Set("W", widths);
+	static const char* TRAILER_KEYS[] = {"Root", "Info", "ID"};
+	for (int i = 0; i < (int)(sizeof(TRAILER_KEYS) / sizeof(char*)); i++)
+	{
+		PdfObject* pValue = doc.GetTrailer().Get(TRAILER_KEYS[i]);
+		if (pValue == NULL)
+			continue;
+		PdfObject value = *pValue;
+		value.Renumber(m_renumber);
+		if (!value.Is(PdfObject::Null))
+			xref.Set(TRAILER_KEYS[i], value);
+	}
+	if (zlib.Compress(sRows.data(), sRows.size(), m_nLevel, xref.sValue))
+		xref.Set("Filter", PdfObject::MakeName("FlateDecode"));
+	else
+		xref.sValue = sRows;
+
+	std::string sObject = PdfObject::FormatInteger(nXref) + " 0 obj\n";
+	xref.Write(sObject);
+	sObject += "\nendobj\nstartxref\n" + PdfObject::FormatInteger(nOffset) + "\n%%EOF\n";
+	out.Write(sObject);
+}
@@ -0,0 +1,144 @@
+/**
+	@file
+	@brief Post-processing stage writing the document compacted (object and cross-reference streams)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PDFCOMPACT_H_
+#define _PDFCOMPACT_H_
+
+#include "PdfPipeline.h"
+
+/**
+    @brief Writes the document in the compact PDF 1.5 form
+
+	- Objects that aren't streams are packed, compressed, into object streams
+	- The cross-reference table becomes a (compressed) cross-reference stream
+	- Identical objects are written once, and objects nothing refers to are dropped; pages,
+	  page tree nodes, annotations, form fields and structure elements (anything with Parent
+	  or P) always stay separate objects
+	- Flate streams are compressed again at compact.level (1-9, default 9), and kept if
+	  that makes them smaller; this is done by compact.threads threads (default: one
+	  per processor), which share compact.memory MB (default 256) for the data: streams
+	  that don't fit in a thread's share are left as they are
+
+	Compression uses zlib1.dll; without it the stage fails, and the document is left as
+	it was. The job result gets postprocess.compact.saved (bytes), postprocess.compact.packed
+	and postprocess.compact.duplicates (objects), and the processor time the stage took,
+	in all threads: time.postprocess.compact.cpu, and time.postprocess.compact.cpu.page
+	per page.
+*/
+class CompactStage : public PdfStage
+{
+public:
+	/// Ctor
+	CompactStage();
+
+	/**
+		@brief Returns the stage name
+		@return "compact"
+	*/
+	virtual const char*	GetName() const {return "compact";};
+	/// Plans the new layout
+	virtual bool		Process(PdfDocument& doc, JobResult& result);
+	/**
+		@brief Checks if the stage writes the document itself
+		@return true
+	*/
+	virtual bool		WritesDocument() const {return true;};
+	/// Writes the document, compacted
+	virtual bool		Save(PdfDocument& doc, const char* pFile, JobResult& result);
+
+protected:
+	/// A compression job, for the worker threads
+	struct Job
+	{
+		/// Ctor
+		Job() : bInflate(false), nSize(0), bDone(false) {};
+
+		/// The data to compress
+		PdfData			input;
+		/// true if the data is Flate compressed already (and has to be decompressed first)
+		bool			bInflate;
+		/// Decompressed size, if the stream gives it (/DL; 0 if not)
+		size_t			nSize;
+		/// The compressed data
+		std::string		sOutput;
+		/// true if the data was compressed (and is smaller)
+		bool			bDone;
+	};
+
+	/// Runs the jobs on the worker threads
+	void				RunJobs();
+	/// Runs a job
+	void				RunJob(Job& job) const;
+	/// Worker thread
+	static DWORD WINAPI	WorkerThread(LPVOID pParam);
+	/// Writes the stream objects
+	bool				WriteStreams(PdfDocument& doc, PdfOutput& out);
+	/// Writes the object streams
+	void				WriteObjectStreams(PdfDocument& doc, PdfOutput& out);
+	/// Writes the cross-reference stream, and the end of the file
+	void				WriteXref(PdfDocument& doc, PdfOutput& out);
+	/// Adds a cross-reference entry
+	void				SetEntry(int nNum, unsigned char cType, size_t nField2, int nField3);
+
+protected:
+	/// New object numbers, by old number (0 for dropped objects)
+	std::vector<int>	m_renumber;
+	/// Stream objects to write (old numbers)
+	std::vector<int>	m_streams;
+	/// Other objects to write (old numbers), packed into object streams
+	std::vector<int>	m_objects;
+	/// Number of the first object stream
+	int					m_nFirstObjStm;
+	/// Object count (the cross-reference stream's Size)
+	int					m_nSize;
+	/// Objects written once for more than one object number
+	int					m_nDuplicates;
+	/// Page count
+	__int64				m_nPages;
+	/// Compression level
+	int					m_nLevel;
+	/// Worker threads
+	int					m_nThreads;
+	/// Most memory a worker thread may use for a decompressed stream
+	size_t				m_nMaxInflated;
+	/// Compression jobs being done
+	std::vector<Job>	m_jobs;
+	/// Next job to do
+	volatile LONG		m_nNextJob;
+	/// Processor time of the worker threads (100 ns units)
+	unsigned __int64	m_nWorkerTime;
+	/// Processor time of this thread when the stage started (100 ns units)
+	unsigned __int64	m_nStartTime;
+	/// Cross-reference entry types, by new number
+	std::vector<unsigned char>	m_types;
+	/// Cross-reference entry second fields (offset, or object stream number)
+	std::vector<size_t>	m_field2;
+	/// Cross-reference entry third fields (generation, or index in the object stream)
+	std::vector<int>	m_field3;
+};
+
+#endif   //#define _PDFCOMPACT_H_
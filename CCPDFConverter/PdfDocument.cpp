@@ -0,0 +1,1125 @@
+/**
+	@file
+	@brief Minimal PDF object model: parsing, editing and writing documents
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfDocument.h"
+#include <stdio.h>
+#include <algorithm>
+#include <string.h>
+
+/// How far from the end of the file to look for startxref
+#define STARTXREF_SEARCH	1024
+/// How many older cross-reference tables (incremental updates) to follow
+#define MAX_XREF_SECTIONS	256
+
+/**
+	@param c The character to check
+	@return true if it's a PDF whitespace character
+*/
+inline bool IsWhite(char c)
+{
+	return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == '\f') || (c == '\0');
+}
+
+/**
+	@param c The character to check
+	@return true if it's a PDF delimiter character
+*/
+inline bool IsDelimiter(char c)
+{
+	return (c == '(') || (c == ')') || (c == '<') || (c == '>') || (c == '[') || (c == ']') || (c == '{') || (c == '}') || (c == '/') || (c == '%');
+}
+
+/**
+	@param sData The data
+	@param nPos Location to start at (updated to the first character that isn't whitespace or a comment)
+*/
+static void SkipWhite(const PdfData& sData, size_t& nPos)
+{
+	while (nPos < sData.size())
+	{
+		if (IsWhite(sData[nPos]))
+			nPos++;
+		else if (sData[nPos] == '%')
+		{
+			while ((nPos < sData.size()) && (sData[nPos] != '\n') && (sData[nPos] != '\r'))
+				nPos++;
+		}
+		else
+			break;
+	}
+}
+
+/**
+	@param sData The buffer
+	@param nPos Location of the token (updated to its end)
+	@return The token (the characters up to the next whitespace or delimiter)
+*/
+static std::string ReadToken(const PdfData& sData, size_t& nPos)
+{
+	SkipWhite(sData, nPos);
+	size_t nStart = nPos;
+	while ((nPos < sData.size()) && !IsWhite(sData[nPos]) && !IsDelimiter(sData[nPos]))
+		nPos++;
+	return sData.substr(nStart, nPos - nStart);
+}
+
+/**
+	@param sToken The token to convert
+	@param n Receives the number
+	@return true if the token is an integer
+*/
+static bool ToInteger(const std::string& sToken, __int64& n)
+{
+	size_t i = 0;
+	bool bNegative = false;
+	if ((i < sToken.size()) && ((sToken[i] == '+') || (sToken[i] == '-')))
+		bNegative = sToken[i++] == '-';
+	if (i == sToken.size())
+		return false;
+	n = 0;
+	for (; i < sToken.size(); i++)
+	{
+		if ((sToken[i] < '0') || (sToken[i] > '9'))
+			return false;
+		n = n * 10 + (sToken[i] - '0');
+	}
+	if (bNegative)
+		n = -n;
+	return true;
+}
+
+/**
+	@param n The number to format
+	@param nWidth Minimal width (padded with zeros)
+	@return The number as text
+*/
+std::string PdfObject::FormatInteger(__int64 n, int nWidth /* = 0 */)
+{
+	char cDigits[32];
+	int nLen = 0;
+	bool bNegative = n < 0;
+	unsigned __int64 u = bNegative ? (unsigned __int64)(-n) : (unsigned __int64)n;
+	do
+	{
+		cDigits[nLen++] = (char)('0' + (u % 10));
+		u /= 10;
+	} while (u > 0);
+	while (nLen < nWidth)
+		cDigits[nLen++] = '0';
+	std::string sRet;
+	if (bNegative)
+		sRet += '-';
+	while (nLen > 0)
+		sRet += cDigits[--nLen];
+	return sRet;
+}
+
+/**
+	@param n The number
+	@return The integer object
+*/
+PdfObject PdfObject::MakeInteger(__int64 n)
+{
+	PdfObject ret;
+	ret.eType = Integer;
+	ret.nValue = n;
+	return ret;
+}
+
+/**
+	@param sName The name (without the slash)
+	@return The name object
+*/
+PdfObject PdfObject::MakeName(const std::string& sName)
+{
+	PdfObject ret;
+	ret.eType = Name;
+	ret.sValue = sName;
+	return ret;
+}
+
+/**
+	@param sText The string's text
+	@return The string object
+*/
+PdfObject PdfObject::MakeString(const std::string& sText)
+{
+	PdfObject ret;
+	ret.eType = String;
+	for (std::string::const_iterator i = sText.begin(); i != sText.end(); i++)
+	{
+		switch (*i)
+		{
+			case '\\':
+			case '(':
+			case ')':
+				ret.sValue += '\\';
+				ret.sValue += *i;
+				break;
+			case '\r':
+				ret.sValue += "\\r";
+				break;
+			case '\n':
+				ret.sValue += "\\n";
+				break;
+			default:
+				ret.sValue += *i;
+				break;
+		}
+	}
+	return ret;
+}
+
+/**
+	@param sText The text (in the system code page)
+	@return The string object: a literal string if the text is plain ASCII (which
+	PDFDocEncoding shares), otherwise a UTF-16BE hex string
+*/
+PdfObject PdfObject::MakeTextString(const std::string& sText)
+{
+	std::string::const_iterator i = sText.begin();
+	while ((i != sText.end()) && ((unsigned char)*i < 0x80))
+		i++;
+	if (i == sText.end())
+		return MakeString(sText);
+
+	// Viewers know UTF-16BE by its byte order mark
+	int nLen = MultiByteToWideChar(CP_ACP, 0, sText.data(), (int)sText.size(), NULL, 0);
+	std::vector<wchar_t> text(max(nLen, 1));
+	nLen = MultiByteToWideChar(CP_ACP, 0, sText.data(), (int)sText.size(), &text[0], nLen);
+	PdfObject ret;
+	ret.eType = HexString;
+	ret.sValue = "FEFF";
+	char cHex[8];
+	for (int n = 0; n < nLen; n++)
+	{
+		sprintf_s(cHex, sizeof(cHex), "%04X", (unsigned)text[n]);
+		ret.sValue += cHex;
+	}
+	return ret;
+}
+
+/**
+	@param nNum The object number
+	@param nGen The object generation
+	@return The reference object
+*/
+PdfObject PdfObject::MakeReference(int nNum, int nGen /* = 0 */)
+{
+	PdfObject ret;
+	ret.eType = Reference;
+	ret.nValue = nNum;
+	ret.nGen = nGen;
+	return ret;
+}
+
+/**
+	@return An empty dictionary object
+*/
+PdfObject PdfObject::MakeDictionary()
+{
+	PdfObject ret;
+	ret.eType = Dictionary;
+	return ret;
+}
+
+/**
+	@return An empty array object
+*/
+PdfObject PdfObject::MakeArray()
+{
+	PdfObject ret;
+	ret.eType = Array;
+	return ret;
+}
+
+/**
+	@param sKey The key to look for (without the slash)
+	@return The value, or NULL if the key isn't in the dictionary
+*/
+const PdfObject* PdfObject::Get(const std::string& sKey) const
+{
+	for (std::vector<std::pair<std::string, PdfObject> >::const_iterator i = keys.begin(); i != keys.end(); i++)
+		if ((*i).first == sKey)
+			return &(*i).second;
+	return NULL;
+}
+
+/**
+	@param sKey The key to look for (without the slash)
+	@return The value, or NULL if the key isn't in the dictionary
+*/
+PdfObject* PdfObject::Get(const std::string& sKey)
+{
+	for (std::vector<std::pair<std::string, PdfObject> >::iterator i = keys.begin(); i != keys.end(); i++)
+		if ((*i).first == sKey)
+			return &(*i).second;
+	return NULL;
+}
+
+/**
+	@param sKey The key to set (without the slash)
+	@param value The value to set
+*/
+void PdfObject::Set(const std::string& sKey, const PdfObject& value)
+{
+	PdfObject* pValue = Get(sKey);
+	if (pValue != NULL)
+		*pValue = value;
+	else
+		keys.push_back(std::pair<std::string, PdfObject>(sKey, value));
+}
+
+/**
+	@param sKey The key to remove (without the slash)
+*/
+void PdfObject::Remove(const std::string& sKey)
+{
+	for (std::vector<std::pair<std::string, PdfObject> >::iterator i = keys.begin(); i != keys.end(); i++)
+		if ((*i).first == sKey)
+		{
+			keys.erase(i);
+			return;
+		}
+}
+
+/**
+	@param sOut Buffer to add the object to
+*/
+void PdfObject::Write(std::string& sOut) const
+{
+	switch (eType)
+	{
+		case Null:
+			sOut += "null";
+			break;
+		case Boolean:
+			sOut += (nValue != 0) ? "true" : "false";
+			break;
+		case Integer:
+			sOut += FormatInteger(nValue);
+			break;
+		case Real:
+			sOut += sValue;
+			break;
+		case String:
+			sOut += '(';
+			sOut += sValue;
+			sOut += ')';
+			break;
+		case HexString:
+			sOut += '<';
+			sOut += sValue;
+			sOut += '>';
+			break;
+		case Name:
+			sOut += '/';
+			sOut += sValue;
+			break;
+		case Array:
+			sOut += '[';
+			for (std::vector<PdfObject>::const_iterator i = items.begin(); i != items.end(); i++)
+			{
+				if (i != items.begin())
+					sOut += ' ';
+				(*i).Write(sOut);
+			}
+			sOut += ']';
+			break;
+		case Dictionary:
+		case Stream:
+			sOut += "<<";
+			for (std::vector<std::pair<std::string, PdfObject> >::const_iterator i = keys.begin(); i != keys.end(); i++)
+			{
+				sOut += '/';
+				sOut += (*i).first;
+				sOut += ' ';
+				// The stream length is always written as the actual data size
+				if ((eType == Stream) && ((*i).first == "Length"))
+					sOut += FormatInteger(sValue.size());
+				else
+					(*i).second.Write(sOut);
+			}
+			if ((eType == Stream) && (Get("Length") == NULL))
+			{
+				sOut += "/Length ";
+				sOut += FormatInteger(sValue.size());
+			}
+			sOut += ">>";
+			if (eType == Stream)
+			{
+				sOut += "\nstream\n";
+				sOut += sValue;
+				sOut += "\nendstream";
+			}
+			break;
+		case Reference:
+			sOut += FormatInteger(nValue);
+			sOut += ' ';
+			sOut += FormatInteger(nGen);
+			sOut += " R";
+			break;
+	}
+}
+
+/**
+	@param refs Receives the object numbers it refers to
+	@param bTop true for an indirect object itself (a stream's Length isn't followed,
+	since streams are written with direct lengths)
+*/
+void PdfObject::CollectReferences(std::vector<int>& refs, bool bTop) const
+{
+	switch (eType)
+	{
+		case Reference:
+			refs.push_back((int)nValue);
+			break;
+		case Array:
+			for (std::vector<PdfObject>::const_iterator i = items.begin(); i != items.end(); i++)
+				(*i).CollectReferences(refs, false);
+			break;
+		case Dictionary:
+		case Stream:
+			for (std::vector<std::pair<std::string, PdfObject> >::const_iterator i = keys.begin(); i != keys.end(); i++)
+				if (!bTop || (eType != Stream) || ((*i).first != "Length"))
+					(*i).second.CollectReferences(refs, false);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+	@param renumber New number of each object number (0 for objects that are dropped: references
+	to them become null)
+*/
+void PdfObject::Renumber(const std::vector<int>& renumber)
+{
+	switch (eType)
+	{
+		case Reference:
+			if ((nValue > 0) && ((size_t)nValue < renumber.size()) && (renumber[(size_t)nValue] > 0))
+			{
+				nValue = renumber[(size_t)nValue];
+				nGen = 0;
+			}
+			else
+				*this = PdfObject();
+			break;
+		case Array:
+			for (std::vector<PdfObject>::iterator i = items.begin(); i != items.end(); i++)
+				(*i).Renumber(renumber);
+			break;
+		case Dictionary:
+		case Stream:
+			for (std::vector<std::pair<std::string, PdfObject> >::iterator i = keys.begin(); i != keys.end(); i++)
+				(*i).second.Renumber(renumber);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+*/
+PdfDocument::PdfDocument() : m_hFile(NULL), m_hMapping(NULL), m_sVersion("1.4"), m_nXref(0), m_trailer(PdfObject::MakeDictionary())
+{
+}
+
+/**
+*/
+PdfDocument::~PdfDocument()
+{
+	Close();
+}
+
+/**
+	Objects that were parsed (or set) are kept; everything else can no longer be read
+*/
+void PdfDocument::Close()
+{
+#ifdef _WIN32
+	if (m_data.data() != NULL)
+		UnmapViewOfFile(m_data.data());
+	if (m_hMapping != NULL)
+		CloseHandle(m_hMapping);
+	if (m_hFile != NULL)
+		CloseHandle(m_hFile);
+#endif
+	m_hMapping = NULL;
+	m_hFile = NULL;
+	m_data = PdfData();
+	m_sBuffer.clear();
+	m_entries.clear();
+	m_bounds.clear();
+	m_nXref = 0;
+}
+
+/**
+	@param sData The data to parse
+	@param nPos Location of the value (updated to the end of the value)
+	@param object Receives the value
+	@return true if a value was parsed
+*/
+bool PdfDocument::ParseValue(const PdfData& sData, size_t& nPos, PdfObject& object)
+{
+	object = PdfObject();
+	SkipWhite(sData, nPos);
+	if (nPos >= sData.size())
+		return false;
+
+	char c = sData[nPos];
+	if (c == '/')
+	{
+		// Name (an empty name is legal)
+		nPos++;
+		size_t nStart = nPos;
+		while ((nPos < sData.size()) && !IsWhite(sData[nPos]) && !IsDelimiter(sData[nPos]))
+			nPos++;
+		object.eType = PdfObject::Name;
+		object.sValue = sData.substr(nStart, nPos - nStart);
+		return true;
+	}
+	if (c == '(')
+	{
+		// Literal string: kept escaped, balanced parentheses are part of it
+		size_t nStart = ++nPos;
+		int nDepth = 1;
+		while (nPos < sData.size())
+		{
+			if (sData[nPos] == '\\')
+				nPos++;
+			else if (sData[nPos] == '(')
+				nDepth++;
+			else if ((sData[nPos] == ')') && (--nDepth == 0))
+				break;
+			nPos++;
+		}
+		if (nPos >= sData.size())
+			return false;
+		object.eType = PdfObject::String;
+		object.sValue = sData.substr(nStart, nPos - nStart);
+		nPos++;
+		return true;
+	}
+	if (c == '<')
+	{
+		if ((nPos + 1 < sData.size()) && (sData[nPos + 1] == '<'))
+		{
+			// Dictionary
+			nPos += 2;
+			object.eType = PdfObject::Dictionary;
+			while (true)
+			{
+				SkipWhite(sData, nPos);
+				if (nPos + 1 >= sData.size())
+					return false;
+				if ((sData[nPos] == '>') && (sData[nPos + 1] == '>'))
+				{
+					nPos += 2;
+					return true;
+				}
+				PdfObject key, value;
+				if (!ParseValue(sData, nPos, key) || !key.Is(PdfObject::Name) || !ParseValue(sData, nPos, value))
+					return false;
+				object.keys.push_back(std::pair<std::string, PdfObject>(key.sValue, value));
+			}
+		}
+		// Hex string
+		size_t nStart = ++nPos;
+		nPos = sData.find('>', nPos);
+		if (nPos == std::string::npos)
+			return false;
+		object.eType = PdfObject::HexString;
+		object.sValue = sData.substr(nStart, nPos - nStart);
+		nPos++;
+		return true;
+	}
+	if (c == '[')
+	{
+		nPos++;
+		object.eType = PdfObject::Array;
+		while (true)
+		{
+			SkipWhite(sData, nPos);
+			if (nPos >= sData.size())
+				return false;
+			if (sData[nPos] == ']')
+			{
+				nPos++;
+				return true;
+			}
+			PdfObject item;
+			if (!ParseValue(sData, nPos, item))
+				return false;
+			object.items.push_back(item);
+		}
+	}
+	if (IsDelimiter(c))
+		return false;
+
+	std::string sToken = ReadToken(sData, nPos);
+	if (sToken == "true" || sToken == "false")
+	{
+		object.eType = PdfObject::Boolean;
+		object.nValue = (sToken == "true") ? 1 : 0;
+		return true;
+	}
+	if (sToken == "null")
+		return true;
+	__int64 n;
+	if (ToInteger(sToken, n))
+	{
+		object.eType = PdfObject::Integer;
+		object.nValue = n;
+		// Check for a reference ("num gen R")
+		size_t nNext = nPos;
+		__int64 nGen;
+		if ((n >= 0) && ToInteger(ReadToken(sData, nNext), nGen) && (ReadToken(sData, nNext) == "R"))
+		{
+			object.eType = PdfObject::Reference;
+			object.nGen = (int)nGen;
+			nPos = nNext;
+		}
+		return true;
+	}
+	if (!sToken.empty() && (sToken.find_first_not_of("+-.0123456789") == std::string::npos))
+	{
+		object.eType = PdfObject::Real;
+		object.sValue = sToken;
+		return true;
+	}
+	return false;
+}
+
+/**
+	@param nPos Location of the object in the file
+	@param object Receives the object
+	@param nEnd Receives the location just after the object (after "endobj")
+	@param pStreamData If not NULL, stream data isn't copied into the object; this gets where it is instead
+	@return true if the object was parsed
+*/
+bool PdfDocument::ParseIndirect(size_t nPos, PdfObject& object, size_t& nEnd, PdfData* pStreamData /* = NULL */)
+{
+	__int64 nNum, nGen;
+	if (!ToInteger(ReadToken(m_data, nPos), nNum) || !ToInteger(ReadToken(m_data, nPos), nGen) || (ReadToken(m_data, nPos) != "obj"))
+		return false;
+	if (!ParseValue(m_data, nPos, object))
+		return false;
+
+	size_t nNext = nPos;
+	if (object.Is(PdfObject::Dictionary) && (ReadToken(m_data, nNext) == "stream"))
+	{
+		// The data starts after the end of line following the keyword
+		if ((nNext < m_data.size()) && (m_data[nNext] == '\r'))
+			nNext++;
+		if ((nNext < m_data.size()) && (m_data[nNext] == '\n'))
+			nNext++;
+		size_t nStart = nNext, nDataEnd = std::string::npos;
+
+		// Trust the length if "endstream" is where it says it should be
+		PdfObject* pLength = Resolve(object.Get("Length"));
+		if ((pLength != NULL) && pLength->Is(PdfObject::Integer) && (pLength->nValue >= 0) && (nStart + (size_t)pLength->nValue <= m_data.size()))
+		{
+			size_t nCheck = nStart + (size_t)pLength->nValue;
+			if (ReadToken(m_data, nCheck) == "endstream")
+			{
+				nDataEnd = nStart + (size_t)pLength->nValue;
+				nPos = nCheck;
+			}
+		}
+		if (nDataEnd == std::string::npos)
+		{
+			// Bad length: look for the keyword instead
+			nDataEnd = m_data.find("endstream", nStart);
+			if (nDataEnd == std::string::npos)
+				return false;
+			nPos = nDataEnd + 9;
+			if ((nDataEnd > nStart) && (m_data[nDataEnd - 1] == '\n'))
+				nDataEnd--;
+			if ((nDataEnd > nStart) && (m_data[nDataEnd - 1] == '\r'))
+				nDataEnd--;
+		}
+		object.eType = PdfObject::Stream;
+		if (pStreamData != NULL)
+			*pStreamData = PdfData(m_data.data() + nStart, nDataEnd - nStart);
+		else
+			object.sValue = m_data.substr(nStart, nDataEnd - nStart);
+	}
+
+	nNext = nPos;
+	if (ReadToken(m_data, nNext) == "endobj")
+		nPos = nNext;
+	nEnd = nPos;
+	return true;
+}
+
+/**
+	@param nPos Location of the cross-reference table in the file
+	@return true if the table (and the ones before it) was read
+*/
+bool PdfDocument::ReadXref(size_t nPos)
+{
+	std::vector<bool> seen;
+	for (int nSection = 0; nSection < MAX_XREF_SECTIONS; nSection++)
+	{
+		m_bounds.push_back(nPos);
+		if (ReadToken(m_data, nPos) != "xref")
+			// Cross-reference streams aren't supported
+			return false;
+
+		std::string sToken;
+		while ((sToken = ReadToken(m_data, nPos)) != "trailer")
+		{
+			__int64 nFirst, nCount;
+			if (!ToInteger(sToken, nFirst) || !ToInteger(ReadToken(m_data, nPos), nCount) || (nFirst < 0) || (nCount < 0))
+				return false;
+			if ((size_t)(nFirst + nCount) > m_entries.size())
+			{
+				m_entries.resize((size_t)(nFirst + nCount));
+				seen.resize((size_t)(nFirst + nCount), false);
+			}
+			for (__int64 i = nFirst; i < nFirst + nCount; i++)
+			{
+				__int64 nOffset, nGen;
+				if (!ToInteger(ReadToken(m_data, nPos), nOffset) || !ToInteger(ReadToken(m_data, nPos), nGen))
+					return false;
+				std::string sType = ReadToken(m_data, nPos);
+				if ((sType == "n") && (nOffset > 0))
+					m_bounds.push_back((size_t)nOffset);
+				// Newer tables come first, and win
+				if (seen[(size_t)i])
+					continue;
+				seen[(size_t)i] = true;
+				Entry& entry = m_entries[(size_t)i];
+				entry.nGen = (int)nGen;
+				entry.bUsed = (sType == "n") && (nOffset > 0) && ((size_t)nOffset < m_data.size());
+				entry.nOffset = entry.bUsed ? (size_t)nOffset : 0;
+			}
+		}
+
+		PdfObject trailer;
+		if (!ParseValue(m_data, nPos, trailer) || !trailer.Is(PdfObject::Dictionary))
+			return false;
+		// Older trailers only fill in what the newer ones left out
+		for (std::vector<std::pair<std::string, PdfObject> >::const_iterator i = trailer.keys.begin(); i != trailer.keys.end(); i++)
+			if (m_trailer.Get((*i).first) == NULL)
+				m_trailer.keys.push_back(*i);
+
+		const PdfObject* pPrev = trailer.Get("Prev");
+		if ((pPrev == NULL) || !pPrev->Is(PdfObject::Integer))
+			return true;
+		nPos = (size_t)pPrev->nValue;
+		if (std::find(m_bounds.begin(), m_bounds.end(), nPos) != m_bounds.end())
+			// A loop in the chain
+			return true;
+	}
+	return true;
+}
+
+/**
+	@param pFile The file to read
+	@return true if the file was read
+*/
+bool PdfDocument::Load(const char* pFile)
+{
+	Close();
+	m_trailer = PdfObject::MakeDictionary();
+
+#ifdef _WIN32
+	// Mapped, so only the parts that are used are read (and they can be dropped again); others
+	// may add to the file meanwhile (the mapping keeps the size it had)
+	HANDLE hFile = CreateFile(pFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	m_hFile = hFile;
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(hFile, &liSize) || (liSize.QuadPart == 0) || ((unsigned __int64)liSize.QuadPart > (size_t)-1))
+		return false;
+	m_hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping == NULL)
+		return false;
+	const char* pView = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (pView == NULL)
+		return false;
+	m_data = PdfData(pView, (size_t)liSize.QuadPart);
+#else
+	// Other systems: read into memory
+	FILE* pIn;
+	if (fopen_s(&pIn, pFile, "rb") != 0)
+		return false;
+	char cBlock[64 * 1024];
+	size_t nRead;
+	while ((nRead = fread(cBlock, 1, sizeof(cBlock), pIn)) > 0)
+		m_sBuffer.append(cBlock, nRead);
+	fclose(pIn);
+	m_data = PdfData(m_sBuffer.data(), m_sBuffer.size());
+#endif
+
+	if (m_data.compare(0, 5, "%PDF-") != 0)
+		return false;
+	size_t nPos = 5;
+	while ((nPos < m_data.size()) && !IsWhite(m_data[nPos]))
+		nPos++;
+	m_sVersion = m_data.substr(5, nPos - 5);
+
+	// Only the end of the file is searched, so a file that isn't a PDF isn't read all through
+	size_t nTail = (m_data.size() > STARTXREF_SEARCH) ? m_data.size() - STARTXREF_SEARCH : 0;
+	size_t nStart = PdfData(m_data.data() + nTail, m_data.size() - nTail).rfind("startxref", STARTXREF_SEARCH);
+	if (nStart == std::string::npos)
+		return false;
+	nStart += nTail;
+	nPos = nStart + 9;
+	__int64 nXref;
+	if (!ToInteger(ReadToken(m_data, nPos), nXref) || (nXref <= 0) || ((size_t)nXref >= m_data.size()))
+		return false;
+	m_bounds.push_back(nStart);
+	m_nXref = (size_t)nXref;
+	if (!ReadXref((size_t)nXref) || (m_trailer.Get("Root") == NULL))
+		return false;
+
+	// The table may not cover the declared size
+	const PdfObject* pSize = m_trailer.Get("Size");
+	if ((pSize != NULL) && pSize->Is(PdfObject::Integer) && (pSize->nValue > (__int64)m_entries.size()) && (pSize->nValue < 0x800000))
+		m_entries.resize((size_t)pSize->nValue);
+	if (m_entries.empty())
+		m_entries.resize(1);
+	m_entries[0].bUsed = false;
+
+	std::sort(m_bounds.begin(), m_bounds.end());
+	return true;
+}
+
+/**
+	@param nNum The object number
+	@return The object, or NULL if there's no such object
+	The pointer stays valid as long as the object isn't removed or replaced
+*/
+PdfObject* PdfDocument::GetObject(int nNum)
+{
+	if (!IsObject(nNum))
+		return NULL;
+	Entry& entry = m_entries[nNum];
+	if (!entry.bLoaded)
+	{
+		// Mark first, so a stream whose length refers to itself doesn't loop
+		entry.bLoaded = true;
+		size_t nEnd;
+		PdfObject object;
+		if (ParseIndirect(entry.nOffset, object, nEnd))
+			entry.object = object;
+	}
+	return &entry.object;
+}
+
+/**
+	@param pObject The object to resolve (may be NULL)
+	@return The referenced object (NULL for a reference to a missing object)
+*/
+PdfObject* PdfDocument::Resolve(PdfObject* pObject)
+{
+	for (int i = 0; (i < 32) && (pObject != NULL) && pObject->Is(PdfObject::Reference); i++)
+		pObject = GetObject((int)pObject->nValue);
+	return pObject;
+}
+
+/**
+	@param object The object to add
+	@return The new object number
+*/
+int PdfDocument::AddObject(const PdfObject& object)
+{
+	if (m_entries.empty())
+		m_entries.resize(1);
+	int nNum = (int)m_entries.size();
+	m_entries.resize(m_entries.size() + 1);
+	SetObject(nNum, object);
+	return nNum;
+}
+
+/**
+	@param nNum The object number
+	@param object The new object
+*/
+void PdfDocument::SetObject(int nNum, const PdfObject& object)
+{
+	if (nNum <= 0)
+		return;
+	if ((size_t)nNum >= m_entries.size())
+		m_entries.resize(nNum + 1);
+	Entry& entry = m_entries[nNum];
+	entry.bUsed = true;
+	entry.bLoaded = true;
+	entry.nOffset = 0;
+	entry.object = object;
+}
+
+/**
+	@param nNum The object number
+*/
+void PdfDocument::RemoveObject(int nNum)
+{
+	if (!IsObject(nNum))
+		return;
+	Entry& entry = m_entries[nNum];
+	entry.bUsed = false;
+	entry.bLoaded = false;
+	entry.nOffset = 0;
+	entry.nGen++;
+	entry.object = PdfObject();
+}
+
+/**
+	@param nNum The object number
+	@return true if the object exists
+*/
+bool PdfDocument::IsObject(int nNum) const
+{
+	return (nNum > 0) && ((size_t)nNum < m_entries.size()) && m_entries[nNum].bUsed;
+}
+
+/**
+	@param nNum The object number
+	@return The generation number (0 if there's no such object)
+*/
+int PdfDocument::GetGeneration(int nNum) const
+{
+	return ((nNum > 0) && ((size_t)nNum < m_entries.size())) ? m_entries[nNum].nGen : 0;
+}
+
+/**
+	@param nNum The object number
+	@param sOut Buffer to add the object to
+	Objects that weren't parsed are copied as they are from the original file
+*/
+void PdfDocument::WriteObject(int nNum, std::string& sOut)
+{
+	Entry& entry = m_entries[nNum];
+	if (!entry.bLoaded)
+	{
+		// The object ends at the last "endobj" before whatever comes next in the file
+		std::vector<size_t>::const_iterator iNext = std::upper_bound(m_bounds.begin(), m_bounds.end(), entry.nOffset);
+		size_t nLimit = (iNext != m_bounds.end()) ? *iNext : m_data.size();
+		size_t nEnd = (nLimit > entry.nOffset + 6) ? m_data.rfind("endobj", nLimit - 6) : std::string::npos;
+		if ((nEnd != std::string::npos) && (nEnd > entry.nOffset))
+		{
+			sOut.append(m_data.data() + entry.nOffset, nEnd + 6 - entry.nOffset);
+			sOut += '\n';
+			return;
+		}
+		GetObject(nNum);
+	}
+
+	sOut += PdfObject::FormatInteger(nNum);
+	sOut += ' ';
+	sOut += PdfObject::FormatInteger(entry.nGen);
+	sOut += " obj\n";
+	entry.object.Write(sOut);
+	sOut += "\nendobj\n";
+}
+
+/**
+	@param pFile The file to write
+	@return true if the file was written
+*/
+bool PdfDocument::Save(const char* pFile)
+{
+	PdfOutput out;
+	if ((m_trailer.Get("Root") == NULL) || !out.Open(pFile))
+		return false;
+
+	out.Write(GetHeader());
+	std::vector<size_t> offsets(m_entries.size(), 0);
+	std::string sObject;
+	for (size_t i = 1; i < m_entries.size(); i++)
+		if (m_entries[i].bUsed)
+		{
+			offsets[i] = out.GetOffset();
+			sObject.clear();
+			WriteObject((int)i, sObject);
+			out.Write(sObject);
+		}
+
+	// Free entries are linked to each other: each one's offset is the next free number (found
+	// in one pass from the end)
+	size_t nNextFree = 0;
+	for (size_t i = m_entries.size(); i-- > 0; )
+		if (!m_entries[i].bUsed)
+		{
+			offsets[i] = nNextFree;
+			nNextFree = i;
+		}
+
+	// Cross-reference table
+	size_t nXref = out.GetOffset();
+	out.Write("xref\n0 " + PdfObject::FormatInteger(m_entries.size()) + "\n");
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		if (m_entries[i].bUsed)
+			out.Write(PdfObject::FormatInteger(offsets[i], 10) + " " + PdfObject::FormatInteger(m_entries[i].nGen, 5) + " n\r\n");
+		else
+			out.Write(PdfObject::FormatInteger(offsets[i], 10) + " " + PdfObject::FormatInteger((i == 0) ? 65535 : m_entries[i].nGen, 5) + " f\r\n");
+	}
+
+	PdfObject trailer = m_trailer;
+	trailer.Remove("Prev");
+	trailer.Remove("XRefStm");
+	trailer.Set("Size", PdfObject::MakeInteger(m_entries.size()));
+	std::string sTrailer = "trailer\n";
+	trailer.Write(sTrailer);
+	out.Write(sTrailer + "\nstartxref\n" + PdfObject::FormatInteger(nXref) + "\n%%EOF\n");
+	return out.Close();
+}
+
+/**
+	@return The file header (version, and the comment that marks the file as binary)
+*/
+std::string PdfDocument::GetHeader() const
+{
+	return "%PDF-" + m_sVersion + "\n%\xE2\xE3\xCF\xD3\n";
+}
+
+/**
+	@param nNum The object number
+	@param object Receives a copy of the object
+	@param pStreamData If not NULL, stream data isn't copied into the object; this gets
+	where it is instead (valid until the object is changed, or the document closed)
+	@return true if the object exists
+	Unlike GetObject, this doesn't keep objects that weren't parsed yet, so going over
+	every object of a large document doesn't keep all of them in memory.
+*/
+bool PdfDocument::ReadObject(int nNum, PdfObject& object, PdfData* pStreamData /* = NULL */)
+{
+	if (!IsObject(nNum))
+		return false;
+	if (pStreamData != NULL)
+		*pStreamData = PdfData();
+	Entry& entry = m_entries[nNum];
+	if (!entry.bLoaded)
+	{
+		size_t nEnd;
+		if (!ParseIndirect(entry.nOffset, object, nEnd, pStreamData))
+			object = PdfObject();
+		return true;
+	}
+	if (pStreamData == NULL)
+	{
+		object = entry.object;
+		return true;
+	}
+	// Copy everything but the data
+	std::string sData;
+	sData.swap(entry.object.sValue);
+	object = entry.object;
+	sData.swap(entry.object.sValue);
+	*pStreamData = PdfData(entry.object.sValue.data(), entry.object.sValue.size());
+	return true;
+}
+
+/**
+	@param c The character to look for
+	@param nPos Location to start at
+	@return Location of the character, or std::string::npos if not found
+*/
+size_t PdfData::find(char c, size_t nPos) const
+{
+	if (nPos >= m_nSize)
+		return std::string::npos;
+	const char* p = (const char*)memchr(m_pData + nPos, c, m_nSize - nPos);
+	return (p == NULL) ? std::string::npos : (size_t)(p - m_pData);
+}
+
+/**
+	@param pText The text to look for
+	@param nPos Location to start at
+	@return Location of the text, or std::string::npos if not found
+*/
+size_t PdfData::find(const char* pText, size_t nPos) const
+{
+	size_t nLen = strlen(pText);
+	while ((nPos = find(pText[0], nPos)) != std::string::npos)
+	{
+		if (nPos + nLen > m_nSize)
+			break;
+		if (memcmp(m_pData + nPos, pText, nLen) == 0)
+			return nPos;
+		nPos++;
+	}
+	return std::string::npos;
+}
+
+/**
+	@param pText The text to look for
+	@param nPos Last location the text may start at
+	@return Location of the text, or std::string::npos if not found
+*/
+size_t PdfData::rfind(const char* pText, size_t nPos) const
+{
+	size_t nLen = strlen(pText);
+	if (nLen > m_nSize)
+		return std::string::npos;
+	for (nPos = min(nPos, m_nSize - nLen) + 1; nPos-- > 0; )
+		if ((m_pData[nPos] == pText[0]) && (memcmp(m_pData + nPos, pText, nLen) == 0))
+			return nPos;
+	return std::string::npos;
+}
+
+/**
+	@param pFile The file to create (NULL to only count the bytes)
+	@return true if the file was created
+*/
+bool PdfOutput::Open(const char* pFile)
+{
+	m_nOffset = 0;
+	m_bFailed = false;
+	if (pFile == NULL)
+		return true;
+	return fopen_s(&m_pFile, pFile, "wb") == 0;
+}
+
+/**
+	@param pData The data to write
+	@param nLen Size of the data
+*/
+void PdfOutput::Write(const char* pData, size_t nLen)
+{
+	if ((m_pFile != NULL) && !m_bFailed && (fwrite(pData, 1, nLen, m_pFile) != nLen))
+		m_bFailed = true;
+	m_nOffset += nLen;
+}
+
+/**
+	@return true if everything was written
+*/
+bool PdfOutput::Close()
+{
+	if ((m_pFile != NULL) && (fclose(m_pFile) != 0))
+		m_bFailed = true;
+	m_pFile = NULL;
+	return !m_bFailed;
+}
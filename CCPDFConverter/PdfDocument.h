@@ -0,0 +1,354 @@
+/**
+	@file
+	@brief Minimal PDF object model: parsing, editing and writing documents
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PDFDOCUMENT_H_
+#define _PDFDOCUMENT_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+
+/**
+    @brief A PDF object (direct, or the value of an indirect object)
+
+	Strings, names and real numbers keep their original text, so objects are written back
+	exactly as they were read. Arrays and dictionaries own their items; dictionaries keep
+	their key order.
+*/
+class PdfObject
+{
+public:
+	/// Object types
+	enum Type
+	{
+		Null,
+		Boolean,
+		Integer,
+		Real,
+		/// Literal string: sValue is the text between the parentheses (still escaped)
+		String,
+		/// Hex string: sValue is the hex digits
+		HexString,
+		/// Name: sValue is the name without the slash (still #-escaped)
+		Name,
+		Array,
+		Dictionary,
+		/// Reference to an indirect object: nValue is the object number, nGen the generation
+		Reference,
+		/// Stream: the dictionary in keys, the (still encoded) data in sValue
+		Stream
+	};
+
+	/// Ctor (a null object)
+	PdfObject() : eType(Null), nValue(0), nGen(0) {};
+
+	/// Makes an integer object
+	static PdfObject	MakeInteger(__int64 n);
+	/// Makes a name object
+	static PdfObject	MakeName(const std::string& sName);
+	/// Makes a literal string object from text (escaping it as needed)
+	static PdfObject	MakeString(const std::string& sText);
+	/// Makes a text string object from text in the system code page
+	static PdfObject	MakeTextString(const std::string& sText);
+	/// Makes a reference object
+	static PdfObject	MakeReference(int nNum, int nGen = 0);
+	/// Makes an empty dictionary
+	static PdfObject	MakeDictionary();
+	/// Makes an empty array
+	static PdfObject	MakeArray();
+
+	/**
+		@brief Checks the object's type
+		@param e The type to check for
+		@return true if the object is of that type
+	*/
+	bool				Is(Type e) const {return eType == e;};
+	/**
+		@brief Checks if the object has dictionary keys (a dictionary or a stream)
+		@return true if it has
+	*/
+	bool				IsDictionary() const {return (eType == Dictionary) || (eType == Stream);};
+
+	/// Returns a dictionary value (NULL if not there)
+	const PdfObject*	Get(const std::string& sKey) const;
+	/// Returns a dictionary value (NULL if not there)
+	PdfObject*			Get(const std::string& sKey);
+	/// Sets a dictionary value (adding the key if needed)
+	void				Set(const std::string& sKey, const PdfObject& value);
+	/// Removes a dictionary key
+	void				Remove(const std::string& sKey);
+
+	/// Writes the object in PDF syntax
+	void				Write(std::string& sOut) const;
+	/// Adds the object numbers the object refers to
+	void				CollectReferences(std::vector<int>& refs, bool bTop) const;
+	/// Changes the object numbers the object refers to
+	void				Renumber(const std::vector<int>& renumber);
+
+	/// Formats an integer
+	static std::string	FormatInteger(__int64 n, int nWidth = 0);
+
+public:
+	/// Type
+	Type				eType;
+	/// Boolean (0/1), integer or object number
+	__int64				nValue;
+	/// Generation number (references)
+	int					nGen;
+	/// Text of strings, names and reals; data of streams
+	std::string			sValue;
+	/// Array items
+	std::vector<PdfObject>	items;
+	/// Dictionary (and stream dictionary) keys, without the slash, and values
+	std::vector<std::pair<std::string, PdfObject> >	keys;
+};
+
+/**
+    @brief Read-only view of a document's data (usually a mapped file), searched like a string
+*/
+class PdfData
+{
+public:
+	/// Ctor (no data)
+	PdfData() : m_pData(NULL), m_nSize(0) {};
+	/**
+		@brief Ctor
+		@param pData The data
+		@param nSize Size of the data
+	*/
+	PdfData(const char* pData, size_t nSize) : m_pData(pData), m_nSize(nSize) {};
+
+	/**
+		@brief Returns the data
+		@return Pointer to the data
+	*/
+	const char*			data() const {return m_pData;};
+	/**
+		@brief Returns the data size
+		@return Size of the data
+	*/
+	size_t				size() const {return m_nSize;};
+	/**
+		@brief Returns a character
+		@param nPos Location of the character (must be less than size())
+		@return The character
+	*/
+	char				operator[](size_t nPos) const {return m_pData[nPos];};
+	/**
+		@brief Returns a copy of part of the data
+		@param nPos Start location
+		@param nLen Length
+		@return The data
+	*/
+	std::string			substr(size_t nPos, size_t nLen) const {return std::string(m_pData + nPos, nLen);};
+	/**
+		@brief Compares part of the data to text
+		@param nPos Start location
+		@param nLen Length
+		@param pText The text to compare to
+		@return 0 if they're the same
+	*/
+	int					compare(size_t nPos, size_t nLen, const char* pText) const {return (nPos + nLen <= m_nSize) ? memcmp(m_pData + nPos, pText, nLen) : -1;};
+	/// Looks for a character
+	size_t				find(char c, size_t nPos) const;
+	/// Looks for text
+	size_t				find(const char* pText, size_t nPos) const;
+	/// Looks for text, backwards
+	size_t				rfind(const char* pText, size_t nPos) const;
+
+protected:
+	/// The data
+	const char*			m_pData;
+	/// Size of the data
+	size_t				m_nSize;
+};
+
+/**
+    @brief Writes a document to a file, keeping track of the location
+
+	Without a file, it only counts the bytes (to find where everything will go before
+	writing it).
+*/
+class PdfOutput
+{
+public:
+	/// Ctor
+	PdfOutput() : m_pFile(NULL), m_nOffset(0), m_bFailed(false) {};
+	/// Dtor
+	~PdfOutput() {Close();};
+
+	/// Creates the file
+	bool				Open(const char* pFile);
+	/// Writes data
+	void				Write(const char* pData, size_t nLen);
+	/**
+		@brief Writes text
+		@param s The text to write
+	*/
+	void				Write(const std::string& s) {Write(s.data(), s.size());};
+	/// Closes the file
+	bool				Close();
+	/**
+		@brief Returns the current location
+		@return Count of bytes written so far
+	*/
+	size_t				GetOffset() const {return m_nOffset;};
+
+protected:
+	/// The file (NULL when only counting)
+	FILE*				m_pFile;
+	/// Bytes written
+	size_t				m_nOffset;
+	/// true if a write failed
+	bool				m_bFailed;
+};
+
+/**
+    @brief A PDF document, read from (and written to) a file with a classic cross-reference table
+
+	The file is mapped rather than read, and objects are parsed on first use; objects that
+	are never used are copied to the new file as they are, without being parsed again.
+	Documents with cross-reference streams (PDF 1.5 and up) are not supported by Load.
+*/
+class PdfDocument
+{
+public:
+	/// Ctor
+	PdfDocument();
+	/// Dtor
+	virtual ~PdfDocument();
+
+	/// Reads a document
+	bool				Load(const char* pFile);
+	/// Writes the document
+	bool				Save(const char* pFile);
+	/// Releases the file
+	void				Close();
+	/// Returns the file header
+	std::string			GetHeader() const;
+	/**
+		@brief Returns the size of the file the document was read from
+		@return The size (0 if the document was closed)
+	*/
+	size_t				GetFileSize() const {return m_data.size();};
+
+	/// Returns an indirect object (parsing it if needed)
+	PdfObject*			GetObject(int nNum);
+	/// Returns a copy of an indirect object (without keeping it parsed)
+	bool				ReadObject(int nNum, PdfObject& object, PdfData* pStreamData = NULL);
+	/// Follows a reference (returns the object itself if it's not a reference)
+	PdfObject*			Resolve(PdfObject* pObject);
+	/// Adds an indirect object
+	int					AddObject(const PdfObject& object);
+	/// Replaces an indirect object
+	void				SetObject(int nNum, const PdfObject& object);
+	/// Removes an indirect object
+	void				RemoveObject(int nNum);
+	/**
+		@brief Returns the count of object numbers (including free ones, and 0)
+		@return One more than the highest object number
+	*/
+	int					GetObjectCount() const {return (int)m_entries.size();};
+	/// Checks if an object number is in use
+	bool				IsObject(int nNum) const;
+	/// Returns an object's generation number
+	int					GetGeneration(int nNum) const;
+	/**
+		@brief Returns where the newest cross-reference table is (for an update's Prev)
+		@return The offset in the file (0 if no document was read)
+	*/
+	size_t				GetXrefOffset() const {return m_nXref;};
+
+	/**
+		@brief Returns the trailer dictionary
+		@return The trailer (Root, Info, ID...)
+	*/
+	PdfObject&			GetTrailer() {return m_trailer;};
+	/**
+		@brief Returns the PDF version
+		@return The version from the header (e.g. "1.4")
+	*/
+	const std::string&	GetVersion() const {return m_sVersion;};
+	/**
+		@brief Sets the PDF version written in the header
+		@param sVersion The version (e.g. "1.5")
+	*/
+	void				SetVersion(const std::string& sVersion) {m_sVersion = sVersion;};
+
+	/// Parses a value at a location in a buffer
+	static bool			ParseValue(const PdfData& sData, size_t& nPos, PdfObject& object);
+
+protected:
+	/// A cross-reference entry
+	struct Entry
+	{
+		/// Ctor (a free entry)
+		Entry() : nOffset(0), nGen(0), bUsed(false), bLoaded(false) {};
+
+		/// Offset in the file (0 for free or new objects)
+		size_t			nOffset;
+		/// Generation
+		int				nGen;
+		/// true if the object is in use
+		bool			bUsed;
+		/// true if the object was parsed (or set)
+		bool			bLoaded;
+		/// The object, once parsed
+		PdfObject		object;
+	};
+
+	/// Reads a cross-reference table (and the ones it updates)
+	bool				ReadXref(size_t nPos);
+	/// Parses an indirect object from the file
+	bool				ParseIndirect(size_t nPos, PdfObject& object, size_t& nEnd, PdfData* pStreamData = NULL);
+	/// Writes an indirect object
+	void				WriteObject(int nNum, std::string& sOut);
+
+protected:
+	/// The file data
+	PdfData				m_data;
+	/// The file data, when read rather than mapped
+	std::string			m_sBuffer;
+	/// The file (when mapped)
+	void*				m_hFile;
+	/// The file mapping
+	void*				m_hMapping;
+	/// PDF version
+	std::string			m_sVersion;
+	/// Objects, by number (a deque, so adding objects doesn't move the existing ones)
+	std::deque<Entry>	m_entries;
+	/// Offset of the newest cross-reference table
+	size_t				m_nXref;
+	/// Sorted offsets of everything the cross-reference tables point at (used to find where objects end)
+	std::vector<size_t>	m_bounds;
+	/// Trailer dictionary
+	PdfObject			m_trailer;
+};
+
+#endif   //#define _PDFDOCUMENT_H_
@@ -0,0 +1,615 @@
+/**
+	@file
+	@brief Post-processing stage writing the document linearized (Fast Web View)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfLinearize.h"
+#include "Configuration.h"
+
+/// A page object
+#define LF_PAGE			0x01
+/// A page tree node
+#define LF_NODE			0x02
+/// Already has its part of the file
+#define LF_PLACED		0x04
+
+/// How deep the page tree may go
+#define MAX_TREE_DEPTH	64
+/// Default for the largest document linearized (linearize.maxsize)
+#define DEFAULT_MAX_SIZE	(1024 * 1024 * 1024)
+
+/**
+    @brief Writes the hint tables, a bit field at a time
+*/
+class HintBits
+{
+public:
+	/// Ctor
+	HintBits() : m_cCurrent(0), m_nBits(0) {};
+
+	/**
+		@brief Adds a value
+		@param nValue The value
+		@param nBits Number of bits to write it in (up to 32)
+	*/
+	void				Write(unsigned __int64 nValue, int nBits)
+	{
+		while (nBits-- > 0)
+		{
+			m_cCurrent = (unsigned char)((m_cCurrent << 1) | ((nValue >> nBits) & 1));
+			if (++m_nBits == 8)
+			{
+				m_sData += (char)m_cCurrent;
+				m_cCurrent = 0;
+				m_nBits = 0;
+			}
+		}
+	};
+	/**
+		@brief Pads to the next byte (every hint table item list starts on one)
+	*/
+	void				Flush()
+	{
+		if (m_nBits > 0)
+			Write(0, 8 - m_nBits);
+	};
+	/**
+		@brief Returns the data written so far
+		@return The data (call Flush first)
+	*/
+	const std::string&	GetData() const {return m_sData;};
+
+protected:
+	/// The bytes written so far
+	std::string			m_sData;
+	/// The byte being filled
+	unsigned char		m_cCurrent;
+	/// Bits in the byte being filled
+	int					m_nBits;
+};
+
+/**
+	@param n The value
+	@return Number of bits needed to represent it
+*/
+static int BitsFor(unsigned __int64 n)
+{
+	int nBits = 0;
+	for (; n > 0; n >>= 1)
+		nBits++;
+	return nBits;
+}
+
+/**
+*/
+LinearizeStage::LinearizeStage() : m_nVisit(0), m_nPart4(0), m_nPart6(0), m_nPart7(0), m_nPart8(0), m_nMain(0), m_nParameters(0), m_nHint(0), m_nSize(0),
+	m_nSharedHints(0), m_nFirstXref(0), m_nHintOffset(0), m_nHintLength(0), m_nEndFirstPage(0), m_nMainXref(0), m_nFileLength(0)
+{
+}
+
+/**
+	@param doc The document
+	@param result The job result (gets the memory the plan took)
+	@return true if the document can be linearized
+*/
+bool LinearizeStage::Process(PdfDocument& doc, JobResult& result)
+{
+	// Every object is read, so all the (mapped) file ends up in memory
+	unsigned __int64 nMaxSize = myconfigdata.getsize("linearize.maxsize", DEFAULT_MAX_SIZE);
+	if ((nMaxSize > 0) && (doc.GetFileSize() > nMaxSize))
+	{
+		char cError[128];
+		sprintf_s(cError, sizeof(cError), "the document is %I64u bytes, more than linearize.maxsize (%I64u)", (unsigned __int64)doc.GetFileSize(), nMaxSize);
+		result["postprocess.linearize.error"] = cError;
+		return false;
+	}
+
+	// Encrypted documents would need their strings decrypted and encrypted again
+	if ((doc.GetTrailer().Get("Encrypt") != NULL) || (doc.GetTrailer().Get("Root") == NULL) || !doc.GetTrailer().Get("Root")->Is(PdfObject::Reference))
+		return false;
+
+	Classify(doc);
+	if (m_pages.empty())
+		return false;
+	result.SetInt("postprocess.linearize.memory", GetMemoryUse());
+	// The object graph isn't needed any more
+	std::vector<std::vector<int> >().swap(m_refs);
+	std::vector<std::vector<int> >().swap(m_pageObjects);
+	std::vector<int>().swap(m_visited);
+
+	Renumber();
+	// Measure every object, to know where everything goes
+	PdfOutput measure;
+	measure.Open(NULL);
+	m_lengths.assign(m_nSize, 0);
+	for (std::vector<int>::const_iterator i = m_order.begin(); i != m_order.end(); i++)
+		m_lengths[m_renumber[*i]] = WriteObject(doc, *i, measure);
+	Layout(doc);
+	return true;
+}
+
+/**
+	@param doc The document
+	@param pFile The file to write
+	@param result The job result (not used)
+	@return true if the file was written
+*/
+bool LinearizeStage::Save(PdfDocument& doc, const char* pFile, JobResult& /*result*/)
+{
+	PdfOutput out;
+	if (m_order.empty() || !out.Open(pFile))
+		return false;
+	bool bRet = Write(doc, out);
+	return out.Close() && bRet;
+}
+
+/**
+	@param doc The document
+	@param nNode The page tree node (or page) to add
+	@param nDepth How deep in the tree it is
+	@return true if the tree could be read
+*/
+bool LinearizeStage::FindPages(PdfDocument& doc, int nNode, int nDepth)
+{
+	PdfObject node;
+	if ((nDepth > MAX_TREE_DEPTH) || !doc.ReadObject(nNode, node) || (m_flags[nNode] & (LF_PAGE | LF_NODE)))
+		return false;
+	const PdfObject* pKids = node.Get("Kids");
+	if ((pKids == NULL) || !pKids->Is(PdfObject::Array))
+	{
+		m_flags[nNode] |= LF_PAGE | LF_PLACED;
+		m_pages.push_back(nNode);
+		return true;
+	}
+	m_flags[nNode] |= LF_NODE;
+	for (std::vector<PdfObject>::const_iterator i = pKids->items.begin(); i != pKids->items.end(); i++)
+		if ((*i).Is(PdfObject::Reference) && !FindPages(doc, (int)(*i).nValue, nDepth + 1))
+			return false;
+	return true;
+}
+
+/**
+	@param start The objects to start from
+	@param reached Receives the objects reached that don't have their part yet, in order
+	@param bStop true to stop at pages, page tree nodes and objects that have their part
+*/
+void LinearizeStage::Reach(const std::vector<int>& start, std::vector<int>& reached, bool bStop)
+{
+	m_nVisit++;
+	std::vector<int> stack(start.rbegin(), start.rend());
+	while (!stack.empty())
+	{
+		int nNum = stack.back();
+		stack.pop_back();
+		if ((nNum <= 0) || ((size_t)nNum >= m_refs.size()) || (m_visited[nNum] == m_nVisit))
+			continue;
+		m_visited[nNum] = m_nVisit;
+		if (bStop && (m_flags[nNum] & (LF_PAGE | LF_NODE | LF_PLACED)))
+			continue;
+		if (!(m_flags[nNum] & LF_PLACED))
+			reached.push_back(nNum);
+		stack.insert(stack.end(), m_refs[nNum].rbegin(), m_refs[nNum].rend());
+	}
+}
+
+/**
+	@param doc The document
+*/
+void LinearizeStage::Classify(PdfDocument& doc)
+{
+	size_t nCount = doc.GetObjectCount();
+	m_refs.assign(nCount, std::vector<int>());
+	m_flags.assign(nCount, 0);
+	m_firstPage.assign(nCount, -1);
+	m_useCount.assign(nCount, 0);
+	m_visited.assign(nCount, 0);
+	m_pages.clear();
+	m_order.clear();
+
+	// What refers to what (without keeping the objects)
+	for (size_t i = 1; i < nCount; i++)
+	{
+		PdfObject object;
+		PdfData data;
+		if (doc.ReadObject((int)i, object, &data))
+			object.CollectReferences(m_refs[i], true);
+	}
+
+	int nRoot = (int)doc.GetTrailer().Get("Root")->nValue;
+	PdfObject catalog;
+	if (!doc.ReadObject(nRoot, catalog))
+		return;
+	const PdfObject* pPages = catalog.Get("Pages");
+	if ((pPages == NULL) || !pPages->Is(PdfObject::Reference) || !FindPages(doc, (int)pPages->nValue, 0))
+	{
+		m_pages.clear();
+		return;
+	}
+
+	// Part 4: the catalog, and what's needed to open the document
+	m_flags[nRoot] |= LF_PLACED;
+	m_order.push_back(nRoot);
+	static const char* DOCUMENT_KEYS[] = {"ViewerPreferences", "PageMode", "Threads", "OpenAction", "AcroForm"};
+	std::vector<int> start, reached;
+	for (int i = 0; i < (int)(sizeof(DOCUMENT_KEYS) / sizeof(char*)); i++)
+		if (catalog.Get(DOCUMENT_KEYS[i]) != NULL)
+			catalog.Get(DOCUMENT_KEYS[i])->CollectReferences(start, false);
+	Reach(start, reached, true);
+	for (std::vector<int>::const_iterator i = reached.begin(); i != reached.end(); i++)
+	{
+		m_flags[*i] |= LF_PLACED;
+		m_order.push_back(*i);
+	}
+	m_nPart4 = m_order.size();
+
+	// What each page uses
+	m_pageObjects.assign(m_pages.size(), std::vector<int>());
+	for (size_t nPage = 0; nPage < m_pages.size(); nPage++)
+	{
+		Reach(m_refs[m_pages[nPage]], m_pageObjects[nPage], true);
+		for (std::vector<int>::const_iterator i = m_pageObjects[nPage].begin(); i != m_pageObjects[nPage].end(); i++)
+		{
+			if (m_firstPage[*i] < 0)
+				m_firstPage[*i] = (int)nPage;
+			if (m_useCount[*i] < 2)
+				m_useCount[*i]++;
+		}
+	}
+
+	// Part 6: the first page, with everything it uses
+	m_pageCount.assign(m_pages.size(), 0);
+	m_order.push_back(m_pages[0]);
+	m_order.insert(m_order.end(), m_pageObjects[0].begin(), m_pageObjects[0].end());
+	m_nPart6 = m_order.size() - m_nPart4;
+	m_pageCount[0] = (int)m_nPart6;
+
+	// Part 7: the other pages, each with what only it uses
+	for (size_t nPage = 1; nPage < m_pages.size(); nPage++)
+	{
+		m_order.push_back(m_pages[nPage]);
+		for (std::vector<int>::const_iterator i = m_pageObjects[nPage].begin(); i != m_pageObjects[nPage].end(); i++)
+			if (m_useCount[*i] == 1)
+				m_order.push_back(*i);
+		m_pageCount[nPage] = (int)(m_order.size() - m_nPart4 - m_nPart6) - (int)m_nPart7;
+		m_nPart7 += m_pageCount[nPage];
+	}
+
+	// Part 8: objects shared by pages other than the first
+	for (size_t nPage = 1; nPage < m_pages.size(); nPage++)
+		for (std::vector<int>::const_iterator i = m_pageObjects[nPage].begin(); i != m_pageObjects[nPage].end(); i++)
+			if ((m_useCount[*i] > 1) && (m_firstPage[*i] == (int)nPage))
+				m_order.push_back(*i);
+	m_nPart8 = m_order.size() - m_nPart4 - m_nPart6 - m_nPart7;
+
+	// Shared object identifiers: every first page object, then part 8
+	std::vector<int> sharedId(nCount, -1);
+	for (size_t i = 0; i < m_nPart6 + m_nPart8; i++)
+		sharedId[m_order[m_nPart4 + ((i < m_nPart6) ? i : i + m_nPart7)]] = (int)i;
+	m_pageShared.assign(m_pages.size(), std::vector<int>());
+	for (size_t nPage = 0; nPage < m_pages.size(); nPage++)
+		for (std::vector<int>::const_iterator i = m_pageObjects[nPage].begin(); i != m_pageObjects[nPage].end(); i++)
+		{
+			m_flags[*i] |= LF_PLACED;
+			if (m_useCount[*i] > 1)
+				m_pageShared[nPage].push_back(sharedId[*i]);
+		}
+
+	// Part 9: everything else still in use (the page tree, outlines, document information...)
+	start.clear();
+	doc.GetTrailer().CollectReferences(start, false);
+	reached.clear();
+	Reach(start, reached, false);
+	m_order.insert(m_order.end(), reached.begin(), reached.end());
+}
+
+/**
+*/
+void LinearizeStage::Renumber()
+{
+	// The main table has the objects after the first page, the first page table the rest
+	m_renumber.assign(m_flags.size(), 0);
+	int nNum = 1;
+	for (size_t i = m_nPart4 + m_nPart6; i < m_order.size(); i++)
+		m_renumber[m_order[i]] = nNum++;
+	m_nMain = nNum - 1;
+	m_nParameters = nNum++;
+	for (size_t i = 0; i < m_nPart4 + m_nPart6; i++)
+		m_renumber[m_order[i]] = nNum++;
+	m_nHint = nNum++;
+	m_nSize = nNum;
+}
+
+/**
+	@param doc The document
+	@param nOld The object's old number
+	@param out Where to write it
+	@return Size of the object
+*/
+size_t LinearizeStage::WriteObject(PdfDocument& doc, int nOld, PdfOutput& out)
+{
+	size_t nStart = out.GetOffset();
+	PdfObject object;
+	PdfData data;
+	doc.ReadObject(nOld, object, &data);
+	object.Renumber(m_renumber);
+
+	std::string sObject = PdfObject::FormatInteger(m_renumber[nOld]) + " 0 obj\n";
+	if (object.Is(PdfObject::Stream))
+	{
+		// The data is copied straight from the original
+		object.eType = PdfObject::Dictionary;
+		object.Set("Length", PdfObject::MakeInteger(data.size()));
+		object.Write(sObject);
+		sObject += "\nstream\n";
+		out.Write(sObject);
+		out.Write(data.data(), data.size());
+		out.Write("\nendstream\nendobj\n");
+	}
+	else
+	{
+		object.Write(sObject);
+		sObject += "\nendobj\n";
+		out.Write(sObject);
+	}
+	return out.GetOffset() - nStart;
+}
+
+/**
+	@return The linearization parameters object (its numbers always take the same space)
+*/
+std::string LinearizeStage::MakeParameters() const
+{
+	return PdfObject::FormatInteger(m_nParameters) + " 0 obj\n<</Linearized 1/L " + PdfObject::FormatInteger(m_nFileLength, 10) +
+		"/H [" + PdfObject::FormatInteger(m_nHintOffset, 10) + " " + PdfObject::FormatInteger(m_nHintLength, 10) + "]/O " +
+		PdfObject::FormatInteger(m_renumber[m_pages[0]], 10) + "/E " + PdfObject::FormatInteger(m_nEndFirstPage, 10) +
+		"/N " + PdfObject::FormatInteger(m_pages.size(), 10) + "/T " +
+		PdfObject::FormatInteger(m_nMainXref + strlen("xref\n0 ") + PdfObject::FormatInteger(m_nMain + 1).size(), 10) + ">>\nendobj\n";
+}
+
+/**
+	@param doc The document (for the trailer)
+	@return The first page cross-reference table and trailer
+*/
+std::string LinearizeStage::MakeFirstXref(PdfDocument& doc) const
+{
+	std::string sXref = "xref\n" + PdfObject::FormatInteger(m_nMain + 1) + " " + PdfObject::FormatInteger(m_nSize - m_nMain - 1) + "\n";
+	for (int i = m_nMain + 1; i < m_nSize; i++)
+		sXref += PdfObject::FormatInteger(m_offsets.empty() ? 0 : m_offsets[i], 10) + " 00000 n\r\n";
+
+	PdfObject trailer = PdfObject::MakeDictionary();
+	trailer.Set("Size", PdfObject::MakeInteger(m_nSize));
+	static const char* TRAILER_KEYS[] = {"Root", "Info", "ID"};
+	for (int i = 0; i < (int)(sizeof(TRAILER_KEYS) / sizeof(char*)); i++)
+	{
+		PdfObject* pValue = doc.GetTrailer().Get(TRAILER_KEYS[i]);
+		if (pValue == NULL)
+			continue;
+		PdfObject value = *pValue;
+		value.Renumber(m_renumber);
+		if (!value.Is(PdfObject::Null))
+			trailer.Set(TRAILER_KEYS[i], value);
+	}
+	std::string sTrailer;
+	trailer.Write(sTrailer);
+	// The main table's location always takes the same space
+	sTrailer.erase(sTrailer.size() - 2);
+	sTrailer += "/Prev " + PdfObject::FormatInteger(m_nMainXref, 10) + ">>";
+	return sXref + "trailer\n" + sTrailer + "\nstartxref\n0\n%%EOF\n";
+}
+
+/**
+	@return The main cross-reference table and trailer
+*/
+std::string LinearizeStage::MakeMainXref() const
+{
+	std::string sXref = "xref\n0 " + PdfObject::FormatInteger(m_nMain + 1) + "\n0000000000 65535 f\r\n";
+	for (int i = 1; i <= m_nMain; i++)
+		sXref += PdfObject::FormatInteger(m_offsets[i], 10) + " 00000 n\r\n";
+	return sXref + "trailer\n<</Size " + PdfObject::FormatInteger(m_nMain + 1) + ">>\nstartxref\n" + PdfObject::FormatInteger(m_nFirstXref) + "\n%%EOF\n";
+}
+
+/**
+	@param nFirstPage Location of the first page object
+	@param nShared Location of the first shared object
+	The locations are as if there were no hint stream, as the hint tables expect them
+*/
+void LinearizeStage::MakeHints(size_t nFirstPage, size_t nShared)
+{
+	// Page offset hint table
+	int nLeastObjects = m_pageCount[0], nMostObjects = m_pageCount[0];
+	size_t nLeastLength = m_pageLength[0], nMostLength = m_pageLength[0], nMostShared = 0;
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		nLeastObjects = min(nLeastObjects, m_pageCount[i]);
+		nMostObjects = max(nMostObjects, m_pageCount[i]);
+		nLeastLength = min(nLeastLength, m_pageLength[i]);
+		nMostLength = max(nMostLength, m_pageLength[i]);
+		nMostShared = max(nMostShared, m_pageShared[i].size());
+	}
+	int nObjectBits = BitsFor(nMostObjects - nLeastObjects), nLengthBits = BitsFor(nMostLength - nLeastLength);
+	int nSharedBits = BitsFor(nMostShared), nIdBits = BitsFor(m_nPart6 + m_nPart8 - 1);
+
+	HintBits bits;
+	bits.Write(nLeastObjects, 32);
+	bits.Write(nFirstPage, 32);
+	bits.Write(nObjectBits, 16);
+	bits.Write(nLeastLength, 32);
+	bits.Write(nLengthBits, 16);
+	// Content streams: not given separately (the whole page is used instead)
+	bits.Write(0, 32);
+	bits.Write(0, 16);
+	bits.Write(nLeastLength, 32);
+	bits.Write(nLengthBits, 16);
+	bits.Write(nSharedBits, 16);
+	bits.Write(nIdBits, 16);
+	// No fractional positions
+	bits.Write(0, 16);
+	bits.Write(1, 16);
+	for (size_t i = 0; i < m_pages.size(); i++)
+		bits.Write(m_pageCount[i] - nLeastObjects, nObjectBits);
+	bits.Flush();
+	for (size_t i = 0; i < m_pages.size(); i++)
+		bits.Write(m_pageLength[i] - nLeastLength, nLengthBits);
+	bits.Flush();
+	for (size_t i = 0; i < m_pages.size(); i++)
+		bits.Write(m_pageShared[i].size(), nSharedBits);
+	bits.Flush();
+	for (size_t i = 0; i < m_pages.size(); i++)
+		for (std::vector<int>::const_iterator j = m_pageShared[i].begin(); j != m_pageShared[i].end(); j++)
+			bits.Write(*j, nIdBits);
+	bits.Flush();
+	for (size_t i = 0; i < m_pages.size(); i++)
+		bits.Write(m_pageLength[i] - nLeastLength, nLengthBits);
+	bits.Flush();
+	m_nSharedHints = bits.GetData().size();
+
+	// Shared object hint table: one object per group
+	size_t nLeastGroup = (size_t)-1, nMostGroup = 0;
+	for (size_t i = 0; i < m_nPart6 + m_nPart8; i++)
+	{
+		size_t nLength = m_lengths[m_renumber[m_order[m_nPart4 + ((i < m_nPart6) ? i : i + m_nPart7)]]];
+		nLeastGroup = min(nLeastGroup, nLength);
+		nMostGroup = max(nMostGroup, nLength);
+	}
+	int nGroupBits = BitsFor(nMostGroup - nLeastGroup);
+	bits.Write((m_nPart8 > 0) ? m_renumber[m_order[m_nPart4 + m_nPart6 + m_nPart7]] : 0, 32);
+	bits.Write((m_nPart8 > 0) ? nShared : 0, 32);
+	bits.Write(m_nPart6, 32);
+	bits.Write(m_nPart6 + m_nPart8, 32);
+	bits.Write(0, 16);
+	bits.Write(nLeastGroup, 32);
+	bits.Write(nGroupBits, 16);
+	for (size_t i = 0; i < m_nPart6 + m_nPart8; i++)
+		bits.Write(m_lengths[m_renumber[m_order[m_nPart4 + ((i < m_nPart6) ? i : i + m_nPart7)]]] - nLeastGroup, nGroupBits);
+	bits.Flush();
+	// No MD5 signatures
+	for (size_t i = 0; i < m_nPart6 + m_nPart8; i++)
+		bits.Write(0, 1);
+	bits.Flush();
+	m_sHints = bits.GetData();
+}
+
+/**
+	@return The hint stream object
+*/
+std::string LinearizeStage::MakeHintStream() const
+{
+	PdfObject hints;
+	hints.eType = PdfObject::Stream;
+	hints.Set("S", PdfObject::MakeInteger(m_nSharedHints));
+	hints.sValue = m_sHints;
+	std::string sObject = PdfObject::FormatInteger(m_nHint) + " 0 obj\n";
+	hints.Write(sObject);
+	return sObject + "\nendobj\n";
+}
+
+/**
+	@param doc The document
+*/
+void LinearizeStage::Layout(PdfDocument& doc)
+{
+	// Page sizes
+	m_pageLength.assign(m_pages.size(), 0);
+	size_t nObject = m_nPart4;
+	for (size_t nPage = 0; nPage < m_pages.size(); nPage++)
+		for (int i = 0; i < m_pageCount[nPage]; i++)
+			m_pageLength[nPage] += m_lengths[m_renumber[m_order[nObject++]]];
+
+	// The start (the numbers in it always take the same space)
+	m_offsets.clear();
+	size_t nOffset = doc.GetHeader().size() + MakeParameters().size();
+	m_nFirstXref = nOffset;
+	nOffset += MakeFirstXref(doc).size();
+	m_offsets.assign(m_nSize, 0);
+	m_offsets[m_nParameters] = doc.GetHeader().size();
+	for (size_t i = 0; i < m_nPart4; i++)
+	{
+		m_offsets[m_renumber[m_order[i]]] = nOffset;
+		nOffset += m_lengths[m_renumber[m_order[i]]];
+	}
+
+	// The hints only need the locations as if they weren't there
+	size_t nShared = nOffset;
+	for (size_t i = m_nPart4; i < m_nPart4 + m_nPart6 + m_nPart7; i++)
+		nShared += m_lengths[m_renumber[m_order[i]]];
+	MakeHints(nOffset, nShared);
+	m_nHintOffset = nOffset;
+	m_offsets[m_nHint] = nOffset;
+	m_nHintLength = MakeHintStream().size();
+	nOffset += m_nHintLength;
+
+	for (size_t i = m_nPart4; i < m_order.size(); i++)
+	{
+		m_offsets[m_renumber[m_order[i]]] = nOffset;
+		nOffset += m_lengths[m_renumber[m_order[i]]];
+		if (i + 1 == m_nPart4 + m_nPart6)
+			m_nEndFirstPage = nOffset;
+	}
+	m_nMainXref = nOffset;
+	m_nFileLength = nOffset + MakeMainXref().size();
+}
+
+/**
+	@param doc The document
+	@param out Where to write it
+	@return true if everything went where the layout said it would
+*/
+bool LinearizeStage::Write(PdfDocument& doc, PdfOutput& out)
+{
+	out.Write(doc.GetHeader());
+	out.Write(MakeParameters());
+	out.Write(MakeFirstXref(doc));
+	for (size_t i = 0; i < m_order.size(); i++)
+	{
+		if (i == m_nPart4)
+		{
+			if (out.GetOffset() != m_nHintOffset)
+				return false;
+			out.Write(MakeHintStream());
+		}
+		if (out.GetOffset() != m_offsets[m_renumber[m_order[i]]])
+			return false;
+		WriteObject(doc, m_order[i], out);
+	}
+	if (out.GetOffset() != m_nMainXref)
+		return false;
+	out.Write(MakeMainXref());
+	return out.GetOffset() == m_nFileLength;
+}
+
+/**
+	@return Bytes used by the plan's tables
+*/
+size_t LinearizeStage::GetMemoryUse() const
+{
+	size_t nBytes = m_flags.capacity() + m_useCount.capacity() + (m_firstPage.capacity() + m_visited.capacity() + m_pages.capacity() + m_order.capacity()) * sizeof(int);
+	for (std::vector<std::vector<int> >::const_iterator i = m_refs.begin(); i != m_refs.end(); i++)
+		nBytes += sizeof(*i) + (*i).capacity() * sizeof(int);
+	for (std::vector<std::vector<int> >::const_iterator i = m_pageObjects.begin(); i != m_pageObjects.end(); i++)
+		nBytes += sizeof(*i) + (*i).capacity() * sizeof(int);
+	// (and what's still to come: new numbers, sizes and locations of every object)
+	return nBytes + m_flags.size() * (sizeof(int) + 2 * sizeof(size_t));
+}
@@ -0,0 +1,167 @@
+/**
+	@file
+	@brief Post-processing stage writing the document linearized (Fast Web View)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PDFLINEARIZE_H_
+#define _PDFLINEARIZE_H_
+
+#include "PdfPipeline.h"
+
+/**
+    @brief Writes the document linearized, so viewers can show the first page (and then
+	any page) before the whole file was downloaded
+
+	The objects are renumbered and arranged by page as the PDF reference (Annex F) lays it
+	out: the catalog and the first page first, with their own cross-reference table, the
+	hint tables telling the viewer where every page and shared object is, and then the
+	other pages, the objects they share, and everything else. Objects nothing refers to
+	are dropped.
+
+	Only the object graph is kept in memory: planning goes over the objects without
+	keeping them, the sizes are measured by writing everything without a file, and the
+	real write copies stream data straight from the mapped input. The job result gets
+	postprocess.linearize.memory, the size of the tables the plan needed.
+
+	Since every object is read, the whole input is in memory by the time it's written:
+	documents over linearize.maxsize (default 1G, 0 for no limit) are left as they are,
+	and postprocess.linearize.error says why.
+*/
+class LinearizeStage : public PdfStage
+{
+public:
+	/// Ctor
+	LinearizeStage();
+
+	/**
+		@brief Returns the stage name
+		@return "linearize"
+	*/
+	virtual const char*	GetName() const {return "linearize";};
+	/// Plans the new layout
+	virtual bool		Process(PdfDocument& doc, JobResult& result);
+	/**
+		@brief Checks if the stage writes the document itself
+		@return true
+	*/
+	virtual bool		WritesDocument() const {return true;};
+	/// Writes the document, linearized
+	virtual bool		Save(PdfDocument& doc, const char* pFile, JobResult& result);
+
+protected:
+	/// Finds the pages, in order
+	bool				FindPages(PdfDocument& doc, int nNode, int nDepth);
+	/// Decides which part of the file each object goes to
+	void				Classify(PdfDocument& doc);
+	/// Goes over the objects reachable from a list of objects
+	void				Reach(const std::vector<int>& start, std::vector<int>& reached, bool bPagesOnly);
+	/// Gives the objects their new numbers
+	void				Renumber();
+	/// Finds where everything goes
+	void				Layout(PdfDocument& doc);
+	/// Writes everything (or, without a file, measures it)
+	bool				Write(PdfDocument& doc, PdfOutput& out);
+	/// Writes an object (with its new number)
+	size_t				WriteObject(PdfDocument& doc, int nOld, PdfOutput& out);
+
+	/// Creates the linearization parameters object
+	std::string			MakeParameters() const;
+	/// Creates the first page cross-reference table and trailer
+	std::string			MakeFirstXref(PdfDocument& doc) const;
+	/// Creates the main cross-reference table and trailer
+	std::string			MakeMainXref() const;
+	/// Creates the hint tables
+	void				MakeHints(size_t nFirstPage, size_t nShared);
+	/// Creates the hint stream object
+	std::string			MakeHintStream() const;
+	/// Returns the memory the plan takes
+	size_t				GetMemoryUse() const;
+
+protected:
+	/// The pages (old object numbers), in order
+	std::vector<int>	m_pages;
+	/// Per object (old number): references to other objects
+	std::vector<std::vector<int> >	m_refs;
+	/// Per object: what it is and where it goes (LF_ flags)
+	std::vector<unsigned char>	m_flags;
+	/// Per object: the first page using it (-1 if none)
+	std::vector<int>	m_firstPage;
+	/// Per object: how many pages use it (up to 2: shared)
+	std::vector<unsigned char>	m_useCount;
+	/// Per object: last traversal that reached it
+	std::vector<int>	m_visited;
+	/// Current traversal
+	int					m_nVisit;
+	/// Per page: the objects it uses (other than the page itself)
+	std::vector<std::vector<int> >	m_pageObjects;
+	/// Objects (old numbers) in the order they're written: parts 4, 6, 7, 8 and 9
+	std::vector<int>	m_order;
+	/// Objects in the document level part (catalog and what's needed to open the document)
+	size_t				m_nPart4;
+	/// Objects in the first page part
+	size_t				m_nPart6;
+	/// Objects in the other pages part
+	size_t				m_nPart7;
+	/// Objects in the shared objects part
+	size_t				m_nPart8;
+	/// Per page: objects in the page's part (for the first page, all of part 6)
+	std::vector<int>	m_pageCount;
+	/// Per page: size of the page's part
+	std::vector<size_t>	m_pageLength;
+	/// Per page: the shared objects it uses (hint table identifiers)
+	std::vector<std::vector<int> >	m_pageShared;
+	/// New object numbers, by old number (0 for dropped objects)
+	std::vector<int>	m_renumber;
+	/// Object sizes, by new number
+	std::vector<size_t>	m_lengths;
+	/// Object locations, by new number
+	std::vector<size_t>	m_offsets;
+	/// Objects in the main cross-reference table (numbered 1 to this)
+	int					m_nMain;
+	/// Number of the linearization parameters object
+	int					m_nParameters;
+	/// Number of the hint stream object
+	int					m_nHint;
+	/// Object count (the trailer's Size)
+	int					m_nSize;
+	/// Hint tables
+	std::string			m_sHints;
+	/// Location of the shared objects hint table in the hint tables
+	size_t				m_nSharedHints;
+	/// Location of the first page cross-reference table
+	size_t				m_nFirstXref;
+	/// Location of the hint stream
+	size_t				m_nHintOffset;
+	/// Size of the hint stream
+	size_t				m_nHintLength;
+	/// End of the first page
+	size_t				m_nEndFirstPage;
+	/// Location of the main cross-reference table
+	size_t				m_nMainXref;
+	/// File size
+	size_t				m_nFileLength;
+};
+
+#endif   //#define _PDFLINEARIZE_H_
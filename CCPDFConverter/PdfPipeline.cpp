@@ -0,0 +1,248 @@
+/**
+	@file
+	@brief Post-processing of the converted PDF: stages working on one parsed document
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfPipeline.h"
+#include "PdfLinearize.h"
+#include "PdfCompact.h"
+
+/// Characters separating stage names
+#define STAGE_SEPARATORS	", \t"
+
+/**
+    @brief Sets document information (Title, Author, Subject, Keywords...) from the settings
+
+	Every metadata.<key> setting becomes the <key> entry of the document information
+	dictionary (e.g. metadata.Author = Accounts Department). Settings are in the system code
+	page: values that aren't plain ASCII are written as UTF-16BE.
+*/
+class MetadataStage : public PdfStage
+{
+public:
+	/**
+		@brief Returns the stage name
+		@return "metadata"
+	*/
+	virtual const char*	GetName() const {return "metadata";};
+	/// Processes the document
+	virtual bool		Process(PdfDocument& doc, JobResult& result);
+};
+
+/**
+	@param doc The document to change
+	@param result The job result (not used)
+	@return true if the information dictionary was updated
+*/
+bool MetadataStage::Process(PdfDocument& doc, JobResult& /*result*/)
+{
+	PdfObject* pInfo = doc.Resolve(doc.GetTrailer().Get("Info"));
+	if ((pInfo == NULL) || !pInfo->Is(PdfObject::Dictionary))
+	{
+		// No information dictionary yet: add one
+		int nInfo = doc.AddObject(PdfObject::MakeDictionary());
+		doc.GetTrailer().Set("Info", PdfObject::MakeReference(nInfo));
+		pInfo = doc.GetObject(nInfo);
+	}
+
+	static const std::string sPrefix = "metadata.";
+	for (configuration::data::const_iterator i = myconfigdata.begin(); i != myconfigdata.end(); i++)
+		if (((*i).first.size() > sPrefix.size()) && ((*i).first.compare(0, sPrefix.size(), sPrefix) == 0))
+			pInfo->Set((*i).first.substr(sPrefix.size()), PdfObject::MakeTextString((*i).second));
+	return true;
+}
+
+/**
+	@param liStart Start counter value
+	@return Milliseconds since then
+*/
+double PdfPipeline::ElapsedSince(const LARGE_INTEGER& liStart)
+{
+	LARGE_INTEGER liEnd, liFreq;
+	QueryPerformanceCounter(&liEnd);
+	QueryPerformanceFrequency(&liFreq);
+	return (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFreq.QuadPart;
+}
+
+/**
+*/
+PdfPipeline::PdfPipeline() : m_pWriter(NULL)
+{
+}
+
+/**
+*/
+PdfPipeline::~PdfPipeline()
+{
+	for (std::vector<PdfStage*>::iterator i = m_stages.begin(); i != m_stages.end(); i++)
+		delete *i;
+	if (m_pWriter != NULL)
+		delete m_pWriter;
+}
+
+/**
+	@param sName The stage name
+	@return The new stage (to be deleted by the caller), or NULL if there's no such stage
+*/
+PdfStage* PdfPipeline::CreateStage(const std::string& sName)
+{
+	if (sName == "metadata")
+		return new MetadataStage;
+	if (sName == "linearize")
+		return new LinearizeStage;
+	if (sName == "compact")
+		return new CompactStage;
+	return NULL;
+}
+
+/**
+	@param sList Stage names, separated by commas or spaces
+	@return true if all the stages were recognized, and can be used together
+*/
+bool PdfPipeline::AddStages(const std::string& sList)
+{
+	bool bRet = true;
+	size_t nPos = 0;
+	while ((nPos = sList.find_first_not_of(STAGE_SEPARATORS, nPos)) != std::string::npos)
+	{
+		size_t nEnd = sList.find_first_of(STAGE_SEPARATORS, nPos);
+		std::string sName = sList.substr(nPos, (nEnd == std::string::npos) ? std::string::npos : nEnd - nPos);
+		nPos = nEnd;
+		PdfStage* pStage = CreateStage(sName);
+		if (pStage == NULL)
+		{
+			if (!m_sUnknown.empty())
+				m_sUnknown += ',';
+			m_sUnknown += sName;
+			bRet = false;
+			continue;
+		}
+		if (!pStage->WritesDocument())
+		{
+			m_stages.push_back(pStage);
+			continue;
+		}
+		if (m_pWriter != NULL)
+		{
+			// Only one stage can write the document: neither is picked over the other
+			if (m_sConflict.empty())
+				m_sConflict = m_pWriter->GetName();
+			m_sConflict += std::string(" and ") + pStage->GetName();
+			delete pStage;
+			bRet = false;
+			continue;
+		}
+		m_pWriter = pStage;
+	}
+	return bRet;
+}
+
+/**
+	@param lpPrinter The print queue the job came from (NULL or empty if not known)
+	@return true if all the stages were recognized, and can be used together
+*/
+bool PdfPipeline::AddConfiguredStages(LPCTSTR lpPrinter)
+{
+	std::string sList = myconfigdata.getstring("postprocess", "");
+	if ((lpPrinter != NULL) && (lpPrinter[0] != '\0'))
+		sList = myconfigdata.getstring(std::string("postprocess.") + lpPrinter, sList);
+	return AddStages(sList);
+}
+
+/**
+	@param lpFile The converted document (replaced by the processed one)
+	@param result The job result to add the timing to
+	@return true if all the stages were done and the document was replaced
+*/
+bool PdfPipeline::Run(LPCTSTR lpFile, JobResult& result)
+{
+	if (!m_sUnknown.empty())
+		result["postprocess.unknown"] = m_sUnknown;
+	if (!m_sConflict.empty())
+	{
+		// Not what was asked for, so nothing is done
+		result["postprocess.conflict"] = m_sConflict + " both write the document, only one of them can be set";
+		result["postprocess.error"] = "conflict";
+		return false;
+	}
+	if (!HasStages())
+		return true;
+
+	std::string sStages;
+	for (std::vector<PdfStage*>::const_iterator i = m_stages.begin(); i != m_stages.end(); i++)
+	{
+		if (!sStages.empty())
+			sStages += ',';
+		sStages += (*i)->GetName();
+	}
+	if (m_pWriter != NULL)
+		sStages += std::string(sStages.empty() ? "" : ",") + m_pWriter->GetName();
+	result["postprocess.stages"] = sStages;
+
+	LARGE_INTEGER liStart;
+	QueryPerformanceCounter(&liStart);
+	PdfDocument doc;
+	bool bLoaded = doc.Load(lpFile);
+	result.SetTime("time.postprocess.parse", ElapsedSince(liStart));
+	if (!bLoaded)
+	{
+		result["postprocess.error"] = "parse";
+		return false;
+	}
+
+	std::vector<PdfStage*> stages(m_stages);
+	if (m_pWriter != NULL)
+		stages.push_back(m_pWriter);
+	for (std::vector<PdfStage*>::const_iterator i = stages.begin(); i != stages.end(); i++)
+	{
+		QueryPerformanceCounter(&liStart);
+		bool bDone = (*i)->Process(doc, result);
+		result.SetTime(std::string("time.postprocess.") + (*i)->GetName(), ElapsedSince(liStart));
+		if (!bDone)
+		{
+			// The document may be half done: leave the converted one as it is
+			result["postprocess.error"] = (*i)->GetName();
+			return false;
+		}
+	}
+
+	// Written next to the original, then swapped in
+	QueryPerformanceCounter(&liStart);
+	TCHAR cProcessed[MAX_PATH + 16];
+	sprintf_s(cProcessed, sizeof(cProcessed), "%s.pp", lpFile);
+	bool bSaved = (m_pWriter != NULL) ? m_pWriter->Save(doc, cProcessed, result) : doc.Save(cProcessed);
+	// (The original is mapped until the document is closed)
+	doc.Close();
+	bSaved = bSaved && MoveFileEx(cProcessed, lpFile, MOVEFILE_REPLACE_EXISTING);
+	result.SetTime("time.postprocess.write", ElapsedSince(liStart));
+	if (!bSaved)
+	{
+		DeleteFile(cProcessed);
+		result["postprocess.error"] = "write";
+		return false;
+	}
+	return true;
+}
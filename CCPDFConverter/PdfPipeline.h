@@ -0,0 +1,122 @@
+/**
+	@file
+	@brief Post-processing of the converted PDF: stages working on one parsed document
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PDFPIPELINE_H_
+#define _PDFPIPELINE_H_
+
+#include "PdfDocument.h"
+#include "JobResult.h"
+
+/**
+    @brief A post-processing stage: changes the parsed document in place
+*/
+class PdfStage
+{
+public:
+	/// Dtor
+	virtual ~PdfStage() {};
+
+	/**
+		@brief Returns the stage name (as used in the settings)
+		@return The name
+	*/
+	virtual const char*	GetName() const = 0;
+	/**
+		@brief Processes the document
+		@param doc The document to change
+		@param result The job result, for anything the stage wants to report
+		@return true if the stage succeeded
+	*/
+	virtual bool		Process(PdfDocument& doc, JobResult& result) = 0;
+	/**
+		@brief Checks if the stage writes the document itself (in its own layout)
+		@return true if it does; such a stage always runs last
+	*/
+	virtual bool		WritesDocument() const {return false;};
+	/**
+		@brief Writes the document (for stages that write it themselves)
+		@param doc The document to write
+		@param pFile The file to write it to
+		@param result The job result, for anything the stage wants to report
+		@return true if the document was written
+	*/
+	virtual bool		Save(PdfDocument& doc, const char* pFile, JobResult& /*result*/) {return doc.Save(pFile);};
+};
+
+/**
+    @brief Runs the post-processing stages on the converted document
+
+	The document is parsed once, passed from stage to stage, and written once (objects no
+	stage touched are copied as they are). The stages are set per print queue:
+	postprocess.<printer name> is used if it's there, otherwise postprocess; either is a
+	list of stage names separated by commas or spaces.
+
+	Only one stage can write the document (e.g. linearize or compact); it runs after all the
+	others, wherever it's listed. Listing more than one is an error: the document is left as
+	it was converted, and postprocess.conflict says which stages were listed together.
+
+	The job result gets postprocess.stages, the time each stage took (time.postprocess.<stage>),
+	the parse and write times (time.postprocess.parse, time.postprocess.write), and
+	postprocess.error if anything failed (the converted document is then left as it was).
+*/
+class PdfPipeline
+{
+public:
+	/// Ctor
+	PdfPipeline();
+	/// Dtor
+	virtual ~PdfPipeline();
+
+	/// Adds the stages set for a print queue
+	bool				AddConfiguredStages(LPCTSTR lpPrinter);
+	/// Adds stages from a list of names
+	bool				AddStages(const std::string& sList);
+	/**
+		@brief Checks if there's anything to do
+		@return true if there are stages
+	*/
+	bool				HasStages() const {return !m_stages.empty() || (m_pWriter != NULL);};
+	/// Runs the stages on a file (replacing it)
+	bool				Run(LPCTSTR lpFile, JobResult& result);
+
+	/// Creates a stage by name
+	static PdfStage*	CreateStage(const std::string& sName);
+	/// Returns the time since a performance counter value
+	static double		ElapsedSince(const LARGE_INTEGER& liStart);
+
+protected:
+	/// The stages, in order
+	std::vector<PdfStage*>	m_stages;
+	/// The stage that writes the document (NULL to write it as it is); not in m_stages
+	PdfStage*			m_pWriter;
+	/// Stage names that weren't recognized
+	std::string			m_sUnknown;
+	/// Names of the stages writing the document, if more than one was listed (empty if not)
+	std::string			m_sConflict;
+};
+
+#endif   //#define _PDFPIPELINE_H_
@@ -0,0 +1,263 @@
+/**
+	@file
+	@brief PDF/A output: prepared definition file and output intent
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfaSupport.h"
+#include "Configuration.h"
+#include <shlobj.h>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <tchar.h>
+
+namespace PdfaSupport
+{
+
+/// Name of the definitions template (in the lib folder) and of the prepared copy
+#define PDFA_DEF_FILE		"PDFA_def.ps"
+/// Start of the first line of the prepared copy, followed by the settings it was built for
+#define PREPARED_KEY		"% CCPDFConverter prepared: "
+
+/// The prepared definitions file (empty until prepared in this process)
+static std::string sPrepared;
+/// Color model of the output intent profile
+static std::string sColorModel;
+/// Time the last preparation took
+static double dPrepareTime = 0;
+/// true if the last preparation reused the prepared file
+static bool bCached = false;
+
+/**
+	@param lpFile The file
+	@return Size and modification time of the file, as text (empty if it doesn't exist)
+*/
+static std::string GetFileStamp(LPCTSTR lpFile)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesEx(lpFile, GetFileExInfoStandard, &data))
+		return "";
+	char cStamp[64];
+	sprintf_s(cStamp, sizeof(cStamp), "%u/%u/%08X%08X", data.nFileSizeHigh, data.nFileSizeLow, data.ftLastWriteTime.dwHighDateTime, data.ftLastWriteTime.dwLowDateTime);
+	return cStamp;
+}
+
+/**
+	@param lpICC The ICC profile file
+	@param nComponents Filled with the count of color components
+	@return The GhostScript color model of the profile (DeviceRGB, DeviceGray or DeviceCMYK), empty if unknown
+*/
+static std::string ReadColorModel(LPCTSTR lpICC, int& nComponents)
+{
+	// The color space signature is at offset 16 of the profile header
+	char cHeader[20];
+	FILE* pFile;
+	if (_tfopen_s(&pFile, lpICC, _T("rb")) != 0)
+		return "";
+	size_t nRead = fread(cHeader, 1, sizeof(cHeader), pFile);
+	fclose(pFile);
+	if (nRead < sizeof(cHeader))
+		return "";
+	if (strncmp(cHeader + 16, "RGB ", 4) == 0)
+	{
+		nComponents = 3;
+		return "DeviceRGB";
+	}
+	if (strncmp(cHeader + 16, "GRAY", 4) == 0)
+	{
+		nComponents = 1;
+		return "DeviceGray";
+	}
+	if (strncmp(cHeader + 16, "CMYK", 4) == 0)
+	{
+		nComponents = 4;
+		return "DeviceCMYK";
+	}
+	return "";
+}
+
+/**
+	@param s The text to put in a PostScript string
+	@return The text, with forward slashes and escaped parentheses
+*/
+static std::string ToPSString(const std::string& s)
+{
+	std::string sRet;
+	for (std::string::const_iterator i = s.begin(); i != s.end(); i++)
+	{
+		if (*i == '\\')
+			sRet += '/';
+		else
+		{
+			if ((*i == '(') || (*i == ')'))
+				sRet += '\\';
+			sRet += *i;
+		}
+	}
+	return sRet;
+}
+
+/**
+	@return true if the prepared definitions file is ready
+*/
+static bool Prepare()
+{
+	if (!sPrepared.empty())
+	{
+		// Already done in this process
+		return true;
+	}
+
+	LARGE_INTEGER liStart, liEnd, liFreq;
+	QueryPerformanceCounter(&liStart);
+
+	// The template is in the lib folder next to the application
+	TCHAR cTemplate[MAX_PATH];
+	if (!GetModuleFileName(NULL, cTemplate, MAX_PATH))
+		return false;
+	TCHAR* pPos = _tcsrchr(cTemplate, '\\');
+	if (pPos == NULL)
+		return false;
+	_tcscpy_s(pPos + 1, MAX_PATH - (pPos + 1 - cTemplate), _T("lib\\") _T(PDFA_DEF_FILE));
+
+	// The output intent profile
+	TCHAR cDefaultICC[MAX_PATH];
+	GetWindowsDirectory(cDefaultICC, MAX_PATH);
+	_tcscat_s(cDefaultICC, _T("\\System32\\spool\\drivers\\color\\sRGB Color Space Profile.icm"));
+	std::string sICC = myconfigdata.getstring("pdfa.icc", cDefaultICC);
+	std::string sCondition = myconfigdata.getstring("pdfa.condition", "sRGB IEC61966-2.1");
+	int nComponents = 0;
+	std::string sModel = ReadColorModel(sICC.c_str(), nComponents);
+	if (sModel.empty())
+		return false;
+
+	// Where the prepared copy goes
+	TCHAR cPrepared[MAX_PATH];
+	if (SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA | CSIDL_FLAG_CREATE, NULL, SHGFP_TYPE_CURRENT, cPrepared) != S_OK)
+		GetTempPath(MAX_PATH, cPrepared);
+	_tcscat_s(cPrepared, _T("\\CCPDFConverter"));
+	CreateDirectory(cPrepared, NULL);
+	_tcscat_s(cPrepared, _T("\\") _T(PDFA_DEF_FILE));
+
+	// Is the prepared copy there, and made from the same things?
+	std::string sKey = std::string(PREPARED_KEY) + GetFileStamp(cTemplate) + "|" + sICC + "|" + GetFileStamp(sICC.c_str()) + "|" + sCondition;
+	std::string sLine;
+	{
+		std::ifstream in(cPrepared);
+		std::getline(in, sLine);
+	}
+	bCached = (sLine == sKey);
+	if (!bCached)
+	{
+		// No, so make it
+		std::ifstream in(cTemplate);
+		if (!in)
+			return false;
+		std::ostringstream out;
+		out << sKey << '\n';
+		bool bSkipDocInfo = false;
+		while (std::getline(in, sLine))
+		{
+			if (bSkipDocInfo)
+			{
+				// The template's sample title is not ours to set
+				bSkipDocInfo = false;
+				if (sLine.find("/DOCINFO") != std::string::npos)
+					continue;
+			}
+			if (sLine.compare(0, 11, "/ICCProfile") == 0)
+				out << "/ICCProfile (" << ToPSString(sICC) << ")\n";
+			else if (sLine.find("/Title (Title)") != std::string::npos)
+				bSkipDocInfo = true;
+			else if (sLine.find("/N systemdict /ProcessColorModel") != std::string::npos)
+				out << "[{icc_PDFA} <</N " << nComponents << " >> /PUT pdfmark\n";
+			else if (sLine.find("/OutputConditionIdentifier") != std::string::npos)
+				out << "  /OutputConditionIdentifier (" << ToPSString(sCondition) << ")\n";
+			else
+				out << sLine << '\n';
+		}
+
+		// Replace it in one step, other converters may be using it
+		TCHAR cTemp[MAX_PATH + 16];
+		_stprintf_s(cTemp, MAX_PATH + 16, _T("%s.%u"), cPrepared, GetCurrentProcessId());
+		{
+			std::ofstream f(cTemp);
+			f << out.str();
+			if (!f)
+				return false;
+		}
+		if (!MoveFileEx(cTemp, cPrepared, MOVEFILE_REPLACE_EXISTING))
+		{
+			DeleteFile(cTemp);
+			return false;
+		}
+	}
+
+	sPrepared = cPrepared;
+	sColorModel = sModel;
+	QueryPerformanceCounter(&liEnd);
+	QueryPerformanceFrequency(&liFreq);
+	dPrepareTime = (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFreq.QuadPart;
+	return true;
+}
+
+/**
+	@param args The flags to add to
+	@return true if PDF/A output can be created
+*/
+bool GetArgs(ARGLIST& args)
+{
+	if (!Prepare())
+		return false;
+
+	args.push_back("-dPDFA=" + myconfigdata.getstring("pdfa.level", "1"));
+	args.push_back("-dPDFACompatibilityPolicy=1");
+	args.push_back("-dNOOUTERSAVE");
+	args.push_back("-sProcessColorModel=" + sColorModel);
+	// DeviceRGB -> RGB etc.
+	args.push_back("-sColorConversionStrategy=" + sColorModel.substr(6));
+	// The definitions run before the document
+	args.push_back(sPrepared);
+	return true;
+}
+
+/**
+	@return The time (in milliseconds)
+*/
+double GetPrepareTime()
+{
+	return dPrepareTime;
+}
+
+/**
+	@return true if the prepared definitions were reused
+*/
+bool WasCached()
+{
+	return bCached;
+}
+
+}
@@ -0,0 +1,59 @@
+/**
+	@file
+	@brief PDF/A output: prepared definition file and output intent
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PDFASUPPORT_H_
+#define _PDFASUPPORT_H_
+
+#include "Sidecar.h"
+
+/**
+    @brief Prepares the PDF/A definitions for the "pdfa" conversion profile
+
+	The lib\\PDFA_def.ps file shipped with the application is a template: it needs the
+	output intent ICC profile and its color model filled in. This is done once, into a
+	prepared copy kept in the local application data folder; it is only rebuilt when the
+	template, the ICC profile or the settings change, and a process that converts more
+	than once (retries) reuses it without checking again.
+
+	Settings:
+	- pdfa.icc: the output intent ICC profile (default: the Windows sRGB profile)
+	- pdfa.condition: the output condition identifier (default: "sRGB IEC61966-2.1")
+	- pdfa.level: the PDF/A part (1 or 2, default 1)
+*/
+namespace PdfaSupport
+{
+
+/// Adds the GhostScript flags needed for PDF/A output (preparing the definitions if needed)
+bool GetArgs(ARGLIST& args);
+/// Returns the time the last preparation took (in milliseconds)
+double GetPrepareTime();
+/// Checks if the last preparation could reuse the prepared definitions
+bool WasCached();
+
+}
+
+#endif   //#define _PDFASUPPORT_H_
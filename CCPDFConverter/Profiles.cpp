@@ -0,0 +1,106 @@
+/**
+	@file
+	@brief Conversion profiles: sets of GhostScript flags with a fallback
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "Profiles.h"
+#include "Configuration.h"
+#include "PdfaSupport.h"
+#include <sstream>
+
+/// Built-in profile definition
+struct BuiltInProfile
+{
+	/// Profile name
+	const char*	pName;
+	/// Extra flags
+	const char*	pArgs;
+	/// Fallback profile name
+	const char*	pFallback;
+};
+
+/// The built-in profiles
+static const BuiltInProfile BUILTIN_PROFILES[] =
+{
+	{"standard",	"",																			"safe"},
+	{"fast",		"-dPDFSETTINGS=/ebook",														"safe"},
+	{"safe",		"-dPDFSETTINGS=/default -dEmbedAllFonts=true -dSubsetFonts=false",			""},
+};
+
+/**
+	@param sName Name of the profile
+	@param profile Profile to fill
+	@return true if a profile by this name exists (in the configuration or built in)
+*/
+bool GetConversionProfile(const std::string& sName, ConversionProfile& profile)
+{
+	profile.sName = sName;
+	profile.args.clear();
+	profile.sFallback.clear();
+
+	// Configuration first
+	std::string sKey = "profile." + sName;
+	if (myconfigdata.iskey(sKey))
+	{
+		profile.args = SplitArgs(myconfigdata[sKey]);
+		profile.sFallback = myconfigdata.getstring(sKey + ".fallback", "");
+		return true;
+	}
+
+	for (int i = 0; i < (int)(sizeof(BUILTIN_PROFILES) / sizeof(BUILTIN_PROFILES[0])); i++)
+	{
+		if (sName == BUILTIN_PROFILES[i].pName)
+		{
+			profile.args = SplitArgs(BUILTIN_PROFILES[i].pArgs);
+			profile.sFallback = myconfigdata.getstring(sKey + ".fallback", BUILTIN_PROFILES[i].pFallback);
+			return true;
+		}
+	}
+
+	if (sName == "pdfa")
+	{
+		// PDF/A output needs its definitions prepared first
+		if (!PdfaSupport::GetArgs(profile.args))
+			return false;
+		profile.sFallback = myconfigdata.getstring(sKey + ".fallback", "");
+		return true;
+	}
+	return false;
+}
+
+/**
+	@param sArgs The flags
+	@return List of flags
+*/
+ARGLIST SplitArgs(const std::string& sArgs)
+{
+	ARGLIST args;
+	std::istringstream in(sArgs);
+	std::string sArg;
+	while (in >> sArg)
+		args.push_back(sArg);
+	return args;
+}
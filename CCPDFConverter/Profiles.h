@@ -0,0 +1,64 @@
+/**
+	@file
+	@brief Conversion profiles: sets of GhostScript flags with a fallback
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PROFILES_H_
+#define _PROFILES_H_
+
+#include "Sidecar.h"
+
+/**
+    @brief A named set of extra pdfwrite flags, and the profile to retry with if it fails
+
+	Built-in profiles:
+	- standard: no extra flags; falls back to safe
+	- fast: -dPDFSETTINGS=/ebook; falls back to safe
+	- safe: -dPDFSETTINGS=/default with all fonts fully embedded; no fallback
+	- pdfa: PDF/A output using the prepared lib\\PDFA_def.ps (see PdfaSupport); no fallback
+
+	Any profile can be defined or replaced in the configuration file:
+	@code
+	profile = fast
+	profile.fast = -dPDFSETTINGS=/screen -dDetectDuplicateImages=true
+	profile.fast.fallback = safe
+	@endcode
+*/
+struct ConversionProfile
+{
+	/// Profile name
+	std::string		sName;
+	/// Extra GhostScript flags
+	ARGLIST			args;
+	/// Name of the profile to retry with (empty for none)
+	std::string		sFallback;
+};
+
+/// Finds a conversion profile by name
+bool GetConversionProfile(const std::string& sName, ConversionProfile& profile);
+/// Splits a string of flags on white space
+ARGLIST SplitArgs(const std::string& sArgs);
+
+#endif   //#define _PROFILES_H_
@@ -0,0 +1,224 @@
+/**
+	@file
+	@brief Progressive delivery of large documents as page range chunks
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "ProgressiveDelivery.h"
+#include "Configuration.h"
+#include "OutputWriter.h"
+#include <deque>
+#include <fstream>
+#include <stdio.h>
+
+/// Default time limit of each chunk's helper, when the job has none (in seconds)
+#define DEFAULT_CHUNK_TIME		600
+/// Extra time given to the scheduler to collect the helpers it killed (in milliseconds)
+#define FINISH_MARGIN			10000
+
+/// A chunk being converted
+struct RunningChunk
+{
+	/// The helper
+	PageSidecar*	pSidecar;
+	/// First page
+	int				nFirst;
+	/// Last page (if the document has that many)
+	int				nLast;
+	/// File name (in the chunks folder)
+	std::string		sFile;
+};
+
+/**
+	@param spool The input data
+*/
+ProgressiveDelivery::ProgressiveDelivery(SpoolBuffer& spool) : m_spool(spool), m_nMemoryLimit(0), m_dwTimeLimit(0), m_nFailed(0), m_hThread(NULL), m_bStop(false)
+{
+	m_nChunkPages = max(1, (int)myconfigdata.getint("progressive.pages", 50));
+	m_nParallel = max(1, (int)myconfigdata.getint("progressive.parallel", 2));
+}
+
+/**
+*/
+ProgressiveDelivery::~ProgressiveDelivery()
+{
+	if (m_hThread != NULL)
+	{
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+	}
+}
+
+/**
+	@param lpDocument The final document
+	@param args Flags for the helpers (the conversion profile's)
+	@param nMemoryLimit Memory limit of each helper (0 for none)
+	@param dwTimeLimit Time limit of each helper (0 for the progressive.time setting)
+	@return true if started
+*/
+bool ProgressiveDelivery::Start(LPCTSTR lpDocument, const ARGLIST& args, unsigned __int64 nMemoryLimit, DWORD dwTimeLimit)
+{
+	m_sDocument = lpDocument;
+	m_sFolder = m_sDocument;
+	if ((m_sFolder.size() > 4) && (_stricmp(m_sFolder.c_str() + m_sFolder.size() - 4, ".pdf") == 0))
+		m_sFolder.erase(m_sFolder.size() - 4);
+	m_sFolder += ".pages";
+	if (!CreateDirectory(m_sFolder.c_str(), NULL) && (GetLastError() != ERROR_ALREADY_EXISTS))
+		return false;
+
+	m_args = args;
+	m_args.push_back("-c");
+	m_args.push_back(".setpdfwrite");
+	m_nMemoryLimit = nMemoryLimit;
+	// A chunk is only a preview, so one that hangs must not hold the job
+	m_dwTimeLimit = (dwTimeLimit > 0) ? dwTimeLimit : (DWORD)max(1, (int)myconfigdata.getint("progressive.time", DEFAULT_CHUNK_TIME));
+	WriteManifest(NULL);
+	m_hThread = CreateThread(NULL, 0, SchedulerThread, this, 0, NULL);
+	return m_hThread != NULL;
+}
+
+/**
+	@param lpParam The ProgressiveDelivery object
+	@return 0
+*/
+DWORD WINAPI ProgressiveDelivery::SchedulerThread(LPVOID lpParam)
+{
+	((ProgressiveDelivery*)lpParam)->Run();
+	return 0;
+}
+
+/**
+*/
+void ProgressiveDelivery::Run()
+{
+	std::deque<RunningChunk> running;
+	int nFirst = 1;
+	bool bMore = true;
+	while (bMore || !running.empty())
+	{
+		// Collect the oldest chunk when there's no room for another, or nothing left to start
+		if (!running.empty() && (!bMore || ((int)running.size() >= m_nParallel)))
+		{
+			RunningChunk& chunk = running.front();
+			// The helper wrote "<chunk>.inprogress", which is only published if it succeeded
+			if (chunk.pSidecar->Finish(m_dwTimeLimit * 1000))
+			{
+				// Now that it's done, the page count is known
+				Chunk done;
+				done.sFile = chunk.sFile;
+				done.nFirst = chunk.nFirst;
+				done.nLast = min(chunk.nLast, m_spool.GetPageCount());
+				m_chunks.push_back(done);
+				WriteManifest(NULL);
+			}
+			else
+				m_nFailed++;
+			delete chunk.pSidecar;
+			running.pop_front();
+			continue;
+		}
+
+		// Wait for the next chunk's first page
+		if (m_bStop || (m_spool.WaitForPageStart(nFirst) == DscIndex::NOT_FOUND))
+		{
+			// That's all the pages (or there's no page structure at all, or the job ended)
+			bMore = false;
+			continue;
+		}
+		RunningChunk chunk;
+		chunk.nFirst = nFirst;
+		chunk.nLast = nFirst + m_nChunkPages - 1;
+		char cName[64];
+		sprintf_s(cName, sizeof(cName), "pages-%05d.pdf", nFirst);
+		chunk.sFile = cName;
+		chunk.pSidecar = new PageSidecar(m_spool, chunk.nFirst, chunk.nLast);
+		chunk.pSidecar->SetLimits(m_nMemoryLimit, m_dwTimeLimit);
+		if (chunk.pSidecar->Start("pdfwrite", (m_sFolder + "\\" + chunk.sFile).c_str(), m_args))
+			running.push_back(chunk);
+		else
+		{
+			delete chunk.pSidecar;
+			m_nFailed++;
+		}
+		nFirst += m_nChunkPages;
+	}
+}
+
+/**
+	@param pStatus The job's status (NULL while it runs)
+*/
+void ProgressiveDelivery::WriteManifest(const char* pStatus)
+{
+	configuration::data manifest;
+	manifest["document"] = m_sDocument;
+	manifest["complete"] = (pStatus != NULL) ? "1" : "0";
+	if (pStatus != NULL)
+		manifest["status"] = pStatus;
+	char cKey[32], cNum[16];
+	sprintf_s(cNum, sizeof(cNum), "%u", (unsigned)m_chunks.size());
+	manifest["chunks"] = cNum;
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		sprintf_s(cKey, sizeof(cKey), "chunk.%u.", (unsigned)i + 1);
+		manifest[std::string(cKey) + "file"] = m_chunks[i].sFile;
+		sprintf_s(cNum, sizeof(cNum), "%d", m_chunks[i].nFirst);
+		manifest[std::string(cKey) + "first"] = cNum;
+		sprintf_s(cNum, sizeof(cNum), "%d", m_chunks[i].nLast);
+		manifest[std::string(cKey) + "last"] = cNum;
+	}
+
+	// Readers only ever see a whole manifest
+	std::string sManifest = m_sFolder + "\\manifest";
+	{
+		std::ofstream f((sManifest + ".inprogress").c_str());
+		f << manifest;
+		if (!f)
+			return;
+	}
+	PublishOutput((sManifest + ".inprogress").c_str(), sManifest.c_str());
+}
+
+/**
+	@param bSucceeded true if the document was converted
+	@param result Job result to record the chunk counts in
+*/
+void ProgressiveDelivery::Finish(bool bSucceeded, JobResult& result)
+{
+	if (m_hThread == NULL)
+		return;
+	// No new chunks; the running ones are killed by their time limit, which counts from their start
+	m_bStop = true;
+	if (WaitForSingleObject(m_hThread, m_dwTimeLimit * 1000 + FINISH_MARGIN) != WAIT_OBJECT_0)
+	{
+		// (The manifest is left incomplete, and the destructor still waits for the thread)
+		result["progressive.status"] = "timeout";
+		return;
+	}
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
+	WriteManifest(bSucceeded ? "ok" : "failed");
+	result.SetInt("progressive.chunks", (__int64)m_chunks.size());
+	result.SetInt("progressive.failed", m_nFailed);
+}
@@ -0,0 +1,116 @@
+/**
+	@file
+	@brief Progressive delivery of large documents as page range chunks
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _PROGRESSIVEDELIVERY_H_
+#define _PROGRESSIVEDELIVERY_H_
+
+#include "Sidecar.h"
+#include "JobResult.h"
+
+/**
+    @brief Publishes a large document in chunks of pages while it's being converted
+
+	With the progressive setting, pages are converted in chunks of progressive.pages
+	(default 50) by helper processes (up to progressive.parallel at a time, default 2),
+	each started as soon as its first page arrives (found through the DSC page index).
+	Each helper is limited to the job's time limit (or progressive.time, default 600
+	seconds, if the job has none), so a stuck chunk can't hold up the job.
+	Chunks are written as "<chunk>.inprogress" and published (renamed) when their
+	helper succeeds into "<document>.pages\", along with a manifest that is
+	rewritten (atomically) whenever a chunk is added:
+	- document: the final document
+	- complete: 1 once the job ended (and the document is published)
+	- status: ok or failed (when complete)
+	- chunks: count of chunks
+	- chunk.N.file, chunk.N.first, chunk.N.last: each chunk's file name and pages
+	The final document is still made by the main conversion; the manifest points at it.
+*/
+class ProgressiveDelivery
+{
+public:
+	/// Ctor
+	ProgressiveDelivery(SpoolBuffer& spool);
+	/// Dtor
+	virtual ~ProgressiveDelivery();
+
+	/// Starts converting chunks in the background
+	bool				Start(LPCTSTR lpDocument, const ARGLIST& args, unsigned __int64 nMemoryLimit, DWORD dwTimeLimit);
+	/// Waits for the chunks, and completes the manifest
+	void				Finish(bool bSucceeded, JobResult& result);
+	/**
+		@brief Checks if progressive delivery was started
+		@return true if started
+	*/
+	bool				IsStarted() const {return m_hThread != NULL;};
+
+protected:
+	/// Chunk scheduling thread function
+	static DWORD WINAPI	SchedulerThread(LPVOID lpParam);
+	/// Starts the chunk helpers as their pages arrive, and collects them
+	void				Run();
+	/// Writes the manifest
+	void				WriteManifest(const char* pStatus);
+
+protected:
+	/// A published chunk
+	struct Chunk
+	{
+		/// File name (in the chunks folder)
+		std::string		sFile;
+		/// First page
+		int				nFirst;
+		/// Last page
+		int				nLast;
+	};
+
+	/// The input data
+	SpoolBuffer&		m_spool;
+	/// The final document
+	std::string			m_sDocument;
+	/// Folder of the chunks and manifest
+	std::string			m_sFolder;
+	/// Flags for the helpers
+	ARGLIST				m_args;
+	/// Helper limits
+	unsigned __int64	m_nMemoryLimit;
+	/// Helper limits
+	DWORD				m_dwTimeLimit;
+	/// Pages per chunk
+	int					m_nChunkPages;
+	/// Helpers running at a time
+	int					m_nParallel;
+	/// Published chunks
+	std::vector<Chunk>	m_chunks;
+	/// Count of chunks that failed
+	int					m_nFailed;
+	/// Scheduling thread
+	HANDLE				m_hThread;
+	/// Set when the job ended, so no more chunks are started
+	volatile bool		m_bStop;
+};
+
+#endif   //#define _PROGRESSIVEDELIVERY_H_
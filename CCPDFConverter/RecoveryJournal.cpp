@@ -0,0 +1,304 @@
+/**
+	@file
+	@brief Write-ahead journal of the jobs being converted, replayed after a crash
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "RecoveryJournal.h"
+#include "TempFiles.h"
+#include "OutputNaming.h"
+#include <fstream>
+#include <stdlib.h>
+
+/// Name of the journal, in the converters' shared temporary folder
+#define JOURNAL_FILE		"recovery.journal"
+/// Name of the mutex serializing changes to the journal
+#define JOURNAL_MUTEX		"CCPDFConverterRecovery"
+/// Conversions of a job (the first one included) before it's given up
+#define MAX_ATTEMPTS		2
+
+/**
+*/
+RecoveryJournal::RecoveryJournal()
+{
+}
+
+/**
+*/
+RecoveryJournal::~RecoveryJournal()
+{
+}
+
+/**
+	@return The journal's full path
+*/
+std::string RecoveryJournal::GetJournalPath()
+{
+	return std::string(tempFiles.GetRoot()) + "\\" + JOURNAL_FILE;
+}
+
+/**
+	@param sId The job's ID
+	@return The capture file's full path
+*/
+std::string RecoveryJournal::GetCapturePath(const std::string& sId)
+{
+	return std::string(tempFiles.GetRoot()) + "\\capture-" + sId + ".ps";
+}
+
+/**
+	@param sLine The line (without the line break)
+	@return true if it was added
+*/
+bool RecoveryJournal::AddLine(const std::string& sLine)
+{
+	HANDLE hMutex = CreateMutex(NULL, FALSE, JOURNAL_MUTEX);
+	if (hMutex == NULL)
+		return false;
+	WaitForSingleObject(hMutex, INFINITE);
+	HANDLE hFile = CreateFile(GetJournalPath().c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	bool bRet = false;
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		std::string sData = sLine + "\r\n";
+		DWORD dwWritten;
+		bRet = WriteFile(hFile, sData.data(), (DWORD)sData.size(), &dwWritten, NULL) && (dwWritten == sData.size());
+		CloseHandle(hFile);
+	}
+	ReleaseMutex(hMutex);
+	CloseHandle(hMutex);
+	return bRet;
+}
+
+/**
+	@param sId The job's ID
+	@param record The job
+	@return The lines (with their line breaks)
+*/
+std::string RecoveryJournal::FormatRecord(const std::string& sId, const Record& record)
+{
+	char cAttempt[16];
+	sprintf_s(cAttempt, sizeof(cAttempt), "%d", record.nAttempt);
+	std::string sRet = "begin\t" + sId + "\t" + record.sOwner + "\t" + record.sPartial + "\t" + record.sTarget + "\t" + record.sCapture + "\t" + cAttempt + "\t" + record.sReserved + "\r\n";
+	if (record.bCaptured)
+		sRet += "captured\t" + sId + "\r\n";
+	if (record.bPublished)
+		sRet += "published\t" + sId + "\r\n";
+	return sRet;
+}
+
+/**
+	@param sId The job's ID
+	@param lpPartial The document being written
+	@param lpTarget The document's final name
+	@param lpReserved The document name the job reserved (NULL if none)
+	@param lpCapture The copy of the job's input (NULL if none)
+	@param nAttempt Conversions of the job so far, this one included
+*/
+void RecoveryJournal::Begin(const std::string& sId, LPCTSTR lpPartial, LPCTSTR lpTarget, LPCTSTR lpReserved, LPCTSTR lpCapture, int nAttempt)
+{
+	Record record;
+	TCHAR cOwner[MAX_PATH];
+	TempFiles::GetOwnerName(cOwner, MAX_PATH);
+	record.sOwner = cOwner;
+	record.sPartial = lpPartial;
+	record.sTarget = lpTarget;
+	record.sCapture = (lpCapture != NULL) ? lpCapture : "";
+	record.sReserved = (lpReserved != NULL) ? lpReserved : "";
+	record.nAttempt = nAttempt;
+	std::string sLines = FormatRecord(sId, record);
+	if (AddLine(sLines.substr(0, sLines.size() - 2)))
+	{
+		m_sId = sId;
+		m_sCapture = record.sCapture;
+	}
+}
+
+/**
+*/
+void RecoveryJournal::Captured()
+{
+	if (!m_sId.empty() && !m_sCapture.empty())
+		AddLine("captured\t" + m_sId);
+}
+
+/**
+	Called once the document is in place, before what follows (fan-out, journals...): a job
+	that crashes after this isn't converted again
+*/
+void RecoveryJournal::Published()
+{
+	if (!m_sId.empty())
+		AddLine("published\t" + m_sId);
+}
+
+/**
+*/
+void RecoveryJournal::End()
+{
+	if (m_sId.empty())
+		return;
+	AddLine("end\t" + m_sId);
+	if (!m_sCapture.empty())
+		DeleteFile(m_sCapture.c_str());
+	m_sId.clear();
+}
+
+/**
+	@param record The job
+	@return true if the process was started
+*/
+bool RecoveryJournal::Rerun(const Record& record)
+{
+	TCHAR cExe[MAX_PATH];
+	if (!GetModuleFileName(NULL, cExe, MAX_PATH))
+		return false;
+	char cAttempt[16];
+	sprintf_s(cAttempt, sizeof(cAttempt), "%d", record.nAttempt + 1);
+	std::string sCmd = std::string("\"") + cExe + "\" /rerun " + cAttempt + " \"" + record.sTarget + "\" \"" + record.sCapture + "\"";
+	STARTUPINFO si;
+	ZeroMemory(&si, sizeof(si));
+	si.cb = sizeof(si);
+	PROCESS_INFORMATION pi;
+	std::vector<TCHAR> cmd(sCmd.begin(), sCmd.end());
+	cmd.push_back('\0');
+	if (!CreateProcess(NULL, &cmd[0], NULL, NULL, FALSE, CREATE_NO_WINDOW | BELOW_NORMAL_PRIORITY_CLASS, NULL, NULL, &si, &pi))
+		return false;
+	CloseHandle(pi.hThread);
+	CloseHandle(pi.hProcess);
+	return true;
+}
+
+/**
+	@param in The journal
+	@param jobs Receives the jobs that didn't end, by ID
+	@param order Receives the IDs of the jobs, in the order they began (ended ones too)
+	@return Count of lines read
+*/
+int RecoveryJournal::Read(std::istream& in, std::map<std::string, Record>& jobs, std::vector<std::string>& order)
+{
+	int nLines = 0;
+	std::string sLine;
+	while (std::getline(in, sLine))
+	{
+		nLines++;
+		if (!sLine.empty() && (sLine[sLine.size() - 1] == '\r'))
+			sLine.erase(sLine.size() - 1);
+		std::vector<std::string> fields;
+		std::string::size_type nStart = 0, nTab;
+		while ((nTab = sLine.find('\t', nStart)) != std::string::npos)
+		{
+			fields.push_back(sLine.substr(nStart, nTab - nStart));
+			nStart = nTab + 1;
+		}
+		fields.push_back(sLine.substr(nStart));
+		if ((fields[0] == "begin") && (fields.size() >= 7))
+		{
+			Record& record = jobs[fields[1]];
+			record.sOwner = fields[2];
+			record.sPartial = fields[3];
+			record.sTarget = fields[4];
+			record.sCapture = fields[5];
+			record.nAttempt = atoi(fields[6].c_str());
+			// (Not there in journals written before names were reserved)
+			record.sReserved = (fields.size() >= 8) ? fields[7] : "";
+			order.push_back(fields[1]);
+		}
+		else if ((fields[0] == "captured") && (fields.size() >= 2) && (jobs.find(fields[1]) != jobs.end()))
+			jobs[fields[1]].bCaptured = true;
+		else if ((fields[0] == "published") && (fields.size() >= 2) && (jobs.find(fields[1]) != jobs.end()))
+			jobs[fields[1]].bPublished = true;
+		else if ((fields[0] == "end") && (fields.size() >= 2))
+			jobs.erase(fields[1]);
+	}
+	return nLines;
+}
+
+/**
+	Called at start-up (after the temporary folders are set up)
+*/
+void RecoveryJournal::Replay()
+{
+	HANDLE hMutex = CreateMutex(NULL, FALSE, JOURNAL_MUTEX);
+	if (hMutex == NULL)
+		return;
+	WaitForSingleObject(hMutex, INFINITE);
+
+	// Jobs that didn't end, in the order they began
+	std::string sJournal = GetJournalPath();
+	std::map<std::string, Record> jobs;
+	std::vector<std::string> order;
+	int nLines;
+	{
+		std::ifstream in(sJournal.c_str());
+		nLines = Read(in, jobs, order);
+	}
+
+	// Those whose process is gone crashed; the others are kept
+	std::string sKeep;
+	std::vector<Record> crashed;
+	for (std::vector<std::string>::const_iterator i = order.begin(); i != order.end(); i++)
+	{
+		std::map<std::string, Record>::iterator iJob = jobs.find(*i);
+		if (iJob == jobs.end())
+			continue;
+		if (TempFiles::IsOwnerRunning((*iJob).second.sOwner.c_str()))
+			sKeep += FormatRecord(*i, (*iJob).second);
+		else
+			crashed.push_back((*iJob).second);
+		jobs.erase(iJob);
+	}
+	if ((nLines > 0) && sKeep.empty())
+		// Nothing is running: the journal starts over
+		DeleteFile(sJournal.c_str());
+	else if (nLines > 0)
+	{
+		// Rewritten aside, then swapped in
+		std::string sNew = sJournal + ".new";
+		{
+			std::ofstream out(sNew.c_str(), std::ios::binary | std::ios::trunc);
+			out << sKeep;
+		}
+		MoveFileEx(sNew.c_str(), sJournal.c_str(), MOVEFILE_REPLACE_EXISTING);
+	}
+	ReleaseMutex(hMutex);
+	CloseHandle(hMutex);
+
+	for (std::vector<Record>::const_iterator i = crashed.begin(); i != crashed.end(); i++)
+	{
+		// The partial document (and the post-processed one, if it got that far)
+		DeleteFile((*i).sPartial.c_str());
+		DeleteFile(((*i).sPartial + ".pp").c_str());
+		// The name is free again (a document published as it is kept)
+		if (!(*i).sReserved.empty())
+			OutputNaming::Unreserve((*i).sReserved.c_str());
+		if ((*i).sCapture.empty())
+			continue;
+		// A published document is there already (converting it again would replace it, or
+		// append it twice)
+		if (!(*i).bCaptured || (*i).bPublished || ((*i).nAttempt >= MAX_ATTEMPTS) || !Rerun(*i))
+			DeleteFile((*i).sCapture.c_str());
+	}
+}
@@ -0,0 +1,123 @@
+/**
+	@file
+	@brief Write-ahead journal of the jobs being converted, replayed after a crash
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _RECOVERYJOURNAL_H_
+#define _RECOVERYJOURNAL_H_
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+    @brief Records each job before it writes anything, so a converter that dies leaves no orphans
+
+	A job adds a line to recovery.journal, in the converters' shared temporary folder,
+	before it converts anything: its ID, the process converting it, the partial document
+	(<name>.pdf.inprogress), the document's final name, the copy of its input, if
+	recovery.capture is set, and the name it reserved, if it was named by a template. More lines mark when the input was all captured (as soon as
+	the end of the input is reached), when the document was published (before the steps
+	that follow, like fan-out), and when the job ended. The lines aren't flushed to disk:
+	a process that dies doesn't lose what it wrote.
+
+	When a converter starts, it replays the journal. A job that didn't end, and whose
+	process is gone, crashed: its partial document and its name's reservation (if that's
+	still just an empty marker) are removed and, if all its input was
+	captured and its document wasn't published yet, it is converted again to its final
+	name in a process of its own (once; a job that crashes the converter twice is given
+	up, and its capture removed). The journal is
+	then rewritten with only the jobs still running (or removed, if none are), so it stays
+	a few lines long, and nothing is ever found by listing folders.
+*/
+class RecoveryJournal
+{
+public:
+	/// Ctor
+	RecoveryJournal();
+	/// Dtor
+	virtual ~RecoveryJournal();
+
+	/// Records a job before it writes anything
+	void				Begin(const std::string& sId, LPCTSTR lpPartial, LPCTSTR lpTarget, LPCTSTR lpReserved, LPCTSTR lpCapture, int nAttempt);
+	/// Records that all the job's input is in its capture file
+	void				Captured();
+	/// Records that the job's document was published
+	void				Published();
+	/// Records the end of the job, and removes its capture file
+	void				End();
+
+	/// Cleans up after the converters that crashed
+	static void			Replay();
+	/// Returns the name of a job's capture file
+	static std::string	GetCapturePath(const std::string& sId);
+
+	/// A job, as read from the journal
+	struct Record
+	{
+		/// Ctor
+		Record() : nAttempt(1), bCaptured(false), bPublished(false) {};
+
+		/// The process converting it (named like its job folder)
+		std::string		sOwner;
+		/// The partial document
+		std::string		sPartial;
+		/// The document's final name
+		std::string		sTarget;
+		/// The copy of its input (empty if none)
+		std::string		sCapture;
+		/// The document name it reserved (empty if none; see OutputNaming)
+		std::string		sReserved;
+		/// Conversions of the job so far, this one included
+		int				nAttempt;
+		/// true if all the input was captured
+		bool			bCaptured;
+		/// true if the document was published
+		bool			bPublished;
+	};
+
+	/// Reads a journal: the jobs that didn't end
+	static int			Read(std::istream& in, std::map<std::string, Record>& jobs, std::vector<std::string>& order);
+
+protected:
+
+	/// Adds a line to the journal
+	static bool			AddLine(const std::string& sLine);
+	/// Returns the journal's lines for a job
+	static std::string	FormatRecord(const std::string& sId, const Record& record);
+	/// Converts a crashed job again, in a process of its own
+	static bool			Rerun(const Record& record);
+	/// Returns the journal's name
+	static std::string	GetJournalPath();
+
+protected:
+	/// The job's ID (empty until it begins)
+	std::string			m_sId;
+	/// The job's capture file (empty if none)
+	std::string			m_sCapture;
+};
+
+#endif   //#define _RECOVERYJOURNAL_H_
@@ -0,0 +1,345 @@
+/**
+	@file
+	@brief Helper GhostScript process fed from the spool buffer
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "Sidecar.h"
+#include "OutputWriter.h"
+#include "TempFiles.h"
+#include <tchar.h>
+#include <strsafe.h>
+#include <stdio.h>
+
+/// Size of the blocks written to the helper's pipe
+#define FEED_BLOCK		(64 * 1024)
+/// A helper that failed this close to its memory limit is taken to have hit it
+#define CHECK_MARGIN	(1024 * 1024)
+
+/**
+	@param buffer The input data to send to the helper
+*/
+Sidecar::Sidecar(SpoolBuffer& buffer) : m_buffer(buffer), m_hProcess(NULL), m_hFeedThread(NULL), m_hPipe(INVALID_HANDLE_VALUE), m_hJob(NULL), m_hErrors(INVALID_HANDLE_VALUE),
+	m_dwStartTime(0), m_nMemoryLimit(0), m_dwTimeLimit(0), m_bPublish(true), m_pDiagnostics(NULL), m_dwExitCode((DWORD)-1), m_eLimit(LimitNone)
+{
+	m_cOutputFile[0] = '\0';
+}
+
+Sidecar::~Sidecar()
+{
+	if (m_hProcess != NULL)
+		Finish();
+}
+
+/**
+	@param lpDevice Name of the GhostScript device to use
+	@param lpOutputFile The file to create
+	@param args Extra GhostScript flags (put before the input)
+	@return true if the helper process was started
+*/
+bool Sidecar::Start(LPCTSTR lpDevice, LPCTSTR lpOutputFile, const ARGLIST& args)
+{
+	_tcscpy_s(m_cOutputFile, lpOutputFile);
+
+	// Build the command line: "<application>" /render <device> "<output>.inprogress" args...
+	TCHAR cApp[MAX_PATH];
+	if (!GetModuleFileName(NULL, cApp, MAX_PATH))
+		return false;
+	std::string sCmd = std::string("\"") + cApp + "\" /render " + lpDevice + " \"" + lpOutputFile + ".inprogress\"";
+	for (ARGLIST::const_iterator i = args.begin(); i != args.end(); i++)
+		sCmd += " \"" + *i + "\"";
+
+	// Create the input pipe; only the read end is inherited by the helper
+	SECURITY_ATTRIBUTES sa;
+	sa.nLength = sizeof(sa);
+	sa.lpSecurityDescriptor = NULL;
+	sa.bInheritHandle = TRUE;
+	HANDLE hRead;
+	if (!CreatePipe(&hRead, &m_hPipe, &sa, FEED_BLOCK))
+		return false;
+	SetHandleInformation(m_hPipe, HANDLE_FLAG_INHERIT, 0);
+
+	// Keep the helper's errors in a temporary file, if wanted
+	if (m_pDiagnostics != NULL)
+	{
+		TCHAR cFile[MAX_PATH];
+		if (GetTempFileName(tempFiles.GetJobFolder(), _T("cce"), 0, cFile) != 0)
+			m_hErrors = CreateFile(cFile, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	}
+
+	// Limits are kept by a job object
+	if ((m_nMemoryLimit > 0) || (m_dwTimeLimit > 0))
+	{
+		m_hJob = CreateJobObject(NULL, NULL);
+		if (m_hJob != NULL)
+		{
+			JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+			ZeroMemory(&limits, sizeof(limits));
+			// The helper never outlives us
+			limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+			if (m_nMemoryLimit > 0)
+			{
+				limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+				limits.ProcessMemoryLimit = (SIZE_T)m_nMemoryLimit;
+			}
+			SetInformationJobObject(m_hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+		}
+	}
+
+	STARTUPINFO si;
+	ZeroMemory(&si, sizeof(si));
+	si.cb = sizeof(si);
+	si.dwFlags = STARTF_USESTDHANDLES;
+	si.hStdInput = hRead;
+	si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+	si.hStdError = (m_hErrors != INVALID_HANDLE_VALUE) ? m_hErrors : GetStdHandle(STD_ERROR_HANDLE);
+	PROCESS_INFORMATION pi;
+	std::vector<TCHAR> cmd(sCmd.begin(), sCmd.end());
+	cmd.push_back('\0');
+	// Start it suspended, so it is in the job before it allocates anything
+	BOOL bStarted = CreateProcess(NULL, &cmd[0], NULL, NULL, TRUE, CREATE_NO_WINDOW|CREATE_SUSPENDED|BELOW_NORMAL_PRIORITY_CLASS, NULL, NULL, &si, &pi);
+	CloseHandle(hRead);
+	if (!bStarted)
+	{
+		CloseHandle(m_hPipe);
+		m_hPipe = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	if (m_hJob != NULL)
+		AssignProcessToJobObject(m_hJob, pi.hProcess);
+	ResumeThread(pi.hThread);
+	CloseHandle(pi.hThread);
+	m_hProcess = pi.hProcess;
+	m_dwStartTime = GetTickCount();
+
+	// And start feeding it
+	m_hFeedThread = CreateThread(NULL, 0, FeedThread, this, 0, NULL);
+	if (m_hFeedThread == NULL)
+	{
+		// Closing the pipe ends the helper's input
+		CloseHandle(m_hPipe);
+		m_hPipe = INVALID_HANDLE_VALUE;
+	}
+	return true;
+}
+
+/**
+	@param dwTimeout Maximal time to wait for the helper (in milliseconds)
+	@return true if the helper succeeded and its output is in place
+*/
+bool Sidecar::Finish(DWORD dwTimeout)
+{
+	if (m_hProcess == NULL)
+		return false;
+
+	// The time limit counts from the start of the helper
+	if (m_dwTimeLimit > 0)
+	{
+		DWORD dwElapsed = GetTickCount() - m_dwStartTime;
+		DWORD dwLeft = (dwElapsed < m_dwTimeLimit * 1000) ? m_dwTimeLimit * 1000 - dwElapsed : 0;
+		dwTimeout = min(dwTimeout, dwLeft);
+	}
+
+	m_dwExitCode = (DWORD)-1;
+	if (WaitForSingleObject(m_hProcess, dwTimeout) == WAIT_OBJECT_0)
+		GetExitCodeProcess(m_hProcess, &m_dwExitCode);
+	else
+	{
+		// Took too long
+		TerminateProcess(m_hProcess, (DWORD)-1);
+		WaitForSingleObject(m_hProcess, INFINITE);
+		m_eLimit = LimitTime;
+	}
+	if ((m_dwExitCode != 0) && (m_hJob != NULL) && (m_nMemoryLimit > 0))
+	{
+		// Did it fail because it reached the memory limit?
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+		if (QueryInformationJobObject(m_hJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL) &&
+			(limits.PeakProcessMemoryUsed + CHECK_MARGIN >= m_nMemoryLimit))
+			m_eLimit = LimitMemory;
+	}
+	if (m_hFeedThread != NULL)
+	{
+		// The helper is gone, so writes to the pipe fail and the thread ends
+		WaitForSingleObject(m_hFeedThread, INFINITE);
+		CloseHandle(m_hFeedThread);
+		m_hFeedThread = NULL;
+	}
+	CloseHandle(m_hProcess);
+	m_hProcess = NULL;
+	if (m_hJob != NULL)
+	{
+		CloseHandle(m_hJob);
+		m_hJob = NULL;
+	}
+	if (m_hErrors != INVALID_HANDLE_VALUE)
+	{
+		// Pass on whatever the helper complained about
+		char cBlock[4096];
+		DWORD dwRead;
+		SetFilePointer(m_hErrors, 0, NULL, FILE_BEGIN);
+		while (ReadFile(m_hErrors, cBlock, sizeof(cBlock), &dwRead, NULL) && (dwRead > 0))
+			m_pDiagnostics->Add(Diagnostics::StreamErr, cBlock, dwRead);
+		m_pDiagnostics->Flush();
+		CloseHandle(m_hErrors);
+		m_hErrors = INVALID_HANDLE_VALUE;
+	}
+
+	TCHAR cInProgress[MAX_PATH + 16];
+	StringCchPrintf(cInProgress, MAX_PATH + 16, _T("%s.inprogress"), m_cOutputFile);
+	if (m_dwExitCode != 0)
+	{
+		DeleteFile(cInProgress);
+		return false;
+	}
+	if (!m_bPublish)
+		return true;
+	return PublishOutput(cInProgress, m_cOutputFile);
+}
+
+/**
+	@return true if all the data was sent
+*/
+bool Sidecar::Feed()
+{
+	return FeedRange(0, DscIndex::NOT_FOUND);
+}
+
+/**
+	@param nStart Location of the first byte to send
+	@param nEnd Location following the last byte to send (DscIndex::NOT_FOUND for everything)
+	@return true if all the data was sent
+*/
+bool Sidecar::FeedRange(unsigned __int64 nStart, unsigned __int64 nEnd)
+{
+	SpoolReader reader(m_buffer, nStart);
+	char* pBlock = new char[FEED_BLOCK];
+	size_t nRead;
+	bool bRet = true;
+	while (reader.GetOffset() < nEnd)
+	{
+		nRead = reader.Read(pBlock, (size_t)min((unsigned __int64)FEED_BLOCK, nEnd - reader.GetOffset()));
+		if (nRead == 0)
+			break;
+		if (!Write(pBlock, nRead))
+		{
+			bRet = false;
+			break;
+		}
+	}
+	delete [] pBlock;
+	return bRet;
+}
+
+/**
+	@param lpDevice GhostScript device of the helper
+	@param lpOutputFile Final output file name
+	@param args Extra GhostScript flags
+	@return true if the helper was started
+*/
+bool PageSidecar::Start(LPCTSTR lpDevice, LPCTSTR lpOutputFile, const ARGLIST& args)
+{
+	// The page numbers the helper sees have to be known now: if the wanted pages already
+	// arrived they are sent alone, otherwise (the input may have no page structure at all)
+	// the helper gets every page up to the last wanted one
+	m_bRenumbered = (m_nFirst <= 1) || (m_buffer.GetPageCount() >= m_nFirst);
+	char cFirst[32], cLast[32];
+	sprintf_s(cFirst, sizeof(cFirst), "-dFirstPage=%d", m_bRenumbered ? 1 : m_nFirst);
+	sprintf_s(cLast, sizeof(cLast), "-dLastPage=%d", m_bRenumbered ? m_nLast - max(m_nFirst, 1) + 1 : m_nLast);
+	// (Before the caller's flags, which may end with PostScript code after -c)
+	ARGLIST pageArgs;
+	pageArgs.push_back(cFirst);
+	pageArgs.push_back(cLast);
+	pageArgs.insert(pageArgs.end(), args.begin(), args.end());
+	return Sidecar::Start(lpDevice, lpOutputFile, pageArgs);
+}
+
+/**
+	@return true if all the wanted data was sent
+*/
+bool PageSidecar::Feed()
+{
+	// Wait for the first page: everything before it is the prolog and setup
+	unsigned __int64 nHeader = m_buffer.WaitForPageStart(1);
+	if (nHeader == DscIndex::NOT_FOUND)
+		// No page structure, so no choice (the helper skips the pages it wasn't asked for)
+		return FeedRange(0, DscIndex::NOT_FOUND);
+	if (!FeedRange(0, nHeader))
+		return false;
+
+	// The helper was told to count from the first page of the document, so it gets them all
+	unsigned __int64 nStart = m_buffer.WaitForPageStart(m_bRenumbered ? m_nFirst : 1);
+	if (nStart == DscIndex::NOT_FOUND)
+		// Not that many pages
+		return true;
+	return FeedRange(nStart, m_buffer.WaitForPageEnd(m_nLast));
+}
+
+/**
+	@param pData Data to send
+	@param nLen Size of data (in bytes)
+	@return true if written, false if the helper is no longer reading
+*/
+bool Sidecar::Write(const char* pData, size_t nLen)
+{
+	while (nLen > 0)
+	{
+		DWORD dwWritten;
+		if (!WriteFile(m_hPipe, pData, (DWORD)nLen, &dwWritten, NULL))
+			return false;
+		pData += dwWritten;
+		nLen -= dwWritten;
+	}
+	return true;
+}
+
+/**
+	@param lpParam Pointer to the sidecar
+	@return 0 if all the data was sent, 1 otherwise
+*/
+DWORD WINAPI Sidecar::FeedThread(LPVOID lpParam)
+{
+	Sidecar* pThis = (Sidecar*)lpParam;
+	bool bRet = pThis->Feed();
+	// Closing the pipe is the end of the helper's input
+	CloseHandle(pThis->m_hPipe);
+	pThis->m_hPipe = INVALID_HANDLE_VALUE;
+	return bRet ? 0 : 1;
+}
+
+/**
+	@param lpDest Buffer to fill with the new name
+	@param nSize Size of the buffer (in characters)
+	@param lpPDF Name of the PDF file
+	@param lpExtension New extension (including the dot)
+*/
+void MakeSidePath(LPTSTR lpDest, size_t nSize, LPCTSTR lpPDF, LPCTSTR lpExtension)
+{
+	_tcscpy_s(lpDest, nSize, lpPDF);
+	size_t nLen = _tcslen(lpDest);
+	if ((nLen > 4) && (_tcsicmp(lpDest + nLen - 4, _T(".pdf")) == 0))
+		lpDest[nLen - 4] = '\0';
+	_tcscat_s(lpDest, nSize, lpExtension);
+}
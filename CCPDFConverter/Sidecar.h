@@ -0,0 +1,185 @@
+/**
+	@file
+	@brief Helper GhostScript process fed from the spool buffer
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _SIDECAR_H_
+#define _SIDECAR_H_
+
+#include "SpoolBuffer.h"
+#include "Diagnostics.h"
+#include <string>
+#include <vector>
+
+/// List of extra GhostScript flags for a helper process
+typedef std::vector<std::string> ARGLIST;
+
+/**
+    @brief Runs a second GhostScript device over the same input, in a helper process
+
+	GhostScript only supports a single instance per process, so the helper is a copy of
+	this application started with the "/render" flag. It gets the spool buffer data through
+	a pipe from a feeding thread, so it runs concurrently with the main conversion and the
+	input is only read once from the port monitor.
+	The output is written to "<file>.inprogress" and renamed when the helper succeeds.
+
+	The helper can be put under resource limits: its memory is capped by a job object
+	(allocations above the cap fail inside GhostScript) and it is killed when it runs
+	longer than its time limit.
+*/
+class Sidecar
+{
+public:
+	/// Constructor
+	Sidecar(SpoolBuffer& buffer);
+	/// Destructor: waits for the helper if it is still running
+	virtual ~Sidecar();
+
+	/// Starts the helper process and the thread that feeds it
+	bool			Start(LPCTSTR lpDevice, LPCTSTR lpOutputFile, const ARGLIST& args);
+	/// Waits for the helper to end and publishes its output
+	bool			Finish(DWORD dwTimeout = INFINITE);
+	/**
+		@brief Checks if the helper was started
+		@return true if the helper process is running (or ran)
+	*/
+	bool			IsStarted() const {return m_hProcess != NULL;};
+
+	/// Limit the helper hit
+	typedef enum
+	{
+		LimitNone,
+		LimitMemory,
+		LimitTime
+	} Limit;
+
+	/**
+		@brief Sets resource limits for the helper (must be called before Start)
+		@param nMemory Maximal memory of the helper process (in bytes, 0 for no limit)
+		@param dwSeconds Maximal run time (in seconds, 0 for no limit)
+	*/
+	void			SetLimits(unsigned __int64 nMemory, DWORD dwSeconds) {m_nMemoryLimit = nMemory; m_dwTimeLimit = dwSeconds;};
+	/**
+		@brief Sets whether Finish renames the output to its final name
+		@param bPublish false to leave the output as "<file>.inprogress" for the caller
+	*/
+	void			SetPublish(bool bPublish) {m_bPublish = bPublish;};
+	/**
+		@brief Sets where the helper's errors go (must be called before Start)
+		@param pDiagnostics Receives everything the helper wrote to its error stream
+	*/
+	void			CaptureErrors(Diagnostics* pDiagnostics) {m_pDiagnostics = pDiagnostics;};
+	/**
+		@brief Returns the exit code of the helper (after Finish)
+		@return The exit code, (DWORD)-1 if the helper was killed
+	*/
+	DWORD			GetExitCode() const {return m_dwExitCode;};
+	/**
+		@brief Returns the limit the helper exceeded (after Finish)
+		@return The limit, or LimitNone
+	*/
+	Limit			GetLimitExceeded() const {return m_eLimit;};
+
+protected:
+	/// Sends the input to the helper; the default sends all the spool buffer data
+	virtual bool	Feed();
+	/// Sends part of the spool buffer data to the helper
+	bool			FeedRange(unsigned __int64 nStart, unsigned __int64 nEnd);
+	/// Writes a block of data to the helper's input pipe
+	bool			Write(const char* pData, size_t nLen);
+	/// Feeding thread function
+	static DWORD WINAPI FeedThread(LPVOID lpParam);
+
+	// Data
+	/// The input data
+	SpoolBuffer&	m_buffer;
+	/// Final output file name
+	TCHAR			m_cOutputFile[MAX_PATH];
+	/// Helper process handle
+	HANDLE			m_hProcess;
+	/// Feeding thread handle
+	HANDLE			m_hFeedThread;
+	/// Write end of the helper's input pipe
+	HANDLE			m_hPipe;
+	/// Job object holding the helper's limits (NULL if none)
+	HANDLE			m_hJob;
+	/// File receiving the helper's error stream (INVALID_HANDLE_VALUE if not captured)
+	HANDLE			m_hErrors;
+	/// Time the helper was started
+	DWORD			m_dwStartTime;
+	/// Memory limit (bytes)
+	unsigned __int64 m_nMemoryLimit;
+	/// Time limit (seconds)
+	DWORD			m_dwTimeLimit;
+	/// true to rename the output when done
+	bool			m_bPublish;
+	/// Receives the helper's errors
+	Diagnostics*	m_pDiagnostics;
+	/// Helper exit code
+	DWORD			m_dwExitCode;
+	/// Limit the helper exceeded
+	Limit			m_eLimit;
+};
+
+/**
+    @brief A helper process that only gets some of the pages of the document
+
+	Uses the DSC page index: the helper gets everything before the first page (the
+	prolog and setup) and then only the wanted pages, so its cost depends on the pages
+	it renders and not on the size of the document. Input without DSC page comments is
+	sent whole. Either way the helper is also told which pages to render
+	(-dFirstPage/-dLastPage), so it never renders more than it was asked for.
+*/
+class PageSidecar : public Sidecar
+{
+public:
+	/**
+		@brief Constructor
+		@param buffer The input data to send to the helper
+		@param nFirst First page to send (starting at 1)
+		@param nLast Last page to send
+	*/
+	PageSidecar(SpoolBuffer& buffer, int nFirst, int nLast) : Sidecar(buffer), m_nFirst(nFirst), m_nLast(nLast), m_bRenumbered(true) {};
+
+	/// Starts the helper process, limited to the wanted pages, and the thread that feeds it
+	bool			Start(LPCTSTR lpDevice, LPCTSTR lpOutputFile, const ARGLIST& args);
+
+protected:
+	/// Sends the prolog, setup and wanted pages to the helper
+	virtual bool	Feed();
+
+	// Data
+	/// First page to send
+	int				m_nFirst;
+	/// Last page to send
+	int				m_nLast;
+	/// true if the helper gets the wanted pages only (so they start at 1 for it)
+	bool			m_bRenumbered;
+};
+
+/// Builds the name of a file written next to the PDF, replacing its extension
+void MakeSidePath(LPTSTR lpDest, size_t nSize, LPCTSTR lpPDF, LPCTSTR lpExtension);
+
+#endif   //#define _SIDECAR_H_
@@ -0,0 +1,314 @@
+/**
+	@file
+	@brief Buffered copy of the PostScript input, shared between several readers
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "SpoolBuffer.h"
+#include "IoBackend.h"
+
+/**
+	@param nMemoryBudget Maximal count of bytes to keep in memory; the rest goes to the spill file
+*/
+SpoolBuffer::SpoolBuffer(unsigned __int64 nMemoryBudget) : m_nMemoryBudget(nMemoryBudget), m_nMemory(0), m_nSize(0), m_pHash(NULL), m_bComplete(false), m_hCapture(INVALID_HANDLE_VALUE), m_nCaptured(0), m_pJournal(NULL), m_hSpill(INVALID_HANDLE_VALUE), m_pInput(NULL), m_hInputThread(NULL)
+{
+	// Always keep at least one chunk in memory: the header parsing depends on it
+	if (m_nMemoryBudget < CHUNK_SIZE)
+		m_nMemoryBudget = CHUNK_SIZE;
+	m_cSpillFolder[0] = '\0';
+	InitializeCriticalSection(&m_cs);
+	InitializeConditionVariable(&m_cvData);
+}
+
+SpoolBuffer::~SpoolBuffer()
+{
+	if (m_hInputThread != NULL)
+	{
+		WaitForSingleObject(m_hInputThread, INFINITE);
+		CloseHandle(m_hInputThread);
+	}
+	for (std::vector<char*>::iterator i = m_chunks.begin(); i != m_chunks.end(); i++)
+		delete [] *i;
+	if (m_hSpill != INVALID_HANDLE_VALUE)
+		// The file is deleted on close
+		IoBackend::Get().Close(m_hSpill);
+	if (m_hCapture != INVALID_HANDLE_VALUE)
+		IoBackend::Get().Close(m_hCapture);
+	DeleteCriticalSection(&m_cs);
+}
+
+/**
+	@param lpFile The file to write (replaced if it exists); must be set before data is added
+	@param pJournal Journal to record it in once it has all the data (NULL if none)
+	@return true if the file was created
+*/
+bool SpoolBuffer::SetCapture(LPCTSTR lpFile, RecoveryJournal* pJournal)
+{
+	// (It can be deleted while it's still being written)
+	m_hCapture = IoBackend::Get().Open(lpFile, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL);
+	m_pJournal = pJournal;
+	return m_hCapture != INVALID_HANDLE_VALUE;
+}
+
+/**
+	Called by the input thread, before the data is marked complete (so the journal has it
+	before the job can end)
+	@param bAll true if all the input was added
+*/
+void SpoolBuffer::FinishCapture(bool bAll)
+{
+	if (m_hCapture == INVALID_HANDLE_VALUE)
+		return;
+	bool bRet = IoBackend::Get().Close(m_hCapture);
+	m_hCapture = INVALID_HANDLE_VALUE;
+	// Recorded as soon as the input ends, not when the conversion does: a job that crashes
+	// while converting can then be converted again
+	if (bAll && bRet && (m_pJournal != NULL))
+		m_pJournal->Captured();
+}
+
+/**
+	@param pData Data to add
+	@param nLen Size of data (in bytes)
+	@return true if the data was added, false if it could not be spilled to disk
+*/
+bool SpoolBuffer::Append(const char* pData, size_t nLen)
+{
+	EnterCriticalSection(&m_cs);
+	m_index.Scan(pData, nLen);
+	LeaveCriticalSection(&m_cs);
+	if (m_pHash != NULL)
+		// Only the (single) writer uses the hash
+		m_pHash->Add(pData, nLen);
+	if (m_hCapture != INVALID_HANDLE_VALUE)
+	{
+		// (Likewise the capture file; if it can't be written, there's just no capture)
+		if (IoBackend::Get().Write(m_hCapture, m_nCaptured, pData, (DWORD)nLen))
+			m_nCaptured += nLen;
+		else
+		{
+			IoBackend::Get().Close(m_hCapture);
+			m_hCapture = INVALID_HANDLE_VALUE;
+		}
+	}
+	while (nLen > 0)
+	{
+		size_t nAdd;
+		EnterCriticalSection(&m_cs);
+		if (m_nMemory < m_nMemoryBudget)
+		{
+			// Still room in memory: fill the last chunk (or a new one)
+			size_t nInChunk = (size_t)(m_nMemory % CHUNK_SIZE);
+			if (nInChunk == 0)
+				m_chunks.push_back(new char[CHUNK_SIZE]);
+			nAdd = min(nLen, (size_t)CHUNK_SIZE - nInChunk);
+			memcpy(m_chunks.back() + nInChunk, pData, nAdd);
+			m_nMemory += nAdd;
+			m_nSize += nAdd;
+			LeaveCriticalSection(&m_cs);
+		}
+		else
+		{
+			// Memory is full, so everything else goes to the spill file; readers never
+			// look past m_nSize, so the write itself doesn't need the lock
+			LeaveCriticalSection(&m_cs);
+			nAdd = nLen;
+			if (!Spill(pData, nAdd))
+				return false;
+			EnterCriticalSection(&m_cs);
+			m_nSize += nAdd;
+			LeaveCriticalSection(&m_cs);
+		}
+		pData += nAdd;
+		nLen -= nAdd;
+		WakeAllConditionVariable(&m_cvData);
+	}
+	return true;
+}
+
+void SpoolBuffer::SetComplete()
+{
+	EnterCriticalSection(&m_cs);
+	m_bComplete = true;
+	LeaveCriticalSection(&m_cs);
+	WakeAllConditionVariable(&m_cvData);
+}
+
+/**
+	@param nOffset Location of the data in the buffer
+	@param pBuffer Buffer to fill
+	@param nLen Size of the buffer
+	@return Count of bytes read; 0 if the location is at (or after) the end of the data
+*/
+size_t SpoolBuffer::Read(unsigned __int64 nOffset, char* pBuffer, size_t nLen)
+{
+	EnterCriticalSection(&m_cs);
+	// Wait for the data to be there
+	while ((nOffset >= m_nSize) && !m_bComplete)
+		SleepConditionVariableCS(&m_cvData, &m_cs, INFINITE);
+	if (nOffset >= m_nSize)
+	{
+		// That's it
+		LeaveCriticalSection(&m_cs);
+		return 0;
+	}
+	nLen = (size_t)min((unsigned __int64)nLen, m_nSize - nOffset);
+	if (nOffset < m_nMemory)
+	{
+		// Copy from memory, not crossing chunk (or memory) boundaries
+		size_t nInChunk = (size_t)(nOffset % CHUNK_SIZE);
+		nLen = (size_t)min((unsigned __int64)min(nLen, (size_t)CHUNK_SIZE - nInChunk), m_nMemory - nOffset);
+		memcpy(pBuffer, m_chunks[(size_t)(nOffset / CHUNK_SIZE)] + nInChunk, nLen);
+		LeaveCriticalSection(&m_cs);
+		return nLen;
+	}
+	LeaveCriticalSection(&m_cs);
+
+	// Read from the spill file; this part of the file is not written anymore (though the
+	// backend may still be writing it)
+	DWORD dwRead = 0;
+	if (!IoBackend::Get().Read(m_hSpill, nOffset - m_nMemory, pBuffer, (DWORD)nLen, dwRead))
+		return 0;
+	return dwRead;
+}
+
+void SpoolBuffer::WaitComplete()
+{
+	EnterCriticalSection(&m_cs);
+	while (!m_bComplete)
+		SleepConditionVariableCS(&m_cvData, &m_cs, INFINITE);
+	LeaveCriticalSection(&m_cs);
+}
+
+/**
+	@param nPage The page number (starting at 1)
+	@return Location of the page's %%Page: comment, or DscIndex::NOT_FOUND if the data
+	ended without it
+*/
+unsigned __int64 SpoolBuffer::WaitForPageStart(int nPage)
+{
+	EnterCriticalSection(&m_cs);
+	unsigned __int64 nRet;
+	while (((nRet = m_index.GetPageStart(nPage)) == DscIndex::NOT_FOUND) && !m_bComplete)
+		SleepConditionVariableCS(&m_cvData, &m_cs, INFINITE);
+	LeaveCriticalSection(&m_cs);
+	return nRet;
+}
+
+/**
+	@param nPage The page number (starting at 1)
+	@return Location following the page: the start of the next page, the trailer, or the
+	end of the data
+*/
+unsigned __int64 SpoolBuffer::WaitForPageEnd(int nPage)
+{
+	EnterCriticalSection(&m_cs);
+	unsigned __int64 nRet;
+	while (true)
+	{
+		if ((nRet = m_index.GetPageStart(nPage + 1)) != DscIndex::NOT_FOUND)
+			break;
+		if ((m_index.GetPageCount() >= nPage) && ((nRet = m_index.GetTrailer()) != DscIndex::NOT_FOUND))
+			break;
+		if (m_bComplete)
+		{
+			nRet = m_nSize;
+			break;
+		}
+		SleepConditionVariableCS(&m_cvData, &m_cs, INFINITE);
+	}
+	LeaveCriticalSection(&m_cs);
+	return nRet;
+}
+
+/**
+	@param pData Data to write
+	@param nLen Size of data (in bytes)
+	@return true if written successfully
+*/
+bool SpoolBuffer::Spill(const char* pData, size_t nLen)
+{
+	if (m_hSpill == INVALID_HANDLE_VALUE)
+	{
+		// First time: create the file
+		TCHAR cFolder[MAX_PATH], cFile[MAX_PATH];
+		if (m_cSpillFolder[0] != '\0')
+			_tcscpy_s(cFolder, m_cSpillFolder);
+		else
+			GetTempPath(MAX_PATH, cFolder);
+		if (GetTempFileName(cFolder, _T("ccs"), 0, cFile) == 0)
+			return false;
+		m_hSpill = IoBackend::Get().Open(cFile, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE);
+		if (m_hSpill == INVALID_HANDLE_VALUE)
+			return false;
+	}
+
+	// Always write at the end (readers use positioned reads)
+	return IoBackend::Get().Write(m_hSpill, m_nSize - m_nMemory, pData, (DWORD)nLen);
+}
+
+/**
+	@param pFile The file to read from (usually stdin)
+	@return true if the thread was started
+*/
+bool SpoolBuffer::StartInput(FILE* pFile)
+{
+	m_pInput = pFile;
+	m_hInputThread = CreateThread(NULL, 0, InputThread, this, 0, NULL);
+	if (m_hInputThread == NULL)
+	{
+		FinishCapture(false);
+		SetComplete();
+		return false;
+	}
+	return true;
+}
+
+/**
+	@param lpParam Pointer to the spool buffer
+	@return 0 when all the data was read
+*/
+DWORD WINAPI SpoolBuffer::InputThread(LPVOID lpParam)
+{
+	SpoolBuffer* pThis = (SpoolBuffer*)lpParam;
+	char* pBuffer = new char[CHUNK_SIZE];
+	size_t nRead;
+	bool bAll = true;
+	while ((nRead = fread(pBuffer, 1, CHUNK_SIZE, pThis->m_pInput)) > 0)
+	{
+		if (!pThis->Append(pBuffer, nRead))
+		{
+			// Can't keep it: read the rest so the port monitor doesn't get an error
+			while (fread(pBuffer, 1, CHUNK_SIZE, pThis->m_pInput) > 0)
+				;
+			bAll = false;
+			break;
+		}
+	}
+	delete [] pBuffer;
+	pThis->FinishCapture(bAll);
+	pThis->SetComplete();
+	return 0;
+}
@@ -0,0 +1,184 @@
+/**
+	@file
+	@brief Buffered copy of the PostScript input, shared between several readers
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _SPOOLBUFFER_H_
+#define _SPOOLBUFFER_H_
+
+#include <stdio.h>
+#include <tchar.h>
+#include <vector>
+#include "DscIndex.h"
+#include "ContentHash.h"
+#include "RecoveryJournal.h"
+
+/**
+    @brief Keeps a copy of the PostScript data sent by the port monitor
+
+	The data is read once from the input and kept in memory up to a memory budget;
+	anything beyond the budget is spilled to a temporary file. Any number of readers
+	can read the data concurrently, each from its own location, while it is still
+	being received. The DSC page structure is indexed as the data arrives.
+*/
+class SpoolBuffer
+{
+public:
+	/// Creates a buffer that keeps up to nMemoryBudget bytes in memory
+	SpoolBuffer(unsigned __int64 nMemoryBudget);
+	/// Destructor: waits for the input thread and releases the data
+	~SpoolBuffer();
+
+	/**
+		@brief Sets the folder the spill file is created in (the system temp folder by default)
+		@param lpFolder The folder to use; must be set before data is added
+	*/
+	void				SetSpillFolder(LPCTSTR lpFolder) {_tcscpy_s(m_cSpillFolder, lpFolder);};
+	/**
+		@brief Sets a hash that all the data is added to as it arrives
+		@param pHash The hash (NULL for none); must be set before data is added
+	*/
+	void				SetHash(ContentHash* pHash) {m_pHash = pHash;};
+	/// Keeps a copy of all the data in a file (which outlives the buffer)
+	bool				SetCapture(LPCTSTR lpFile, RecoveryJournal* pJournal = NULL);
+
+	/// Adds data to the end of the buffer
+	bool				Append(const char* pData, size_t nLen);
+	/// Marks the end of the data: readers get 0 when they reach it
+	void				SetComplete();
+	/// Reads data from a location in the buffer, waiting for it to arrive if needed
+	size_t				Read(unsigned __int64 nOffset, char* pBuffer, size_t nLen);
+	/// Waits until all the data was received
+	void				WaitComplete();
+
+	/// Waits until the start of a page is known
+	unsigned __int64	WaitForPageStart(int nPage);
+	/// Waits until the end of a page is known
+	unsigned __int64	WaitForPageEnd(int nPage);
+	/**
+		@brief Returns the count of pages found so far
+		@return Count of (top level) %%Page: comments received
+	*/
+	int					GetPageCount() {EnterCriticalSection(&m_cs); int n = m_index.GetPageCount(); LeaveCriticalSection(&m_cs); return n;};
+
+	/// Starts a thread that copies the rest of a file into the buffer
+	bool				StartInput(FILE* pFile);
+
+	/**
+		@brief Returns the size of the data received so far
+		@return Count of bytes in the buffer
+	*/
+	unsigned __int64	GetSize() {EnterCriticalSection(&m_cs); unsigned __int64 n = m_nSize; LeaveCriticalSection(&m_cs); return n;};
+	/**
+		@brief Checks if all the data was received
+		@return true if the end of the input was reached
+	*/
+	bool				IsComplete() {EnterCriticalSection(&m_cs); bool b = m_bComplete; LeaveCriticalSection(&m_cs); return b;};
+	/**
+		@brief Returns the memory budget of the buffer
+		@return Maximal count of bytes kept in memory
+	*/
+	unsigned __int64	GetMemoryBudget() const {return m_nMemoryBudget;};
+
+protected:
+	/// Size of each memory chunk
+	enum {CHUNK_SIZE = 64 * 1024};
+
+	/// Writes data to the spill file (creating it if needed)
+	bool				Spill(const char* pData, size_t nLen);
+	/// Closes the capture file, at the end of the input
+	void				FinishCapture(bool bAll);
+	/// Input thread function
+	static DWORD WINAPI	InputThread(LPVOID lpParam);
+
+	// Data
+	/// Memory chunks, CHUNK_SIZE bytes each
+	std::vector<char*>	m_chunks;
+	/// Maximal count of bytes kept in memory
+	unsigned __int64	m_nMemoryBudget;
+	/// Count of bytes kept in memory (always at the start of the data)
+	unsigned __int64	m_nMemory;
+	/// Total count of bytes received
+	unsigned __int64	m_nSize;
+	/// Locations of the DSC comments in the data
+	DscIndex			m_index;
+	/// Hash of the data (NULL if not needed)
+	ContentHash*		m_pHash;
+	/// true when the end of the data was reached
+	bool				m_bComplete;
+	/// Capture file handle (INVALID_HANDLE_VALUE if none)
+	HANDLE				m_hCapture;
+	/// Count of bytes written to the capture file
+	unsigned __int64	m_nCaptured;
+	/// Journal told when the capture file has all the data (NULL if none)
+	RecoveryJournal*	m_pJournal;
+	/// Spill file handle (INVALID_HANDLE_VALUE until needed)
+	HANDLE				m_hSpill;
+	/// Folder for the spill file
+	TCHAR				m_cSpillFolder[MAX_PATH];
+	/// Input file (for the input thread)
+	FILE*				m_pInput;
+	/// Input thread handle
+	HANDLE				m_hInputThread;
+	/// Protects the data members
+	CRITICAL_SECTION	m_cs;
+	/// Signalled whenever data is added or the input ends
+	CONDITION_VARIABLE	m_cvData;
+};
+
+/**
+    @brief A reader of the spool buffer data, keeping its own location
+*/
+class SpoolReader
+{
+public:
+	/**
+		@brief Constructor
+		@param buffer The buffer to read from
+		@param nOffset Location to start reading from
+	*/
+	SpoolReader(SpoolBuffer& buffer, unsigned __int64 nOffset = 0) : m_buffer(buffer), m_nOffset(nOffset) {};
+
+	/**
+		@brief Reads the next block of data
+		@param pBuffer Buffer to fill
+		@param nLen Size of the buffer
+		@return Count of bytes read, 0 at the end of the data
+	*/
+	size_t				Read(char* pBuffer, size_t nLen) {size_t n = m_buffer.Read(m_nOffset, pBuffer, nLen); m_nOffset += n; return n;};
+	/**
+		@brief Returns the location of the next read
+		@return Offset of the next byte to read
+	*/
+	unsigned __int64	GetOffset() const {return m_nOffset;};
+
+protected:
+	/// The buffer being read
+	SpoolBuffer&		m_buffer;
+	/// Location of the next read
+	unsigned __int64	m_nOffset;
+};
+
+#endif   //#define _SPOOLBUFFER_H_
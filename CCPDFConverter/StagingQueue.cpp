@@ -0,0 +1,367 @@
+/**
+	@file
+	@brief Local staging of converted documents, published to their folders in the background
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "StagingQueue.h"
+#include "Configuration.h"
+#include "FilePlacement.h"
+#include "OutputWriter.h"
+#include "OutputNaming.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+/// Default time to keep trying to publish (seconds)
+#define DEFAULT_STAGING_RETRY		30
+/// Default time between attempts (milliseconds)
+#define DEFAULT_STAGING_INTERVAL	2000
+/// Default count of attempts before a document is given up on
+#define DEFAULT_STAGING_ATTEMPTS	50
+/// Longest wait between attempts on another job's document (seconds)
+#define MAX_STAGING_BACKOFF			3600
+
+/**
+	@return The current time, in FILETIME units
+*/
+static unsigned __int64 GetNow()
+{
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	return ((unsigned __int64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+/**
+*/
+StagingQueue::StagingQueue() : m_hThread(NULL), m_hOwnDone(NULL), m_bStop(false), m_bOwnPublished(false), m_nDepth(0), m_nPublished(0), m_nFailures(0), m_nDropped(0), m_dLatency(0)
+{
+	m_sFolder = myconfigdata.getstring("staging.folder", "");
+	if (m_sFolder.empty())
+		return;
+	if ((m_sFolder[m_sFolder.size() - 1] == '\\') || (m_sFolder[m_sFolder.size() - 1] == '/'))
+		m_sFolder.erase(m_sFolder.size() - 1);
+	CreateDirectory(m_sFolder.c_str(), NULL);
+}
+
+/**
+*/
+StagingQueue::~StagingQueue()
+{
+	Stop();
+}
+
+/**
+	@param sJobId The job ID
+	@return Full name of the staged document (GhostScript writes it with .inprogress added)
+*/
+std::string StagingQueue::GetStagedFile(const std::string& sJobId) const
+{
+	return m_sFolder + "\\" + sJobId + ".pdf";
+}
+
+/**
+	@param sJobId The job ID (its document must be staged already)
+	@param lpDest Where the document goes
+	@param lpJournalRoot Output root whose journal records the document (NULL if none)
+	@param record The journal record (without the finish time, set when published)
+	@return true if queued
+*/
+bool StagingQueue::Enqueue(const std::string& sJobId, LPCTSTR lpDest, LPCTSTR lpJournalRoot, const JournalRecord& record)
+{
+	configuration::data ticket;
+	ticket["dest"] = lpDest;
+	char cNum[32];
+	sprintf_s(cNum, sizeof(cNum), "%I64u", GetNow());
+	ticket["enqueued"] = cNum;
+	if (lpJournalRoot != NULL)
+	{
+		ticket["journal.root"] = lpJournalRoot;
+		for (JournalRecord::const_iterator i = record.begin(); i != record.end(); i++)
+			ticket["record." + i->first] = i->second;
+	}
+
+	// Written aside, so publishers never see half a ticket
+	std::string sTicket = m_sFolder + "\\" + sJobId + ".ticket";
+	{
+		std::ofstream f((sTicket + ".new").c_str());
+		f << ticket;
+		if (!f)
+			return false;
+	}
+	if (!MoveFileEx((sTicket + ".new").c_str(), sTicket.c_str(), MOVEFILE_REPLACE_EXISTING))
+		return false;
+	m_sOwnId = sJobId;
+	m_nDepth = (int)GetQueue().size();
+	return true;
+}
+
+/**
+	@return IDs of the queued documents (the oldest first: IDs start with the time)
+*/
+std::vector<std::string> StagingQueue::GetQueue() const
+{
+	std::vector<std::string> ids;
+	WIN32_FIND_DATA fd;
+	HANDLE hFind = FindFirstFile((m_sFolder + "\\*.ticket").c_str(), &fd);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			std::string sName(fd.cFileName);
+			ids.push_back(sName.substr(0, sName.size() - 7));
+		} while (FindNextFile(hFind, &fd));
+		FindClose(hFind);
+	}
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+/**
+*/
+void StagingQueue::Start()
+{
+	if (!IsEnabled() || (m_hThread != NULL))
+		return;
+	m_hOwnDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_hThread = CreateThread(NULL, 0, PublisherThread, this, 0, NULL);
+}
+
+/**
+*/
+void StagingQueue::Stop()
+{
+	if (m_hThread != NULL)
+	{
+		// Other jobs' documents: the publisher stops after the copy it's making, and whatever
+		// isn't published by then is left for the next converter (it uses this object, so it
+		// must be done before it's gone)
+		m_bStop = true;
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+	if (m_hOwnDone != NULL)
+	{
+		CloseHandle(m_hOwnDone);
+		m_hOwnDone = NULL;
+	}
+}
+
+/**
+	@param lpParam The StagingQueue object
+	@return 0
+*/
+DWORD WINAPI StagingQueue::PublisherThread(LPVOID lpParam)
+{
+	((StagingQueue*)lpParam)->Run();
+	return 0;
+}
+
+/**
+*/
+void StagingQueue::Run()
+{
+	DWORD dwStart = GetTickCount();
+	DWORD dwRetry = (DWORD)myconfigdata.getint("staging.retry", DEFAULT_STAGING_RETRY) * 1000;
+	DWORD dwInterval = (DWORD)myconfigdata.getint("staging.interval", DEFAULT_STAGING_INTERVAL);
+
+	// This job's own document first: it's the only one the job waits for
+	while (!m_sOwnId.empty())
+	{
+		int nRet = PublishEntry(m_sOwnId, true);
+		if (nRet > 0)
+			m_nPublished++;
+		if ((nRet >= 0) || m_bStop || (GetTickCount() - dwStart >= dwRetry))
+			break;
+		// Wait for the share to come back
+		m_nFailures++;
+		Sleep(dwInterval);
+	}
+	SetEvent(m_hOwnDone);
+
+	// Then one try at each of the others that is due, while the job ends
+	std::vector<std::string> ids = GetQueue();
+	for (std::vector<std::string>::const_iterator i = ids.begin(); (i != ids.end()) && !m_bStop; i++)
+	{
+		if (*i == m_sOwnId)
+			continue;
+		int nRet = PublishEntry(*i, false);
+		if (nRet > 0)
+			m_nPublished++;
+		else if (nRet < 0)
+			m_nFailures++;
+	}
+}
+
+/**
+	@param sId ID of the queued document
+	@param bNow true to try now, false to wait for the time the ticket sets for the next attempt
+	@return 1 if it was published, 0 if someone else has it (or had it) or it's not due, -1 if it failed
+*/
+int StagingQueue::PublishEntry(const std::string& sId, bool bNow)
+{
+	// The ticket stays open (and locked) while publishing, so no one else takes it
+	std::string sTicket = m_sFolder + "\\" + sId + ".ticket";
+	HANDLE hTicket = CreateFile(sTicket.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (hTicket == INVALID_HANDLE_VALUE)
+		return 0;
+	std::string sData;
+	char cBlock[4096];
+	DWORD dwRead;
+	while (ReadFile(hTicket, cBlock, sizeof(cBlock), &dwRead, NULL) && (dwRead > 0))
+		sData.append(cBlock, dwRead);
+	configuration::data ticket;
+	{
+		std::istringstream in(sData);
+		in >> ticket;
+	}
+
+	unsigned __int64 nNow = GetNow();
+	if (!bNow && (_strtoui64(ticket.getstring("next", "0").c_str(), NULL, 10) > nNow))
+	{
+		CloseHandle(hTicket);
+		return 0;
+	}
+
+	std::string sStaged = GetStagedFile(sId);
+	std::string sDest = ticket["dest"];
+	std::string sTemp = sDest + ".inprogress";
+	if (GetFileAttributes(sStaged.c_str()) == INVALID_FILE_ATTRIBUTES)
+	{
+		// Nothing left to publish (removed by hand, or the staging folder was cleaned up)
+		m_nDropped++;
+		DeleteTicket(hTicket);
+		CloseHandle(hTicket);
+		return 0;
+	}
+	bool bRet = false;
+	if (!sDest.empty())
+	{
+		// The system copy uses large writes, and can be offloaded to the server
+		PlaceMethod eMethod = PlaceFile(sStaged.c_str(), sTemp.c_str(), false);
+		if ((eMethod != PlaceNone) && PublishOutput(sTemp.c_str(), sDest.c_str()))
+		{
+			// The name is no longer just reserved (see OutputNaming)
+			OutputNaming::Unreserve(sDest.c_str());
+			bRet = true;
+		}
+		else if (eMethod != PlaceNone)
+			DeleteFile(sTemp.c_str());
+	}
+	if (bRet)
+	{
+		if (sId == m_sOwnId)
+		{
+			m_bOwnPublished = true;
+			m_dLatency = (GetNow() - _strtoui64(ticket["enqueued"].c_str(), NULL, 10)) / 10000.0;
+		}
+		if (!ticket["journal.root"].empty())
+		{
+			// It's finished now
+			JournalRecord record;
+			for (configuration::data::const_iterator i = ticket.begin(); i != ticket.end(); i++)
+				if (i->first.compare(0, 7, "record.") == 0)
+					record[i->first.substr(7)] = i->second;
+			FILETIME ftNow;
+			GetSystemTimeAsFileTime(&ftNow);
+			record["finished"] = CompletionJournal::FormatTime(ftNow);
+			CompletionJournal(ticket["journal.root"].c_str()).Append(record);
+		}
+		// Done with it
+		DeleteFile(sStaged.c_str());
+		DeleteTicket(hTicket);
+	}
+	else
+	{
+		// Tried again later, less often each time
+		int nAttempts = ticket.getint("attempts", 0) + 1;
+		if (nAttempts >= myconfigdata.getint("staging.attempts", DEFAULT_STAGING_ATTEMPTS))
+		{
+			// Given up on: the document stays staged, the ticket is kept aside as <id>.failed
+			CloseHandle(hTicket);
+			MoveFileEx(sTicket.c_str(), (m_sFolder + "\\" + sId + ".failed").c_str(), MOVEFILE_REPLACE_EXISTING);
+			m_nDropped++;
+			return -1;
+		}
+		unsigned __int64 nBackoff = (unsigned __int64)myconfigdata.getint("staging.interval", DEFAULT_STAGING_INTERVAL) / 1000;
+		nBackoff = min(max(nBackoff, (unsigned __int64)1) << min(nAttempts, 20), (unsigned __int64)MAX_STAGING_BACKOFF);
+		char cNum[32];
+		sprintf_s(cNum, sizeof(cNum), "%d", nAttempts);
+		ticket["attempts"] = cNum;
+		sprintf_s(cNum, sizeof(cNum), "%I64u", nNow + nBackoff * 10000000);
+		ticket["next"] = cNum;
+		WriteTicket(hTicket, ticket);
+	}
+	CloseHandle(hTicket);
+	return bRet ? 1 : -1;
+}
+
+/**
+	@param hTicket The open ticket (opened for writing)
+	@param ticket What it now holds
+*/
+void StagingQueue::WriteTicket(HANDLE hTicket, const configuration::data& ticket)
+{
+	std::ostringstream out;
+	out << ticket;
+	std::string sData = out.str();
+	DWORD dwWritten;
+	SetFilePointer(hTicket, 0, NULL, FILE_BEGIN);
+	if (WriteFile(hTicket, sData.c_str(), (DWORD)sData.size(), &dwWritten, NULL))
+		SetEndOfFile(hTicket);
+}
+
+/**
+	@param hTicket The open ticket (opened with DELETE access): it's removed when closed
+*/
+void StagingQueue::DeleteTicket(HANDLE hTicket)
+{
+	FILE_DISPOSITION_INFO info;
+	info.DeleteFile = TRUE;
+	SetFileInformationByHandle(hTicket, FileDispositionInfo, &info, sizeof(info));
+}
+
+/**
+	@param result The job result to add the metrics to
+*/
+void StagingQueue::Finish(JobResult& result)
+{
+	// Only this job's own document is waited for (within staging.retry)
+	if (m_hOwnDone != NULL)
+		WaitForSingleObject(m_hOwnDone, INFINITE);
+	Stop();
+	if (m_sOwnId.empty())
+		return;
+	result.SetInt("staging.depth", m_nDepth);
+	result.SetInt("staging.published", m_nPublished);
+	result.SetInt("staging.failures", m_nFailures);
+	result.SetInt("staging.dropped", m_nDropped);
+	result.SetInt("staging.pending", (__int64)GetQueue().size());
+	result["staging.status"] = m_bOwnPublished ? "published" : "queued";
+	if (m_bOwnPublished)
+		result.SetTime("staging.latency", m_dLatency);
+}
@@ -0,0 +1,122 @@
+/**
+	@file
+	@brief Local staging of converted documents, published to their folders in the background
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _STAGINGQUEUE_H_
+#define _STAGINGQUEUE_H_
+
+#include "JobResult.h"
+#include "CompletionJournal.h"
+
+/**
+    @brief Stages documents locally and publishes them to their (slow) folders later
+
+	With the staging.folder setting, GhostScript writes into that (fast, local) folder
+	instead of the destination, which is usually a network share. The staged document
+	is queued with a ticket (<id>.ticket, next to <id>.pdf), and a background thread
+	copies it to the destination in large sequential writes, renaming it into place when
+	it's all there. A converter keeps trying to publish its own document (for
+	staging.retry seconds, default 30, every staging.interval milliseconds, default
+	2000) while the share is unavailable, and only waits for that one: it makes one
+	try at the documents other converters left while it ends, stopping after the copy in
+	progress when it's done, and what's still left is published by a later converter. Each failed attempt makes the next one on that
+	document wait twice as long (up to an hour); after staging.attempts attempts
+	(default 50) its ticket is renamed <id>.failed and the document is left staged.
+	A ticket whose staged document is gone is dropped.
+
+	Ticket keys:
+	- dest: where the document goes
+	- enqueued: when it was queued (FILETIME, as a number)
+	- attempts: count of failed attempts (none if not tried yet)
+	- next: when to try again (FILETIME, as a number)
+	- journal.root: the output root whose completion journal records it (if any)
+	- record.*: the journal record
+*/
+class StagingQueue
+{
+public:
+	/// Ctor
+	StagingQueue();
+	/// Dtor
+	virtual ~StagingQueue();
+
+	/**
+		@brief Checks if staging is enabled
+		@return true if a staging folder is set
+	*/
+	bool				IsEnabled() const {return !m_sFolder.empty();};
+	/// Returns the name of the staged copy of a job's document
+	std::string			GetStagedFile(const std::string& sJobId) const;
+
+	/// Queues a staged document for publishing
+	bool				Enqueue(const std::string& sJobId, LPCTSTR lpDest, LPCTSTR lpJournalRoot, const JournalRecord& record);
+	/// Starts publishing the queue in the background
+	void				Start();
+	/// Waits for the job's own document to be published (or given up on), and records the metrics
+	void				Finish(JobResult& result);
+
+protected:
+	/// Publisher thread function
+	static DWORD WINAPI	PublisherThread(LPVOID lpParam);
+	/// Publishes the job's own document until it's done or time's up, then the other documents that are due
+	void				Run();
+	/// Stops the background publishing, waiting for the copy in progress
+	void				Stop();
+	/// Publishes one queued document
+	int					PublishEntry(const std::string& sId, bool bNow);
+	/// Rewrites an open ticket
+	static void			WriteTicket(HANDLE hTicket, const configuration::data& ticket);
+	/// Removes an open ticket
+	static void			DeleteTicket(HANDLE hTicket);
+	/// Returns the IDs of the queued documents, oldest first
+	std::vector<std::string>	GetQueue() const;
+
+protected:
+	/// The staging folder (empty if disabled)
+	std::string			m_sFolder;
+	/// ID of this job's document (empty if none queued)
+	std::string			m_sOwnId;
+	/// Publisher thread
+	HANDLE				m_hThread;
+	/// Set when the publisher is done with this job's document
+	HANDLE				m_hOwnDone;
+	/// true when the publisher should stop
+	volatile bool		m_bStop;
+	/// true once this job's document is published
+	bool				m_bOwnPublished;
+	/// Queue depth when this job's document was queued
+	int					m_nDepth;
+	/// Count of documents this process published
+	int					m_nPublished;
+	/// Count of failed publishing attempts
+	int					m_nFailures;
+	/// Count of tickets dropped (document gone) or given up on
+	int					m_nDropped;
+	/// Time from queueing to publishing of this job's document (milliseconds)
+	double				m_dLatency;
+};
+
+#endif   //#define _STAGINGQUEUE_H_
@@ -0,0 +1,241 @@
+/**
+	@file
+	@brief Private per-job temporary folders, and the sweep of crash leftovers
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "TempFiles.h"
+#include "Configuration.h"
+#include <stdio.h>
+#include <tchar.h>
+
+/// Name of the file whose time marks the last sweep
+#define SWEEP_MARKER		_T("sweep.last")
+/// Default time between sweeps (seconds)
+#define DEFAULT_SWEEP		3600
+/// Default age after which a temporary document is removed (hours)
+#define DEFAULT_MAX_AGE		24
+
+TempFiles tempFiles;
+
+/**
+*/
+TempFiles::TempFiles() : m_bCreated(false), m_hSweep(NULL), m_bStop(false), m_nMaxAge(0)
+{
+	m_cRoot[0] = '\0';
+	m_cJobFolder[0] = '\0';
+}
+
+/**
+*/
+TempFiles::~TempFiles()
+{
+	Close();
+}
+
+/**
+	@param lpName Receives the name (job-<process ID>-<process start time>)
+	@param nSize Size of lpName (characters)
+*/
+void TempFiles::GetOwnerName(LPTSTR lpName, size_t nSize)
+{
+	FILETIME ftCreate, ftExit, ftKernel, ftUser;
+	GetProcessTimes(GetCurrentProcess(), &ftCreate, &ftExit, &ftKernel, &ftUser);
+	_stprintf_s(lpName, nSize, _T("job-%lu-%I64x"), GetCurrentProcessId(), ((unsigned __int64)ftCreate.dwHighDateTime << 32) | ftCreate.dwLowDateTime);
+}
+
+/**
+	@param lpName Name of a job folder (job-<process ID>-<process start time>)
+	@return true if that process is still running
+*/
+bool TempFiles::IsOwnerRunning(LPCTSTR lpName)
+{
+	unsigned long nPid;
+	unsigned __int64 nStart;
+	if (_stscanf_s(lpName, _T("job-%lu-%I64x"), &nPid, &nStart) != 2)
+		// Not one of ours
+		return true;
+	HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, nPid);
+	if (hProcess == NULL)
+		return GetLastError() == ERROR_ACCESS_DENIED;
+	FILETIME ftCreate, ftExit, ftKernel, ftUser;
+	bool bRet = false;
+	DWORD dwExit;
+	if (GetProcessTimes(hProcess, &ftCreate, &ftExit, &ftKernel, &ftUser) && GetExitCodeProcess(hProcess, &dwExit))
+		// The same process ID may have been given to another process since
+		bRet = (dwExit == STILL_ACTIVE) && ((((unsigned __int64)ftCreate.dwHighDateTime << 32) | ftCreate.dwLowDateTime) == nStart);
+	CloseHandle(hProcess);
+	return bRet;
+}
+
+/**
+	@param lpFolder The folder to remove
+*/
+void TempFiles::RemoveFolder(LPCTSTR lpFolder)
+{
+	TCHAR cFind[MAX_PATH], cFile[MAX_PATH];
+	_stprintf_s(cFind, MAX_PATH, _T("%s\\*"), lpFolder);
+	WIN32_FIND_DATA fd;
+	HANDLE hFind = FindFirstFile(cFind, &fd);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+			{
+				_stprintf_s(cFile, MAX_PATH, _T("%s\\%s"), lpFolder, fd.cFileName);
+				// Files still in use are left for the next sweep
+				DeleteFile(cFile);
+			}
+		} while (FindNextFile(hFind, &fd));
+		FindClose(hFind);
+	}
+	RemoveDirectory(lpFolder);
+}
+
+/**
+*/
+void TempFiles::Create()
+{
+	TCHAR cTemp[MAX_PATH];
+	GetTempPath(MAX_PATH, cTemp);
+	_tcscpy_s(m_cJobFolder, cTemp);
+	// Without the trailing backslash, like the job folder
+	size_t nLen = _tcslen(m_cJobFolder);
+	if ((nLen > 0) && (m_cJobFolder[nLen - 1] == '\\'))
+		m_cJobFolder[nLen - 1] = '\0';
+	_stprintf_s(m_cRoot, MAX_PATH, _T("%sCCPDFConverter"), cTemp);
+	CreateDirectory(m_cRoot, NULL);
+
+	TCHAR cOwner[MAX_PATH], cFolder[MAX_PATH];
+	GetOwnerName(cOwner, MAX_PATH);
+	_stprintf_s(cFolder, MAX_PATH, _T("%s\\%s"), m_cRoot, cOwner);
+	if (CreateDirectory(cFolder, NULL))
+	{
+		_tcscpy_s(m_cJobFolder, cFolder);
+		m_bCreated = true;
+	}
+
+	// Is a sweep due?
+	TCHAR cMarker[MAX_PATH];
+	_stprintf_s(cMarker, MAX_PATH, _T("%s\\%s"), m_cRoot, SWEEP_MARKER);
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	FILETIME ftNow;
+	GetSystemTimeAsFileTime(&ftNow);
+	unsigned __int64 nNow = ((unsigned __int64)ftNow.dwHighDateTime << 32) | ftNow.dwLowDateTime;
+	unsigned __int64 nInterval = (unsigned __int64)myconfigdata.getint("temp.sweep", DEFAULT_SWEEP) * 10000000;
+	if (GetFileAttributesEx(cMarker, GetFileExInfoStandard, &data) &&
+		(nNow - (((unsigned __int64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime) < nInterval))
+		return;
+
+	// Yes: claim it (another converter starting now may sweep too, which does no harm)
+	HANDLE hMarker = CreateFile(cMarker, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, 0, NULL);
+	if (hMarker == INVALID_HANDLE_VALUE)
+		return;
+	CloseHandle(hMarker);
+	// (The settings are read here: the sweep doesn't touch them)
+	m_nMaxAge = (unsigned __int64)myconfigdata.getint("temp.maxage", DEFAULT_MAX_AGE) * 3600 * 10000000;
+	m_bStop = false;
+	m_hSweep = CreateThread(NULL, 0, SweepThread, this, 0, NULL);
+}
+
+/**
+*/
+void TempFiles::Close()
+{
+	if (m_hSweep != NULL)
+	{
+		// A sweep of a large temp folder shouldn't hold the job: it stops after the entry it's
+		// on, and the next one finishes it
+		m_bStop = true;
+		WaitForSingleObject(m_hSweep, INFINITE);
+		CloseHandle(m_hSweep);
+		m_hSweep = NULL;
+	}
+	if (m_bCreated)
+	{
+		RemoveFolder(m_cJobFolder);
+		m_bCreated = false;
+	}
+}
+
+/**
+	@param lpParam The TempFiles object
+	@return 0
+*/
+DWORD WINAPI TempFiles::SweepThread(LPVOID lpParam)
+{
+	// Only use what the job doesn't need
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+	((TempFiles*)lpParam)->Sweep();
+	return 0;
+}
+
+/**
+*/
+void TempFiles::Sweep()
+{
+	TCHAR cFind[MAX_PATH], cFile[MAX_PATH];
+	WIN32_FIND_DATA fd;
+	HANDLE hFind;
+
+	// Job folders whose converter is gone
+	_stprintf_s(cFind, MAX_PATH, _T("%s\\job-*"), m_cRoot);
+	hFind = FindFirstFile(cFind, &fd);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) && !IsOwnerRunning(fd.cFileName))
+			{
+				_stprintf_s(cFile, MAX_PATH, _T("%s\\%s"), m_cRoot, fd.cFileName);
+				RemoveFolder(cFile);
+			}
+		} while (!m_bStop && FindNextFile(hFind, &fd));
+		FindClose(hFind);
+	}
+
+	// Old temporary documents (a viewer still showing one keeps it open, so it stays)
+	FILETIME ftNow;
+	GetSystemTimeAsFileTime(&ftNow);
+	unsigned __int64 nNow = ((unsigned __int64)ftNow.dwHighDateTime << 32) | ftNow.dwLowDateTime;
+	TCHAR cTemp[MAX_PATH];
+	GetTempPath(MAX_PATH, cTemp);
+	_stprintf_s(cFind, MAX_PATH, _T("%s%s*.%s"), cTemp, _T(TEMP_FILENAME), _T(TEMP_EXTENSION));
+	hFind = m_bStop ? INVALID_HANDLE_VALUE : FindFirstFile(cFind, &fd);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			unsigned __int64 nWritten = ((unsigned __int64)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime;
+			if ((nWritten > nNow) || (nNow - nWritten < m_nMaxAge))
+				// Another converter's, or one the user may still be looking at
+				continue;
+			_stprintf_s(cFile, MAX_PATH, _T("%s%s"), cTemp, fd.cFileName);
+			DeleteFile(cFile);
+		} while (!m_bStop && FindNextFile(hFind, &fd));
+		FindClose(hFind);
+	}
+}
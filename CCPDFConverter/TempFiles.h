@@ -0,0 +1,104 @@
+/**
+	@file
+	@brief Private per-job temporary folders, and the sweep of crash leftovers
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _TEMPFILES_H_
+#define _TEMPFILES_H_
+
+/// Prefix of the temporary documents opened after conversion (%%CreateAsTemp)
+#define TEMP_FILENAME "ccprint_"
+/// Extension of the temporary documents
+#define TEMP_EXTENSION "pdf"
+
+/**
+    @brief Keeps the temporary files of a job in a private folder
+
+	Each job's folder is created under %TEMP%\\CCPDFConverter, named by the process ID
+	and start time, and removed when the job ends. That parent folder doubles as the
+	registry of leftovers: a folder whose process is gone was left by a crash. Every so
+	often (temp.sweep seconds, default an hour) a background thread removes those, along
+	with temporary documents in the system temp folder last written more than temp.maxage
+	hours ago (default 24), away from the job's own work. The sweep reads its settings
+	before it starts, and stops after the entry it's on when the job ends: whatever is left
+	is removed by the next one. WinMain closes the temporary files before it returns, so
+	the sweep never outlives the job.
+*/
+class TempFiles
+{
+public:
+	/// Ctor
+	TempFiles();
+	/// Dtor: removes the job folder, if Close wasn't called
+	virtual ~TempFiles();
+
+	/// Creates the job folder, and starts a sweep if one is due
+	void				Create();
+	/// Stops the sweep (if any) and removes the job folder
+	void				Close();
+
+	/**
+		@brief Returns the folder for the job's temporary files
+		@return The job folder, without a trailing backslash (the system temp folder if it couldn't be created)
+	*/
+	LPCTSTR				GetJobFolder() const {return m_cJobFolder;};
+	/**
+		@brief Returns the parent of the job folders (shared by all the converters)
+		@return The folder, without a trailing backslash (empty before Create)
+	*/
+	LPCTSTR				GetRoot() const {return m_cRoot;};
+
+	/// Returns the name this process gives its job folder (which identifies it)
+	static void			GetOwnerName(LPTSTR lpName, size_t nSize);
+	/// Checks if the process that owns a job folder is still running
+	static bool			IsOwnerRunning(LPCTSTR lpName);
+
+protected:
+	/// Sweep thread function
+	static DWORD WINAPI	SweepThread(LPVOID lpParam);
+	/// Removes leftover job folders and temporary documents
+	void				Sweep();
+	/// Removes a folder and the files in it
+	static void			RemoveFolder(LPCTSTR lpFolder);
+
+protected:
+	/// Parent of the job folders
+	TCHAR				m_cRoot[MAX_PATH];
+	/// The job folder
+	TCHAR				m_cJobFolder[MAX_PATH];
+	/// true if the job folder was created by this process
+	bool				m_bCreated;
+	/// Sweep thread (NULL if not running)
+	HANDLE				m_hSweep;
+	/// Set to stop the sweep
+	volatile bool		m_bStop;
+	/// Age after which the sweep removes a temporary document (100ns units)
+	unsigned __int64	m_nMaxAge;
+};
+
+/// This job's temporary files
+extern TempFiles tempFiles;
+
+#endif   //#define _TEMPFILES_H_
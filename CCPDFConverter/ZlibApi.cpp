@@ -0,0 +1,144 @@
+/**
+	@file
+	@brief Access to the zlib compression library, loaded on demand
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "ZlibApi.h"
+#include <tchar.h>
+#include <new>
+
+/// Name of the zlib DLL
+#define ZLIB_DLL		_T("zlib1.dll")
+/// Largest decompressed stream we handle (larger ones are left as they are)
+#define MAX_INFLATED	(512 * 1024 * 1024)
+
+ZlibApi zlib;
+
+/**
+	@return true if the DLL is loaded and has all the functions we need
+*/
+bool ZlibApi::Load()
+{
+	if (hModule != NULL)
+		return true;
+
+	// Prefer the DLL next to the application; otherwise, the usual search order
+	TCHAR cDLL[MAX_PATH];
+	if (GetModuleFileName(NULL, cDLL, MAX_PATH))
+	{
+		TCHAR* pPos = _tcsrchr(cDLL, '\\');
+		if (pPos != NULL)
+		{
+			_tcscpy_s(pPos + 1, MAX_PATH - (pPos + 1 - cDLL), ZLIB_DLL);
+			hModule = LoadLibrary(cDLL);
+		}
+	}
+	if (hModule == NULL)
+		hModule = LoadLibrary(ZLIB_DLL);
+	if (hModule == NULL)
+		return false;
+
+	compressBound = (PFN_compressBound)GetProcAddress(hModule, "compressBound");
+	compress2 = (PFN_compress2)GetProcAddress(hModule, "compress2");
+	uncompress = (PFN_uncompress)GetProcAddress(hModule, "uncompress");
+	if ((compressBound == NULL) || (compress2 == NULL) || (uncompress == NULL))
+	{
+		// Not a DLL we can use
+		FreeLibrary(hModule);
+		hModule = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+	@param pData The data to compress
+	@param nLen Size of the data
+	@param nLevel Compression level (1-9)
+	@param sOut Receives the compressed data
+	@return true if the data was compressed
+*/
+bool ZlibApi::Compress(const char* pData, size_t nLen, int nLevel, std::string& sOut) const
+{
+	if ((hModule == NULL) || (nLen > MAX_INFLATED))
+		return false;
+	unsigned long nOut = compressBound((unsigned long)nLen);
+	try
+	{
+		sOut.resize(nOut);
+	}
+	catch (std::bad_alloc&)
+	{
+		// Left as it is
+		return false;
+	}
+	if (compress2((unsigned char*)&sOut[0], &nOut, (const unsigned char*)pData, (unsigned long)nLen, nLevel) != ZLIB_OK)
+		return false;
+	sOut.resize(nOut);
+	return true;
+}
+
+/**
+	@param pData The compressed data
+	@param nLen Size of the data
+	@param nSize Size of the decompressed data, if known (0 if not)
+	@param nMaxSize Most memory the decompressed data may take
+	@param sOut Receives the decompressed data
+	@return true if the data was decompressed (false if it didn't fit)
+*/
+bool ZlibApi::Decompress(const char* pData, size_t nLen, size_t nSize, size_t nMaxSize, std::string& sOut) const
+{
+	if ((hModule == NULL) || (nLen == 0))
+		return false;
+	nMaxSize = min(nMaxSize, (size_t)MAX_INFLATED);
+	if (nSize > nMaxSize)
+		return false;
+	// Done in one go when the size is known; otherwise guess, and try again with more room if it's not enough
+	size_t nRoom = (nSize > 0) ? nSize : min(max(nLen * 4, (size_t)4096), nMaxSize);
+	try
+	{
+		while (true)
+		{
+			sOut.resize(nRoom);
+			unsigned long nOut = (unsigned long)nRoom;
+			int nRet = uncompress((unsigned char*)&sOut[0], &nOut, (const unsigned char*)pData, (unsigned long)nLen);
+			if (nRet == ZLIB_OK)
+			{
+				sOut.resize(nOut);
+				return true;
+			}
+			if ((nRet != ZLIB_BUF_ERROR) || (nRoom >= nMaxSize))
+				break;
+			nRoom = min(nRoom * 2, nMaxSize);
+		}
+	}
+	catch (std::bad_alloc&)
+	{
+		// Out of memory: left as it is
+	}
+	std::string().swap(sOut);
+	return false;
+}
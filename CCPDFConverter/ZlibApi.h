@@ -0,0 +1,84 @@
+/**
+	@file
+	@brief Access to the zlib compression library, loaded on demand
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _ZLIBAPI_H_
+#define _ZLIBAPI_H_
+
+#include <string>
+
+/// Return code: success
+#define ZLIB_OK				0
+/// Return code: the output buffer was too small
+#define ZLIB_BUF_ERROR		(-5)
+
+/// compressBound
+typedef unsigned long (*PFN_compressBound)(unsigned long sourceLen);
+/// compress2
+typedef int (*PFN_compress2)(unsigned char* dest, unsigned long* destLen, const unsigned char* source, unsigned long sourceLen, int level);
+/// uncompress
+typedef int (*PFN_uncompress)(unsigned char* dest, unsigned long* destLen, const unsigned char* source, unsigned long sourceLen);
+
+/**
+    @brief The zlib functions we use, loaded from zlib1.dll on first use
+
+	Like GhostScript, zlib is not linked to the application: it's only needed by the
+	post-processing stages that compress, and the stage is skipped if it's not there.
+	The functions can be called from any thread.
+*/
+struct ZlibApi
+{
+	/// Constructor: nothing loaded yet
+	ZlibApi() : hModule(NULL), compressBound(NULL), compress2(NULL), uncompress(NULL) {};
+
+	/// Loads the DLL (if not loaded yet)
+	bool						Load();
+	/**
+		@brief Checks if the DLL was loaded
+		@return true if the functions can be called
+	*/
+	bool						IsLoaded() const {return hModule != NULL;};
+
+	/// Compresses data (zlib format, as the Flate filter expects)
+	bool						Compress(const char* pData, size_t nLen, int nLevel, std::string& sOut) const;
+	/// Decompresses data, within a memory limit
+	bool						Decompress(const char* pData, size_t nLen, size_t nSize, size_t nMaxSize, std::string& sOut) const;
+
+	// Data
+	/// The DLL
+	HMODULE						hModule;
+	/// compressBound
+	PFN_compressBound			compressBound;
+	/// compress2
+	PFN_compress2				compress2;
+	/// uncompress
+	PFN_uncompress				uncompress;
+};
+
+/// The zlib library
+extern ZlibApi zlib;
+
+#endif   //#define _ZLIBAPI_H_
@@ -0,0 +1,175 @@
+/**
+	@file
+	@brief Tests of Diagnostics: parsing the errors GhostScript reports, and keeping its last lines
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "Diagnostics.h"
+#include "TestUtil.h"
+
+/**
+	@param diag The diagnostics to add to
+	@param eStream The stream the text was written to
+	@param pText The text
+*/
+static void AddText(Diagnostics& diag, Diagnostics::Stream eStream, const char* pText)
+{
+	diag.Add(eStream, pText, (int)strlen(pText));
+}
+
+static void TestInterpreterFormat()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamErr, "Error: /undefined in /foo\n");
+	CHECK_EQUAL(std::string("undefined"), diag.GetErrorName());
+	CHECK_EQUAL(std::string("foo"), diag.GetOffendingCommand());
+	CHECK_EQUAL(-21, diag.GetErrorCode());
+	CHECK(diag.HasErrors());
+}
+
+static void TestPrinterFormat()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamOut, "%%[ Error: typecheck; OffendingCommand: setfont ]%%\n");
+	CHECK_EQUAL(std::string("typecheck"), diag.GetErrorName());
+	CHECK_EQUAL(std::string("setfont"), diag.GetOffendingCommand());
+	CHECK_EQUAL(-20, diag.GetErrorCode());
+	// It came on the output stream
+	CHECK(!diag.HasErrors());
+}
+
+static void TestErrorCodes()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamErr, "Error: /unknownerror in x\n");
+	CHECK_EQUAL(-1, diag.GetErrorCode());
+	diag.Reset();
+	AddText(diag, Diagnostics::StreamErr, "Error: /dictfull in x\n");
+	CHECK_EQUAL(-2, diag.GetErrorCode());
+	diag.Reset();
+	AddText(diag, Diagnostics::StreamErr, "Error: /invalidid in x\n");
+	CHECK_EQUAL(-30, diag.GetErrorCode());
+	diag.Reset();
+	AddText(diag, Diagnostics::StreamErr, "Error: /VMerror in x\n");
+	CHECK_EQUAL(-25, diag.GetErrorCode());
+}
+
+static void TestUnknownName()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamErr, "Error: /somethingnew in x\n");
+	CHECK_EQUAL(std::string("somethingnew"), diag.GetErrorName());
+	CHECK_EQUAL(-1, diag.GetErrorCode());
+}
+
+static void TestNoCommand()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamErr, "Error: /ioerror\n");
+	CHECK_EQUAL(std::string("ioerror"), diag.GetErrorName());
+	CHECK_EQUAL(std::string(""), diag.GetOffendingCommand());
+	CHECK_EQUAL(-12, diag.GetErrorCode());
+}
+
+static void TestNoError()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamOut, "GPL Ghostscript 9.0 (2010-09-14)\nLoading font Times\n");
+	AddText(diag, Diagnostics::StreamErr, "   **** Warning: some error-like text\n");
+	CHECK(diag.GetErrorName().empty());
+	CHECK_EQUAL(0, diag.GetErrorCode());
+	CHECK(diag.HasErrors());
+}
+
+static void TestFirstErrorKept()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamErr, "Error: /rangecheck in --get--\n");
+	AddText(diag, Diagnostics::StreamErr, "Error: /undefined in foo\n");
+	CHECK_EQUAL(std::string("rangecheck"), diag.GetErrorName());
+	CHECK_EQUAL(std::string("--get--"), diag.GetOffendingCommand());
+	CHECK_EQUAL(-15, diag.GetErrorCode());
+}
+
+static void TestPartialLines()
+{
+	Diagnostics diag;
+	AddText(diag, Diagnostics::StreamErr, "Error: /undef");
+	CHECK(diag.GetErrorName().empty());
+	AddText(diag, Diagnostics::StreamErr, "ined in ");
+	diag.Flush();
+	CHECK_EQUAL(std::string("undefined"), diag.GetErrorName());
+
+	// Windows line ends too
+	diag.Reset();
+	AddText(diag, Diagnostics::StreamErr, "Error: /syntaxerror in (\r\n");
+	CHECK_EQUAL(std::string("syntaxerror"), diag.GetErrorName());
+	CHECK_EQUAL(std::string("("), diag.GetOffendingCommand());
+}
+
+static void TestErrorAfterLimit()
+{
+	Diagnostics diag;
+	diag.SetMaxLines(5);
+	for (int i = 0; i < 20; i++)
+		AddText(diag, Diagnostics::StreamOut, "Processing page\n");
+	AddText(diag, Diagnostics::StreamOut, "%%[ Error: limitcheck; OffendingCommand: image ]%%\n");
+	CHECK_EQUAL(std::string("limitcheck"), diag.GetErrorName());
+	CHECK_EQUAL(-13, diag.GetErrorCode());
+
+	configuration::data result;
+	diag.ToResult(result);
+	CHECK_EQUAL(std::string("limitcheck"), result["error.name"]);
+	CHECK_EQUAL(std::string("image"), result["error.command"]);
+	CHECK_EQUAL(std::string("-13"), result["error.code"]);
+	CHECK_EQUAL(std::string("21"), result["output.lines"]);
+	CHECK_EQUAL(std::string("15"), result["output.dropped"]);
+	// The error line is kept, after the ones below the limit
+	CHECK_EQUAL(std::string("%%[ Error: limitcheck; OffendingCommand: image ]%%"), result["output.05.out"]);
+}
+
+static void TestErrorText()
+{
+	Diagnostics diag;
+	diag.SetMaxLines(2);
+	AddText(diag, Diagnostics::StreamOut, "one\ntwo\nthree\n");
+	AddText(diag, Diagnostics::StreamErr, "Error: /undefined in foo\nOperand stack:\n");
+	CHECK_EQUAL(std::string("Error: /undefined in foo\nOperand stack:\n(1 more lines)\n"), diag.GetErrorText());
+}
+
+int main()
+{
+	RUN_TEST(TestInterpreterFormat);
+	RUN_TEST(TestPrinterFormat);
+	RUN_TEST(TestErrorCodes);
+	RUN_TEST(TestUnknownName);
+	RUN_TEST(TestNoCommand);
+	RUN_TEST(TestNoError);
+	RUN_TEST(TestFirstErrorKept);
+	RUN_TEST(TestPartialLines);
+	RUN_TEST(TestErrorAfterLimit);
+	RUN_TEST(TestErrorText);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+/**
+	@file
+	@brief Times DirectoryEnumerator against the readdir listing it replaced, and checks they find the same folders
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "DirectoryEnumerator.h"
+#include "TestUtil.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <time.h>
+#include <algorithm>
+
+/// Times each listing is run (the best time is kept)
+#define RUNS				5
+
+/**
+	The listing DirectoryIndex used before DirectoryEnumerator: readdir, one folder at a time
+	(it took the folder's time first too)
+
+	@param sFolder The folder
+	@param names Receives the names of the sub-folders, sorted
+	@return true if the folder was listed
+*/
+static bool OldListFolder(const std::string& sFolder, std::vector<std::string>& names)
+{
+	names.clear();
+	unsigned __int64 nStamp;
+	if (!DirectoryEnumerator::GetStamp(sFolder, nStamp))
+		return false;
+	DIR* pDir = opendir(sFolder.c_str());
+	if (pDir == NULL)
+		return false;
+	struct dirent* pEntry;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		if ((strcmp(pEntry->d_name, ".") == 0) || (strcmp(pEntry->d_name, "..") == 0) || (strchr(pEntry->d_name, '\n') != NULL))
+			continue;
+		bool bFolder = (pEntry->d_type == DT_DIR);
+		if ((pEntry->d_type == DT_UNKNOWN) || (pEntry->d_type == DT_LNK))
+		{
+			struct stat st;
+			bFolder = (stat((sFolder + '/' + pEntry->d_name).c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+		}
+		if (bFolder)
+			names.push_back(pEntry->d_name);
+	}
+	closedir(pDir);
+	std::sort(names.begin(), names.end(), DirectoryEnumerator::NameLess);
+	return true;
+}
+
+/**
+	@return The time now, in milliseconds
+*/
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+	@param folders The folders
+	@param names Receives the sub-folders of all of them
+	@return The time taken (milliseconds)
+*/
+static double TimeOld(const std::vector<std::string>& folders, std::vector<std::string>& names)
+{
+	double dStart = Now();
+	names.clear();
+	std::vector<std::string> sub;
+	for (std::vector<std::string>::const_iterator i = folders.begin(); i != folders.end(); i++)
+	{
+		CHECK(OldListFolder(*i, sub));
+		names.insert(names.end(), sub.begin(), sub.end());
+	}
+	return Now() - dStart;
+}
+
+/**
+	@param folders The folders
+	@param nThreads Threads to list them with
+	@param names Receives the sub-folders of all of them
+	@return The time taken (milliseconds)
+*/
+static double TimeNew(const std::vector<std::string>& folders, int nThreads, std::vector<std::string>& names)
+{
+	double dStart = Now();
+	DirectoryEnumerator enumerator;
+	for (std::vector<std::string>::const_iterator i = folders.begin(); i != folders.end(); i++)
+		enumerator.Add(*i);
+	enumerator.Run(nThreads);
+	double dRet = Now() - dStart;
+	for (size_t i = 0; i < enumerator.GetFolderCount(); i++)
+		CHECK(enumerator.GetFolder(i).bListed);
+	names = enumerator.GetNames();
+	return dRet;
+}
+
+/**
+	Usage: DirectoryEnumeratorBenchmark [folders] [sub-folders each] [files each]
+*/
+int main(int argc, char* argv[])
+{
+	int nFolders = (argc > 1) ? atoi(argv[1]) : 50;
+	int nSub = (argc > 2) ? atoi(argv[2]) : 40;
+	int nFiles = (argc > 3) ? atoi(argv[3]) : 40;
+
+	// Level 1 folders, each with sub-folders and documents
+	std::string sRoot = MakeTestFolder();
+	std::vector<std::string> folders;
+	char cName[64];
+	for (int i = 0; i < nFolders; i++)
+	{
+		sprintf_s(cName, sizeof(cName), "/Folder %04d", i);
+		std::string sFolder = sRoot + cName;
+		mkdir(sFolder.c_str(), 0755);
+		folders.push_back(sFolder);
+		for (int j = 0; j < nSub; j++)
+		{
+			sprintf_s(cName, sizeof(cName), "/Sub %04d", j);
+			mkdir((sFolder + cName).c_str(), 0755);
+		}
+		for (int j = 0; j < nFiles; j++)
+		{
+			sprintf_s(cName, sizeof(cName), "/Document %04d.pdf", j);
+			FILE* pFile = fopen((sFolder + cName).c_str(), "w");
+			if (pFile != NULL)
+				fclose(pFile);
+		}
+	}
+
+	double dOld = 1e30, dNew1 = 1e30, dNew8 = 1e30;
+	std::vector<std::string> oldNames, newNames1, newNames8;
+	for (int i = 0; i < RUNS; i++)
+	{
+		dOld = min(dOld, TimeOld(folders, oldNames));
+		dNew1 = min(dNew1, TimeNew(folders, 1, newNames1));
+		dNew8 = min(dNew8, TimeNew(folders, 8, newNames8));
+	}
+	CHECK_EQUAL((size_t)nFolders * nSub, oldNames.size());
+	CHECK(oldNames == newNames1);
+	CHECK(oldNames == newNames8);
+
+	printf("%d folders, %d sub-folders and %d files each (best of %d runs)\n", nFolders, nSub, nFiles, RUNS);
+	printf("readdir, one folder at a time:     %8.2f ms\n", dOld);
+	printf("DirectoryEnumerator, 1 thread:     %8.2f ms (%.2fx)\n", dNew1, dOld / dNew1);
+	printf("DirectoryEnumerator, 8 threads:    %8.2f ms (%.2fx)\n", dNew8, dOld / dNew8);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+/**
+	@file
+	@brief Tests of DirectoryIndex: looking folders up, and saving and reading the snapshot
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "DirectoryIndex.h"
+#include "TestUtil.h"
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+	@param sRoot The root folder
+	@param pFolder A folder to create under it
+*/
+static void MakeFolder(const std::string& sRoot, const char* pFolder)
+{
+	std::string sPath = sRoot + "/" + pFolder;
+	CHECK(mkdir(sPath.c_str(), 0777) == 0);
+}
+
+/**
+	@return A tree: A, b (with x), c (with y and z), and a file
+*/
+static std::string MakeTree()
+{
+	std::string sRoot = MakeTestFolder() + "/root";
+	mkdir(sRoot.c_str(), 0777);
+	MakeFolder(sRoot, "b");
+	MakeFolder(sRoot, "b/x");
+	MakeFolder(sRoot, "A");
+	MakeFolder(sRoot, "c");
+	MakeFolder(sRoot, "c/y");
+	MakeFolder(sRoot, "c/z");
+	std::ofstream((sRoot + "/file").c_str()) << "not a folder";
+	return sRoot;
+}
+
+/**
+	Sub-folders come back sorted without regard to case, files left out
+*/
+static void TestLookup()
+{
+	std::string sRoot = MakeTree();
+	DirectoryIndex index;
+	// No snapshot yet
+	CHECK(!index.Open(sRoot.c_str(), (sRoot + ".index").c_str()));
+	CHECK(index.GetChildren("") == MakeList("A", "b", "c", NULL));
+	CHECK(index.GetChildren("c") == MakeList("y", "z", NULL));
+	CHECK(index.GetChildren(DirectoryIndex::GetChildNode("c", "y")).empty());
+	CHECK(index.GetChildren("missing").empty());
+	CHECK_EQUAL(std::string("c/y"), DirectoryIndex::GetChildNode("c", "y"));
+	CHECK_EQUAL(std::string("c"), DirectoryIndex::GetChildNode("", "c"));
+}
+
+/**
+	Folders added or renamed after a node was looked up show up the next time
+*/
+static void TestChanges()
+{
+	std::string sRoot = MakeTree();
+	DirectoryIndex index;
+	index.Open(sRoot.c_str(), NULL);
+	CHECK(index.GetChildren("") == MakeList("A", "b", "c", NULL));
+	CHECK(index.GetChildren("c") == MakeList("y", "z", NULL));
+	MakeFolder(sRoot, "c/w");
+	CHECK(rename((sRoot + "/b").c_str(), (sRoot + "/bb").c_str()) == 0);
+	CHECK(index.GetChildren("") == MakeList("A", "bb", "c", NULL));
+	CHECK(index.GetChildren("c") == MakeList("w", "y", "z", NULL));
+	CHECK(index.GetChildren("b").empty());
+	CHECK(index.GetChildren("bb") == MakeList("x", NULL));
+}
+
+/**
+	A saved index is read back by the next one, which checks it against the folders
+*/
+static void TestSaveLoad()
+{
+	std::string sRoot = MakeTree();
+	std::string sSnapshot = sRoot + ".index";
+	{
+		DirectoryIndex index;
+		index.Open(sRoot.c_str(), sSnapshot.c_str());
+		index.GetChildren("");
+		index.GetChildren("c");
+		CHECK(index.Save());
+	}
+	std::string sLine;
+	{
+		std::ifstream in(sSnapshot.c_str());
+		std::getline(in, sLine);
+	}
+	CHECK_EQUAL(std::string("CCPDFConverter directory index 1"), sLine);
+
+	{
+		DirectoryIndex index;
+		CHECK(index.Open(sRoot.c_str(), sSnapshot.c_str()));
+		CHECK(index.GetChildren("") == MakeList("A", "b", "c", NULL));
+		CHECK(index.GetChildren("c") == MakeList("y", "z", NULL));
+	}
+
+	// Changed while no index was open: the folder's time tells
+	CHECK(rmdir((sRoot + "/c/y").c_str()) == 0);
+	MakeFolder(sRoot, "c/q");
+	{
+		DirectoryIndex index;
+		CHECK(index.Open(sRoot.c_str(), sSnapshot.c_str()));
+		CHECK(index.GetChildren("c") == MakeList("q", "z", NULL));
+		CHECK(index.Save());
+	}
+	{
+		DirectoryIndex index;
+		CHECK(index.Open(sRoot.c_str(), sSnapshot.c_str()));
+		CHECK(index.GetChildren("c") == MakeList("q", "z", NULL));
+	}
+}
+
+/**
+	A snapshot of another tree, or a damaged one, isn't used
+*/
+static void TestBadSnapshot()
+{
+	std::string sRoot = MakeTree();
+	std::string sSnapshot = sRoot + ".index";
+	{
+		DirectoryIndex index;
+		index.Open(sRoot.c_str(), sSnapshot.c_str());
+		index.GetChildren("");
+		CHECK(index.Save());
+	}
+	std::string sOther = MakeTree();
+	{
+		DirectoryIndex index;
+		CHECK(!index.Open(sOther.c_str(), sSnapshot.c_str()));
+		CHECK(index.GetChildren("") == MakeList("A", "b", "c", NULL));
+	}
+
+	std::ofstream(sSnapshot.c_str(), std::ios::trunc) << "CCPDFConverter directory index 1\n" << sRoot << "\n\t12\tx\n";
+	{
+		DirectoryIndex index;
+		CHECK(!index.Open(sRoot.c_str(), sSnapshot.c_str()));
+		CHECK(index.GetChildren("c") == MakeList("y", "z", NULL));
+	}
+}
+
+/**
+	Build lists the root and all the level 1 folders at once
+*/
+static void TestBuild()
+{
+	std::string sRoot = MakeTree();
+	DirectoryIndex index;
+	index.Open(sRoot.c_str(), NULL);
+	CHECK(index.Build(4) > 0);
+	CHECK(index.GetChildren("") == MakeList("A", "b", "c", NULL));
+	CHECK(index.GetChildren("b") == MakeList("x", NULL));
+	CHECK(index.GetChildren("A").empty());
+}
+
+int main()
+{
+	RUN_TEST(TestLookup);
+	RUN_TEST(TestChanges);
+	RUN_TEST(TestSaveLoad);
+	RUN_TEST(TestBadSnapshot);
+	RUN_TEST(TestBuild);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+/**
+	@file
+	@brief Tests of JobRouter: reading the rules, matching globs and regexes, and the names it makes
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "JobRouter.h"
+#include "TestUtil.h"
+
+// CCPDFConverter.cpp holds the settings
+configuration::data myconfigdata;
+
+/// Opens up the protected parts of JobRouter
+class TestRouter : public JobRouter
+{
+public:
+	typedef JobRouter::Rule Rule;
+
+	using JobRouter::GlobMatch;
+	using JobRouter::ParseRule;
+};
+
+/// Where a job was routed
+struct Routed
+{
+	/// The rule number (0 if none matched)
+	int					nRule;
+	/// The folders and the document name
+	std::string			sLevel1, sLevel2, sFile;
+	/// The job result
+	JobResult			result;
+};
+
+/**
+	@param pTitle The document title
+	@param pUser The user
+	@param pJobName The job name
+	@param routed Receives where the job went
+*/
+static void Route(const char* pTitle, const char* pUser, const char* pJobName, Routed& routed)
+{
+	JobRouter router;
+	router.LoadRules();
+	JobInfo info;
+	info.sTitle = pTitle;
+	info.sUser = pUser;
+	info.sJobName = pJobName;
+	routed.result = JobResult();
+	routed.nRule = router.Route(info, routed.sLevel1, routed.sLevel2, routed.sFile, routed.result);
+}
+
+static void TestGlob()
+{
+	CHECK(TestRouter::GlobMatch("abc", "abc"));
+	CHECK(!TestRouter::GlobMatch("abc", "abcd"));
+	CHECK(!TestRouter::GlobMatch("abcd", "abc"));
+	CHECK(TestRouter::GlobMatch("*-q?-report", "2010-q3-report"));
+	CHECK(!TestRouter::GlobMatch("*-q?-report", "2010-q-report"));
+	CHECK(TestRouter::GlobMatch("a*c", "abbbc"));
+	CHECK(TestRouter::GlobMatch("a*c", "ac"));
+	CHECK(!TestRouter::GlobMatch("a*c", "abcd"));
+	CHECK(TestRouter::GlobMatch("*a*b", "xxaxxbab"));
+	CHECK(!TestRouter::GlobMatch("*a*b", "xxaxxba"));
+	CHECK(TestRouter::GlobMatch("a**", "a"));
+	CHECK(TestRouter::GlobMatch("*", ""));
+	CHECK(!TestRouter::GlobMatch("?", ""));
+	CHECK(!TestRouter::GlobMatch("a?c", "ac"));
+}
+
+static void TestParseRule()
+{
+	TestRouter::Rule rule;
+	CHECK(TestRouter::ParseRule("title prefix \"Invoice \" -> Invoices\\{user}", rule));
+	CHECK_EQUAL(std::string("invoice "), rule.sPattern);
+	CHECK_EQUAL(std::string("invoice "), rule.sLiteral);
+	CHECK_EQUAL(std::string("Invoices\\{user}"), rule.sTarget);
+
+	CHECK(TestRouter::ParseRule("JobName GLOB *-Q?-report -> Reports\\Quarterly", rule));
+	CHECK_EQUAL(std::string("*-q?-report"), rule.sPattern);
+	CHECK_EQUAL(std::string(""), rule.sLiteral);
+	CHECK(TestRouter::ParseRule("jobname glob Q?-* -> Reports\\Quarterly", rule));
+	CHECK_EQUAL(std::string("q"), rule.sLiteral);
+
+	// The literal start of a regex
+	CHECK(TestRouter::ParseRule("user regex ^Acct-(\\w+)$ -> Accounts\\{1}", rule));
+	CHECK_EQUAL(std::string("^Acct-(\\w+)$"), rule.sPattern);
+	CHECK_EQUAL(std::string("acct-"), rule.sLiteral);
+	CHECK(TestRouter::ParseRule("user regex abc*d -> A\\B", rule));
+	CHECK_EQUAL(std::string("ab"), rule.sLiteral);
+	CHECK(TestRouter::ParseRule("user regex a{2}b -> A\\B", rule));
+	CHECK_EQUAL(std::string(""), rule.sLiteral);
+	CHECK(TestRouter::ParseRule("user regex abc|xyz -> A\\B", rule));
+	CHECK_EQUAL(std::string(""), rule.sLiteral);
+	CHECK(TestRouter::ParseRule("user regex caf\xe9-.* -> A\\B", rule));
+	CHECK_EQUAL(std::string("caf"), rule.sLiteral);
+
+	// Not rules
+	CHECK(!TestRouter::ParseRule("title prefix Invoice", rule));
+	CHECK(!TestRouter::ParseRule("owner prefix Invoice -> A\\B", rule));
+	CHECK(!TestRouter::ParseRule("title suffix Invoice -> A\\B", rule));
+	CHECK(!TestRouter::ParseRule("title prefix -> A\\B", rule));
+	CHECK(!TestRouter::ParseRule("title prefix Invoice ->", rule));
+}
+
+static void TestRoute()
+{
+	myconfigdata.clear();
+	myconfigdata["route.10"] = "title prefix \"Invoice \" -> Invoices\\{user}\\{name}";
+	myconfigdata["route.9"] = "jobname glob *-Q?-report -> Reports\\Quarterly";
+	myconfigdata["route.30"] = "user regex ^acct-(\\w+)$ -> Accounts\\{1}";
+	myconfigdata["route.x"] = "title prefix a -> Not\\Read";
+
+	Routed routed;
+	Route("INVOICE 1234 - Microsoft Word", "jane", "2010-q3-summary", routed);
+	CHECK_EQUAL(10, routed.nRule);
+	CHECK_EQUAL(std::string("Invoices"), routed.sLevel1);
+	CHECK_EQUAL(std::string("jane"), routed.sLevel2);
+	CHECK_EQUAL(std::string("INVOICE 1234"), routed.sFile);
+	CHECK_EQUAL(std::string("10"), routed.result["route.rule"]);
+	CHECK(routed.result.iskey("time.route"));
+	CHECK(!routed.result.iskey("route.invalid"));
+
+	// By number, not as the keys sort
+	Route("Invoice 1 - Excel", "jane", "2010-Q3-Report", routed);
+	CHECK_EQUAL(9, routed.nRule);
+	CHECK_EQUAL(std::string("Quarterly"), routed.sLevel2);
+	CHECK_EQUAL(std::string("Invoice 1"), routed.sFile);
+
+	Route("Ledger", "ACCT-Payable", "", routed);
+	CHECK_EQUAL(30, routed.nRule);
+	CHECK_EQUAL(std::string("Accounts"), routed.sLevel1);
+	CHECK_EQUAL(std::string("Payable"), routed.sLevel2);
+	CHECK_EQUAL(std::string("Ledger"), routed.sFile);
+
+	// The whole value must match the regex
+	Route("Ledger", "acct-payable-2", "", routed);
+	CHECK_EQUAL(0, routed.nRule);
+	CHECK(!routed.result.iskey("route.rule"));
+}
+
+static void TestInvalidRules()
+{
+	myconfigdata.clear();
+	myconfigdata["route.1"] = "title prefix";
+	myconfigdata["route.2"] = "title regex ^bad( -> A\\B";
+	myconfigdata["route.3"] = "title regex ^good -> Good\\Rule";
+	JobRouter router;
+	CHECK(!router.LoadRules());
+	CHECK(router.IsEnabled());
+
+	JobInfo info;
+	info.sTitle = "good";
+	std::string sLevel1, sLevel2, sFile;
+	JobResult result;
+	CHECK_EQUAL(3, router.Route(info, sLevel1, sLevel2, sFile, result));
+	CHECK_EQUAL(std::string("Good"), sLevel1);
+	// The regex is only compiled once a value could match it
+	CHECK_EQUAL(std::string("1"), result["route.invalid"]);
+	info.sTitle = "bad";
+	CHECK_EQUAL(0, router.Route(info, sLevel1, sLevel2, sFile, result));
+	CHECK_EQUAL(std::string("1,2"), result["route.invalid"]);
+}
+
+static void TestNames()
+{
+	myconfigdata.clear();
+	myconfigdata["route.1"] = "title prefix a -> {user}\\{jobname}\\{title}";
+	myconfigdata["route.2"] = "title prefix b -> Fixed\\{user}";
+	myconfigdata["route.3"] = "title prefix c -> Level\\{unknown}\\{9}";
+
+	// Nothing in a value makes another folder, or goes out of one
+	Routed routed;
+	Route("a/b:c*d?e\"f<g>h|i - App", "dom\\user", "..\\..\\x", routed);
+	CHECK_EQUAL(1, routed.nRule);
+	CHECK_EQUAL(std::string("dom_user"), routed.sLevel1);
+	CHECK_EQUAL(std::string(".._.._x"), routed.sLevel2);
+	CHECK_EQUAL(std::string("a_b_c_d_e_f_g_h_i - App"), routed.sFile);
+	Route("a\ttab", "u", "j", routed);
+	CHECK_EQUAL(std::string("a_tab"), routed.sFile);
+
+	// A value that leaves a level empty (or . or ..) passes on to the next rule
+	Route("a", "", "j", routed);
+	CHECK_EQUAL(0, routed.nRule);
+	Route("a", "..", "j", routed);
+	CHECK_EQUAL(0, routed.nRule);
+
+	// Named as the dialog would name it
+	Route("b - Notepad", "u", "", routed);
+	CHECK_EQUAL(2, routed.nRule);
+	CHECK_EQUAL(std::string("b"), routed.sFile);
+	Route("b ", "u", "", routed);
+	CHECK_EQUAL(std::string("b"), routed.sFile);
+
+	// Anything that isn't a variable is kept, captures that aren't there are empty
+	Route("c", "u", "", routed);
+	CHECK_EQUAL(0, routed.nRule);
+	myconfigdata["route.3"] = "title prefix c -> Level\\{unknown}{9}";
+	Route("c", "u", "", routed);
+	CHECK_EQUAL(3, routed.nRule);
+	CHECK_EQUAL(std::string("{unknown}"), routed.sLevel2);
+}
+
+static void TestJobInfo()
+{
+	const char* pData =
+		"\x1b%-12345X@PJL JOB NAME = \"Quarterly report\"\r\n"
+		"@PJL ENTER LANGUAGE = POSTSCRIPT\r\n"
+		"%!PS-Adobe-3.0\r\n"
+		"%%Title: Report.doc\r\n"
+		"%%For: (jane)\r\n";
+	JobInfo info;
+	info.Read(pData, strlen(pData));
+	CHECK_EQUAL(std::string("jane"), info.sUser);
+	CHECK_EQUAL(std::string("Quarterly report"), info.sJobName);
+
+	pData = "@PJL SET JOBNAME=\"Scan 1\"\n%%For: jane smith\n";
+	JobInfo other;
+	other.Read(pData, strlen(pData));
+	CHECK_EQUAL(std::string("jane smith"), other.sUser);
+	CHECK_EQUAL(std::string("Scan 1"), other.sJobName);
+}
+
+int main()
+{
+	RUN_TEST(TestGlob);
+	RUN_TEST(TestParseRule);
+	RUN_TEST(TestRoute);
+	RUN_TEST(TestInvalidRules);
+	RUN_TEST(TestNames);
+	RUN_TEST(TestJobInfo);
+	return (g_nFailures == 0) ? 0 : 1;
+}
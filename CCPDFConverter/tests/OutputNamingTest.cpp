@@ -0,0 +1,255 @@
+/**
+	@file
+	@brief Tests of OutputNaming: expanding the naming template, and names that are taken
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "OutputNaming.h"
+#include "TestUtil.h"
+#include <fstream>
+#include <sys/stat.h>
+
+/// Opens up the protected parts of OutputNaming
+class TestNaming : public OutputNaming
+{
+public:
+	TestNaming(const std::string& sTemplate) : OutputNaming(sTemplate) {}
+
+	using OutputNaming::Expand;
+	using OutputNaming::NextSequence;
+	using OutputNaming::Reserve;
+};
+
+/**
+	@param sFile The file name
+	@return true if the file is there
+*/
+static bool FileExists(const std::string& sFile)
+{
+	struct stat st;
+	return stat(sFile.c_str(), &st) == 0;
+}
+
+/**
+	@param sFile The file name
+	@param pText The text to write into it
+*/
+static void WriteText(const std::string& sFile, const char* pText)
+{
+	std::ofstream f(sFile.c_str());
+	f << pText;
+}
+
+/**
+	@param sFile The file name
+	@return The first line of the file
+*/
+static std::string ReadLine(const std::string& sFile)
+{
+	std::ifstream f(sFile.c_str());
+	std::string sRet;
+	std::getline(f, sRet);
+	return sRet;
+}
+
+/**
+	@param naming The naming to use
+	@param sFolder The folder of the document
+	@param pTitle The document name, as typed in the dialog
+	@param result The job result
+	@return The name given by the template (without the folder), empty if it wasn't named
+*/
+static std::string Name(OutputNaming& naming, const std::string& sFolder, const char* pTitle, JobResult& result)
+{
+	char cFile[MAX_PATH];
+	sprintf_s(cFile, sizeof(cFile), "%s\\%s", sFolder.c_str(), pTitle);
+	if (!naming.MakeName(cFile, sizeof(cFile), result))
+		return "";
+	std::string sFile(cFile);
+	CHECK_EQUAL(sFolder + "\\", sFile.substr(0, sFolder.size() + 1));
+	return sFile.substr(sFolder.size() + 1);
+}
+
+static void TestExpand()
+{
+	TestNaming naming("{level1}-{title}");
+	naming.SetVariable("level1", "Sales");
+	naming.SetVariable("level2", "2010");
+	naming.SetVariable("title", "Report");
+	CHECK_EQUAL(std::string("Sales-Report"), naming.Expand("{level1}-{title}", 0));
+	CHECK_EQUAL(std::string("2010/2010"), naming.Expand("{level2}/{level2}", 0));
+	CHECK_EQUAL(std::string("Report 7"), naming.Expand("{title} {seq}", 7));
+	CHECK_EQUAL(std::string("0042-Report"), naming.Expand("{seq:4}-{title}", 42));
+	CHECK_EQUAL(std::string("12345"), naming.Expand("{seq:2}", 12345));
+	// Widths are kept to 20 digits
+	CHECK_EQUAL(std::string(19, '0') + "1", naming.Expand("{seq:50}", 1));
+	// Anything else is left as it is
+	CHECK_EQUAL(std::string("{user} {seq"), naming.Expand("{user} {seq", 1));
+}
+
+static void TestDateAndTime()
+{
+	TestNaming naming("{date} {time}");
+	std::string sName = naming.Expand("{date} {time}", 0);
+	CHECK_EQUAL((std::string::size_type)17, sName.size());
+	CHECK_EQUAL(std::string::npos, sName.find_first_not_of("0123456789- "));
+	CHECK_EQUAL('-', sName[4]);
+	CHECK_EQUAL('-', sName[7]);
+	CHECK_EQUAL(' ', sName[10]);
+}
+
+static void TestSanitize()
+{
+	TestNaming naming("{title}");
+	naming.SetVariable("title", "a\\b/c:d*e?f\"g<h>i|j.k l");
+	CHECK_EQUAL(std::string("a_b_c_d_e_f_g_h_i_j.k l"), naming.Expand("{title}", 0));
+}
+
+static void TestDisabled()
+{
+	std::string sFolder = MakeTestFolder();
+	OutputNaming naming("");
+	CHECK(!naming.IsEnabled());
+	JobResult result;
+	CHECK_EQUAL(std::string(""), Name(naming, sFolder, "Report.pdf", result));
+	CHECK(!FileExists(sFolder + "/Report.pdf.reserved"));
+}
+
+static void TestCollisions()
+{
+	std::string sFolder = MakeTestFolder();
+	OutputNaming naming("{level1} {title}");
+	naming.SetVariable("level1", "Sales");
+	JobResult result;
+	// Used as it is while it's free, with a sequence number after that
+	CHECK_EQUAL(std::string("Sales Report.pdf"), Name(naming, sFolder, "Report.PDF", result));
+	CHECK(!result.iskey("naming.seq"));
+	CHECK_EQUAL(std::string("Sales Report (1).pdf"), Name(naming, sFolder, "Report.pdf", result));
+	CHECK_EQUAL(std::string("1"), result["naming.seq"]);
+	CHECK_EQUAL(std::string("Sales Report (2).pdf"), Name(naming, sFolder, "Report", result));
+	CHECK_EQUAL(std::string("2"), result["naming.seq"]);
+	// Each name is reserved by a marker, and no empty document is there
+	CHECK(FileExists(sFolder + "/Sales Report.pdf.reserved"));
+	CHECK(FileExists(sFolder + "/Sales Report (1).pdf.reserved"));
+	CHECK(FileExists(sFolder + "/Sales Report (2).pdf.reserved"));
+	CHECK(!FileExists(sFolder + "/Sales Report.pdf"));
+	// Another title is free again
+	CHECK_EQUAL(std::string("Sales Summary.pdf"), Name(naming, sFolder, "Summary.pdf", result));
+}
+
+static void TestSequence()
+{
+	std::string sFolder = MakeTestFolder();
+	OutputNaming naming("{title}-{seq:3}");
+	JobResult result;
+	CHECK_EQUAL(std::string("Scan-001.pdf"), Name(naming, sFolder, "Scan.pdf", result));
+	CHECK_EQUAL(std::string("Scan-002.pdf"), Name(naming, sFolder, "Scan.pdf", result));
+	// A name taken some other way is skipped
+	WriteText(sFolder + "/Scan-003.pdf", "by hand");
+	CHECK_EQUAL(std::string("Scan-004.pdf"), Name(naming, sFolder, "Scan.pdf", result));
+	CHECK_EQUAL(std::string("4"), result["naming.seq"]);
+	CHECK_EQUAL(std::string("by hand"), ReadLine(sFolder + "/Scan-003.pdf"));
+	// The counter is per folder, not per title
+	CHECK_EQUAL(std::string("Other-005.pdf"), Name(naming, sFolder, "Other.pdf", result));
+}
+
+static void TestNextSequence()
+{
+	std::string sFolder = MakeTestFolder();
+	unsigned __int64 nSequence = 0;
+	CHECK(TestNaming::NextSequence(sFolder, nSequence));
+	CHECK_EQUAL(1ULL, nSequence);
+	CHECK(TestNaming::NextSequence(sFolder, nSequence));
+	CHECK_EQUAL(2ULL, nSequence);
+	// Carries on from a counter written before
+	WriteText(sFolder + "/CCPDFConverter.seq", "41\r\n");
+	CHECK(TestNaming::NextSequence(sFolder, nSequence));
+	CHECK_EQUAL(42ULL, nSequence);
+	CHECK_EQUAL(std::string("42\r"), ReadLine(sFolder + "/CCPDFConverter.seq"));
+}
+
+static void TestTooLong()
+{
+	std::string sFolder = MakeTestFolder();
+	OutputNaming naming("{title} with a long suffix");
+	JobResult result;
+	char cFile[MAX_PATH];
+	sprintf_s(cFile, sizeof(cFile), "%s\\Report.pdf", sFolder.c_str());
+	std::string sBefore(cFile);
+	CHECK(!naming.MakeName(cFile, sBefore.size() + 4, result));
+	CHECK_EQUAL(sBefore, std::string(cFile));
+}
+
+static void TestReserve()
+{
+	std::string sFolder = MakeTestFolder();
+	std::string sName = sFolder + "/Report.pdf";
+	CHECK(TestNaming::Reserve(sName));
+	CHECK(FileExists(sName + ".reserved"));
+	CHECK(!FileExists(sName));
+	CHECK(!TestNaming::Reserve(sName));
+	CHECK_EQUAL((DWORD)ERROR_FILE_EXISTS, GetLastError());
+	CHECK(!TestNaming::Reserve(sFolder + "/missing/Report.pdf"));
+	CHECK((DWORD)ERROR_FILE_EXISTS != GetLastError());
+	// A document that's there already is taken, and no marker is left for it
+	WriteText(sFolder + "/Summary.pdf", "%PDF-1.4");
+	CHECK(!TestNaming::Reserve(sFolder + "/Summary.pdf"));
+	CHECK_EQUAL((DWORD)ERROR_FILE_EXISTS, GetLastError());
+	CHECK(!FileExists(sFolder + "/Summary.pdf.reserved"));
+}
+
+static void TestUnreserve()
+{
+	std::string sFolder = MakeTestFolder();
+	OutputNaming naming("{title}");
+	JobResult result;
+	CHECK_EQUAL(std::string("Report.pdf"), Name(naming, sFolder, "Report.pdf", result));
+	// The document is published next to its marker, which then goes
+	WriteText(sFolder + "/Report.pdf", "%PDF-1.4");
+	CHECK(OutputNaming::Unreserve((sFolder + "\\Report.pdf").c_str()));
+	CHECK(!FileExists(sFolder + "/Report.pdf.reserved"));
+	CHECK(FileExists(sFolder + "/Report.pdf"));
+	// Nothing to free
+	CHECK(OutputNaming::Unreserve((sFolder + "\\Report.pdf").c_str()));
+	// A marker something was written into is kept
+	WriteText(sFolder + "/Report.pdf.reserved", "data");
+	CHECK(!OutputNaming::Unreserve((sFolder + "\\Report.pdf").c_str()));
+	CHECK(FileExists(sFolder + "/Report.pdf.reserved"));
+}
+
+int main()
+{
+	RUN_TEST(TestExpand);
+	RUN_TEST(TestDateAndTime);
+	RUN_TEST(TestSanitize);
+	RUN_TEST(TestDisabled);
+	RUN_TEST(TestCollisions);
+	RUN_TEST(TestSequence);
+	RUN_TEST(TestNextSequence);
+	RUN_TEST(TestTooLong);
+	RUN_TEST(TestReserve);
+	RUN_TEST(TestUnreserve);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+/**
+	@file
+	@brief Tests for the compact stage
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfCompact.h"
+#include "Configuration.h"
+#include "TestUtil.h"
+#include "TestPdf.h"
+
+/// The settings the stage reads
+configuration::data myconfigdata;
+
+/// The stage, with its plan open to the tests
+class TestCompactStage : public CompactStage
+{
+public:
+	/**
+		@param nNum Old object number
+		@return The new number (0 if the object is dropped)
+	*/
+	int					GetNewNumber(int nNum) const {return m_renumber[nNum];};
+};
+
+/**
+	@return Two pages with the same link, form field, structure element, content and resources each
+*/
+static std::string MakeSharedPdf()
+{
+	std::vector<std::string> objects;
+	objects.push_back("<</Type /Catalog /Pages 2 0 R /StructTreeRoot 11 0 R>>");
+	objects.push_back("<</Type /Pages /Kids [3 0 R 4 0 R] /Count 2 /MediaBox [0 0 612 792]>>");
+	objects.push_back("<</Type /Page /Parent 2 0 R /Contents 5 0 R /Resources 14 0 R /Annots [7 0 R 9 0 R]>>");
+	objects.push_back("<</Type /Page /Parent 2 0 R /Contents 6 0 R /Resources 15 0 R /Annots [8 0 R 10 0 R]>>");
+	objects.push_back("<</Length 12>>\nstream\n0 0 m 9 9 l\nendstream");
+	objects.push_back("<</Length 12>>\nstream\n0 0 m 9 9 l\nendstream");
+	objects.push_back("<</Type /Annot /Subtype /Link /Rect [0 0 99 9] /A <</S /URI /URI (http://example.com/)>>>>");
+	objects.push_back("<</Type /Annot /Subtype /Link /Rect [0 0 99 9] /A <</S /URI /URI (http://example.com/)>>>>");
+	objects.push_back("<</Subtype /Widget /FT /Btn /Rect [0 0 9 9]>>");
+	objects.push_back("<</Subtype /Widget /FT /Btn /Rect [0 0 9 9]>>");
+	objects.push_back("<</Type /StructTreeRoot /K [12 0 R 13 0 R]>>");
+	objects.push_back("<</Type /StructElem /S /Link>>");
+	objects.push_back("<</Type /StructElem /S /Link>>");
+	objects.push_back("<</ProcSet [/PDF]>>");
+	objects.push_back("<</ProcSet [/PDF]>>");
+	return MakePdf(objects, "/Root 1 0 R");
+}
+
+static void TestSharedAnnotations()
+{
+	myconfigdata.clear();
+	myconfigdata["compact.threads"] = "1";
+	std::string sFolder = MakeTestFolder();
+	CHECK(WriteFileData(sFolder + "/in.pdf", MakeSharedPdf()));
+	PdfDocument doc;
+	CHECK(doc.Load((sFolder + "/in.pdf").c_str()));
+	TestCompactStage stage;
+	JobResult result;
+	CHECK(stage.Process(doc, result));
+
+	// Each page keeps its own link, form field and structure element
+	CHECK(stage.GetNewNumber(7) != stage.GetNewNumber(8));
+	CHECK(stage.GetNewNumber(9) != stage.GetNewNumber(10));
+	CHECK(stage.GetNewNumber(12) != stage.GetNewNumber(13));
+	CHECK(stage.GetNewNumber(3) != stage.GetNewNumber(4));
+	// But the content and resources they share are written once
+	CHECK(stage.GetNewNumber(5) != 0);
+	CHECK_EQUAL(stage.GetNewNumber(5), stage.GetNewNumber(6));
+	CHECK_EQUAL(stage.GetNewNumber(14), stage.GetNewNumber(15));
+
+	CHECK(stage.Save(doc, (sFolder + "/out.pdf").c_str(), result));
+	CHECK_EQUAL((long)2, result.getint("postprocess.compact.duplicates", -1));
+	CHECK_EQUAL(std::string("1.5"), ReadFileData(sFolder + "/out.pdf").substr(5, 3));
+}
+
+int main()
+{
+	RUN_TEST(TestSharedAnnotations);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/**
+	@file
+	@brief Tests for the PDF parser and writer (round trips, cross-reference tables and free lists)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfDocument.h"
+#include "TestUtil.h"
+#include "TestPdf.h"
+
+/**
+	@param doc The document
+	@param nNum The object number
+	@return The object in PDF syntax (empty if there's no such object)
+*/
+static std::string ObjectText(PdfDocument& doc, int nNum)
+{
+	std::string sRet;
+	PdfObject* pObject = doc.GetObject(nNum);
+	if (pObject != NULL)
+		pObject->Write(sRet);
+	return sRet;
+}
+
+/**
+	@param sData The saved document
+	@param nNum The object number
+	@return The object's cross-reference entry (without the line break)
+*/
+static std::string XrefEntry(const std::string& sData, int nNum)
+{
+	size_t nPos = sData.rfind("xref\n0 ");
+	if (nPos == std::string::npos)
+		return "";
+	nPos = sData.find('\n', nPos + 5) + 1 + nNum * 20;
+	return (nPos + 18 <= sData.size()) ? sData.substr(nPos, 18) : "";
+}
+
+static void TestLoad()
+{
+	std::string sFile = MakeTestFolder() + "/in.pdf";
+	CHECK(WriteFileData(sFile, MakeTwoPagePdf()));
+	PdfDocument doc;
+	CHECK(doc.Load(sFile.c_str()));
+	CHECK_EQUAL(std::string("1.4"), doc.GetVersion());
+	CHECK_EQUAL(7, doc.GetObjectCount());
+	CHECK(!doc.IsObject(0));
+	CHECK(doc.IsObject(6));
+	CHECK(!doc.IsObject(7));
+	PdfObject* pCatalog = doc.Resolve(doc.GetTrailer().Get("Root"));
+	CHECK((pCatalog != NULL) && (pCatalog->Get("Type") != NULL) && (pCatalog->Get("Type")->sValue == "Catalog"));
+	PdfObject* pContents = doc.GetObject(5);
+	CHECK((pContents != NULL) && pContents->Is(PdfObject::Stream) && (pContents->sValue == "0 0 m 9 9 l\n"));
+
+	// Only the data is kept when read with ReadObject
+	PdfObject page;
+	PdfData data;
+	CHECK(doc.ReadObject(6, page, &data));
+	CHECK(page.sValue.empty());
+	CHECK_EQUAL(std::string("9 9 m 0 0 l\n"), std::string(data.data(), data.size()));
+	CHECK(!doc.ReadObject(9, page));
+}
+
+static void TestRoundTrip()
+{
+	std::string sFolder = MakeTestFolder();
+	CHECK(WriteFileData(sFolder + "/in.pdf", MakeTwoPagePdf()));
+	PdfDocument doc;
+	CHECK(doc.Load((sFolder + "/in.pdf").c_str()));
+	CHECK(doc.Save((sFolder + "/out.pdf").c_str()));
+
+	// Everything reads back the same
+	PdfDocument saved;
+	CHECK(saved.Load((sFolder + "/out.pdf").c_str()));
+	CHECK_EQUAL(doc.GetObjectCount(), saved.GetObjectCount());
+	for (int i = 1; i < doc.GetObjectCount(); i++)
+		CHECK_EQUAL(ObjectText(doc, i), ObjectText(saved, i));
+	CHECK(saved.GetTrailer().Get("Root") != NULL);
+	CHECK((saved.GetTrailer().Get("Size") != NULL) && (saved.GetTrailer().Get("Size")->nValue == 7));
+
+	// Changes are saved too
+	int nNum = saved.AddObject(PdfObject::MakeString("added (text)"));
+	CHECK_EQUAL(7, nNum);
+	saved.GetObject(1)->Set("Extra", PdfObject::MakeReference(nNum));
+	CHECK(saved.Save((sFolder + "/changed.pdf").c_str()));
+	PdfDocument changed;
+	CHECK(changed.Load((sFolder + "/changed.pdf").c_str()));
+	CHECK_EQUAL(std::string("(added \\(text\\))"), ObjectText(changed, 7));
+	CHECK_EQUAL(std::string("7 0 R"), ObjectText(changed, 1).substr(ObjectText(changed, 1).find("/Extra ") + 7, 5));
+}
+
+static void TestFreeList()
+{
+	std::string sFolder = MakeTestFolder();
+	CHECK(WriteFileData(sFolder + "/in.pdf", MakeTwoPagePdf()));
+	PdfDocument doc;
+	CHECK(doc.Load((sFolder + "/in.pdf").c_str()));
+	doc.RemoveObject(5);
+	doc.RemoveObject(3);
+	CHECK(doc.Save((sFolder + "/out.pdf").c_str()));
+
+	// Each free entry points at the next one, and the last at 0
+	std::string sData = ReadFileData(sFolder + "/out.pdf");
+	CHECK_EQUAL(std::string("0000000003 65535 f"), XrefEntry(sData, 0));
+	CHECK_EQUAL(std::string("0000000005 00001 f"), XrefEntry(sData, 3));
+	CHECK_EQUAL(std::string("0000000000 00001 f"), XrefEntry(sData, 5));
+	CHECK(XrefEntry(sData, 4).compare(10, 8, " 00000 n") == 0);
+
+	PdfDocument saved;
+	CHECK(saved.Load((sFolder + "/out.pdf").c_str()));
+	CHECK(!saved.IsObject(3));
+	CHECK(!saved.IsObject(5));
+	CHECK(saved.IsObject(4));
+	CHECK_EQUAL(1, saved.GetGeneration(3));
+	CHECK_EQUAL(ObjectText(doc, 6), ObjectText(saved, 6));
+
+	// A document with nothing free still has entry 0
+	PdfDocument full;
+	CHECK(full.Load((sFolder + "/in.pdf").c_str()));
+	CHECK(full.Save((sFolder + "/full.pdf").c_str()));
+	CHECK_EQUAL(std::string("0000000000 65535 f"), XrefEntry(ReadFileData(sFolder + "/full.pdf"), 0));
+}
+
+static void TestUpdate()
+{
+	// An incremental update replaces object 5 and adds object 7
+	std::string sData = MakeTwoPagePdf();
+	size_t nPrev = sData.rfind("\nxref\n") + 1;
+	size_t nNew5 = sData.size();
+	sData += "5 0 obj\n<</Length 4>>\nstream\nnew\n\nendstream\nendobj\n";
+	size_t nNew7 = sData.size();
+	sData += "7 0 obj\n(seven)\nendobj\n";
+	size_t nXref = sData.size();
+	char cTable[256];
+	sprintf(cTable, "xref\n5 1\n%010u 00000 n \n7 1\n%010u 00000 n \ntrailer\n<</Size 8 /Root 1 0 R /Prev %u>>\nstartxref\n%u\n%%%%EOF\n",
+		(unsigned)nNew5, (unsigned)nNew7, (unsigned)nPrev, (unsigned)nXref);
+	sData += cTable;
+	std::string sFile = MakeTestFolder() + "/update.pdf";
+	CHECK(WriteFileData(sFile, sData));
+
+	PdfDocument doc;
+	CHECK(doc.Load(sFile.c_str()));
+	CHECK_EQUAL(nXref, doc.GetXrefOffset());
+	CHECK_EQUAL(8, doc.GetObjectCount());
+	CHECK(doc.GetObject(5) != NULL);
+	CHECK_EQUAL(std::string("new\n"), doc.GetObject(5)->sValue);
+	CHECK_EQUAL(std::string("(seven)"), ObjectText(doc, 7));
+	// What the update didn't touch is still read from the original
+	CHECK_EQUAL(std::string("9 9 m 0 0 l\n"), doc.GetObject(6)->sValue);
+}
+
+static void TestStartxref()
+{
+	std::string sFolder = MakeTestFolder();
+	// A little after the end is fine
+	CHECK(WriteFileData(sFolder + "/tail.pdf", MakeTwoPagePdf() + std::string(200, ' ') + "\n"));
+	PdfDocument doc;
+	CHECK(doc.Load((sFolder + "/tail.pdf").c_str()));
+	// But startxref is only looked for near the end
+	CHECK(WriteFileData(sFolder + "/far.pdf", MakeTwoPagePdf() + std::string(2000, ' ') + "\n"));
+	CHECK(!doc.Load((sFolder + "/far.pdf").c_str()));
+	// Not a PDF at all
+	CHECK(WriteFileData(sFolder + "/text.pdf", std::string(5000, 'x')));
+	CHECK(!doc.Load((sFolder + "/text.pdf").c_str()));
+	CHECK(!doc.Load((sFolder + "/missing.pdf").c_str()));
+	// No startxref
+	std::string sData = MakeTwoPagePdf();
+	CHECK(WriteFileData(sFolder + "/cut.pdf", sData.substr(0, sData.rfind("startxref"))));
+	CHECK(!doc.Load((sFolder + "/cut.pdf").c_str()));
+}
+
+static void TestTextString()
+{
+	// Plain ASCII is a literal string
+	PdfObject ascii = PdfObject::MakeTextString("Q3 (draft)");
+	CHECK(ascii.Is(PdfObject::String));
+	CHECK_EQUAL(std::string("Q3 \\(draft\\)"), ascii.sValue);
+	// Anything else is UTF-16BE
+	PdfObject text = PdfObject::MakeTextString("Caf\xE9");
+	CHECK(text.Is(PdfObject::HexString));
+	CHECK_EQUAL(std::string("FEFF00430061006600E9"), text.sValue);
+	std::string sOut;
+	text.Write(sOut);
+	CHECK_EQUAL(std::string("<FEFF00430061006600E9>"), sOut);
+	CHECK(PdfObject::MakeTextString("").Is(PdfObject::String));
+}
+
+int main()
+{
+	RUN_TEST(TestLoad);
+	RUN_TEST(TestRoundTrip);
+	RUN_TEST(TestFreeList);
+	RUN_TEST(TestUpdate);
+	RUN_TEST(TestStartxref);
+	RUN_TEST(TestTextString);
+	return (g_nFailures == 0) ? 0 : 1;
+}
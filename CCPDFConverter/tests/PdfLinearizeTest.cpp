@@ -0,0 +1,111 @@
+/**
+	@file
+	@brief Tests for the linearize post-processing stage
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfLinearize.h"
+#include "Configuration.h"
+#include "TestUtil.h"
+#include "TestPdf.h"
+
+/// The settings the stage reads
+configuration::data myconfigdata;
+
+/**
+	@param sFolder Folder to write the files in
+	@param sOutput Receives the linearized file's name
+	@param result Receives what the stage reported
+	@return true if the stage linearized the document
+*/
+static bool Linearize(const std::string& sFolder, std::string& sOutput, JobResult& result)
+{
+	std::string sInput = sFolder + "/in.pdf";
+	sOutput = sFolder + "/out.pdf";
+	CHECK(WriteFileData(sInput, MakeTwoPagePdf()));
+	PdfDocument doc;
+	CHECK(doc.Load(sInput.c_str()));
+	LinearizeStage stage;
+	return stage.Process(doc, result) && stage.Save(doc, sOutput.c_str(), result);
+}
+
+static void TestLinearize()
+{
+	myconfigdata.clear();
+	std::string sFolder = MakeTestFolder(), sOutput;
+	JobResult result;
+	CHECK(Linearize(sFolder, sOutput, result));
+	CHECK(result.iskey("postprocess.linearize.memory"));
+
+	// The parameter dictionary comes first, and has the file's length
+	std::string sData = ReadFileData(sOutput);
+	size_t nDict = sData.find("<<");
+	CHECK((nDict != std::string::npos) && (nDict < sData.find("endobj")));
+	PdfObject params;
+	CHECK(PdfDocument::ParseValue(PdfData(sData.data(), sData.size()), nDict, params));
+	CHECK(params.Get("Linearized") != NULL);
+	CHECK((params.Get("L") != NULL) && (params.Get("L")->nValue == (__int64)sData.size()));
+	CHECK((params.Get("N") != NULL) && (params.Get("N")->nValue == 2));
+
+	// And the document reads back the same
+	PdfDocument doc;
+	CHECK(doc.Load(sOutput.c_str()));
+	PdfObject* pRoot = doc.Resolve(doc.GetTrailer().Get("Root"));
+	CHECK((pRoot != NULL) && pRoot->IsDictionary());
+	PdfObject* pPages = (pRoot != NULL) ? doc.Resolve(pRoot->Get("Pages")) : NULL;
+	CHECK((pPages != NULL) && (pPages->Get("Count") != NULL) && (pPages->Get("Count")->nValue == 2));
+	PdfObject* pKids = (pPages != NULL) ? pPages->Get("Kids") : NULL;
+	CHECK((pKids != NULL) && (pKids->items.size() == 2));
+	if ((pKids != NULL) && (pKids->items.size() == 2))
+	{
+		PdfObject* pPage = doc.Resolve(&pKids->items[1]);
+		PdfObject* pContents = (pPage != NULL) ? doc.Resolve(pPage->Get("Contents")) : NULL;
+		CHECK((pContents != NULL) && pContents->Is(PdfObject::Stream));
+		CHECK((pContents != NULL) && (pContents->sValue == "9 9 m 0 0 l\n"));
+	}
+}
+
+static void TestTooLarge()
+{
+	myconfigdata.clear();
+	myconfigdata["linearize.maxsize"] = "100";
+	std::string sFolder = MakeTestFolder(), sOutput;
+	JobResult result;
+	CHECK(!Linearize(sFolder, sOutput, result));
+	CHECK(result["postprocess.linearize.error"].find("linearize.maxsize (100)") != std::string::npos);
+
+	// No limit
+	myconfigdata["linearize.maxsize"] = "0";
+	result = JobResult();
+	CHECK(Linearize(sFolder, sOutput, result));
+	CHECK(!result.iskey("postprocess.linearize.error"));
+}
+
+int main()
+{
+	RUN_TEST(TestLinearize);
+	RUN_TEST(TestTooLarge);
+	return (g_nFailures == 0) ? 0 : 1;
+}
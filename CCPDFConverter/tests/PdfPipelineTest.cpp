@@ -0,0 +1,98 @@
+/**
+	@file
+	@brief Tests for the PDF post-processing pipeline and its metadata stage
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "PdfPipeline.h"
+#include "Configuration.h"
+#include "TestUtil.h"
+#include "TestPdf.h"
+
+/// The settings the stages read
+configuration::data myconfigdata;
+
+/**
+	@param sFile The document to process
+	@param result Receives what the pipeline reported
+	@return The document's information dictionary after the metadata stage ran (empty if none)
+*/
+static PdfObject RunMetadata(const std::string& sFile, JobResult& result)
+{
+	PdfPipeline pipeline;
+	CHECK(pipeline.AddStages("metadata"));
+	CHECK(pipeline.Run(sFile.c_str(), result));
+	PdfDocument doc;
+	CHECK(doc.Load(sFile.c_str()));
+	PdfObject* pInfo = doc.Resolve(doc.GetTrailer().Get("Info"));
+	return (pInfo != NULL) ? *pInfo : PdfObject();
+}
+
+static void TestMetadata()
+{
+	myconfigdata.clear();
+	myconfigdata["metadata.Title"] = "Caf\xE9 menu";
+	myconfigdata["metadata.Author"] = "Accounts (Q3)";
+	myconfigdata["metadata."] = "ignored";
+	std::string sFile = MakeTestFolder() + "/doc.pdf";
+	CHECK(WriteFileData(sFile, MakeTwoPagePdf()));
+	JobResult result;
+	PdfObject info = RunMetadata(sFile, result);
+	CHECK_EQUAL(std::string("metadata"), result.getstring("postprocess.stages", ""));
+	CHECK(info.Is(PdfObject::Dictionary));
+	CHECK_EQUAL((size_t)2, info.keys.size());
+
+	// Plain ASCII stays a literal string, the rest is UTF-16BE
+	const PdfObject* pAuthor = info.Get("Author");
+	CHECK((pAuthor != NULL) && pAuthor->Is(PdfObject::String));
+	CHECK((pAuthor != NULL) && (pAuthor->sValue == "Accounts \\(Q3\\)"));
+	const PdfObject* pTitle = info.Get("Title");
+	CHECK((pTitle != NULL) && pTitle->Is(PdfObject::HexString));
+	CHECK((pTitle != NULL) && (pTitle->sValue == "FEFF00430061006600E90020006D0065006E0075"));
+}
+
+static void TestExistingInfo()
+{
+	// What's already in the information dictionary is kept, unless a setting replaces it
+	std::vector<std::string> objects;
+	objects.push_back("<</Type /Catalog /Pages 2 0 R>>");
+	objects.push_back("<</Type /Pages /Kids [] /Count 0>>");
+	objects.push_back("<</Producer (GPL Ghostscript) /Title (Untitled)>>");
+	std::string sFile = MakeTestFolder() + "/doc.pdf";
+	CHECK(WriteFileData(sFile, MakePdf(objects, "/Root 1 0 R /Info 3 0 R")));
+	myconfigdata.clear();
+	myconfigdata["metadata.Title"] = "Report";
+	JobResult result;
+	PdfObject info = RunMetadata(sFile, result);
+	CHECK((info.Get("Producer") != NULL) && (info.Get("Producer")->sValue == "GPL Ghostscript"));
+	CHECK((info.Get("Title") != NULL) && (info.Get("Title")->sValue == "Report"));
+}
+
+int main()
+{
+	RUN_TEST(TestMetadata);
+	RUN_TEST(TestExistingInfo);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+/**
+	@file
+	@brief Tests of RecoveryJournal: the lines a job adds, and reading them back
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "RecoveryJournal.h"
+#include "TempFiles.h"
+#include "TestUtil.h"
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+/// Opens up the protected parts of RecoveryJournal
+class TestJournal : public RecoveryJournal
+{
+public:
+	using RecoveryJournal::FormatRecord;
+};
+
+/**
+	@param pText The journal
+	@param jobs Receives the jobs that didn't end
+	@param order Receives the IDs of the jobs, in the order they began
+	@return Count of lines read
+*/
+static int ReadText(const char* pText, std::map<std::string, RecoveryJournal::Record>& jobs, std::vector<std::string>& order)
+{
+	jobs.clear();
+	order.clear();
+	std::istringstream in(pText);
+	return RecoveryJournal::Read(in, jobs, order);
+}
+
+/**
+	@param jobs Receives the jobs that didn't end
+	@return Count of lines in the journal the tests' RecoveryJournal writes
+*/
+static int ReadJournal(std::map<std::string, RecoveryJournal::Record>& jobs)
+{
+	jobs.clear();
+	std::vector<std::string> order;
+	std::ifstream in((std::string(tempFiles.GetRoot()) + "/recovery.journal").c_str(), std::ios::binary);
+	return RecoveryJournal::Read(in, jobs, order);
+}
+
+/**
+	@param sFile The file name
+	@return true if the file is there
+*/
+static bool FileExists(const std::string& sFile)
+{
+	struct stat st;
+	return stat(sFile.c_str(), &st) == 0;
+}
+
+static void TestRead()
+{
+	std::map<std::string, RecoveryJournal::Record> jobs;
+	std::vector<std::string> order;
+	CHECK_EQUAL(8, ReadText(
+		"begin\t1\towner-a\tC:\\Out\\a.pdf.inprogress\tC:\\Out\\a.pdf\tC:\\Temp\\capture-1.ps\t1\r\n"
+		"begin\t2\towner-b\tC:\\Out\\b.pdf.inprogress\tC:\\Out\\b.pdf\t\t2\r\n"
+		"captured\t1\r\n"
+		"begin\t3\towner-a\tc.pdf.inprogress\tc.pdf\t\t1\r\n"
+		"published\t2\r\n"
+		"end\t3\r\n"
+		"captured\t2\r\n"
+		"begin\t4\towner-c\td.pdf.inprogress\td.pdf\t\t1\td.pdf\r\n", jobs, order));
+
+	CHECK_EQUAL((size_t)3, jobs.size());
+	RecoveryJournal::Record& first = jobs["1"];
+	CHECK_EQUAL(std::string("owner-a"), first.sOwner);
+	CHECK_EQUAL(std::string("C:\\Out\\a.pdf.inprogress"), first.sPartial);
+	CHECK_EQUAL(std::string("C:\\Out\\a.pdf"), first.sTarget);
+	CHECK_EQUAL(std::string("C:\\Temp\\capture-1.ps"), first.sCapture);
+	CHECK_EQUAL(1, first.nAttempt);
+	CHECK(first.bCaptured);
+	CHECK(!first.bPublished);
+	// (Written before names were reserved)
+	CHECK_EQUAL(std::string(""), first.sReserved);
+	RecoveryJournal::Record& second = jobs["2"];
+	CHECK_EQUAL(std::string("owner-b"), second.sOwner);
+	CHECK_EQUAL(std::string(""), second.sCapture);
+	CHECK_EQUAL(2, second.nAttempt);
+	CHECK(second.bCaptured);
+	CHECK(second.bPublished);
+	CHECK_EQUAL(std::string(""), second.sReserved);
+	CHECK_EQUAL(std::string("d.pdf"), jobs["4"].sReserved);
+
+	// Ended jobs are in the order too
+	CHECK(order == MakeList("1", "2", "3", "4", NULL));
+}
+
+static void TestReadBadLines()
+{
+	std::map<std::string, RecoveryJournal::Record> jobs;
+	std::vector<std::string> order;
+	// Lines that are cut short, or don't belong to a job that began, are passed over
+	CHECK_EQUAL(9, ReadText(
+		"\n"
+		"begin\t1\towner\tpartial\ttarget\tcapture\n"
+		"begin\n"
+		"something\t1\n"
+		"captured\t9\n"
+		"published\n"
+		"end\n"
+		"begin\t2\towner\tpartial\ttarget\tcapture\t1\treserved\tmore\n"
+		"published\t9", jobs, order));
+	CHECK_EQUAL((size_t)1, jobs.size());
+	CHECK(jobs.find("2") != jobs.end());
+	CHECK(!jobs["2"].bPublished);
+	CHECK_EQUAL(std::string("reserved"), jobs["2"].sReserved);
+	CHECK(order == MakeList("2", NULL));
+
+	CHECK_EQUAL(0, ReadText("", jobs, order));
+	CHECK(jobs.empty());
+}
+
+static void TestFormatRecord()
+{
+	RecoveryJournal::Record record;
+	record.sOwner = "owner";
+	record.sPartial = "a.pdf.inprogress";
+	record.sTarget = "a.pdf";
+	record.sCapture = "capture-1.ps";
+	record.sReserved = "a.pdf";
+	record.nAttempt = 2;
+	record.bPublished = true;
+	std::string sLines = TestJournal::FormatRecord("1", record);
+	CHECK_EQUAL(std::string("begin\t1\towner\ta.pdf.inprogress\ta.pdf\tcapture-1.ps\t2\ta.pdf\r\npublished\t1\r\n"), sLines);
+
+	// What's written is read back the same
+	std::map<std::string, RecoveryJournal::Record> jobs;
+	std::vector<std::string> order;
+	record.bCaptured = true;
+	CHECK_EQUAL(3, ReadText(TestJournal::FormatRecord("1", record).c_str(), jobs, order));
+	CHECK_EQUAL(record.sOwner, jobs["1"].sOwner);
+	CHECK_EQUAL(record.sPartial, jobs["1"].sPartial);
+	CHECK_EQUAL(record.sTarget, jobs["1"].sTarget);
+	CHECK_EQUAL(record.sCapture, jobs["1"].sCapture);
+	CHECK_EQUAL(record.sReserved, jobs["1"].sReserved);
+	CHECK_EQUAL(record.nAttempt, jobs["1"].nAttempt);
+	CHECK(jobs["1"].bCaptured);
+	CHECK(jobs["1"].bPublished);
+}
+
+static void TestJob()
+{
+	tempFiles.Create();
+	std::string sCapture = std::string(tempFiles.GetRoot()) + "/capture-7.ps";
+	std::ofstream(sCapture.c_str()) << "%!PS";
+	std::map<std::string, RecoveryJournal::Record> jobs;
+	{
+		RecoveryJournal journal;
+		journal.Begin("7", "a.pdf.inprogress", "a.pdf", "a.pdf", sCapture.c_str(), 1);
+		CHECK_EQUAL(1, ReadJournal(jobs));
+		CHECK_EQUAL(std::string("test-owner"), jobs["7"].sOwner);
+		CHECK_EQUAL(sCapture, jobs["7"].sCapture);
+		CHECK_EQUAL(std::string("a.pdf"), jobs["7"].sReserved);
+		CHECK(!jobs["7"].bCaptured);
+
+		journal.Captured();
+		journal.Published();
+		CHECK_EQUAL(3, ReadJournal(jobs));
+		CHECK(jobs["7"].bCaptured);
+		CHECK(jobs["7"].bPublished);
+
+		// The end removes the capture too
+		journal.End();
+		CHECK_EQUAL(4, ReadJournal(jobs));
+		CHECK(jobs.empty());
+		CHECK(!FileExists(sCapture));
+		// Once only
+		journal.End();
+		journal.Published();
+		CHECK_EQUAL(4, ReadJournal(jobs));
+	}
+	{
+		// Without a capture, there's nothing to mark captured
+		RecoveryJournal journal;
+		journal.Begin("8", "b.pdf.inprogress", "b.pdf", NULL, NULL, 1);
+		journal.Captured();
+		CHECK_EQUAL(5, ReadJournal(jobs));
+		CHECK_EQUAL(std::string(""), jobs["8"].sCapture);
+		CHECK_EQUAL(std::string(""), jobs["8"].sReserved);
+		CHECK(!jobs["8"].bCaptured);
+	}
+	tempFiles.Close();
+}
+
+int main()
+{
+	RUN_TEST(TestRead);
+	RUN_TEST(TestReadBadLines);
+	RUN_TEST(TestFormatRecord);
+	RUN_TEST(TestJob);
+	return (g_nFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+/**
+	@file
+	@brief Stand-in for JobResult.cpp (which needs the output writer): the tested sources only set values in the result
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "JobResult.h"
+
+JobResult::JobResult()
+{
+	m_sId = "test";
+	(*this)["job.id"] = m_sId;
+}
+
+/**
+	@param sKey The key to set
+	@param nValue The value to set
+*/
+void JobResult::SetInt(const std::string& sKey, __int64 nValue)
+{
+	char cNum[32];
+	sprintf_s(cNum, sizeof(cNum), "%I64d", nValue);
+	(*this)[sKey] = cNum;
+}
+
+/**
+	@param sKey The key to set
+	@param dMilliseconds The time to set
+*/
+void JobResult::SetTime(const std::string& sKey, double dMilliseconds)
+{
+	char cNum[32];
+	sprintf_s(cNum, sizeof(cNum), "%.3f", dMilliseconds);
+	(*this)[sKey] = cNum;
+}
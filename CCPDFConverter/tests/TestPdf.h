@@ -0,0 +1,112 @@
+/**
+	@file
+	@brief Small PDF documents for the parser and post-processing tests
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _TESTPDF_H_
+#define _TESTPDF_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+	@param objects The indirect objects' values, numbered from 1
+	@param sTrailer Trailer keys added after Size (e.g. "/Root 1 0 R")
+	@return The document, with a classic cross-reference table
+*/
+static inline std::string MakePdf(const std::vector<std::string>& objects, const std::string& sTrailer)
+{
+	std::string sRet = "%PDF-1.4\n";
+	std::vector<size_t> offsets;
+	char cLine[64];
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		offsets.push_back(sRet.size());
+		sprintf(cLine, "%u 0 obj\n", (unsigned)i + 1);
+		sRet += cLine + objects[i] + "\nendobj\n";
+	}
+	size_t nXref = sRet.size();
+	sprintf(cLine, "xref\n0 %u\n0000000000 65535 f \n", (unsigned)objects.size() + 1);
+	sRet += cLine;
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		sprintf(cLine, "%010u 00000 n \n", (unsigned)offsets[i]);
+		sRet += cLine;
+	}
+	sprintf(cLine, "trailer\n<</Size %u ", (unsigned)objects.size() + 1);
+	sRet += cLine + sTrailer + ">>\n";
+	sprintf(cLine, "startxref\n%u\n%%%%EOF\n", (unsigned)nXref);
+	return sRet + cLine;
+}
+
+/**
+	@param sFile The file to write
+	@param sData What to write in it
+	@return true if written
+*/
+static inline bool WriteFileData(const std::string& sFile, const std::string& sData)
+{
+	FILE* pFile = fopen(sFile.c_str(), "wb");
+	if (pFile == NULL)
+		return false;
+	bool bRet = fwrite(sData.data(), 1, sData.size(), pFile) == sData.size();
+	return (fclose(pFile) == 0) && bRet;
+}
+
+/**
+	@param sFile The file to read
+	@return What's in it (empty if it couldn't be read)
+*/
+static inline std::string ReadFileData(const std::string& sFile)
+{
+	std::string sRet;
+	FILE* pFile = fopen(sFile.c_str(), "rb");
+	if (pFile == NULL)
+		return sRet;
+	char cBlock[4096];
+	size_t nRead;
+	while ((nRead = fread(cBlock, 1, sizeof(cBlock), pFile)) > 0)
+		sRet.append(cBlock, nRead);
+	fclose(pFile);
+	return sRet;
+}
+
+/**
+	@return A document with two pages, each with a content stream
+*/
+static inline std::string MakeTwoPagePdf()
+{
+	std::vector<std::string> objects;
+	objects.push_back("<</Type /Catalog /Pages 2 0 R>>");
+	objects.push_back("<</Type /Pages /Kids [3 0 R 4 0 R] /Count 2 /MediaBox [0 0 612 792]>>");
+	objects.push_back("<</Type /Page /Parent 2 0 R /Contents 5 0 R>>");
+	objects.push_back("<</Type /Page /Parent 2 0 R /Contents 6 0 R>>");
+	objects.push_back("<</Length 12>>\nstream\n0 0 m 9 9 l\nendstream");
+	objects.push_back("<</Length 12>>\nstream\n9 9 m 0 0 l\nendstream");
+	return MakePdf(objects, "/Root 1 0 R");
+}
+
+#endif   //#define _TESTPDF_H_
@@ -0,0 +1,97 @@
+/**
+	@file
+	@brief Stand-in for TempFiles.cpp (which needs the Windows process and thread functions): a root folder of the test's own
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#include "stdafx.h"
+#include "TempFiles.h"
+
+/// Name the test process goes by (it's the only one running)
+#define TEST_OWNER		"test-owner"
+
+TempFiles tempFiles;
+
+TempFiles::TempFiles() : m_bCreated(false), m_hSweep(NULL), m_bStop(false), m_nMaxAge(0)
+{
+	m_cRoot[0] = m_cJobFolder[0] = '\0';
+}
+
+TempFiles::~TempFiles()
+{
+	Close();
+}
+
+/**
+	Creates a new root folder (the job folder is the root itself)
+*/
+void TempFiles::Create()
+{
+	Close();
+	char cTemplate[] = "/tmp/ccpdftest-XXXXXX";
+	if (mkdtemp(cTemplate) == NULL)
+		return;
+	strcpy_s(m_cRoot, MAX_PATH, cTemplate);
+	strcpy_s(m_cJobFolder, MAX_PATH, cTemplate);
+	m_bCreated = true;
+}
+
+/**
+	Removes the root folder
+*/
+void TempFiles::Close()
+{
+	if (!m_bCreated)
+		return;
+	RemoveFolder(m_cRoot);
+	m_cRoot[0] = m_cJobFolder[0] = '\0';
+	m_bCreated = false;
+}
+
+/**
+	@param lpFolder The folder to remove
+*/
+void TempFiles::RemoveFolder(LPCTSTR lpFolder)
+{
+	if (system(("rm -rf '" + std::string(lpFolder) + "'").c_str()) != 0)
+		fprintf(stderr, "could not remove %s\n", lpFolder);
+}
+
+/**
+	@param lpName Receives the name
+	@param nSize Size of lpName (characters)
+*/
+void TempFiles::GetOwnerName(LPTSTR lpName, size_t nSize)
+{
+	strcpy_s(lpName, nSize, TEST_OWNER);
+}
+
+/**
+	@param lpName The name of a job folder
+	@return true if it's the test's own
+*/
+bool TempFiles::IsOwnerRunning(LPCTSTR lpName)
+{
+	return strcmp(lpName, TEST_OWNER) == 0;
+}
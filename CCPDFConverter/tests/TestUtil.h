@@ -0,0 +1,89 @@
+/**
+	@file
+	@brief Minimal checks for the unit tests (each test is a program of its own, run by ctest)
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _TESTUTIL_H_
+#define _TESTUTIL_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/// Count of failed checks in this test program
+static int g_nFailures = 0;
+
+/// Checks a condition (the test goes on if it fails)
+#define CHECK(x) \
+	do { if (!(x)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x); g_nFailures++; } } while (0)
+
+/// Checks that two values are equal
+#define CHECK_EQUAL(expected, actual) \
+	do { if (!((expected) == (actual))) { fprintf(stderr, "%s:%d: CHECK_EQUAL(%s, %s) failed\n", __FILE__, __LINE__, #expected, #actual); g_nFailures++; } } while (0)
+
+/// Runs a test function
+#define RUN_TEST(f) \
+	do { int nBefore = g_nFailures; f(); printf("%s %s\n", (g_nFailures == nBefore) ? "ok  " : "FAIL", #f); } while (0)
+
+/**
+	@param pFirst The strings (a NULL-terminated list)
+	@return The strings, as a vector
+*/
+static inline std::vector<std::string> MakeList(const char* pFirst, ...)
+{
+	std::vector<std::string> ret;
+	va_list args;
+	va_start(args, pFirst);
+	for (const char* p = pFirst; p != NULL; p = va_arg(args, const char*))
+		ret.push_back(p);
+	va_end(args);
+	return ret;
+}
+
+/**
+	@return A new empty folder under the system temp folder (removed at exit)
+*/
+static inline std::string MakeTestFolder()
+{
+	char cTemplate[] = "/tmp/ccpdftest-XXXXXX";
+	std::string sFolder = mkdtemp(cTemplate);
+	static std::vector<std::string> folders;
+	folders.push_back(sFolder);
+	struct Cleanup
+	{
+		~Cleanup()
+		{
+			for (std::vector<std::string>::const_iterator i = folders.begin(); i != folders.end(); i++)
+				if (system(("rm -rf '" + *i + "'").c_str()) != 0)
+					fprintf(stderr, "could not remove %s\n", i->c_str());
+		}
+	};
+	static Cleanup cleanup;
+	return sFolder;
+}
+
+#endif   //#define _TESTUTIL_H_
@@ -0,0 +1,568 @@
+/**
+	@file
+	@brief Stand-ins for the Windows headers, so converter sources can be built into the unit tests
+*/
+
+
+/*
+ * CC PDF Converter: Windows PDF Printer with Creative Commons license support
+ * Excel to PDF Converter: Excel PDF printing addin, keeping hyperlinks AND Creative Commons license support
+ * Copyright (C) 2007-2010 Guy Hachlili <hguy@cogniview.com>, Cogniview LTD.
+ * 
+ * This file is part of CC PDF Converter / Excel to PDF Converter
+ * 
+ * CC PDF Converter and Excel to PDF Converter are free software;
+ * you can redistribute them and/or modify them under the terms of the 
+ * GNU General Public License as published by the Free Software Foundation;
+ * either version 2 of the License, or (at your option) any later version.
+ * 
+ * CC PDF Converter and Excel to PDF Converter are is distributed in the hope 
+ * that they will be useful, but WITHOUT ANY WARRANTY; without even the implied 
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. * 
+ */
+
+#ifndef _COMPAT_STDAFX_H_
+#define _COMPAT_STDAFX_H_
+
+// Found before the converter's own StdAfx.h (which needs windows.h); only the few Windows
+// and CRT names the tested sources use are defined here
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <regex>
+#include <string>
+
+#define __int64 long long
+
+/**
+	@param pFormat A Windows CRT format
+	@return The same format for the C library ("%I64d" becomes "%lld")
+*/
+static inline std::string CompatFormat(const char* pFormat)
+{
+	std::string sRet = pFormat;
+	for (std::string::size_type n = 0; (n = sRet.find("I64", n)) != std::string::npos; )
+		sRet.replace(n, 3, "ll");
+	return sRet;
+}
+
+/**
+	@param pBuffer The buffer to write to
+	@param nSize Size of the buffer
+	@param pFormat The format
+	@return The count of characters written
+*/
+static inline int sprintf_s(char* pBuffer, size_t nSize, const char* pFormat, ...)
+{
+	va_list args;
+	va_start(args, pFormat);
+	int nRet = vsnprintf(pBuffer, nSize, CompatFormat(pFormat).c_str(), args);
+	va_end(args);
+	return nRet;
+}
+
+/**
+	@param pStr The string to read
+	@param pFormat The format: each %s, %c and %[ is followed by the buffer size in the arguments
+	@return The count of fields assigned
+
+	Each field is read on its own with sscanf, so the buffer sizes can be dropped (and
+	used as the field width).
+*/
+static inline int sscanf_s(const char* pStr, const char* pFormat, ...)
+{
+	va_list args;
+	va_start(args, pFormat);
+	std::string sFormat = CompatFormat(pFormat);
+	const char* pFmt = sFormat.c_str();
+	int nRet = 0;
+	while (*pFmt != '\0')
+	{
+		// Literal text up to the next field
+		const char* pField = pFmt;
+		while ((*pField != '\0') && ((*pField != '%') || (pField[1] == '%')))
+			pField += (*pField == '%') ? 2 : 1;
+		if (pField > pFmt)
+		{
+			int nRead = -1;
+			sscanf(pStr, (std::string(pFmt, pField) + "%n").c_str(), &nRead);
+			if (nRead < 0)
+				break;
+			pStr += nRead;
+			pFmt = pField;
+			continue;
+		}
+
+		// The field: flags and width, length modifiers and the conversion
+		const char* pEnd = pField + 1;
+		bool bSkip = (*pEnd == '*');
+		if (bSkip)
+			pEnd++;
+		bool bWidth = (*pEnd >= '0') && (*pEnd <= '9');
+		while ((*pEnd >= '0') && (*pEnd <= '9'))
+			pEnd++;
+		while ((*pEnd != '\0') && (strchr("hlLqjzt", *pEnd) != NULL))
+			pEnd++;
+		char cType = *pEnd;
+		if (cType == '\0')
+			break;
+		if (cType == '[')
+		{
+			// A set may start with ']' (or "^]")
+			pEnd++;
+			if (*pEnd == '^')
+				pEnd++;
+			if (*pEnd == ']')
+				pEnd++;
+			while ((*pEnd != '\0') && (*pEnd != ']'))
+				pEnd++;
+			if (*pEnd == '\0')
+				break;
+		}
+		pEnd++;
+		std::string sField(pField, pEnd);
+		pFmt = pEnd;
+
+		int nRead = -1, nAssigned;
+		if (bSkip)
+			nAssigned = (sscanf(pStr, (sField + "%n").c_str(), &nRead), 1);
+		else if ((cType == 's') || (cType == 'c') || (cType == '['))
+		{
+			char* pBuffer = va_arg(args, char*);
+			unsigned int nSize = va_arg(args, unsigned int);
+			if (!bWidth && (cType != 'c'))
+				sField.insert(1, std::to_string(nSize - 1));
+			nAssigned = sscanf(pStr, (sField + "%n").c_str(), pBuffer, &nRead);
+		}
+		else
+			nAssigned = sscanf(pStr, (sField + "%n").c_str(), va_arg(args, void*), &nRead);
+		if ((nAssigned < 1) || (nRead < 0))
+			break;
+		if (!bSkip)
+			nRet++;
+		pStr += nRead;
+	}
+	va_end(args);
+	return nRet;
+}
+
+/**
+	@param pStr The string to read
+	@param pEnd Receives the location after the number
+	@param nBase The base of the number
+	@return The number read
+*/
+static inline unsigned long long _strtoui64(const char* pStr, char** pEnd, int nBase)
+{
+	return strtoull(pStr, pEnd, nBase);
+}
+
+/**
+	@param pStr1 A string
+	@param pStr2 A string to compare to
+	@return 0 if they're the same (ignoring case), less than 0 if pStr1 comes first
+*/
+static inline int _stricmp(const char* pStr1, const char* pStr2)
+{
+	return strcasecmp(pStr1, pStr2);
+}
+
+/**
+	@param pDest The buffer to copy to
+	@param nSize Size of the buffer
+	@param pSrc The string to copy
+	@return 0 if copied, ERANGE if it's too long (the buffer is then emptied)
+*/
+static inline int strcpy_s(char* pDest, size_t nSize, const char* pSrc)
+{
+	if (strlen(pSrc) >= nSize)
+	{
+		pDest[0] = '\0';
+		return ERANGE;
+	}
+	strcpy(pDest, pSrc);
+	return 0;
+}
+
+// windows.h defines these as macros, which the C++ library headers can't take
+template<typename T> static inline T min(T a, T b) {return (b < a) ? b : a;}
+template<typename T> static inline T max(T a, T b) {return (a < b) ? b : a;}
+
+// Windows types
+typedef unsigned int DWORD;
+typedef unsigned short WORD;
+typedef int BOOL;
+typedef char TCHAR;
+typedef const char* LPCTSTR;
+typedef char* LPTSTR;
+typedef void* HANDLE;
+typedef void* LPVOID;
+typedef long LONG;
+typedef void* HMODULE;
+#define WINAPI
+#define TRUE				1
+#define FALSE				0
+#define MAX_PATH			260
+#define _T(x)				x
+#define INVALID_HANDLE_VALUE	((HANDLE)(long)-1)
+#define INVALID_FILE_ATTRIBUTES	((DWORD)-1)
+
+// Error codes
+#define ERROR_SUCCESS			0
+#define ERROR_FILE_NOT_FOUND	2
+#define ERROR_PATH_NOT_FOUND	3
+#define ERROR_ACCESS_DENIED		5
+#define ERROR_FILE_EXISTS		80
+#define ERROR_INSUFFICIENT_BUFFER	122
+
+/// The last error of this thread (for GetLastError; not static, so all the sources share it)
+inline DWORD& CompatLastError()
+{
+	static __thread DWORD dwError = ERROR_SUCCESS;
+	return dwError;
+}
+
+static inline DWORD GetLastError() {return CompatLastError();}
+static inline void SetLastError(DWORD dwError) {CompatLastError() = dwError;}
+
+/**
+	@param bOK Result of a C library call
+	@return bOK (the last error is set from errno if it's false)
+*/
+static inline BOOL CompatResult(bool bOK)
+{
+	if (!bOK)
+		SetLastError((errno == EEXIST) ? ERROR_FILE_EXISTS : (errno == ENOENT) ? ERROR_FILE_NOT_FOUND : (errno == ENOTDIR) ? ERROR_PATH_NOT_FOUND : ERROR_ACCESS_DENIED);
+	return bOK ? TRUE : FALSE;
+}
+
+/**
+	@param lpFile A Windows file name
+	@return The same name with '/' for '\\'
+*/
+static inline std::string CompatPath(LPCTSTR lpFile)
+{
+	std::string sRet(lpFile);
+	for (std::string::iterator i = sRet.begin(); i != sRet.end(); i++)
+		if (*i == '\\')
+			*i = '/';
+	return sRet;
+}
+
+/**
+	@param ppFile Receives the file (NULL if it couldn't be opened)
+	@param pFile The file name
+	@param pMode Open mode, as fopen takes it
+	@return 0 if opened, the error otherwise
+*/
+static inline int fopen_s(FILE** ppFile, const char* pFile, const char* pMode)
+{
+	*ppFile = fopen(CompatPath(pFile).c_str(), pMode);
+	return (*ppFile != NULL) ? 0 : errno;
+}
+
+/// File descriptor of a handle from CreateFile
+#define COMPAT_FD(h)		((int)(long)(h) - 1)
+
+// Local time
+typedef struct
+{
+	WORD wYear, wMonth, wDayOfWeek, wDay, wHour, wMinute, wSecond, wMilliseconds;
+} SYSTEMTIME;
+
+/**
+	@param pTime Receives the local time
+*/
+static inline void GetLocalTime(SYSTEMTIME* pTime)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	struct tm t;
+	localtime_r(&ts.tv_sec, &t);
+	pTime->wYear = (WORD)(t.tm_year + 1900);
+	pTime->wMonth = (WORD)(t.tm_mon + 1);
+	pTime->wDayOfWeek = (WORD)t.tm_wday;
+	pTime->wDay = (WORD)t.tm_mday;
+	pTime->wHour = (WORD)t.tm_hour;
+	pTime->wMinute = (WORD)t.tm_min;
+	pTime->wSecond = (WORD)t.tm_sec;
+	pTime->wMilliseconds = (WORD)(ts.tv_nsec / 1000000);
+}
+
+// Files
+#define GENERIC_READ			0x80000000
+#define GENERIC_WRITE			0x40000000
+#define FILE_APPEND_DATA		0x00000004
+#define FILE_SHARE_READ			0x00000001
+#define FILE_SHARE_WRITE		0x00000002
+#define FILE_SHARE_DELETE		0x00000004
+#define CREATE_NEW				1
+#define CREATE_ALWAYS			2
+#define OPEN_EXISTING			3
+#define OPEN_ALWAYS				4
+#define FILE_ATTRIBUTE_HIDDEN	0x00000002
+#define FILE_ATTRIBUTE_NORMAL	0x00000080
+#define FILE_BEGIN				0
+#define FILE_CURRENT			1
+#define FILE_END				2
+#define LOCKFILE_EXCLUSIVE_LOCK	0x00000002
+
+typedef struct
+{
+	DWORD Internal, InternalHigh, Offset, OffsetHigh;
+	HANDLE hEvent;
+} OVERLAPPED;
+
+typedef struct
+{
+	DWORD dwLowDateTime, dwHighDateTime;
+} FILETIME;
+
+typedef struct
+{
+	DWORD dwFileAttributes;
+	FILETIME ftCreationTime, ftLastAccessTime, ftLastWriteTime;
+	DWORD nFileSizeHigh, nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef enum {GetFileExInfoStandard} GET_FILEEX_INFO_LEVELS;
+
+/**
+	@param lpFile The file name
+	@param dwAccess GENERIC_READ and/or GENERIC_WRITE, or FILE_APPEND_DATA
+	@param dwDisposition CREATE_NEW, CREATE_ALWAYS, OPEN_EXISTING or OPEN_ALWAYS
+	@return The file handle, INVALID_HANDLE_VALUE if it couldn't be opened (sharing and
+	attributes are ignored)
+*/
+static inline HANDLE CreateFile(LPCTSTR lpFile, DWORD dwAccess, DWORD, void*, DWORD dwDisposition, DWORD, HANDLE)
+{
+	int nFlags = ((dwAccess & GENERIC_READ) && (dwAccess & GENERIC_WRITE)) ? O_RDWR : (dwAccess & (GENERIC_WRITE | FILE_APPEND_DATA)) ? O_WRONLY : O_RDONLY;
+	if (dwAccess == FILE_APPEND_DATA)
+		nFlags |= O_APPEND;
+	switch (dwDisposition)
+	{
+	case CREATE_NEW:	nFlags |= O_CREAT | O_EXCL; break;
+	case CREATE_ALWAYS:	nFlags |= O_CREAT | O_TRUNC; break;
+	case OPEN_ALWAYS:	nFlags |= O_CREAT; break;
+	}
+	int fd = open(CompatPath(lpFile).c_str(), nFlags, 0666);
+	if (!CompatResult(fd >= 0))
+		return INVALID_HANDLE_VALUE;
+	return (HANDLE)(long)(fd + 1);
+}
+
+/// Closes a file (other handles need no closing)
+static inline BOOL CloseHandle(HANDLE hFile) {return (COMPAT_FD(hFile) < 0) || CompatResult(close(COMPAT_FD(hFile)) == 0);}
+
+static inline BOOL ReadFile(HANDLE hFile, void* pData, DWORD dwSize, DWORD* pRead, OVERLAPPED*)
+{
+	ssize_t nRead = read(COMPAT_FD(hFile), pData, dwSize);
+	*pRead = (nRead > 0) ? (DWORD)nRead : 0;
+	return CompatResult(nRead >= 0);
+}
+
+static inline BOOL WriteFile(HANDLE hFile, const void* pData, DWORD dwSize, DWORD* pWritten, OVERLAPPED*)
+{
+	ssize_t nWritten = write(COMPAT_FD(hFile), pData, dwSize);
+	*pWritten = (nWritten > 0) ? (DWORD)nWritten : 0;
+	return CompatResult(nWritten == (ssize_t)dwSize);
+}
+
+static inline DWORD SetFilePointer(HANDLE hFile, long nDistance, long*, DWORD dwMethod)
+{
+	off_t nPos = lseek(COMPAT_FD(hFile), nDistance, (dwMethod == FILE_BEGIN) ? SEEK_SET : (dwMethod == FILE_CURRENT) ? SEEK_CUR : SEEK_END);
+	return CompatResult(nPos >= 0) ? (DWORD)nPos : (DWORD)-1;
+}
+
+static inline BOOL SetEndOfFile(HANDLE hFile)
+{
+	int fd = COMPAT_FD(hFile);
+	return CompatResult(ftruncate(fd, lseek(fd, 0, SEEK_CUR)) == 0);
+}
+
+/// Locks the whole file (the range is ignored)
+static inline BOOL LockFileEx(HANDLE hFile, DWORD dwFlags, DWORD, DWORD, DWORD, OVERLAPPED*)
+{
+	return CompatResult(flock(COMPAT_FD(hFile), (dwFlags & LOCKFILE_EXCLUSIVE_LOCK) ? LOCK_EX : LOCK_SH) == 0);
+}
+
+static inline BOOL UnlockFileEx(HANDLE hFile, DWORD, DWORD, DWORD, OVERLAPPED*)
+{
+	return CompatResult(flock(COMPAT_FD(hFile), LOCK_UN) == 0);
+}
+
+/// Fills in the attributes and size only (no times)
+static inline BOOL GetFileAttributesEx(LPCTSTR lpFile, GET_FILEEX_INFO_LEVELS, WIN32_FILE_ATTRIBUTE_DATA* pData)
+{
+	struct stat st;
+	if (!CompatResult(stat(CompatPath(lpFile).c_str(), &st) == 0))
+		return FALSE;
+	memset(pData, 0, sizeof(*pData));
+	pData->dwFileAttributes = S_ISDIR(st.st_mode) ? 0x10 : FILE_ATTRIBUTE_NORMAL;
+	pData->nFileSizeHigh = (DWORD)((unsigned long long)st.st_size >> 32);
+	pData->nFileSizeLow = (DWORD)st.st_size;
+	return TRUE;
+}
+
+static inline DWORD GetFileAttributes(LPCTSTR lpFile)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	return GetFileAttributesEx(lpFile, GetFileExInfoStandard, &data) ? data.dwFileAttributes : INVALID_FILE_ATTRIBUTES;
+}
+
+static inline BOOL DeleteFile(LPCTSTR lpFile) {return CompatResult(unlink(CompatPath(lpFile).c_str()) == 0);}
+
+#define MOVEFILE_REPLACE_EXISTING	0x00000001
+
+/// Replaces the destination whatever the flags are
+static inline BOOL MoveFileEx(LPCTSTR lpFrom, LPCTSTR lpTo, DWORD)
+{
+	return CompatResult(rename(CompatPath(lpFrom).c_str(), CompatPath(lpTo).c_str()) == 0);
+}
+
+// Synchronization: the tests run one thread, so a named mutex is never waited for
+#define INFINITE				0xFFFFFFFF
+#define WAIT_OBJECT_0			0
+#define COMPAT_MUTEX			((HANDLE)(long)-2)
+
+static inline HANDLE CreateMutex(void*, BOOL, LPCTSTR) {return COMPAT_MUTEX;}
+static inline DWORD WaitForSingleObject(HANDLE, DWORD) {return WAIT_OBJECT_0;}
+static inline BOOL ReleaseMutex(HANDLE) {return TRUE;}
+static inline DWORD WaitForMultipleObjects(DWORD, const HANDLE*, BOOL, DWORD) {return WAIT_OBJECT_0;}
+static inline LONG InterlockedIncrement(volatile LONG* pValue) {return __sync_add_and_fetch(pValue, 1);}
+
+// Threads: none are started by the tests (the code falls back to doing the work itself)
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+#define COMPAT_THREAD			((HANDLE)(long)-3)
+
+static inline HANDLE CreateThread(void*, size_t, LPTHREAD_START_ROUTINE, LPVOID, DWORD, DWORD*)
+{
+	SetLastError(ERROR_ACCESS_DENIED);
+	return NULL;
+}
+
+static inline HANDLE GetCurrentThread() {return COMPAT_THREAD;}
+
+/// Thread times aren't kept
+static inline BOOL GetThreadTimes(HANDLE, FILETIME*, FILETIME*, FILETIME*, FILETIME*)
+{
+	SetLastError(ERROR_ACCESS_DENIED);
+	return FALSE;
+}
+
+typedef struct
+{
+	DWORD dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+static inline void GetSystemInfo(SYSTEM_INFO* pInfo) {pInfo->dwNumberOfProcessors = 1;}
+
+// Libraries: a DLL is looked for as the shared library of the same name (zlib1.dll is libz.so.1)
+static inline HMODULE LoadLibrary(LPCTSTR lpFile)
+{
+	std::string sFile(lpFile);
+	if ((sFile.size() >= 9) && (sFile.compare(sFile.size() - 9, 9, "zlib1.dll") == 0))
+		sFile = "libz.so.1";
+	return dlopen(sFile.c_str(), RTLD_NOW);
+}
+
+static inline void* GetProcAddress(HMODULE hModule, const char* pName) {return dlsym(hModule, pName);}
+static inline BOOL FreeLibrary(HMODULE hModule) {return dlclose(hModule) == 0;}
+
+// Text: the system code page is taken to be Latin-1
+#define CP_ACP					0
+
+static inline int MultiByteToWideChar(DWORD, DWORD, const char* pText, int nLen, wchar_t* pWide, int nWide)
+{
+	if (nLen < 0)
+		nLen = (int)strlen(pText) + 1;
+	if (pWide == NULL)
+		return nLen;
+	if (nWide < nLen)
+	{
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return 0;
+	}
+	for (int i = 0; i < nLen; i++)
+		pWide[i] = (unsigned char)pText[i];
+	return nLen;
+}
+
+// Processes: none are started by the tests
+#define CREATE_NO_WINDOW			0x08000000
+#define BELOW_NORMAL_PRIORITY_CLASS	0x00004000
+#define ZeroMemory(p, n)		memset((p), 0, (n))
+
+typedef struct
+{
+	DWORD cb;
+} STARTUPINFO;
+
+typedef struct
+{
+	HANDLE hProcess, hThread;
+	DWORD dwProcessId, dwThreadId;
+} PROCESS_INFORMATION;
+
+static inline DWORD GetModuleFileName(HANDLE, LPTSTR, DWORD)
+{
+	SetLastError(ERROR_ACCESS_DENIED);
+	return 0;
+}
+
+static inline BOOL CreateProcess(LPCTSTR, LPTSTR, void*, void*, BOOL, DWORD, void*, LPCTSTR, STARTUPINFO*, PROCESS_INFORMATION*)
+{
+	SetLastError(ERROR_ACCESS_DENIED);
+	return FALSE;
+}
+
+// Timing
+typedef union
+{
+	long long QuadPart;
+} LARGE_INTEGER;
+
+/// Counts nanoseconds
+static inline BOOL QueryPerformanceCounter(LARGE_INTEGER* pCount)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	pCount->QuadPart = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	return TRUE;
+}
+
+static inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+	pFrequency->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+// Visual C++ 2008 has the regular expressions in std::tr1 only
+namespace std
+{
+	namespace tr1
+	{
+		using std::regex;
+		using std::smatch;
+		using std::regex_match;
+		using std::regex_search;
+		using std::regex_error;
+		namespace regex_constants = std::regex_constants;
+	}
+}
+
+#endif   //#define _COMPAT_STDAFX_H_